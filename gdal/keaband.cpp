@@ -35,6 +35,8 @@
 #include "gdal_rat.h"
 #include "libkea/KEAAttributeTable.h"
 
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <vector>
 #include <limits>
@@ -54,15 +56,9 @@ KEARasterBand::KEARasterBand( KEADataset *pDataset, int nSrcBand, GDALAccess eAc
     this->nRasterXSize = this->poDS->GetRasterXSize();          // ask the dataset for the total image size
     this->nRasterYSize = this->poDS->GetRasterYSize();
     this->eAccess = eAccess;
-
-    if( pImageIO->attributeTablePresent(nSrcBand) )
-    {
-        this->m_nAttributeChunkSize = pImageIO->getAttributeTableChunkSize(nSrcBand);
-    }
-    else
-    {
-        this->m_nAttributeChunkSize = -1; // don't report
-    }
+    // virtual bands are calculated from other bands so can't be written
+    if( pImageIO->isVirtualImageBand(nSrcBand) )
+        this->eAccess = GA_ReadOnly;
 
     // grab the imageio class and its refcount
     this->m_pImageIO = pImageIO;
@@ -70,9 +66,10 @@ KEARasterBand::KEARasterBand( KEADataset *pDataset, int nSrcBand, GDALAccess eAc
     // increment the refcount as we now have a reference to imageio
     this->m_pRefCount->IncRef();
 
-    // initialise overview variables
+    // initialise overview variables - they are found when first asked for
     m_nOverviews = 0;
     m_panOverviewBands = nullptr;
+    m_bOverviewsRead = false;
 
     // mask band
     m_pMaskBand = nullptr;
@@ -84,10 +81,15 @@ KEARasterBand::KEARasterBand( KEADataset *pDataset, int nSrcBand, GDALAccess eAc
     this->m_pAttributeTable = nullptr;  // no RAT yet
     this->m_pColorTable = nullptr;     // no color table yet
 
-    // initialise the metadata as a CPLStringList
+    // initialise the metadata as a CPLStringList, read when first asked for
     m_papszMetadataList = nullptr;
-    this->UpdateMetadataList();
+    m_bMetadataRead = false;
+    m_papszIOStats = nullptr;
     m_pszHistoBinValues = nullptr;
+
+    // any STATISTICS_* in the file are for the data as it is now
+    m_bStatisticsStale = false;
+    m_bHistogramStale = false;
 }
 
 // destructor
@@ -101,6 +103,7 @@ KEARasterBand::~KEARasterBand()
         delete this->m_pColorTable;
         // destroy the metadata
         CSLDestroy(this->m_papszMetadataList);
+        CSLDestroy(this->m_papszIOStats);
         if( this->m_pszHistoBinValues != nullptr )
         {
             // histgram bin values as a string
@@ -169,14 +172,34 @@ void KEARasterBand::UpdateMetadataList()
         m_papszMetadataList = CSLSetNameValue(m_papszMetadataList, "STATISTICS_HISTONUMBINS", osWorkingResult);
 
         // attribute table chunksize
-        if( this->m_nAttributeChunkSize != -1 )
+        if( this->m_pImageIO->attributeTablePresent(this->nBand) )
         {
-            osWorkingResult.Printf( "%d", this->m_nAttributeChunkSize );
+            osWorkingResult.Printf( "%d", (int)this->m_pImageIO->getAttributeTableChunkSize(this->nBand) );
             m_papszMetadataList = CSLSetNameValue(m_papszMetadataList, "ATTRIBUTETABLE_CHUNKSIZE", osWorkingResult );
         }
     }
 }
 
+// reads the metadata into m_papszMetadataList the first time it is needed
+// rather than for every band (and overview) when the file is opened
+void KEARasterBand::LoadMetadataList()
+{
+    CPLMutexHolderD( &m_hMutex );
+    if( !m_bMetadataRead )
+    {
+        m_bMetadataRead = true;
+        try
+        {
+            this->UpdateMetadataList();
+        }
+        catch (const kealib::KEAIOException &e)
+        {
+            CPLError( CE_Warning, CPLE_AppDefined,
+                    "Failed to read metadata: %s", e.what() );
+        }
+    }
+}
+
 // internal method to set the histogram column from a string (for metadata)
 CPLErr KEARasterBand::SetHistogramFromString(const char *pszString)
 {
@@ -194,24 +217,7 @@ CPLErr KEARasterBand::SetHistogramFromString(const char *pszString)
         i++;
     }
 
-    GDALRasterAttributeTable *pTable = this->GetDefaultRAT();
-    if( pTable == nullptr )
-    {
-        CPLFree(pszBinValues);
-        return CE_Failure;
-    }
-    
-    // find histogram column if it exists
-    int nCol = pTable->GetColOfUsage(GFU_PixelCount);
-    if( nCol == -1 )
-    {
-        if( pTable->CreateColumn("Histogram", GFT_Real, GFU_PixelCount) != CE_None )
-            return CE_Failure;
-        nCol = pTable->GetColumnCount() - 1;
-    }
-    if( nRows > pTable->GetRowCount() )
-        pTable->SetRowCount(nRows);
-
+    std::vector<int64_t> anHistogram(nRows, 0);
     char * pszWork = pszBinValues;
     for( int nBin = 0; nBin < nRows; ++nBin )
     {
@@ -219,26 +225,21 @@ CPLErr KEARasterBand::SetHistogramFromString(const char *pszString)
         if ( pszEnd != nullptr )
         {
             *pszEnd = 0;
-            double dValue = CPLAtof( pszWork );
-            pTable->SetValue(nBin, nCol, dValue);
+            anHistogram[nBin] = static_cast<int64_t>(CPLAtof( pszWork ));
             pszWork = pszEnd + 1;
         }
     }
     CPLFree(pszBinValues);
 
-    return CE_None;
+    return this->WriteHistogram(nRows, anHistogram.data());
 }
 
 // get histogram as string with values separated by '|'
 char *KEARasterBand::GetHistogramAsString()
 {
-    const GDALRasterAttributeTable *pTable = this->GetDefaultRAT();
-    if( pTable == nullptr )
-        return nullptr;
-    int nRows = pTable->GetRowCount();
-    // find histogram column if it exists
-    int nCol = pTable->GetColOfUsage(GFU_PixelCount);
-    if( nCol == -1 )
+    int nRows = 0;
+    std::vector<int64_t> anHistogram;
+    if( this->ReadHistogram(&nRows, &anHistogram) != CE_None )
         return nullptr;
 
     unsigned int nBufSize = 1024;
@@ -249,8 +250,7 @@ char *KEARasterBand::GetHistogramAsString()
     for ( int nBin = 0; nBin < nRows; ++nBin )
     {
         char szBuf[32];
-        // RAT's don't handle GUIntBig - use double instead. Cast back
-        snprintf( szBuf, 31, CPL_FRMT_GUIB, (GUIntBig)pTable->GetValueAsDouble(nBin, nCol) );
+        snprintf( szBuf, 31, CPL_FRMT_GUIB, (GUIntBig)anHistogram[nBin] );
         if ( ( nBinValuesLen + strlen( szBuf ) + 2 ) > nBufSize )
         {
             nBufSize *= 2;
@@ -283,6 +283,7 @@ void KEARasterBand::CreateOverviews(int nOverviews, int *panOverviewList)
     // allocate space
     m_panOverviewBands = (KEAOverview**)CPLMalloc(sizeof(KEAOverview*) * nOverviews);
     m_nOverviews = nOverviews;
+    m_bOverviewsRead = true;
 
     // loop through and create the overviews
     int nFactor, nXSize, nYSize;
@@ -321,10 +322,24 @@ CPLErr KEARasterBand::IReadBlock( int nBlockXOff, int nBlockYOff, void * pImage
         {
             nysize -= (nytotalsize - this->nRasterYSize);
         }
-        this->m_pImageIO->readImageBlock2Band( this->nBand, pImage, this->nBlockXSize * nBlockXOff,
+        // read-only bands are safe to read from many threads at once, only
+        // holding the HDF5 lock to fetch the chunks which are then
+        // decompressed in this thread. Chunks which were never written are
+        // just filled with the fill value.
+        if( this->poDS->GetAccess() == GA_ReadOnly )
+        {
+            this->m_pImageIO->readImageBlock2BandConcurrent( this->nBand, 0, pImage, this->nBlockXSize * nBlockXOff,
+                                            this->nBlockYSize * nBlockYOff,
+                                            nxsize, nysize, this->nBlockXSize,
+                                            this->m_eKEADataType );
+        }
+        else
+        {
+            this->m_pImageIO->readImageBlock2Band( this->nBand, pImage, this->nBlockXSize * nBlockXOff,
                                             this->nBlockYSize * nBlockYOff,
                                             nxsize, nysize, this->nBlockXSize, this->nBlockYSize, 
                                             this->m_eKEADataType );
+        }
         return CE_None;
     }
     catch (const kealib::KEAIOException &e)
@@ -359,6 +374,8 @@ CPLErr KEARasterBand::IWriteBlock( int nBlockXOff, int nBlockYOff, void * pImage
                                             this->nBlockYSize * nBlockYOff,
                                             nxsize, nysize, this->nBlockXSize, this->nBlockYSize,
                                             this->m_eKEADataType );
+        m_bStatisticsStale = true;
+        m_bHistogramStale = true;
         return CE_None;
     }
     catch (const kealib::KEAIOException &e)
@@ -369,6 +386,188 @@ CPLErr KEARasterBand::IWriteBlock( int nBlockXOff, int nBlockYOff, void * pImage
     }
 }
 
+CPLErr KEARasterBand::IRasterIO( GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                                  void *pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                                  GSpacing nPixelSpace, GSpacing nLineSpace,
+                                  GDALRasterIOExtraArg *psExtraArg )
+{
+    CPLErr eErr = CE_None;
+    if( this->DirectRasterIO( 0, eRWFlag, nXOff, nYOff, nXSize, nYSize, pData, nBufXSize, nBufYSize,
+                              eBufType, nPixelSpace, nLineSpace, psExtraArg, &eErr ) )
+    {
+        return eErr;
+    }
+    return GDALPamRasterBand::IRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize, pData, nBufXSize, nBufYSize,
+                                         eBufType, nPixelSpace, nLineSpace, psExtraArg );
+}
+
+bool KEARasterBand::DirectRasterIO( uint32_t nOverview, GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                                    void *pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                                    GSpacing nPixelSpace, GSpacing nLineSpace,
+                                    GDALRasterIOExtraArg *psExtraArg, CPLErr *peErr )
+{
+    // requests smaller than a block are better served from the cache and
+    // no conversion is done here as HDF5 does not round like GDAL
+    if( ( (GIntBig)nBufXSize * nBufYSize < (GIntBig)this->nBlockXSize * this->nBlockYSize ) ||
+        ( eBufType != this->eDataType ) )
+    {
+        return false;
+    }
+    
+    // the buffer has to be whole elements apart without lines overlapping
+    GSpacing nTypeSize = GDALGetDataTypeSizeBytes( eBufType );
+    if( ( nPixelSpace <= 0 ) || ( nLineSpace <= 0 ) || ( nPixelSpace % nTypeSize != 0 ) ||
+        ( nLineSpace % nTypeSize != 0 ) ||
+        ( ( nBufYSize > 1 ) && ( nLineSpace < ( ( nBufXSize - 1 ) * nPixelSpace ) + nTypeSize ) ) )
+    {
+        return false;
+    }
+    
+    // only whole decimations (nearest neighbour) are read with a stride,
+    // and only where there are no overviews which GDAL would use instead
+    int nXStep = 1;
+    int nYStep = 1;
+    if( ( nBufXSize != nXSize ) || ( nBufYSize != nYSize ) )
+    {
+        if( ( eRWFlag != GF_Read ) || ( nBufXSize > nXSize ) || ( nBufYSize > nYSize ) ||
+            ( nXSize % nBufXSize != 0 ) || ( nYSize % nBufYSize != 0 ) || ( this->GetOverviewCount() > 0 ) ||
+            ( ( psExtraArg != nullptr ) && ( ( psExtraArg->eResampleAlg != GRIORA_NearestNeighbour ) ||
+                                             psExtraArg->bFloatingPointWindowValidity ) ) )
+        {
+            return false;
+        }
+        nXStep = nXSize / nBufXSize;
+        nYStep = nYSize / nBufYSize;
+    }
+    
+    // cached blocks could be dirty or be made stale by this request
+    if( ( this->eAccess == GA_Update ) && ( this->FlushCache() != CE_None ) )
+    {
+        *peErr = CE_Failure;
+        return true;
+    }
+    
+    try
+    {
+        if( ( eRWFlag == GF_Read ) && ( this->poDS->GetAccess() == GA_ReadOnly ) &&
+            ( nXStep == 1 ) && ( nYStep == 1 ) && ( nPixelSpace == nTypeSize ) )
+        {
+            // takes the lock itself and uses any chunks from AdviseRead
+            this->m_pImageIO->readImageBlock2BandConcurrent( this->nBand, nOverview, pData,
+                                            nXOff, nYOff, nBufXSize, nBufYSize,
+                                            nLineSpace / nTypeSize, this->m_eKEADataType );
+        }
+        else if( eRWFlag == GF_Read )
+        {
+            // shares the lock with the concurrent block reads
+            std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
+            // GDAL takes the pixel at the centre of each decimated cell
+            this->m_pImageIO->readImageBlock2BandStrided( this->nBand, nOverview, pData,
+                                            nXOff + ( nXStep / 2 ), nYOff + ( nYStep / 2 ),
+                                            nBufXSize, nBufYSize, nXStep, nYStep,
+                                            nPixelSpace / nTypeSize, nLineSpace / nTypeSize,
+                                            this->m_eKEADataType );
+        }
+        else
+        {
+            this->m_pImageIO->writeImageBlock2BandStrided( this->nBand, nOverview, pData,
+                                            nXOff, nYOff, nBufXSize, nBufYSize,
+                                            nPixelSpace / nTypeSize, nLineSpace / nTypeSize,
+                                            this->m_eKEADataType );
+            if( nOverview == 0 )
+            {
+                m_bStatisticsStale = true;
+                m_bHistogramStale = true;
+            }
+        }
+        *peErr = CE_None;
+    }
+    catch (const kealib::KEAIOException &e)
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                "Failed to %s file: %s", ( eRWFlag == GF_Read ) ? "read" : "write", e.what() );
+        *peErr = CE_Failure;
+    }
+    
+    if( ( *peErr == CE_None ) && ( psExtraArg != nullptr ) && ( psExtraArg->pfnProgress != nullptr ) )
+    {
+        psExtraArg->pfnProgress( 1.0, "", psExtraArg->pProgressData );
+    }
+    return true;
+}
+
+CPLErr KEARasterBand::AdviseRead( int nXOff, int nYOff, int nXSize, int nYSize,
+                                  int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                                  char **papszOptions )
+{
+    return this->AdviseReadWindow( 0, nXOff, nYOff, nXSize, nYSize, nBufXSize, nBufYSize );
+}
+
+CPLErr KEARasterBand::AdviseReadWindow( uint32_t nOverview, int nXOff, int nYOff, int nXSize, int nYSize,
+                                        int nBufXSize, int nBufYSize )
+{
+    // chunks of a file being written can't be cached, and reduced
+    // resolution requests would mostly be served from the overviews
+    if( ( this->poDS->GetAccess() != GA_ReadOnly ) ||
+        ( nBufXSize != nXSize ) || ( nBufYSize != nYSize ) )
+    {
+        return CE_None;
+    }
+
+    try
+    {
+        this->m_pImageIO->prefetchImageBlocks( this->nBand, nOverview, nXOff, nYOff, nXSize, nYSize );
+    }
+    catch (const kealib::KEAIOException &)
+    {
+        // only advice, so the read will report any problem
+    }
+    return CE_None;
+}
+
+int KEARasterBand::IGetDataCoverageStatus( int nXOff, int nYOff, int nXSize, int nYSize,
+                                           int nMaskFlagStop, double *pdfDataPct )
+{
+    return this->DataCoverageStatus( 0, nXOff, nYOff, nXSize, nYSize, pdfDataPct );
+}
+
+int KEARasterBand::DataCoverageStatus( uint32_t nOverview, int nXOff, int nYOff, int nXSize, int nYSize,
+                                       double *pdfDataPct )
+{
+    // blocks still in the cache haven't been written to the file yet
+    if( ( this->eAccess == GA_Update ) && ( this->FlushCache() != CE_None ) )
+        return GDAL_DATA_COVERAGE_STATUS_UNIMPLEMENTED;
+
+    uint64_t nWritten = 0;
+    try
+    {
+        // shares the lock with the concurrent block reads
+        std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
+        if( !this->m_pImageIO->getAllocatedPixelCount( this->nBand, nOverview, nXOff, nYOff,
+                                                      nXSize, nYSize, &nWritten ) )
+        {
+            return GDAL_DATA_COVERAGE_STATUS_UNIMPLEMENTED;
+        }
+    }
+    catch (const kealib::KEAIOException &e)
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                "Failed to read file: %s", e.what() );
+        return GDAL_DATA_COVERAGE_STATUS_UNIMPLEMENTED;
+    }
+
+    uint64_t nTotal = (uint64_t)nXSize * nYSize;
+    if( pdfDataPct != nullptr )
+        *pdfDataPct = ( nTotal > 0 ) ? ( 100.0 * nWritten / nTotal ) : 0.0;
+
+    int nStatus = 0;
+    if( nWritten > 0 )
+        nStatus |= GDAL_DATA_COVERAGE_STATUS_DATA;
+    if( nWritten < nTotal )
+        nStatus |= GDAL_DATA_COVERAGE_STATUS_EMPTY;
+    return nStatus;
+}
+
 void KEARasterBand::SetDescription(const char *pszDescription)
 {
     CPLMutexHolderD( &m_hMutex );
@@ -393,9 +592,15 @@ const char *KEARasterBand::GetDescription() const
 CPLErr KEARasterBand::SetMetadataItem(const char *pszName, const char *pszValue, const char *pszDomain)
 {
     CPLMutexHolderD( &m_hMutex );
+    if( ( pszDomain != nullptr ) && EQUAL( pszDomain, "KEA_IO_STATS" ) )
+    {
+        this->m_pImageIO->resetIOStats( this->nBand );
+        return CE_None;
+    }
     // only deal with 'default' domain - no geolocation etc
     if( ( pszDomain != nullptr ) && ( *pszDomain != '\0' ) )
         return CE_Failure;
+    this->LoadMetadataList();
 
     // kealib doesn't currently support removing values
     if( pszValue == nullptr )
@@ -448,6 +653,11 @@ CPLErr KEARasterBand::SetMetadataItem(const char *pszName, const char *pszValue,
 const char *KEARasterBand::GetMetadataItem (const char *pszName, const char *pszDomain)
 {
     CPLMutexHolderD( &m_hMutex );
+    if( ( pszDomain != nullptr ) && EQUAL( pszDomain, "KEA_IO_STATS" ) )
+    {
+        m_papszIOStats = KEA_IOStats_to_Metadata( this->m_pImageIO->getIOStats( this->nBand ), m_papszIOStats );
+        return CSLFetchNameValue(m_papszIOStats, pszName);
+    }
     // only deal with 'default' domain - no geolocation etc
     if( ( pszDomain != nullptr ) && ( *pszDomain != '\0' ) )
         return nullptr;
@@ -460,15 +670,23 @@ const char *KEARasterBand::GetMetadataItem (const char *pszName, const char *psz
         return m_pszHistoBinValues;
     }
     // get it out of the CSLStringList so we can be sure it is persistant
+    this->LoadMetadataList();
     return CSLFetchNameValue(m_papszMetadataList, pszName);
 }
 
 // get all the metadata as a CSLStringList - not thread safe
 char **KEARasterBand::GetMetadata(const char *pszDomain)
 {
+    if( ( pszDomain != nullptr ) && EQUAL( pszDomain, "KEA_IO_STATS" ) )
+    {
+        CPLMutexHolderD( &m_hMutex );
+        m_papszIOStats = KEA_IOStats_to_Metadata( this->m_pImageIO->getIOStats( this->nBand ), m_papszIOStats );
+        return m_papszIOStats;
+    }
     // only deal with 'default' domain - no geolocation etc
     if( ( pszDomain != nullptr ) && ( *pszDomain != '\0' ) )
         return nullptr;
+    this->LoadMetadataList();
     // Note: ignoring STATISTICS_HISTOBINVALUES as these are likely to be very long
     // not sure user should get those unless they really ask...
 
@@ -476,6 +694,12 @@ char **KEARasterBand::GetMetadata(const char *pszDomain)
     return m_papszMetadataList; 
 }
 
+char **KEARasterBand::GetMetadataDomainList()
+{
+    return BuildMetadataDomainList( GDALPamRasterBand::GetMetadataDomainList(), TRUE,
+                                    "", "KEA_IO_STATS", nullptr );
+}
+
 // set the metadata as a CSLStringList
 CPLErr KEARasterBand::SetMetadata(char **papszMetadata, const char *pszDomain)
 {
@@ -526,6 +750,7 @@ CPLErr KEARasterBand::SetMetadata(char **papszMetadata, const char *pszDomain)
     // and use that as our list from now on
     CSLDestroy(m_papszMetadataList);
     m_papszMetadataList = CSLDuplicate(papszMetadata);
+    m_bMetadataRead = true;
     return CE_None;
 }
 
@@ -534,6 +759,7 @@ double KEARasterBand::GetNoDataValue(int *pbSuccess)
 {
     try
     {
+        std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
         double dVal;
         this->m_pImageIO->getNoDataValue(this->nBand, &dVal, kealib::kea_64float);
         if( pbSuccess != nullptr )
@@ -553,6 +779,7 @@ int64_t KEARasterBand::GetNoDataValueAsInt64(int *pbSuccess)
 {
     try
     {
+        std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
         int64_t nVal;
         this->m_pImageIO->getNoDataValue(this->nBand, &nVal, kealib::kea_64int);
         if( pbSuccess != nullptr )
@@ -572,6 +799,7 @@ uint64_t KEARasterBand::GetNoDataValueAsUInt64(int *pbSuccess)
 {
     try
     {
+        std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
         uint64_t nVal;
         this->m_pImageIO->getNoDataValue(this->nBand, &nVal, kealib::kea_64uint);
         if( pbSuccess != nullptr )
@@ -685,21 +913,22 @@ CPLErr KEARasterBand::GetDefaultHistogram( double *pdfMin, double *pdfMax,
     else
     {
         // returned cached if avail
-        // I've used the RAT interface here as it deals with data type
-        // conversions. Would be nice to have GUIntBig support in RAT though...
         GDALRasterAttributeTable *pTable = this->GetDefaultRAT();
         if( pTable == nullptr )
             return CE_Failure;
-        int nRows = pTable->GetRowCount();
         // find histogram column if it exists
-        int nCol = pTable->GetColOfUsage(GFU_PixelCount);
-        if( nCol == -1 )
+        if( pTable->GetColOfUsage(GFU_PixelCount) == -1 )
             return CE_Warning;
 
         double dfRow0Min, dfBinSize;
         if( !pTable->GetLinearBinning(&dfRow0Min, &dfBinSize) )
             return CE_Warning;
 
+        int nRows = 0;
+        std::vector<int64_t> anHistogram;
+        if( this->ReadHistogram(&nRows, &anHistogram) != CE_None )
+            return CE_Failure;
+
         *ppanHistogram = (GUIntBig*)VSIMalloc2(nRows, sizeof(GUIntBig));
         if( *ppanHistogram == nullptr )
         {
@@ -707,23 +936,11 @@ CPLErr KEARasterBand::GetDefaultHistogram( double *pdfMin, double *pdfMax,
                     "Memory Allocation failed in KEARasterBand::GetDefaultHistogram");
             return CE_Failure;
         }
-        double *pDoubleHisto = (double*)VSIMalloc2(nRows, sizeof(double));
-        if( pDoubleHisto == nullptr )
-        {
-            CPLFree(*ppanHistogram);
-            CPLError( CE_Failure, CPLE_OutOfMemory,
-                    "Memory Allocation failed in KEARasterBand::GetDefaultHistogram");
-            return CE_Failure;
-        }
-
-        if( pTable->ValuesIO(GF_Read, nCol, 0, nRows, pDoubleHisto) != CE_None )
-            return CE_Failure;
 
         // convert to GUIntBig
         for( int n = 0; n < nRows; n++ )
-            (*ppanHistogram)[n] = pDoubleHisto[n];
+            (*ppanHistogram)[n] = anHistogram[n];
 
-        CPLFree(pDoubleHisto);
         *pnBuckets = nRows;
         *pdfMin = dfRow0Min;
         *pdfMax = dfRow0Min + ((nRows + 1) * dfBinSize);
@@ -734,7 +951,37 @@ CPLErr KEARasterBand::GetDefaultHistogram( double *pdfMin, double *pdfMax,
 CPLErr KEARasterBand::SetDefaultHistogram( double dfMin, double dfMax,
                                         int nBuckets, GUIntBig *panHistogram )
 {
-    GDALRasterAttributeTable *pTable = this->GetDefaultRAT();
+    std::vector<int64_t> anHistogram(panHistogram, panHistogram + nBuckets);
+    if( this->WriteHistogram(nBuckets, anHistogram.data()) != CE_None )
+        return CE_Failure;
+
+    // so GetHistogram() can tell the bins match
+    if( nBuckets > 0 )
+        this->GetDefaultRAT()->SetLinearBinning(dfMin, (dfMax - dfMin) / nBuckets);
+
+    return CE_None;
+}
+
+// read the histogram column of the RAT
+CPLErr KEARasterBand::ReadHistogram(int *pnBuckets, std::vector<int64_t> *panHistogram)
+{
+    KEARasterAttributeTable *pTable = (KEARasterAttributeTable*)this->GetDefaultRAT();
+    if( pTable == nullptr )
+        return CE_Failure;
+    // find histogram column if it exists
+    int nCol = pTable->GetColOfUsage(GFU_PixelCount);
+    if( nCol == -1 )
+        return CE_Failure;
+
+    *pnBuckets = pTable->GetRowCount();
+    panHistogram->resize(*pnBuckets);
+    return pTable->ValuesIO(GF_Read, nCol, 0, *pnBuckets, panHistogram->data());
+}
+
+// write the histogram column of the RAT, creating it if needed
+CPLErr KEARasterBand::WriteHistogram(int nBuckets, int64_t *panHistogram)
+{
+    KEARasterAttributeTable *pTable = (KEARasterAttributeTable*)this->GetDefaultRAT();
     if( pTable == nullptr )
         return CE_Failure;
 
@@ -749,26 +996,198 @@ CPLErr KEARasterBand::SetDefaultHistogram( double dfMin, double dfMax,
     if( nBuckets > pTable->GetRowCount() )
         pTable->SetRowCount(nBuckets);
 
-    // convert to double (RATs don't take GUIntBig yet)
-    double *pDoubleHist = (double*)VSIMalloc2(nBuckets, sizeof(double));
-    if( pDoubleHist == nullptr )
+    if( pTable->ValuesIO(GF_Write, nCol, 0, nBuckets, panHistogram) != CE_None )
+        return CE_Failure;
+    m_bHistogramStale = false;
+    return CE_None;
+}
+
+// kealib ignores masks and always reads the whole band, so when there
+// is a mask, or overviews could be used for an approximation, GDAL is better
+bool KEARasterBand::CanComputeStatistics(int bApproxOK)
+{
+    int nMaskFlags = this->GetMaskFlags();
+    if( ( nMaskFlags != GMF_ALL_VALID ) && ( nMaskFlags != GMF_NODATA ) )
+        return false;
+    return !bApproxOK || ( this->GetOverviewCount() == 0 );
+}
+
+CPLErr KEARasterBand::CalcStatistics(kealib::KEABandStats *pStats, int nBuckets, double dfMin,
+                                        double dfMax, int bIncludeOutOfRange)
+{
+    // make sure kealib sees anything still in the block cache
+    if( ( this->eAccess == GA_Update ) && ( this->FlushCache() != CE_None ) )
+        return CE_Failure;
+
+    // like the other GDAL multithreaded algorithms
+    const char *pszThreads = CPLGetConfigOption("GDAL_NUM_THREADS", "ALL_CPUS");
+    unsigned int nThreads = EQUAL(pszThreads, "ALL_CPUS") ? 0 : std::max(atoi(pszThreads), 1);
+
+    try
     {
-        CPLError( CE_Failure, CPLE_OutOfMemory,
-                "Memory Allocation failed in KEARasterBand::SetDefaultHistogram");
+        // kealib takes the HDF5 lock itself, only while reading each strip
+        this->m_pImageIO->calcImageBandStats( this->nBand, pStats, nBuckets, dfMin, dfMax,
+                                            bIncludeOutOfRange != FALSE, nThreads );
+        return CE_None;
+    }
+    catch (const kealib::KEAIOException &e)
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                "Failed to calculate statistics: %s", e.what() );
         return CE_Failure;
     }
+}
 
-    for( int n = 0; n < nBuckets; n++ )
-        pDoubleHist[n] = static_cast<double>(panHistogram[n]);
+CPLErr KEARasterBand::ComputeStatistics( int bApproxOK, double *pdfMin, double *pdfMax,
+                                        double *pdfMean, double *pdfStdDev,
+                                        GDALProgressFunc pfnProgress, void *pProgressData )
+{
+    // the ones in the file are still correct
+    const char *pszApprox = this->GetMetadataItem("STATISTICS_APPROXIMATE");
+    const char *pszMin = this->GetMetadataItem("STATISTICS_MINIMUM");
+    const char *pszMax = this->GetMetadataItem("STATISTICS_MAXIMUM");
+    const char *pszMean = this->GetMetadataItem("STATISTICS_MEAN");
+    const char *pszStdDev = this->GetMetadataItem("STATISTICS_STDDEV");
+    if( !m_bStatisticsStale && ( pszMin != nullptr ) && ( pszMax != nullptr ) &&
+        ( pszMean != nullptr ) && ( pszStdDev != nullptr ) &&
+        ( bApproxOK || ( pszApprox == nullptr ) || !CPLTestBool(pszApprox) ) )
+    {
+        if( pdfMin != nullptr )
+            *pdfMin = CPLAtofM(pszMin);
+        if( pdfMax != nullptr )
+            *pdfMax = CPLAtofM(pszMax);
+        if( pdfMean != nullptr )
+            *pdfMean = CPLAtofM(pszMean);
+        if( pdfStdDev != nullptr )
+            *pdfStdDev = CPLAtofM(pszStdDev);
+        return CE_None;
+    }
+
+    if( !this->CanComputeStatistics(bApproxOK) )
+    {
+        return GDALPamRasterBand::ComputeStatistics(bApproxOK, pdfMin, pdfMax, pdfMean,
+                                            pdfStdDev, pfnProgress, pProgressData);
+    }
 
-    if( pTable->ValuesIO(GF_Write, nCol, 0, nBuckets, pDoubleHist) != CE_None )
+    // kealib doesn't report progress so just do the start and end
+    if( pfnProgress == nullptr )
+        pfnProgress = GDALDummyProgress;
+    if( !pfnProgress( 0.0, nullptr, pProgressData ) )
     {
-        CPLFree(pDoubleHist);
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
         return CE_Failure;
     }
 
-    CPLFree(pDoubleHist);
+    kealib::KEABandStats oStats;
+    if( this->CalcStatistics(&oStats) != CE_None )
+        return CE_Failure;
+    if( oStats.validCount == 0 )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                "Failed to compute statistics, no valid pixels found." );
+        return CE_Failure;
+    }
 
+    // written to the file as STATISTICS_* by SetMetadataItem
+    this->SetStatistics( oStats.min, oStats.max, oStats.mean, oStats.stdDev );
+    m_bStatisticsStale = false;
+    CPLString osWorkingResult;
+    osWorkingResult.Printf( "%.3f", 100.0 * oStats.validCount / ( (double)this->nRasterXSize * this->nRasterYSize ) );
+    this->SetMetadataItem( "STATISTICS_VALID_PERCENT", osWorkingResult );
+    // kealib can't remove the item
+    if( pszApprox != nullptr )
+        this->SetMetadataItem( "STATISTICS_APPROXIMATE", "NO" );
+
+    if( pdfMin != nullptr )
+        *pdfMin = oStats.min;
+    if( pdfMax != nullptr )
+        *pdfMax = oStats.max;
+    if( pdfMean != nullptr )
+        *pdfMean = oStats.mean;
+    if( pdfStdDev != nullptr )
+        *pdfStdDev = oStats.stdDev;
+
+    pfnProgress( 1.0, nullptr, pProgressData );
+    return CE_None;
+}
+
+CPLErr KEARasterBand::ComputeRasterMinMax( int bApproxOK, double *adfMinMax )
+{
+    // the ones in the file are still correct
+    const char *pszApprox = this->GetMetadataItem("STATISTICS_APPROXIMATE");
+    const char *pszMin = this->GetMetadataItem("STATISTICS_MINIMUM");
+    const char *pszMax = this->GetMetadataItem("STATISTICS_MAXIMUM");
+    if( !m_bStatisticsStale && ( pszMin != nullptr ) && ( pszMax != nullptr ) &&
+        ( bApproxOK || ( pszApprox == nullptr ) || !CPLTestBool(pszApprox) ) )
+    {
+        adfMinMax[0] = CPLAtofM(pszMin);
+        adfMinMax[1] = CPLAtofM(pszMax);
+        return CE_None;
+    }
+
+    if( !this->CanComputeStatistics(bApproxOK) )
+        return GDALPamRasterBand::ComputeRasterMinMax(bApproxOK, adfMinMax);
+
+    kealib::KEABandStats oStats;
+    if( this->CalcStatistics(&oStats) != CE_None )
+        return CE_Failure;
+    if( oStats.validCount == 0 )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                "Failed to compute min/max, no valid pixels found." );
+        return CE_Failure;
+    }
+    adfMinMax[0] = oStats.min;
+    adfMinMax[1] = oStats.max;
+    return CE_None;
+}
+
+CPLErr KEARasterBand::GetHistogram( double dfMin, double dfMax, int nBuckets,
+                                        GUIntBig *panHistogram, int bIncludeOutOfRange,
+                                        int bApproxOK, GDALProgressFunc pfnProgress, void *pProgressData )
+{
+    if( ( nBuckets <= 0 ) || !( dfMax > dfMin ) || !this->CanComputeStatistics(bApproxOK) )
+    {
+        return GDALPamRasterBand::GetHistogram(dfMin, dfMax, nBuckets, panHistogram,
+                                            bIncludeOutOfRange, bApproxOK, pfnProgress, pProgressData);
+    }
+
+    // the one in the RAT has the same bins and is still correct
+    GDALRasterAttributeTable *pTable = this->GetDefaultRAT();
+    double dfRow0Min, dfBinSize;
+    const double dfEpsilon = 1e-10 * std::max(std::fabs(dfMin), std::fabs(dfMax));
+    if( !m_bHistogramStale && ( pTable != nullptr ) && ( pTable->GetRowCount() == nBuckets ) &&
+        ( pTable->GetColOfUsage(GFU_PixelCount) != -1 ) &&
+        pTable->GetLinearBinning(&dfRow0Min, &dfBinSize) &&
+        ( std::fabs(dfRow0Min - dfMin) <= dfEpsilon ) &&
+        ( std::fabs(dfRow0Min + ( nBuckets * dfBinSize ) - dfMax) <= dfEpsilon ) )
+    {
+        int nRows = 0;
+        std::vector<int64_t> anHistogram;
+        if( this->ReadHistogram(&nRows, &anHistogram) == CE_None )
+        {
+            for( int n = 0; n < nBuckets; n++ )
+                panHistogram[n] = anHistogram[n];
+            return CE_None;
+        }
+    }
+
+    // kealib doesn't report progress so just do the start and end
+    if( pfnProgress == nullptr )
+        pfnProgress = GDALDummyProgress;
+    if( !pfnProgress( 0.0, nullptr, pProgressData ) )
+    {
+        CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+        return CE_Failure;
+    }
+
+    kealib::KEABandStats oStats;
+    if( this->CalcStatistics(&oStats, nBuckets, dfMin, dfMax, bIncludeOutOfRange) != CE_None )
+        return CE_Failure;
+    for( int n = 0; n < nBuckets; n++ )
+        panHistogram[n] = oStats.histogram[n];
+
+    pfnProgress( 1.0, nullptr, pProgressData );
     return CE_None;
 }
 
@@ -781,7 +1200,11 @@ GDALRasterAttributeTable *KEARasterBand::GetDefaultRAT()
         {
             // we assume this is never nullptr - creates a new one if none exists
             // (or raises exception)
-            kealib::KEAAttributeTable *pKEATable = this->m_pImageIO->getAttributeTable(kealib::kea_att_file, this->nBand);
+            kealib::KEAAttributeTable *pKEATable = nullptr;
+            {
+                std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
+                pKEATable = this->m_pImageIO->getAttributeTable(kealib::kea_att_file, this->nBand);
+            }
             this->m_pAttributeTable = new KEARasterAttributeTable(pKEATable, this);
         }
         catch(const kealib::KEAException &e)
@@ -904,44 +1327,32 @@ GDALColorTable *KEARasterBand::GetColorTable()
     {
         try
         {
-            GDALRasterAttributeTable *pKEATable = this->GetDefaultRAT();
+            KEARasterAttributeTable *pKEATable = (KEARasterAttributeTable*)this->GetDefaultRAT();
             if( pKEATable == nullptr )
                 return nullptr;
-            int nRedIdx = -1;
-            int nGreenIdx = -1;
-            int nBlueIdx = -1;
-            int nAlphaIdx = -1;
 
-            for( int nColIdx = 0; nColIdx < pKEATable->GetColumnCount(); nColIdx++ )
+            // any buffered edits need to be in the file before the bulk load
+            pKEATable->Flush();
+
+            // only do RGB palettes - needs the Red, Green, Blue and Alpha columns
+            std::vector<uint8_t> aRGBA;
+            bool bHaveRGBA = false;
             {
-                if( pKEATable->GetTypeOfCol(nColIdx) == GFT_Integer )
-                {
-                    GDALRATFieldUsage eFieldUsage = pKEATable->GetUsageOfCol(nColIdx);
-                    if( eFieldUsage == GFU_Red )
-                        nRedIdx = nColIdx;
-                    else if( eFieldUsage == GFU_Green )
-                        nGreenIdx = nColIdx;
-                    else if( eFieldUsage == GFU_Blue )
-                        nBlueIdx = nColIdx;
-                    else if( eFieldUsage == GFU_Alpha )
-                        nAlphaIdx = nColIdx;
-                }
+                std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
+                bHaveRGBA = this->m_pImageIO->getRGBALookupTable(this->nBand, &aRGBA);
             }
-
-            if( ( nRedIdx != -1 ) && ( nGreenIdx != -1 ) && ( nBlueIdx != -1 ) && ( nAlphaIdx != -1 ) )
+            if( bHaveRGBA )
             {
-                // we need to create one - only do RGB palettes
                 this->m_pColorTable = new GDALColorTable(GPI_RGB);
 
-                // OK go through each row and fill in the fields
-                for( int nRowIndex = 0; nRowIndex < pKEATable->GetRowCount(); nRowIndex++ )
+                int nRows = (int)(aRGBA.size() / 4);
+                for( int nRowIndex = 0; nRowIndex < nRows; nRowIndex++ )
                 {
-                    // maybe could be more efficient using ValuesIO
                     GDALColorEntry colorEntry;
-                    colorEntry.c1 = pKEATable->GetValueAsInt(nRowIndex, nRedIdx);
-                    colorEntry.c2 = pKEATable->GetValueAsInt(nRowIndex, nGreenIdx);
-                    colorEntry.c3 = pKEATable->GetValueAsInt(nRowIndex, nBlueIdx);
-                    colorEntry.c4 = pKEATable->GetValueAsInt(nRowIndex, nAlphaIdx);
+                    colorEntry.c1 = aRGBA[(nRowIndex * 4)];
+                    colorEntry.c2 = aRGBA[(nRowIndex * 4) + 1];
+                    colorEntry.c3 = aRGBA[(nRowIndex * 4) + 2];
+                    colorEntry.c4 = aRGBA[(nRowIndex * 4) + 3];
                     this->m_pColorTable->SetColorEntry(nRowIndex, &colorEntry);
                 }
             }
@@ -1212,42 +1623,77 @@ void KEARasterBand::deleteOverviewObjects()
     m_nOverviews = 0;
 }
 
-// read in any overviews in the file into our array of objects
+// find out how many overviews there are in the file. The objects for
+// them are only created when asked for by getOverviewObject()
 void KEARasterBand::readExistingOverviews()
 {
     CPLMutexHolderD( &m_hMutex );
     // delete any existing overview bands
     this->deleteOverviewObjects();
+    m_bOverviewsRead = true;
+
+    try
+    {
+        m_nOverviews = this->m_pImageIO->getNumOfOverviews(this->nBand);
+    }
+    catch (const kealib::KEAIOException &e)
+    {
+        CPLError( CE_Warning, CPLE_AppDefined,
+                "Failed to read overviews: %s", e.what() );
+        m_nOverviews = 0;
+    }
+    m_panOverviewBands = (KEAOverview**)CPLCalloc(m_nOverviews, sizeof(KEAOverview*));
+}
 
-    m_nOverviews = this->m_pImageIO->getNumOfOverviews(this->nBand);
-    m_panOverviewBands = (KEAOverview**)CPLMalloc(sizeof(KEAOverview*) * m_nOverviews);
+// get the object for an overview, creating it if needed
+KEAOverview* KEARasterBand::getOverviewObject(int nOverview)
+{
+    CPLMutexHolderD( &m_hMutex );
+    if( !m_bOverviewsRead )
+        this->readExistingOverviews();
+    if( ( nOverview < 0 ) || ( nOverview >= m_nOverviews ) )
+        return nullptr;
 
-    uint64_t nXSize, nYSize;    
-    for( int nCount = 0; nCount < m_nOverviews; nCount++ )
+    if( m_panOverviewBands[nOverview] == nullptr )
     {
-        this->m_pImageIO->getOverviewSize(this->nBand, nCount + 1, &nXSize, &nYSize);
-        m_panOverviewBands[nCount] = new KEAOverview((KEADataset*)this->poDS, this->nBand, GA_ReadOnly,
-                                        this->m_pImageIO, this->m_pRefCount, nCount + 1, nXSize, nYSize);
+        try
+        {
+            uint64_t nXSize, nYSize;
+            this->m_pImageIO->getOverviewSize(this->nBand, nOverview + 1, &nXSize, &nYSize);
+            m_panOverviewBands[nOverview] = new KEAOverview((KEADataset*)this->poDS, this->nBand, GA_ReadOnly,
+                                        this->m_pImageIO, this->m_pRefCount, nOverview + 1, nXSize, nYSize);
+        }
+        catch (const kealib::KEAIOException &e)
+        {
+            CPLError( CE_Failure, CPLE_AppDefined,
+                    "Failed to read overview: %s", e.what() );
+        }
     }
+    return m_panOverviewBands[nOverview];
+}
+
+// all the overview objects - used when building them
+KEAOverview** KEARasterBand::GetOverviewList()
+{
+    CPLMutexHolderD( &m_hMutex );
+    for( int nCount = 0; nCount < this->GetOverviewCount(); nCount++ )
+        this->getOverviewObject(nCount);
+    return m_panOverviewBands;
 }
 
 // number of overviews
 int KEARasterBand::GetOverviewCount()
 {
+    CPLMutexHolderD( &m_hMutex );
+    if( !m_bOverviewsRead )
+        this->readExistingOverviews();
     return m_nOverviews;
 }
 
 // get a given overview
 GDALRasterBand* KEARasterBand::GetOverview(int nOverview)
 {
-    if( nOverview >= m_nOverviews )
-    {
-        return nullptr;
-    }
-    else
-    {
-        return m_panOverviewBands[nOverview];
-    }
+    return this->getOverviewObject(nOverview);
 }
 
 CPLErr KEARasterBand::CreateMaskBand(int nFlags)
@@ -1275,7 +1721,12 @@ GDALRasterBand* KEARasterBand::GetMaskBand()
     {
         try
         {
-            if( this->m_pImageIO->maskCreated(this->nBand) )
+            bool bMaskCreated = false;
+            {
+                std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
+                bMaskCreated = this->m_pImageIO->maskCreated(this->nBand);
+            }
+            if( bMaskCreated )
             {
                 m_pMaskBand = new KEAMaskBand(this, this->m_pImageIO, this->m_pRefCount);
                 m_bMaskBandOwned = true;
@@ -1299,7 +1750,12 @@ int KEARasterBand::GetMaskFlags()
 {
     try
     {
-        if( ! this->m_pImageIO->maskCreated(this->nBand) )
+        bool bMaskCreated = false;
+        {
+            std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
+            bMaskCreated = this->m_pImageIO->maskCreated(this->nBand);
+        }
+        if( !bMaskCreated )
         {
             // need to return the base class one since we are using
             // the base class implementation of GetMaskBand()
@@ -58,7 +58,7 @@ private:
     LockedRefCount      *m_pRefCount; // reference count of m_pImageIO
 
     int                  m_nOverviews; // number of overviews
-    KEAOverview        **m_panOverviewBands; // array of overview objects
+    KEAOverview        **m_panOverviewBands; // array of overview objects, created on first use
     GDALRasterBand      *m_pMaskBand;   // pointer to mask band if one exists (and been requested)
     bool                 m_bMaskBandOwned; // do we delete it or not?
 
@@ -66,8 +66,6 @@ private:
                                                  // created on first call to GetDefaultRAT()
     GDALColorTable      *m_pColorTable;     // pointer to the color table
                                             // created on first call to GetColorTable()
-
-    int                  m_nAttributeChunkSize; // for reporting via the metadata
 public:
     // constructor/destructor
     KEARasterBand( KEADataset *pDataset, int nSrcBand, GDALAccess eAccess, kealib::KEAImageIO *pImageIO, LockedRefCount *pRefCount );
@@ -86,6 +84,9 @@ public:
     const char *GetMetadataItem (const char *pszName, const char *pszDomain="");
     char **GetMetadata(const char *pszDomain="");
     CPLErr SetMetadata(char **papszMetadata, const char *pszDomain="");
+    // adds KEA_IO_STATS, the counts of I/O for this band and its overviews
+    // since opening which are reset by setting any item in it
+    char **GetMetadataDomainList();
 
     // virtual methods for the no data value
     double GetNoDataValue(int *pbSuccess=nullptr);
@@ -108,6 +109,23 @@ public:
     CPLErr SetDefaultHistogram( double dfMin, double dfMax,
                                         int nBuckets, GUIntBig *panHistogram );
 
+    // statistics are calculated by kealib in a single multithreaded pass
+    // (or come from STATISTICS_* / the RAT if the data hasn't been written
+    // since). Masks and approximations using overviews are left to GDAL.
+    CPLErr ComputeStatistics( int bApproxOK, double *pdfMin, double *pdfMax,
+                                        double *pdfMean, double *pdfStdDev,
+                                        GDALProgressFunc, void *pProgressData );
+    CPLErr ComputeRasterMinMax( int bApproxOK, double *adfMinMax );
+    CPLErr GetHistogram( double dfMin, double dfMax, int nBuckets,
+                                        GUIntBig *panHistogram, int bIncludeOutOfRange,
+                                        int bApproxOK, GDALProgressFunc, void *pProgressData );
+
+    // starts reading and decompressing the chunks of a window on a
+    // background thread (read-only datasets at full resolution only)
+    CPLErr AdviseRead( int nXOff, int nYOff, int nXSize, int nYSize,
+                       int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                       char **papszOptions );
+
 
     // virtual methods for RATs
     GDALRasterAttributeTable *GetDefaultRAT();
@@ -129,32 +147,81 @@ public:
     // internal methods for overviews
     void readExistingOverviews();
     void deleteOverviewObjects();
+    KEAOverview* getOverviewObject(int nOverview);
 #ifdef HAVE_OVERVIEWOPTIONS
     void CreateOverviews(int nOverviews, const int *panOverviewList);
 #else
     void CreateOverviews(int nOverviews, int *panOverviewList);
 #endif
-    KEAOverview** GetOverviewList() { return m_panOverviewBands; }
+    KEAOverview** GetOverviewList();
+    // the data has been written so any statistics are out of date
+    void InvalidateStatistics() { m_bStatisticsStale = true; m_bHistogramStale = true; }
 
     kealib::KEALayerType getLayerType() const;
     void setLayerType(kealib::KEALayerType eLayerType);
     
 protected:
-    // methods for accessing data as blocks
+    // methods for accessing data as blocks. In read-only datasets blocks
+    // may be read from several threads at once: HDF5 is only called under
+    // KEAImageIO::getHDF5Mutex() to fetch the stored chunks, decompression
+    // happens in the calling thread. Mask blocks, the no data value, the
+    // colour table and the attribute table take the same lock so may be
+    // used alongside them. Anything else still needs to be serialised
+    // unless HDF5 is built threadsafe.
     virtual CPLErr IReadBlock( int, int, void * );
     virtual CPLErr IWriteBlock( int, int, void * );
 
+    // reads/writes large windows straight from/to the file rather than
+    // copying them through the block cache
+    virtual CPLErr IRasterIO( GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                              void *pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                              GSpacing nPixelSpace, GSpacing nLineSpace,
+                              GDALRasterIOExtraArg *psExtraArg );
+    // does the above for nOverview (0 being the band itself), returning
+    // false when the request should go through the block cache instead
+    bool DirectRasterIO( uint32_t nOverview, GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                         void *pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                         GSpacing nPixelSpace, GSpacing nLineSpace,
+                         GDALRasterIOExtraArg *psExtraArg, CPLErr *peErr );
+
+    // does AdviseRead for nOverview (0 being the band itself)
+    CPLErr AdviseReadWindow( uint32_t nOverview, int nXOff, int nYOff, int nXSize, int nYSize,
+                             int nBufXSize, int nBufYSize );
+
+    // reports which parts of the band have been written, from which of the
+    // chunks are allocated in the file
+    virtual int IGetDataCoverageStatus( int nXOff, int nYOff, int nXSize, int nYSize,
+                                        int nMaskFlagStop, double *pdfDataPct );
+    // does the above for nOverview (0 being the band itself)
+    int DataCoverageStatus( uint32_t nOverview, int nXOff, int nYOff, int nXSize, int nYSize,
+                            double *pdfDataPct );
+
     // updates m_papszMetadataList
     void UpdateMetadataList();
+    // reads m_papszMetadataList the first time it is needed
+    void LoadMetadataList();
 
     // sets the histogram column from a string (for metadata)
     CPLErr SetHistogramFromString(const char *pszString);
     char *GetHistogramAsString();
+    // reads/writes the histogram column of the RAT in one go
+    CPLErr ReadHistogram(int *pnBuckets, std::vector<int64_t> *panHistogram);
+    CPLErr WriteHistogram(int nBuckets, int64_t *panHistogram);
+    // can kealib calculate the statistics or does GDAL need to?
+    bool CanComputeStatistics(int bApproxOK);
+    // calculates the statistics (and histogram if nBuckets != 0) with kealib
+    CPLErr CalcStatistics(kealib::KEABandStats *pStats, int nBuckets=0, double dfMin=0,
+                                        double dfMax=0, int bIncludeOutOfRange=FALSE);
     // So we can return the histogram as a string from GetMetadataItem
     char *m_pszHistoBinValues;
 
     kealib::KEAImageIO  *m_pImageIO; // our image access pointer - refcounted
     char               **m_papszMetadataList; // CPLStringList of metadata
+    bool                 m_bMetadataRead; // m_papszMetadataList read from the file yet?
+    char               **m_papszIOStats; // KEA_IO_STATS as last asked for
+    bool                 m_bOverviewsRead; // have we found out how many overviews there are?
+    bool                 m_bStatisticsStale; // data written since STATISTICS_* were last computed so they may be out of date?
+    bool                 m_bHistogramStale; // as m_bStatisticsStale for the histogram in the RAT
     kealib::KEADataType  m_eKEADataType; // data type as KEA enum
     CPLMutex            *m_hMutex;
 };
@@ -28,99 +28,271 @@
  */
 
 #include <cmath>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include "gdal_priv.h"
 #include "gdal_rat.h"
 #include "libkea/KEAImageIO.h"
 #include "libkea/KEAAttributeTable.h"
 #include "libkea/KEAAttributeTableInMem.h"
+#include "kearat.h"
+#include "keadataset.h"
 
 // Support functions for CreateCopy()
 
-// Copies GDAL Band to KEA Band if nOverview == -1
-// Otherwise it is assumed we are writing to the specified overview
-bool CopyRasterData( GDALRasterBand *pBand, kealib::KEAImageIO *pImageIO, int nBand, int nOverview, int nTotalBands, GDALProgressFunc pfnProgress, void *pProgressData)
+// A strip of KEA block rows read from the source, one band after another
+struct KEACopyStrip
 {
-    // get some info
-    kealib::KEADataType eKeaType = pImageIO->getImageBandDataType(nBand);
+    unsigned int nY;
+    unsigned int nRows;
+    std::vector<GByte> abyData;
+};
+
+// A KEA chunk still to be written out of a strip
+struct KEACopyChunk
+{
+    std::shared_ptr<KEACopyStrip> poStrip;
+    int iBand;
+    unsigned int nX;
+    unsigned int nY;
+};
+
+// most memory a strip read from the source should take
+const GIntBig COPY_STRIP_BYTES = 64 * 1024 * 1024;
+
+// Copies nBandCount GDAL bands to the KEA bands in panKEABands, or to
+// overview nOverview of them if not -1. Strips of whole block rows are
+// read from all the bands at once on this thread while nThreads workers
+// compress and write the chunks of the strips already read (see
+// KEAImageIO::writeImageChunkConcurrent). The queue between them is
+// bounded so only a few strips are held at once.
+bool CopyRasterData( GDALRasterBand **papBands, const int *panKEABands, int nBandCount, kealib::KEAImageIO *pImageIO, int nOverview, int nThreads, GDALProgressFunc pfnProgress, void *pProgressData)
+{
+    // get some info - all bands in the file share a type
+    kealib::KEADataType eKeaType = pImageIO->getImageBandDataType(panKEABands[0]);
     unsigned int nBlockSize;
     if( nOverview == -1 )
-        nBlockSize = pImageIO->getImageBlockSize( nBand );
+        nBlockSize = pImageIO->getImageBlockSize( panKEABands[0] );
     else
-        nBlockSize = pImageIO->getOverviewBlockSize(nBand, nOverview);
-
-    GDALDataType eGDALType = pBand->GetRasterDataType();
-    unsigned int nXSize = pBand->GetXSize();
-    unsigned int nYSize = pBand->GetYSize();
+        nBlockSize = pImageIO->getOverviewBlockSize( panKEABands[0], nOverview );
+
+    GDALDataType eGDALType = KEA_to_GDAL_Type( eKeaType );
+    unsigned int nXSize = papBands[0]->GetXSize();
+    unsigned int nYSize = papBands[0]->GetYSize();
+    int nPixelSize = GDALGetDataTypeSizeBytes( eGDALType );
+
+    // strips are the smallest multiple of both the KEA and the source block
+    // heights within budget, so every source block is read once even for
+    // strip organised sources. Otherwise they are a KEA block row.
+    int nSrcBlockXSize = 0, nSrcBlockYSize = 0;
+    papBands[0]->GetBlockSize( &nSrcBlockXSize, &nSrcBlockYSize );
+    GIntBig nRowBytes = (GIntBig)nPixelSize * nXSize * nBandCount;
+    unsigned int nStripRows = nBlockSize;
+    if( nSrcBlockYSize > 0 )
+    {
+        GIntBig nA = nBlockSize, nB = nSrcBlockYSize;
+        while( nB != 0 )
+        {
+            GIntBig nR = nA % nB;
+            nA = nB;
+            nB = nR;
+        }
+        GIntBig nLCM = ( (GIntBig)nBlockSize / nA ) * nSrcBlockYSize;
+        if( ( nLCM * nRowBytes ) <= COPY_STRIP_BYTES )
+            nStripRows = (unsigned int)std::min<GIntBig>( nLCM, ( ( nYSize + nBlockSize - 1 ) / nBlockSize ) * nBlockSize );
+    }
+    size_t nBandBytes = (size_t)nPixelSize * nXSize * nStripRows;
+    uint32_t nKEAOverview = ( nOverview == -1 ) ? 0 : nOverview;
 
-    // allocate some space
-    int nPixelSize = GDALGetDataTypeSize( eGDALType ) / 8;
-    void *pData = CPLMalloc( nPixelSize * nBlockSize * nBlockSize);
-    if( pData == nullptr )
+    // the bands can be read together if they are all from one dataset
+    GDALDataset *pSrcDS = papBands[0]->GetDataset();
+    std::vector<int> anSrcBands;
+    for( int i = 0; i < nBandCount; i++ )
     {
-        CPLError( CE_Failure, CPLE_AppDefined, "Unable to allocate memory" );        
-        return false;
+        if( ( pSrcDS == nullptr ) || ( papBands[i]->GetDataset() != pSrcDS ) || ( papBands[i]->GetBand() < 1 ) )
+            pSrcDS = nullptr;
+        else
+            anSrcBands.push_back( papBands[i]->GetBand() );
     }
-    // for progress
-    int nTotalBlocks = std::ceil( (double)nXSize / (double)nBlockSize ) * std::ceil( (double)nYSize / (double)nBlockSize );
-    int nBlocksComplete = 0;
-    double dLastFraction = -1;
-    // go through the image
-    for( unsigned int nY = 0; nY < nYSize; nY += nBlockSize )
+
+    // state shared with the workers
+    std::deque<KEACopyChunk> aoQueue;
+    size_t nMaxQueued = 2 * (size_t)nBandCount * ( ( nXSize + nBlockSize - 1 ) / nBlockSize ) * ( nStripRows / nBlockSize );
+    std::mutex oMutex;
+    std::condition_variable oNotEmpty, oNotFull;
+    bool bDone = false;
+    bool bFailed = false;
+    std::string osError;
+
+    auto WriteChunks = [&]()
     {
-        // adjust for edge blocks
-        unsigned int nysize = nBlockSize;
-        unsigned int nytotalsize = nY + nBlockSize;
-        if( nytotalsize > nYSize )
-            nysize -= (nytotalsize - nYSize);
-        for( unsigned int nX = 0; nX < nXSize; nX += nBlockSize )
+        for( ;; )
         {
-            // adjust for edge blocks
-            unsigned int nxsize = nBlockSize;
-            unsigned int nxtotalsize = nX + nBlockSize;
-            if( nxtotalsize > nXSize )
-                nxsize -= (nxtotalsize - nXSize);
-
-            // read in from GDAL
-            if( pBand->RasterIO( GF_Read, nX, nY, nxsize, nysize, pData, nxsize, nysize, eGDALType, nPixelSize, nPixelSize * nBlockSize) != CE_None )
+            KEACopyChunk oChunk;
             {
-                CPLError( CE_Failure, CPLE_AppDefined, "Unable to read blcok at %d %d\n", nX, nY );
-                return false;
+                std::unique_lock<std::mutex> oLock( oMutex );
+                oNotEmpty.wait( oLock, [&]{ return !aoQueue.empty() || bDone; } );
+                if( aoQueue.empty() )
+                    return;
+                oChunk = aoQueue.front();
+                aoQueue.pop_front();
+                if( bFailed )
+                    continue;
             }
-            // write out to KEA
-            if( nOverview == -1 )
-                pImageIO->writeImageBlock2Band( nBand, pData, nX, nY, nxsize, nysize, nBlockSize, nBlockSize, eKeaType);
-            else
-                pImageIO->writeToOverview( nBand, nOverview, pData,  nX, nY, nxsize, nysize, nBlockSize, nBlockSize, eKeaType);
+            oNotFull.notify_one();
+
+            KEACopyStrip *pStrip = oChunk.poStrip.get();
+            unsigned int nxsize = std::min( nBlockSize, nXSize - oChunk.nX );
+            unsigned int nysize = std::min( nBlockSize, pStrip->nY + pStrip->nRows - oChunk.nY );
+            size_t nOffset = ( oChunk.iBand * nBandBytes ) + ( ( (size_t)( oChunk.nY - pStrip->nY ) * nXSize + oChunk.nX ) * nPixelSize );
+            try
+            {
+                pImageIO->writeImageChunkConcurrent( panKEABands[oChunk.iBand], nKEAOverview,
+                            pStrip->abyData.data() + nOffset,
+                            oChunk.nX, oChunk.nY, nxsize, nysize, nXSize, eKeaType );
+            }
+            catch (const kealib::KEAIOException &e)
+            {
+                {
+                    std::lock_guard<std::mutex> oLock( oMutex );
+                    bFailed = true;
+                    osError = e.what();
+                }
+                oNotFull.notify_all();
+            }
+        }
+    };
+    std::vector<std::thread> aoWorkers;
+    for( int i = 0; i < std::max( nThreads, 1 ); i++ )
+        aoWorkers.emplace_back( WriteChunks );
+
+    // read the strips on this thread as GDAL datasets aren't threadsafe
+    bool bOK = true;
+    for( unsigned int nY = 0; ( nY < nYSize ) && bOK; nY += nStripRows )
+    {
+        auto poStrip = std::make_shared<KEACopyStrip>();
+        poStrip->nY = nY;
+        poStrip->nRows = std::min( nStripRows, nYSize - nY );
+        poStrip->abyData.resize( nBandBytes * nBandCount );
+
+        CPLErr eErr = CE_None;
+        if( pSrcDS != nullptr )
+        {
+            eErr = pSrcDS->RasterIO( GF_Read, 0, nY, nXSize, poStrip->nRows, poStrip->abyData.data(),
+                                     nXSize, poStrip->nRows, eGDALType, nBandCount, anSrcBands.data(),
+                                     nPixelSize, (GSpacing)nPixelSize * nXSize, nBandBytes, nullptr );
+        }
+        else
+        {
+            for( int i = 0; ( i < nBandCount ) && ( eErr == CE_None ); i++ )
+            {
+                eErr = papBands[i]->RasterIO( GF_Read, 0, nY, nXSize, poStrip->nRows,
+                                              poStrip->abyData.data() + ( i * nBandBytes ),
+                                              nXSize, poStrip->nRows, eGDALType, nPixelSize,
+                                              (GSpacing)nPixelSize * nXSize, nullptr );
+            }
+        }
+        if( eErr != CE_None )
+        {
+            CPLError( CE_Failure, CPLE_AppDefined, "Unable to read strip at %d\n", nY );
+            bOK = false;
+            break;
+        }
 
-            // progress
-            nBlocksComplete++;
-            if( nOverview == -1 )
+        // split into KEA chunks
+        for( unsigned int nChunkY = nY; ( nChunkY < nY + poStrip->nRows ) && bOK; nChunkY += nBlockSize )
+        {
+            for( int i = 0; ( i < nBandCount ) && bOK; i++ )
             {
-                double dFraction = (((double)nBlocksComplete / (double)nTotalBlocks) / (double)nTotalBands) + ((double)(nBand-1) * (1.0 / (double)nTotalBands));
-                if( dFraction != dLastFraction )
+                for( unsigned int nX = 0; ( nX < nXSize ) && bOK; nX += nBlockSize )
                 {
-                    if( !pfnProgress( dFraction, nullptr, pProgressData ) )
+                    std::unique_lock<std::mutex> oLock( oMutex );
+                    oNotFull.wait( oLock, [&]{ return ( aoQueue.size() < nMaxQueued ) || bFailed; } );
+                    if( bFailed )
                     {
-                        CPLFree( pData );
-                        return false;
+                        bOK = false;
+                        break;
                     }
-                    dLastFraction = dFraction;
+                    aoQueue.push_back( KEACopyChunk{ poStrip, i, nX, nChunkY } );
+                    oLock.unlock();
+                    oNotEmpty.notify_one();
                 }
             }
         }
+
+        // progress - callers scale it to the share of the whole copy
+        if( bOK )
+        {
+            double dFraction = (double)( nY + poStrip->nRows ) / (double)nYSize;
+            if( !pfnProgress( dFraction, nullptr, pProgressData ) )
+                bOK = false;
+        }
     }
-    
-    CPLFree( pData );
-    return true;
+
+    {
+        std::lock_guard<std::mutex> oLock( oMutex );
+        bDone = true;
+        // anything still queued is dropped if we are giving up
+        if( !bOK )
+            bFailed = true;
+    }
+    oNotEmpty.notify_all();
+    for( std::thread &oWorker : aoWorkers )
+        oWorker.join();
+
+    if( !osError.empty() )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined, "Failed to write file: %s", osError.c_str() );
+        bOK = false;
+    }
+    return bOK;
 }
 
 const int RAT_CHUNKSIZE = 1000;
+
+// if the source band is also KEA the whole table (including the neighbours)
+// is copied as HDF5 objects without being decoded. Returns false if this
+// isn't possible so the caller can fall back to copying the values.
+bool CopyKEARAT(GDALRasterBand *pBand, const GDALRasterAttributeTable *gdalAtt, kealib::KEAImageIO *pImageIO, int nBand)
+{
+    GDALDataset *pSrcDataset = pBand->GetDataset();
+    if( ( pSrcDataset == nullptr ) || ( pSrcDataset->GetDriver() == nullptr ) || 
+        !EQUAL(pSrcDataset->GetDriver()->GetDescription(), "KEA") )
+        return false;
+
+    KEARasterAttributeTable *pKEAAtt = dynamic_cast<KEARasterAttributeTable*>((GDALRasterAttributeTable*)gdalAtt);
+    kealib::KEAImageIO *pSrcImageIO = static_cast<kealib::KEAImageIO*>(pSrcDataset->GetInternalHandle(nullptr));
+    if( ( pKEAAtt == nullptr ) || ( pSrcImageIO == nullptr ) )
+        return false;
+
+    try
+    {
+        // make sure buffered edits on the source have reached the file
+        pKEAAtt->Flush();
+        pImageIO->copyAttributeTable(pSrcImageIO, pBand->GetBand(), nBand);
+    }
+    catch(const kealib::KEAException &e)
+    {
+        return false;
+    }
+    return true;
+}
+
 // copies the raster attribute table
 void CopyRAT(GDALRasterBand *pBand, kealib::KEAImageIO *pImageIO, int nBand)
 {
     const GDALRasterAttributeTable *gdalAtt = pBand->GetDefaultRAT();
     if((gdalAtt != nullptr) && (gdalAtt->GetRowCount() > 0))
     {
+        if( CopyKEARAT(pBand, gdalAtt, pImageIO, nBand) )
+            return;
+
         // some operations depend on whether the input dataset is HFA
         int bInputHFA = EQUAL(pBand->GetDataset()->GetDriver()->GetDescription(), "HFA");
 
@@ -346,12 +518,51 @@ void CopyNoData(GDALRasterBand *pBand, kealib::KEAImageIO *pImageIO, int nBand)
     }
 }
 
-bool CopyBand( GDALRasterBand *pBand, kealib::KEAImageIO *pImageIO, int nBand, int nTotalbands, GDALProgressFunc pfnProgress, void *pProgressData)
+// if the band is from a KEA file whose image data is stored the same way
+// as the new file's the whole band (data, mask, overviews, RAT and
+// metadata) is copied as HDF5 objects without decoding any chunks.
+// Returns false if this isn't possible so the caller can copy it itself.
+bool CopyKEABand( GDALRasterBand *pBand, kealib::KEAImageIO *pImageIO, int nBand )
 {
-    // first copy the raster data over
-    if( !CopyRasterData( pBand, pImageIO, nBand, -1, nTotalbands, pfnProgress, pProgressData) )
+    GDALDataset *pSrcDataset = pBand->GetDataset();
+    if( ( pSrcDataset == nullptr ) || ( pSrcDataset->GetDriver() == nullptr ) || 
+        !EQUAL(pSrcDataset->GetDriver()->GetDescription(), "KEA") || ( pBand->GetBand() < 1 ) )
         return false;
 
+    kealib::KEAImageIO *pSrcImageIO = static_cast<kealib::KEAImageIO*>(pSrcDataset->GetInternalHandle(nullptr));
+    if( pSrcImageIO == nullptr )
+        return false;
+
+    // make sure cached blocks and buffered RAT edits on the source have
+    // reached the file
+    if( pBand->FlushCache() != CE_None )
+        return false;
+    for( int nOverview = 0; nOverview < pBand->GetOverviewCount(); nOverview++ )
+    {
+        if( pBand->GetOverview(nOverview)->FlushCache() != CE_None )
+            return false;
+    }
+    if( pBand->GetMaskBand()->FlushCache() != CE_None )
+        return false;
+    KEARasterAttributeTable *pKEAAtt = dynamic_cast<KEARasterAttributeTable*>(pBand->GetDefaultRAT());
+    
+    try
+    {
+        if( pKEAAtt != nullptr )
+            pKEAAtt->Flush();
+        return pImageIO->copyImageBand(pSrcImageIO, pBand->GetBand(), nBand);
+    }
+    catch(const kealib::KEAException &e)
+    {
+        return false;
+    }
+}
+
+// the raster data of the band has been copied with the others by CopyFile.
+// dfPixelsDone of dfTotalPixels have been copied so far, progress is
+// reported as the overviews add to it.
+bool CopyBand( GDALRasterBand *pBand, kealib::KEAImageIO *pImageIO, int nBand, int nThreads, double &dfPixelsDone, double dfTotalPixels, GDALProgressFunc pfnProgress, void *pProgressData)
+{
     // are there any overviews?
     int nOverviews = pBand->GetOverviewCount();
     for( int nOverviewCount = 0; nOverviewCount < nOverviews; nOverviewCount++ )
@@ -360,7 +571,14 @@ bool CopyBand( GDALRasterBand *pBand, kealib::KEAImageIO *pImageIO, int nBand, i
         int nOverviewXSize = pOverview->GetXSize();
         int nOverviewYSize = pOverview->GetYSize();
         pImageIO->createOverview( nBand, nOverviewCount + 1, nOverviewXSize, nOverviewYSize);
-        if( !CopyRasterData( pOverview, pImageIO, nBand, nOverviewCount + 1, nTotalbands, pfnProgress, pProgressData) )
+        double dfStart = dfPixelsDone / dfTotalPixels;
+        dfPixelsDone += (double)nOverviewXSize * nOverviewYSize;
+        void *pScaledProgressData = GDALCreateScaledProgress( dfStart, dfPixelsDone / dfTotalPixels,
+                                                              pfnProgress, pProgressData );
+        bool bCopied = CopyRasterData( &pOverview, &nBand, 1, pImageIO, nOverviewCount + 1, nThreads,
+                                       GDALScaledProgress, pScaledProgressData );
+        GDALDestroyScaledProgress( pScaledProgressData );
+        if( !bCopied )
             return false;
     }
 
@@ -442,7 +660,7 @@ void CopyGCPs(GDALDataset *pDataset, kealib::KEAImageIO *pImageIO)
 
 
 
-bool CopyFile( GDALDataset *pDataset, kealib::KEAImageIO *pImageIO, GDALProgressFunc pfnProgress, void *pProgressData )
+bool CopyFile( GDALDataset *pDataset, kealib::KEAImageIO *pImageIO, int nThreads, GDALProgressFunc pfnProgress, void *pProgressData )
 {
     // Main function - copies pDataset to pImageIO
 
@@ -455,12 +673,49 @@ bool CopyFile( GDALDataset *pDataset, kealib::KEAImageIO *pImageIO, GDALProgress
     // GCPs
     CopyGCPs(pDataset, pImageIO);
     
-    // now copy all the bands over
+    // bands from KEA files stored the same way are copied whole. The raster
+    // data of the others is copied together
     int nBands = pDataset->GetRasterCount();
+    std::vector<GDALRasterBand*> apBands;
+    std::vector<int> anKEABands;
     for( int nBand = 0; nBand < nBands; nBand++ )
     {
         GDALRasterBand *pBand = pDataset->GetRasterBand(nBand + 1);
-        if( !CopyBand( pBand, pImageIO, nBand +1, nBands, pfnProgress, pProgressData ) )
+        if( !CopyKEABand( pBand, pImageIO, nBand + 1 ) )
+        {
+            apBands.push_back( pBand );
+            anKEABands.push_back( nBand + 1 );
+        }
+    }
+
+    // progress is shared between the bands and their overviews by pixels
+    double dfPixelsDone = 0;
+    double dfTotalPixels = 0;
+    for( GDALRasterBand *pBand : apBands )
+    {
+        dfPixelsDone += (double)pBand->GetXSize() * pBand->GetYSize();
+        for( int nOverview = 0; nOverview < pBand->GetOverviewCount(); nOverview++ )
+        {
+            GDALRasterBand *pOverview = pBand->GetOverview(nOverview);
+            dfTotalPixels += (double)pOverview->GetXSize() * pOverview->GetYSize();
+        }
+    }
+    dfTotalPixels = std::max( dfTotalPixels + dfPixelsDone, 1.0 );
+    if( !apBands.empty() )
+    {
+        void *pScaledProgressData = GDALCreateScaledProgress( 0.0, dfPixelsDone / dfTotalPixels,
+                                                              pfnProgress, pProgressData );
+        bool bCopied = CopyRasterData( apBands.data(), anKEABands.data(), (int)apBands.size(), pImageIO, -1,
+                                       nThreads, GDALScaledProgress, pScaledProgressData );
+        GDALDestroyScaledProgress( pScaledProgressData );
+        if( !bCopied )
+            return false;
+    }
+
+    // then everything else a band at a time
+    for( size_t i = 0; i < apBands.size(); i++ )
+    {
+        if( !CopyBand( apBands[i], pImageIO, anKEABands[i], nThreads, dfPixelsDone, dfTotalPixels, pfnProgress, pProgressData ) )
             return false;
     }
 
@@ -35,6 +35,9 @@
 #include "libkea/KEACommon.h"
 #include "cpl_vsi_virtual.h"
 
+#include <algorithm>
+#include <vector>
+
 // Function for converting a libkea type into a GDAL type
 GDALDataType KEA_to_GDAL_Type( kealib::KEADataType ekeaType )
 {
@@ -124,6 +127,53 @@ kealib::KEADataType GDAL_to_KEA_Type( GDALDataType egdalType )
     return ekeaType;
 }
 
+char **KEA_IOStats_to_Metadata( const kealib::KEAIOStats &oStats, char **papszList )
+{
+    papszList = CSLSetNameValue( papszList, "BYTES_READ", CPLSPrintf( CPL_FRMT_GUIB, (GUIntBig)oStats.bytesRead ) );
+    papszList = CSLSetNameValue( papszList, "RAW_BYTES_READ", CPLSPrintf( CPL_FRMT_GUIB, (GUIntBig)oStats.rawBytesRead ) );
+    papszList = CSLSetNameValue( papszList, "BYTES_WRITTEN", CPLSPrintf( CPL_FRMT_GUIB, (GUIntBig)oStats.bytesWritten ) );
+    papszList = CSLSetNameValue( papszList, "RAW_BYTES_WRITTEN", CPLSPrintf( CPL_FRMT_GUIB, (GUIntBig)oStats.rawBytesWritten ) );
+    papszList = CSLSetNameValue( papszList, "CHUNKS_DECODED", CPLSPrintf( CPL_FRMT_GUIB, (GUIntBig)oStats.chunksDecoded ) );
+    papszList = CSLSetNameValue( papszList, "CHUNKS_ENCODED", CPLSPrintf( CPL_FRMT_GUIB, (GUIntBig)oStats.chunksEncoded ) );
+    papszList = CSLSetNameValue( papszList, "CACHE_HITS", CPLSPrintf( CPL_FRMT_GUIB, (GUIntBig)oStats.cacheHits ) );
+    papszList = CSLSetNameValue( papszList, "CACHE_MISSES", CPLSPrintf( CPL_FRMT_GUIB, (GUIntBig)oStats.cacheMisses ) );
+    papszList = CSLSetNameValue( papszList, "DECODE_SECONDS", CPLSPrintf( "%.6f", oStats.decodeNanos / 1e9 ) );
+    papszList = CSLSetNameValue( papszList, "ENCODE_SECONDS", CPLSPrintf( "%.6f", oStats.encodeNanos / 1e9 ) );
+    papszList = CSLSetNameValue( papszList, "HDF5_SECONDS", CPLSPrintf( "%.6f", oStats.hdf5Nanos / 1e9 ) );
+    papszList = CSLSetNameValue( papszList, "HDF5_DATASET_OPENS", CPLSPrintf( CPL_FRMT_GUIB, (GUIntBig)oStats.datasetOpens ) );
+    papszList = CSLSetNameValue( papszList, "FILE_OPENS", CPLSPrintf( CPL_FRMT_GUIB, (GUIntBig)oStats.fileOpens ) );
+    return papszList;
+}
+
+// opens a file read-only through the virtual driver so we can open
+// files using /vsicurl etc
+static H5::H5File *OpenReadOnlyH5File( const std::string &osFilename )
+{
+    try
+    {
+        // do this same as libkea
+        H5::FileAccPropList keaAccessPlist =
+            H5::FileAccPropList(H5::FileAccPropList::DEFAULT);
+        keaAccessPlist.setCache(
+            kealib::KEA_MDC_NELMTS, kealib::KEA_RDCC_NELMTS,
+            kealib::KEA_RDCC_NBYTES, kealib::KEA_RDCC_W0);
+        keaAccessPlist.setSieveBufSize(kealib::KEA_SIEVE_BUF);
+        hsize_t blockSize = kealib::KEA_META_BLOCKSIZE;
+        keaAccessPlist.setMetaBlockSize(blockSize);
+        // but set the driver
+        keaAccessPlist.setDriver(HDF5VFLGetFileDriver(), nullptr);
+
+        const H5std_string keaImgFilePath(osFilename);
+        return new H5::H5File(keaImgFilePath, H5F_ACC_RDONLY,
+                              H5::FileCreatPropList::DEFAULT,
+                              keaAccessPlist);
+    }
+    catch( const H5::Exception &e )
+    {
+        throw kealib::KEAIOException(e.getCDetailMsg());
+    }
+}
+
 // static function - pointer set in driver 
 GDALDataset *KEADataset::Open( GDALOpenInfo * poOpenInfo )
 {
@@ -135,24 +185,7 @@ GDALDataset *KEADataset::Open( GDALOpenInfo * poOpenInfo )
             H5::H5File *pH5File;
             if( poOpenInfo->eAccess == GA_ReadOnly )
             {
-                // use the virtual driver so we can open files using
-                // /vsicurl etc
-                // do this same as libkea
-                H5::FileAccPropList keaAccessPlist =
-                    H5::FileAccPropList(H5::FileAccPropList::DEFAULT);
-                keaAccessPlist.setCache(
-                    kealib::KEA_MDC_NELMTS, kealib::KEA_RDCC_NELMTS,
-                    kealib::KEA_RDCC_NBYTES, kealib::KEA_RDCC_W0);
-                keaAccessPlist.setSieveBufSize(kealib::KEA_SIEVE_BUF);
-                hsize_t blockSize = kealib::KEA_META_BLOCKSIZE;
-                keaAccessPlist.setMetaBlockSize(blockSize);
-                // but set the driver
-                keaAccessPlist.setDriver(HDF5VFLGetFileDriver(), nullptr);
-
-                const H5std_string keaImgFilePath(poOpenInfo->pszFilename);
-                pH5File = new H5::H5File(keaImgFilePath, H5F_ACC_RDONLY,
-                                         H5::FileCreatPropList::DEFAULT,
-                                         keaAccessPlist);
+                pH5File = OpenReadOnlyH5File( poOpenInfo->pszFilename );
             }
             else
             {
@@ -161,6 +194,25 @@ GDALDataset *KEADataset::Open( GDALOpenInfo * poOpenInfo )
             // create the KEADataset object
             KEADataset *pDataset = new KEADataset( pH5File, poOpenInfo->eAccess );
 
+            // read-only files can be closed when too many are open (or
+            // their chunk caches use too much memory) and are reopened
+            // when next used. The limits apply to every file already open.
+            if( poOpenInfo->eAccess == GA_ReadOnly )
+            {
+                kealib::KEAImageIO::setFileLimits(
+                    (size_t)std::max( 0, atoi( CPLGetConfigOption( "KEA_MAX_OPEN_FILES", "0" ) ) ),
+                    (size_t)std::max( (GIntBig)0, CPLAtoGIntBig( CPLGetConfigOption( "KEA_CHUNK_CACHE_MAX", "0" ) ) ) );
+                std::string osFilename( poOpenInfo->pszFilename );
+                try
+                {
+                    pDataset->m_pImageIO->setReopenable( [osFilename]() { return OpenReadOnlyH5File( osFilename ); } );
+                }
+                catch (const kealib::KEAIOException &)
+                {
+                    // it just stays open
+                }
+            }
+
             // set the description as the name
             pDataset->SetDescription( poOpenInfo->pszFilename );
 
@@ -398,6 +450,14 @@ GDALDataset *KEADataset::CreateCopy( const char * pszFilename, GDALDataset *pSrc
     if( pszValue != nullptr )
         bThematic = EQUAL(pszValue, "YES");
 
+    // threads compressing the data as it is copied
+    int nThreads = 1;
+    pszValue = CSLFetchNameValue( papszParmList, "NUM_THREADS" );
+    if( pszValue != nullptr )
+        nThreads = EQUAL(pszValue, "ALL_CPUS") ? CPLGetNumCPUs() : atoi( pszValue );
+    if( nThreads < 1 )
+        nThreads = 1;
+
     // get the data out of the input dataset
     int nXSize = pSrcDs->GetRasterXSize();
     int nYSize = pSrcDs->GetRasterYSize();
@@ -422,7 +482,7 @@ GDALDataset *KEADataset::CreateCopy( const char * pszFilename, GDALDataset *pSrc
         pImageIO->openKEAImageHeader( keaImgH5File );
 
         // copy file
-        if( !CopyFile( pSrcDs, pImageIO, pfnProgress, pProgressData) )
+        if( !CopyFile( pSrcDs, pImageIO, nThreads, pfnProgress, pProgressData) )
         {
             delete pImageIO;
             return nullptr;
@@ -473,6 +533,8 @@ KEADataset::KEADataset( H5::H5File *keaImgH5File, GDALAccess eAccess )
 {
     this->m_hMutex = CPLCreateMutex();
     CPLReleaseMutex( this->m_hMutex );
+    this->m_bMetadataRead = false;
+    this->m_papszIOStats = nullptr;
     try
     {
         // create the image IO and initilize the refcount
@@ -494,16 +556,14 @@ KEADataset::KEADataset( H5::H5File *keaImgH5File, GDALAccess eAccess )
         {
             // note GDAL uses indices starting at 1 and so does kealib
             // create band object
+            // overviews and metadata are read in when first asked for
             KEARasterBand *pBand = new KEARasterBand( this, nCount + 1, eAccess, m_pImageIO, m_pRefcount );
-            // read in overviews
-            pBand->readExistingOverviews();
             // set the band into this dataset
             this->SetBand( nCount + 1, pBand );            
         }
 
-        // read in the metadata
+        // metadata is read in when first asked for
         m_papszMetadataList = nullptr;
-        this->UpdateMetadataList();
 
         // nullptr until we read them in 
         m_pGCPs = nullptr;
@@ -522,6 +582,7 @@ KEADataset::~KEADataset()
         CPLMutexHolderD( &m_hMutex );
         // destroy the metadata
         CSLDestroy(m_papszMetadataList);
+        CSLDestroy(m_papszIOStats);
         this->DestroyGCPs();
     }
     // decrement the refcount and delete if needed
@@ -555,6 +616,25 @@ void KEADataset::UpdateMetadataList()
     }
 }
 
+// read in the metadata if this hasn't happened yet
+void KEADataset::LoadMetadataList()
+{
+    CPLMutexHolderD( &m_hMutex );
+    if( !m_bMetadataRead )
+    {
+        m_bMetadataRead = true;
+        try
+        {
+            this->UpdateMetadataList();
+        }
+        catch (const kealib::KEAIOException &e)
+        {
+            CPLError( CE_Warning, CPLE_AppDefined,
+                    "Failed to read metadata: %s", e.what() );
+        }
+    }
+}
+
 // read in the geotransform
 CPLErr KEADataset::GetGeoTransform( double * padfTransform )
 {
@@ -661,6 +741,111 @@ void * KEADataset::GetInternalHandle(const char *)
     return m_pImageIO;
 }
 
+// Requests covering several bands at full resolution are done a strip of
+// chunk rows at a time, reading (or writing) every band for the strip
+// before moving on so each band is written straight into its slot in the
+// interleaved buffer rather than going through the block cache per band.
+// Anything else goes to the default implementation which ends up in
+// KEARasterBand::IRasterIO.
+CPLErr KEADataset::IRasterIO(GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                                    void *pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                                    int nBandCount, BANDMAP_TYPE panBandMap, GSpacing nPixelSpace,
+                                    GSpacing nLineSpace, GSpacing nBandSpace,
+                                    GDALRasterIOExtraArg *psExtraArg)
+{
+    bool bDirect = ( nBandCount > 1 ) && ( nBufXSize == nXSize ) && ( nBufYSize == nYSize );
+    
+    // all bands must match the buffer type as no conversion is done here
+    int nBlockXSize = 0, nBlockYSize = 0;
+    for( int i = 0; bDirect && ( i < nBandCount ); i++ )
+    {
+        GDALRasterBand *pBand = this->GetRasterBand(panBandMap[i]);
+        if( ( pBand == nullptr ) || ( pBand->GetRasterDataType() != eBufType ) )
+        {
+            bDirect = false;
+        }
+        else if( i == 0 )
+        {
+            pBand->GetBlockSize(&nBlockXSize, &nBlockYSize);
+        }
+    }
+    
+    // same size and spacing rules as KEARasterBand::DirectRasterIO
+    GSpacing nTypeSize = GDALGetDataTypeSizeBytes( eBufType );
+    if( bDirect && ( ( (GIntBig)nBufXSize * nBufYSize < (GIntBig)nBlockXSize * nBlockYSize ) ||
+        ( nPixelSpace <= 0 ) || ( nLineSpace <= 0 ) || ( nPixelSpace % nTypeSize != 0 ) ||
+        ( nLineSpace % nTypeSize != 0 ) || ( nBandSpace % nTypeSize != 0 ) ||
+        ( ( nBufYSize > 1 ) && ( nLineSpace < ( ( nBufXSize - 1 ) * nPixelSpace ) + nTypeSize ) ) ) )
+    {
+        bDirect = false;
+    }
+    
+    if( !bDirect )
+    {
+        return GDALPamDataset::IRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize, pData, nBufXSize, nBufYSize,
+                                          eBufType, nBandCount, panBandMap, nPixelSpace, nLineSpace,
+                                          nBandSpace, psExtraArg );
+    }
+    
+    // cached blocks could be dirty or be made stale by this request
+    if( this->eAccess == GA_Update )
+    {
+        for( int i = 0; i < nBandCount; i++ )
+        {
+            if( this->GetRasterBand(panBandMap[i])->FlushCache() != CE_None )
+            {
+                return CE_Failure;
+            }
+        }
+    }
+    
+    kealib::KEADataType eKEAType = GDAL_to_KEA_Type( eBufType );
+    GByte *pabyData = static_cast<GByte*>(pData);
+    int nYEnd = nYOff + nYSize;
+    try
+    {
+        for( int nYStrip = nYOff; nYStrip < nYEnd; )
+        {
+            // strips end on chunk boundaries so each chunk is only touched once
+            int nYNext = std::min( ( ( nYStrip / nBlockYSize ) + 1 ) * nBlockYSize, nYEnd );
+            for( int i = 0; i < nBandCount; i++ )
+            {
+                GByte *pabyStrip = pabyData + ( i * nBandSpace ) + ( ( nYStrip - nYOff ) * nLineSpace );
+                if( eRWFlag == GF_Read )
+                {
+                    // shares the lock with the concurrent block reads
+                    std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
+                    m_pImageIO->readImageBlock2BandStrided( panBandMap[i], 0, pabyStrip, nXOff, nYStrip,
+                                                    nXSize, nYNext - nYStrip, 1, 1,
+                                                    nPixelSpace / nTypeSize, nLineSpace / nTypeSize, eKEAType );
+                }
+                else
+                {
+                    m_pImageIO->writeImageBlock2BandStrided( panBandMap[i], 0, pabyStrip, nXOff, nYStrip,
+                                                    nXSize, nYNext - nYStrip,
+                                                    nPixelSpace / nTypeSize, nLineSpace / nTypeSize, eKEAType );
+                    ((KEARasterBand*)this->GetRasterBand(panBandMap[i]))->InvalidateStatistics();
+                }
+            }
+            nYStrip = nYNext;
+            
+            if( ( psExtraArg != nullptr ) && ( psExtraArg->pfnProgress != nullptr ) &&
+                !psExtraArg->pfnProgress( (double)( nYStrip - nYOff ) / nYSize, "", psExtraArg->pProgressData ) )
+            {
+                CPLError( CE_Failure, CPLE_UserInterrupt, "User terminated" );
+                return CE_Failure;
+            }
+        }
+    }
+    catch (const kealib::KEAIOException &e)
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                "Failed to %s file: %s", ( eRWFlag == GF_Read ) ? "read" : "write", e.what() );
+        return CE_Failure;
+    }
+    return CE_None;
+}
+
 // this is called by GDALDataset::BuildOverviews. we implement this function to support
 // building of overviews
 #ifdef HAVE_OVERVIEWOPTIONS
@@ -673,48 +858,78 @@ CPLErr KEADataset::IBuildOverviews(const char *pszResampling, int nOverviews, in
                                     void *pProgressData)
 #endif
 {
-    // go through the list of bands that have been passed in
-    int nCurrentBand, nOK = 1;
-    for( int nBandCount = 0; (nBandCount < nListBands) && nOK; nBandCount++ )
-    {
-        // get the band number
-        nCurrentBand = panBandList[nBandCount];
-        // get the band
-        KEARasterBand *pBand = (KEARasterBand*)this->GetRasterBand(nCurrentBand);
-        // create the overview object
+    // create the overview objects for all the bands first
+    std::vector<GDALRasterBand*> apoSrcBands;
+    std::vector<GDALRasterBand**> apapoOverviewBands;
+    // only the methods GDALRegenerateOverviewsMultiBand() supports
+    bool bMultiBand = ( nListBands > 1 ) && ( STARTS_WITH_CI(pszResampling, "NEAR") ||
+                        EQUAL(pszResampling, "AVERAGE") || EQUAL(pszResampling, "GAUSS") ||
+                        EQUAL(pszResampling, "CUBIC") || EQUAL(pszResampling, "CUBICSPLINE") ||
+                        EQUAL(pszResampling, "LANCZOS") || EQUAL(pszResampling, "BILINEAR")
+#if (GDAL_VERSION_MAJOR > 3) || ((GDAL_VERSION_MAJOR == 3) && (GDAL_VERSION_MINOR >= 3))
+                        || EQUAL(pszResampling, "MODE") || EQUAL(pszResampling, "RMS")
+#endif
+                        );
+    for( int nBandCount = 0; nBandCount < nListBands; nBandCount++ )
+    {
+        KEARasterBand *pBand = (KEARasterBand*)this->GetRasterBand(panBandList[nBandCount]);
         pBand->CreateOverviews( nOverviews, panOverviewList );
+        apoSrcBands.push_back(pBand);
+        apapoOverviewBands.push_back((GDALRasterBand**)pBand->GetOverviewList());
 
-        // get GDAL to do the hard work. It will calculate the overviews and write them
-        // back into the objects
+        // GDALRegenerateOverviewsMultiBand() can't do these
+        if( ( pBand->GetColorTable() != nullptr ) || GDALDataTypeIsComplex(pBand->GetRasterDataType()) )
+            bMultiBand = false;
+    }
+
+    if( bMultiBand )
+    {
+        // read the source once for all the bands rather than once per band
 #ifdef HAVE_OVERVIEWOPTIONS
-        if( GDALRegenerateOverviewsEx( (GDALRasterBandH)pBand, nOverviews, (GDALRasterBandH*)pBand->GetOverviewList(),
-                                    pszResampling, pfnProgress, pProgressData, papszOptions) != CE_None )
+        return GDALRegenerateOverviewsMultiBand( nListBands, apoSrcBands.data(), nOverviews,
+                                    apapoOverviewBands.data(), pszResampling, pfnProgress, pProgressData,
+                                    papszOptions );
 #else
-        if( GDALRegenerateOverviews( (GDALRasterBandH)pBand, nOverviews, (GDALRasterBandH*)pBand->GetOverviewList(),
-                                    pszResampling, pfnProgress, pProgressData ) != CE_None )
+        return GDALRegenerateOverviewsMultiBand( nListBands, apoSrcBands.data(), nOverviews,
+                                    apapoOverviewBands.data(), pszResampling, pfnProgress, pProgressData );
 #endif
-        {
-            nOK = 0;
-        }
-    }
-    if( !nOK )
-    {
-        return CE_Failure;
     }
-    else
+
+    // otherwise get GDAL to do each band in turn. It will calculate the overviews and write them
+    // back into the objects
+    CPLErr eErr = CE_None;
+    for( int nBandCount = 0; (nBandCount < nListBands) && (eErr == CE_None); nBandCount++ )
     {
-        return CE_None;
+        void *pScaledProgressData = GDALCreateScaledProgress( nBandCount / (double)nListBands,
+                                    (nBandCount + 1) / (double)nListBands, pfnProgress, pProgressData );
+#ifdef HAVE_OVERVIEWOPTIONS
+        eErr = GDALRegenerateOverviewsEx( (GDALRasterBandH)apoSrcBands[nBandCount], nOverviews,
+                                    (GDALRasterBandH*)apapoOverviewBands[nBandCount],
+                                    pszResampling, GDALScaledProgress, pScaledProgressData, papszOptions );
+#else
+        eErr = GDALRegenerateOverviews( (GDALRasterBandH)apoSrcBands[nBandCount], nOverviews,
+                                    (GDALRasterBandH*)apapoOverviewBands[nBandCount],
+                                    pszResampling, GDALScaledProgress, pScaledProgressData );
+#endif
+        GDALDestroyScaledProgress( pScaledProgressData );
     }
+    return eErr;
 }
 
 // set a single metadata item
 CPLErr KEADataset::SetMetadataItem(const char *pszName, const char *pszValue, const char *pszDomain)
 {
     CPLMutexHolderD( &m_hMutex );
+    if( ( pszDomain != nullptr ) && EQUAL( pszDomain, "KEA_IO_STATS" ) )
+    {
+        this->m_pImageIO->resetIOStats();
+        return CE_None;
+    }
     // only deal with 'default' domain - no geolocation etc
     if( ( pszDomain != nullptr ) && ( *pszDomain != '\0' ) )
         return CE_Failure;
 
+    this->LoadMetadataList();
     try
     {
         this->m_pImageIO->setImageMetaData(pszName, pszValue );
@@ -732,9 +947,15 @@ CPLErr KEADataset::SetMetadataItem(const char *pszName, const char *pszValue, co
 const char *KEADataset::GetMetadataItem (const char *pszName, const char *pszDomain)
 {
     CPLMutexHolderD( &m_hMutex );
+    if( ( pszDomain != nullptr ) && EQUAL( pszDomain, "KEA_IO_STATS" ) )
+    {
+        m_papszIOStats = KEA_IOStats_to_Metadata( this->m_pImageIO->getIOStats(), m_papszIOStats );
+        return CSLFetchNameValue(m_papszIOStats, pszName);
+    }
     // only deal with 'default' domain - no geolocation etc
     if( ( pszDomain != nullptr ) && ( *pszDomain != '\0' ) )
         return nullptr;
+    this->LoadMetadataList();
     // string returned from CSLFetchNameValue should be persistant
     return CSLFetchNameValue(m_papszMetadataList, pszName);
 }
@@ -742,13 +963,26 @@ const char *KEADataset::GetMetadataItem (const char *pszName, const char *pszDom
 // get the whole metadata as CSLStringList - note may be thread safety issues
 char **KEADataset::GetMetadata(const char *pszDomain)
 { 
+    if( ( pszDomain != nullptr ) && EQUAL( pszDomain, "KEA_IO_STATS" ) )
+    {
+        CPLMutexHolderD( &m_hMutex );
+        m_papszIOStats = KEA_IOStats_to_Metadata( this->m_pImageIO->getIOStats(), m_papszIOStats );
+        return m_papszIOStats;
+    }
     // only deal with 'default' domain - no geolocation etc
     if( ( pszDomain != nullptr ) && ( *pszDomain != '\0' ) )
         return nullptr;
+    this->LoadMetadataList();
     // this is what we store it as anyway
     return m_papszMetadataList; 
 }
 
+char **KEADataset::GetMetadataDomainList()
+{
+    return BuildMetadataDomainList( GDALPamDataset::GetMetadataDomainList(), TRUE,
+                                    "", "KEA_IO_STATS", nullptr );
+}
+
 // set the whole metadata as a CSLStringList
 CPLErr KEADataset::SetMetadata(char **papszMetadata, const char *pszDomain)
 {
@@ -780,6 +1014,7 @@ CPLErr KEADataset::SetMetadata(char **papszMetadata, const char *pszDomain)
     // destroy our one and replace it
     CSLDestroy(m_papszMetadataList);
     m_papszMetadataList = CSLDuplicate(papszMetadata);
+    m_bMetadataRead = true;
     return CE_None;
 }
 
@@ -789,6 +1024,8 @@ CPLErr KEADataset::AddBand(GDALDataType eType, char **papszOptions)
     unsigned int nimageBlockSize = kealib::KEA_IMAGE_CHUNK_SIZE;
     unsigned int nattBlockSize = kealib::KEA_ATT_CHUNK_SIZE;
     unsigned int ndeflate = kealib::KEA_DEFLATE;
+    // a virtual band calculated from the existing bands
+    const char *pszExpression = nullptr;
     if (papszOptions != nullptr) {
         const char *pszValue = CSLFetchNameValue(papszOptions,"IMAGEBLOCKSIZE");
         if ( pszValue != nullptr ) {
@@ -804,12 +1041,21 @@ CPLErr KEADataset::AddBand(GDALDataType eType, char **papszOptions)
         if (pszValue != nullptr) {
             ndeflate = atol(pszValue);
         }
+
+        pszExpression = CSLFetchNameValue(papszOptions, "EXPRESSION");
     }
 
     try {
-        m_pImageIO->addImageBand(GDAL_to_KEA_Type(eType), "", nimageBlockSize,
-                nattBlockSize, ndeflate);
+        if (pszExpression != nullptr) {
+            m_pImageIO->addVirtualImageBand(GDAL_to_KEA_Type(eType), "", pszExpression,
+                    nimageBlockSize, nattBlockSize);
+        } else {
+            m_pImageIO->addImageBand(GDAL_to_KEA_Type(eType), "", nimageBlockSize,
+                    nattBlockSize, ndeflate);
+        }
     } catch (const kealib::KEAIOException &e) {
+        CPLError(CE_Failure, CPLE_AppDefined,
+                "Unable to add a band: %s", e.what());
         return CE_Failure;
     }
 
@@ -72,6 +72,9 @@ public:
 
     char **GetMetadata(const char *pszDomain="");
     CPLErr SetMetadata(char **papszMetadata, const char *pszDomain="");
+    // adds KEA_IO_STATS, the counts of I/O for all bands since opening
+    // which are reset by setting any item in it
+    char **GetMetadataDomainList();
 
     // virtual method for adding new image bands
     CPLErr AddBand(GDALDataType eType, char **papszOptions = NULL);
@@ -86,6 +89,13 @@ public:
             const OGRSpatialReference* poSRS ) override;
 
 protected:
+    // multi-band reads and writes straight to and from the interleaved buffer
+    virtual CPLErr IRasterIO(GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                                    void *pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                                    int nBandCount, BANDMAP_TYPE panBandMap, GSpacing nPixelSpace,
+                                    GSpacing nLineSpace, GSpacing nBandSpace,
+                                    GDALRasterIOExtraArg *psExtraArg) override;
+
     // this method builds overviews for the specified bands. 
 #ifdef HAVE_OVERVIEWOPTIONS
     virtual CPLErr IBuildOverviews(const char *pszResampling, int nOverviews, const int *panOverviewList, 
@@ -99,6 +109,8 @@ protected:
 
     // internal method to update m_papszMetadataList
     void UpdateMetadataList();
+    // reads the metadata in the first time it is asked for
+    void LoadMetadataList();
 
     void DestroyGCPs();
 
@@ -107,6 +119,8 @@ private:
     kealib::KEAImageIO  *m_pImageIO;
     LockedRefCount      *m_pRefcount;
     char               **m_papszMetadataList; // CSLStringList for metadata
+    bool                 m_bMetadataRead; // m_papszMetadataList read from the file yet?
+    char               **m_papszIOStats; // KEA_IO_STATS as last asked for
     GDAL_GCP            *m_pGCPs;
     mutable OGRSpatialReference  m_oGCPSRS{};
     mutable CPLMutex            *m_hMutex;
@@ -116,6 +130,8 @@ private:
 // conversion functions
 GDALDataType KEA_to_GDAL_Type( kealib::KEADataType ekeaType );
 kealib::KEADataType GDAL_to_KEA_Type( GDALDataType egdalType );
+// sets the KEA_IO_STATS metadata items in papszList from oStats
+char **KEA_IOStats_to_Metadata( const kealib::KEAIOStats &oStats, char **papszList );
 
 // A thresafe reference count. Used to manage shared pointer to
 // the kealib::KEAImageIO instance between bands and dataset.
@@ -67,6 +67,7 @@ void GDALRegister_KEA()
 <Option name='META_BLOCKSIZE' type='int' description='Sets the minimum size of metadata block allocations'/> \
 <Option name='DEFLATE' type='int' description='0 (no compression) to 9 (max compression)'/> \
 <Option name='THEMATIC' type='boolean' description='If YES then all bands are set to thematic'/> \
+<Option name='NUM_THREADS' type='string' description='Number of threads compressing data in CreateCopy, or ALL_CPUS'/> \
 </CreationOptionList>" );
 
         // pointer to open function
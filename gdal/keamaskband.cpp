@@ -90,6 +90,8 @@ CPLErr KEAMaskBand::IReadBlock( int nBlockXOff, int nBlockYOff, void * pImage )
         {
             nysize -= (nytotalsize - this->nRasterYSize);
         }
+        // the source band may be read concurrently in read-only datasets
+        std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
         this->m_pImageIO->readImageBlock2BandMask( this->m_nSrcBand,
                                             pImage, this->nBlockXSize * nBlockXOff,
                                             this->nBlockYSize * nBlockYOff,
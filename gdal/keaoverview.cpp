@@ -36,11 +36,15 @@ KEAOverview::KEAOverview(KEADataset *pDataset, int nSrcBand, GDALAccess eAccess,
  : KEARasterBand( pDataset, nSrcBand, eAccess, pImageIO, pRefCount )
 {
     this->m_nOverviewIndex = nOverviewIndex;
+    // overviews of virtual bands are stored like any other
+    this->eAccess = eAccess;
     // overridden from the band - not the same size as the band obviously
     this->nBlockXSize = pImageIO->getOverviewBlockSize(nSrcBand, nOverviewIndex);
     this->nBlockYSize = pImageIO->getOverviewBlockSize(nSrcBand, nOverviewIndex);
     this->nRasterXSize = nXSize;
     this->nRasterYSize = nYSize;
+    // overviews don't have overviews of their own
+    this->m_bOverviewsRead = true;
 }
 
 KEAOverview::~KEAOverview()
@@ -67,11 +71,23 @@ CPLErr KEAOverview::IReadBlock( int nBlockXOff, int nBlockYOff, void * pImage )
         {
             nysize -= (nytotalsize - this->nRasterYSize);
         }
-        this->m_pImageIO->readFromOverview( this->nBand, this->m_nOverviewIndex,
+        // as KEARasterBand::IReadBlock
+        if( this->poDS->GetAccess() == GA_ReadOnly )
+        {
+            this->m_pImageIO->readImageBlock2BandConcurrent( this->nBand, this->m_nOverviewIndex,
+                                            pImage, this->nBlockXSize * nBlockXOff,
+                                            this->nBlockYSize * nBlockYOff,
+                                            nxsize, nysize, this->nBlockXSize,
+                                            this->m_eKEADataType );
+        }
+        else
+        {
+            this->m_pImageIO->readFromOverview( this->nBand, this->m_nOverviewIndex,
                                             pImage, this->nBlockXSize * nBlockXOff,
                                             this->nBlockYSize * nBlockYOff,
                                             nxsize, nysize, this->nBlockXSize, this->nBlockYSize, 
                                             this->m_eKEADataType );
+        }
         return CE_None;
     }
     catch (const kealib::KEAIOException &e)
@@ -128,3 +144,58 @@ CPLErr KEAOverview::SetDefaultRAT(const GDALRasterAttributeTable *poRAT)
     // KEARasterBand implements this, but we don't want to
     return CE_Failure;    
 }
+
+CPLErr KEAOverview::ComputeStatistics( int bApproxOK, double *pdfMin, double *pdfMax,
+                                        double *pdfMean, double *pdfStdDev,
+                                        GDALProgressFunc pfnProgress, void *pProgressData )
+{
+    // KEARasterBand implements this, but we don't want to
+    return GDALPamRasterBand::ComputeStatistics( bApproxOK, pdfMin, pdfMax, pdfMean, pdfStdDev,
+                                        pfnProgress, pProgressData );
+}
+
+CPLErr KEAOverview::ComputeRasterMinMax( int bApproxOK, double *adfMinMax )
+{
+    // KEARasterBand implements this, but we don't want to
+    return GDALPamRasterBand::ComputeRasterMinMax( bApproxOK, adfMinMax );
+}
+
+CPLErr KEAOverview::GetHistogram( double dfMin, double dfMax, int nBuckets,
+                                        GUIntBig *panHistogram, int bIncludeOutOfRange,
+                                        int bApproxOK, GDALProgressFunc pfnProgress, void *pProgressData )
+{
+    // KEARasterBand implements this, but we don't want to
+    return GDALPamRasterBand::GetHistogram( dfMin, dfMax, nBuckets, panHistogram,
+                                        bIncludeOutOfRange, bApproxOK, pfnProgress, pProgressData );
+}
+
+// goes straight to the overview for large requests, as for the band
+CPLErr KEAOverview::IRasterIO( GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                               void *pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                               GSpacing nPixelSpace, GSpacing nLineSpace,
+                               GDALRasterIOExtraArg *psExtraArg )
+{
+    CPLErr eErr = CE_None;
+    if( this->DirectRasterIO( this->m_nOverviewIndex, eRWFlag, nXOff, nYOff, nXSize, nYSize, pData,
+                              nBufXSize, nBufYSize, eBufType, nPixelSpace, nLineSpace, psExtraArg, &eErr ) )
+    {
+        return eErr;
+    }
+    return GDALPamRasterBand::IRasterIO( eRWFlag, nXOff, nYOff, nXSize, nYSize, pData, nBufXSize, nBufYSize,
+                                         eBufType, nPixelSpace, nLineSpace, psExtraArg );
+}
+
+// uses the chunks of the overview, as for the band
+CPLErr KEAOverview::AdviseRead( int nXOff, int nYOff, int nXSize, int nYSize,
+                                int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                                char **papszOptions )
+{
+    return this->AdviseReadWindow( this->m_nOverviewIndex, nXOff, nYOff, nXSize, nYSize,
+                                   nBufXSize, nBufYSize );
+}
+
+int KEAOverview::IGetDataCoverageStatus( int nXOff, int nYOff, int nXSize, int nYSize,
+                                         int nMaskFlagStop, double *pdfDataPct )
+{
+    return this->DataCoverageStatus( this->m_nOverviewIndex, nXOff, nYOff, nXSize, nYSize, pdfDataPct );
+}
@@ -47,6 +47,21 @@ public:
     GDALRasterAttributeTable *GetDefaultRAT();
     CPLErr SetDefaultRAT(const GDALRasterAttributeTable *poRAT);
 
+    // kealib calculates statistics for the band, not overviews, so
+    // these are left to GDAL
+    CPLErr ComputeStatistics( int bApproxOK, double *pdfMin, double *pdfMax,
+                                        double *pdfMean, double *pdfStdDev,
+                                        GDALProgressFunc, void *pProgressData );
+    CPLErr ComputeRasterMinMax( int bApproxOK, double *adfMinMax );
+    CPLErr GetHistogram( double dfMin, double dfMax, int nBuckets,
+                                        GUIntBig *panHistogram, int bIncludeOutOfRange,
+                                        int bApproxOK, GDALProgressFunc, void *pProgressData );
+
+    // prefetches the chunks of this overview rather than the band
+    CPLErr AdviseRead( int nXOff, int nYOff, int nXSize, int nYSize,
+                       int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                       char **papszOptions );
+
     // note that Color Table stuff implemented in base class
     // so could be some duplication if overview asked for color table
 
@@ -54,6 +69,12 @@ protected:
     // we just override these functions from KEARasterBand
     virtual CPLErr IReadBlock( int, int, void * );
     virtual CPLErr IWriteBlock( int, int, void * );
+    virtual CPLErr IRasterIO( GDALRWFlag eRWFlag, int nXOff, int nYOff, int nXSize, int nYSize,
+                              void *pData, int nBufXSize, int nBufYSize, GDALDataType eBufType,
+                              GSpacing nPixelSpace, GSpacing nLineSpace,
+                              GDALRasterIOExtraArg *psExtraArg );
+    virtual int IGetDataCoverageStatus( int nXOff, int nYOff, int nXSize, int nYSize,
+                                        int nMaskFlagStop, double *pdfDataPct );
 };
 
 #endif //KEAOVERVIEW_H
@@ -371,6 +371,7 @@ CPLErr KEARasterAttributeTable::ValuesIO(GDALRWFlag eRWFlag, int iField, int iSt
         return CE_Failure;
     }*/
     CPLMutexHolderD( &m_hMutex );
+    std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
     
     if( iField < 0 || iField >= (int) m_aoFields.size() )
     {
@@ -507,6 +508,7 @@ CPLErr KEARasterAttributeTable::ValuesIO(GDALRWFlag eRWFlag, int iField, int iSt
         return CE_Failure;
     }*/
     CPLMutexHolderD( &m_hMutex );
+    std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
 
     if( iField < 0 || iField >= (int) m_aoFields.size() )
     {
@@ -700,6 +702,80 @@ CPLErr KEARasterAttributeTable::ValuesIO(GDALRWFlag eRWFlag, int iField, int iSt
     return CE_None;
 }
 
+CPLErr KEARasterAttributeTable::ValuesIO(GDALRWFlag eRWFlag, int iField, int iStartRow, int iLength, int64_t *pnData)
+{
+    CPLMutexHolderD( &m_hMutex );
+    std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
+
+    if( iField < 0 || iField >= (int) m_aoFields.size() )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "iField (%d) out of range.", iField );
+
+        return CE_Failure;
+    }
+
+    if( iStartRow < 0 || (iStartRow+iLength) > (int)m_poKEATable->getSize() )
+    {
+        CPLError( CE_Failure, CPLE_AppDefined,
+                  "iStartRow (%d) + iLength(%d) out of range.", iStartRow, iLength );
+
+        return CE_Failure;
+    }
+
+    if( m_aoFields[iField].dataType == kealib::kea_att_int )
+    {
+        // the same type as kealib so no conversion needed
+        try
+        {
+            if( eRWFlag == GF_Read )
+                m_poKEATable->getIntFields(iStartRow, iLength, m_aoFields[iField].idx, pnData);
+            else
+                m_poKEATable->setIntFields(iStartRow, iLength, m_aoFields[iField].idx, pnData);
+        }
+        catch(const kealib::KEAException &e)
+        {
+            CPLError( CE_Failure, CPLE_AppDefined, "Failed to read/write attribute table: %s", e.what() );
+            return CE_Failure;
+        }
+        return CE_None;
+    }
+
+    // allocate space for doubles
+    double *padfColData = (double*)VSIMalloc2(iLength, sizeof(double) );
+    if( padfColData == nullptr )
+    {
+        CPLError( CE_Failure, CPLE_OutOfMemory,
+            "Memory Allocation failed in KEARasterAttributeTable::ValuesIO");
+        return CE_Failure;
+    }
+
+    if( eRWFlag == GF_Write )
+    {
+        // copy the application supplied int64_t to doubles
+        for( int i = 0; i < iLength; i++ )
+            padfColData[i] = static_cast<double>(pnData[i]);
+    }
+
+    // do the ValuesIO as doubles
+    CPLErr eVal = ValuesIO(eRWFlag, iField, iStartRow, iLength, padfColData );
+    if( eVal != CE_None )
+    {
+        CPLFree(padfColData);
+        return eVal;
+    }
+
+    if( eRWFlag == GF_Read )
+    {
+        // copy them back to int64_t
+        for( int i = 0; i < iLength; i++ )
+            pnData[i] = static_cast<int64_t>(padfColData[i]);
+    }
+
+    CPLFree(padfColData);
+    return CE_None;
+}
+
 CPLErr KEARasterAttributeTable::ValuesIO(GDALRWFlag eRWFlag, int iField, int iStartRow, int iLength, char **papszStrList)
 {
     /*if( ( eRWFlag == GF_Write ) && ( this->eAccess == GA_ReadOnly ) )
@@ -708,6 +784,8 @@ CPLErr KEARasterAttributeTable::ValuesIO(GDALRWFlag eRWFlag, int iField, int iSt
             "Dataset not open in update mode");
         return CE_Failure;
     }*/
+    CPLMutexHolderD( &m_hMutex );
+    std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
 
     if( iField < 0 || iField >= (int) m_aoFields.size() )
     {
@@ -848,6 +926,20 @@ int KEARasterAttributeTable::ChangesAreWrittenToFile()
     return TRUE;
 }
 
+void KEARasterAttributeTable::Flush()
+{
+    CPLMutexHolderD( &m_hMutex );
+    std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
+    try
+    {
+        m_poKEATable->flush();
+    }
+    catch(const kealib::KEAException &e)
+    {
+        CPLError( CE_Failure, CPLE_AppDefined, "Failed to flush attribute table: %s", e.what() );
+    }
+}
+
 void KEARasterAttributeTable::SetRowCount( int iCount )
 {
     /*if( this->eAccess == GA_ReadOnly )
@@ -856,6 +948,8 @@ void KEARasterAttributeTable::SetRowCount( int iCount )
             "Dataset not open in update mode");
         return;
     }*/
+    CPLMutexHolderD( &m_hMutex );
+    std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
 
     if( iCount > (int)m_poKEATable->getSize() )
     {
@@ -875,6 +969,7 @@ CPLErr KEARasterAttributeTable::CreateColumn( const char *pszFieldName,
         return CE_Failure;
     }*/
     CPLMutexHolderD( &m_hMutex );
+    std::lock_guard<std::recursive_mutex> oHDF5Lock( kealib::KEAImageIO::getHDF5Mutex() );
 
     std::string strUsage = "Generic";
     switch(eFieldUsage)
@@ -70,6 +70,9 @@ public:
     virtual CPLErr        ValuesIO(GDALRWFlag eRWFlag, int iField, int iStartRow, int iLength, double *pdfData);
     virtual CPLErr        ValuesIO(GDALRWFlag eRWFlag, int iField, int iStartRow, int iLength, int *pnData);
     virtual CPLErr        ValuesIO(GDALRWFlag eRWFlag, int iField, int iStartRow, int iLength, char **papszStrList);
+    // not part of the GDAL interface - integer columns are read/written
+    // without going through 32 bit ints (used for histograms)
+    CPLErr                ValuesIO(GDALRWFlag eRWFlag, int iField, int iStartRow, int iLength, int64_t *pnData);
 
     virtual int           ChangesAreWrittenToFile();
     virtual void          SetRowCount( int iCount );
@@ -88,6 +91,9 @@ public:
     virtual CPLErr        SetTableType(const GDALRATTableType eInTableType);
     virtual GDALRATTableType GetTableType() const;
     virtual void          RemoveStatistics();
+
+    // writes any buffered edits through to the file
+    void                  Flush();
 };
 
 #endif //KEARAT_H
@@ -61,6 +61,62 @@ namespace kealib{
         std::vector<size_t> *neighbours;
     };
     
+    /**
+     * A block of consecutive rows held row-major in flat arrays (see getFeatures).
+     * The value of column colIdx for row i (relative to startfid) is at
+     * [(i * numXFields) + colIdx]. Strings are NUL terminated within strArena
+     * and the neighbours of row i are held within
+     * [neighbourOffsets[i], neighbourOffsets[i+1]) of neighbours.
+     */
+    struct KEAATTFeatureBlock
+    {
+        size_t startfid = 0;
+        size_t len = 0;
+        size_t numBoolFields = 0;
+        size_t numIntFields = 0;
+        size_t numFloatFields = 0;
+        size_t numStringFields = 0;
+        std::vector<uint8_t> boolVals;
+        std::vector<int64_t> intVals;
+        std::vector<double> floatVals;
+        std::vector<size_t> strOffsets;
+        std::vector<char> strArena;
+        std::vector<size_t> neighbourOffsets;
+        std::vector<size_t> neighbours;
+        
+        // sizes the block for len rows, keeping the allocations for reuse
+        void reset(size_t startfidIn, size_t lenIn, size_t nBool, size_t nInt, size_t nFloat, size_t nString)
+        {
+            startfid = startfidIn;
+            len = lenIn;
+            numBoolFields = nBool;
+            numIntFields = nInt;
+            numFloatFields = nFloat;
+            numStringFields = nString;
+            boolVals.assign(len * nBool, 0);
+            intVals.assign(len * nInt, 0);
+            floatVals.assign(len * nFloat, 0.0);
+            strOffsets.assign(len * nString, 0);
+            strArena.clear();
+            neighbourOffsets.assign(len + 1, 0);
+            neighbours.clear();
+        }
+        
+        void setString(size_t i, size_t colIdx, const char *str, size_t strLen)
+        {
+            strOffsets[(i * numStringFields) + colIdx] = strArena.size();
+            strArena.insert(strArena.end(), str, str + strLen);
+            strArena.push_back('\0');
+        }
+        
+        bool getBool(size_t i, size_t colIdx) const { return boolVals[(i * numBoolFields) + colIdx] != 0; }
+        int64_t getInt(size_t i, size_t colIdx) const { return intVals[(i * numIntFields) + colIdx]; }
+        double getFloat(size_t i, size_t colIdx) const { return floatVals[(i * numFloatFields) + colIdx]; }
+        const char* getString(size_t i, size_t colIdx) const { return &strArena[strOffsets[(i * numStringFields) + colIdx]]; }
+        size_t getNumNeighbours(size_t i) const { return neighbourOffsets[i + 1] - neighbourOffsets[i]; }
+        const size_t* getNeighbours(size_t i) const { return neighbours.data() + neighbourOffsets[i]; }
+    };
+    
     enum KEAFieldDataType
     {
         kea_att_na = 0,
@@ -98,6 +154,9 @@ namespace kealib{
         void   *p;
     } VarLenFieldHDF;
     
+    // Progress callback for the bulk table load/save, complete is within [0, 1].
+    typedef void (*KEAATTProgressFunc)(double complete, void *progressData);
+    
     class KEA_EXPORT KEAAttributeTable
     {
     public:
@@ -130,6 +189,12 @@ namespace kealib{
         virtual void getFloatFields(size_t startfid, size_t len, size_t colIdx, double *pfBuffer) const=0;
         virtual void getStringFields(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *psBuffer) const=0;
         virtual void getNeighbours(size_t startfid, size_t len, std::vector<std::vector<size_t>* > *neighbours) const=0;
+        /**
+         * Appends the neighbours of rows [startfid, startfid+len) to
+         * neighbours, pushing the end of each row's list onto rowEnds.
+         * Rows have no neighbours if none have been written.
+         */
+        virtual void getNeighbourBlock(size_t startfid, size_t len, std::vector<size_t> *rowEnds, std::vector<size_t> *neighbours) const;
         
         virtual void setBoolField(size_t fid, size_t colIdx, bool value)=0;
         virtual void setIntField(size_t fid, size_t colIdx, int64_t value)=0;
@@ -149,6 +214,8 @@ namespace kealib{
         virtual void setStringValue(size_t colIdx, const std::string &value);
         
         virtual KEAATTFeature* getFeature(size_t fid) const=0;
+        // reads every column (and the neighbours) of len rows in one pass
+        virtual void getFeatures(size_t startfid, size_t len, KEAATTFeatureBlock *features) const;
         
         virtual void addAttBoolField(const std::string &name, bool val, std::string usage="");
         virtual void addAttIntField(const std::string &name, int64_t val, std::string usage="");
@@ -172,6 +239,10 @@ namespace kealib{
         virtual size_t getTotalNumOfCols() const;
         virtual size_t getMaxGlobalColIdx() const;
         virtual void addRows(size_t numRows)=0;
+        // removes numRows rows from the end of the table (not supported by
+        // default).
+        virtual void removeRows(size_t numRows);
+        virtual void flush();
         
         virtual void exportToKeaFile(H5::H5File *keaImg, unsigned int band, unsigned int chunkSize=KEA_ATT_CHUNK_SIZE, unsigned int deflate=KEA_DEFLATE)=0;
         virtual void exportToASCII(const std::string &outputFile);
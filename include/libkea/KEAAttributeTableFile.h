@@ -34,6 +34,9 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <list>
+#include <map>
+#include <tuple>
 
 #include <H5Cpp.h>
 
@@ -42,6 +45,22 @@
 #include "libkea/KEAAttributeTable.h"
 
 namespace kealib{
+
+    // a cached chunk of a single column (chunkSize rows) which
+    // collects cell level edits until it is written back to the file
+    struct KEAATTChunkBuffer
+    {
+        KEAFieldDataType dataType;
+        size_t colIdx;
+        size_t startfid;
+        size_t len;
+        bool dirty;
+        std::vector<int64_t> intVals; // also used for booleans
+        std::vector<double> floatVals;
+        std::vector<std::string> strVals;
+    };
+
+    typedef std::tuple<int, size_t, size_t> KEAATTChunkKey; // type, column, chunk
        
     class KEA_EXPORT KEAAttributeTableFile : public KEAAttributeTable
     {
@@ -68,6 +87,7 @@ namespace kealib{
         void getFloatFields(size_t startfid, size_t len, size_t colIdx, double *pfBuffer) const;
         void getStringFields(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *psBuffer) const;
         void getNeighbours(size_t startfid, size_t len, std::vector<std::vector<size_t>* > *neighbours) const;
+        void getNeighbourBlock(size_t startfid, size_t len, std::vector<size_t> *rowEnds, std::vector<size_t> *neighbours) const;
         
         void setBoolField(size_t fid, size_t colIdx, bool value);
         void setIntField(size_t fid, size_t colIdx, int64_t value);
@@ -81,6 +101,7 @@ namespace kealib{
         void setNeighbours(size_t startfid, size_t len, std::vector<std::vector<size_t>* > *neighbours);
 
         KEAATTFeature* getFeature(size_t fid) const;
+        void getFeatures(size_t startfid, size_t len, KEAATTFeatureBlock *features) const;
         
         size_t getSize() const;
         
@@ -90,6 +111,9 @@ namespace kealib{
         void addAttStringField(KEAATTField field, const std::string &val);
         
         void addRows(size_t numRows);
+        void removeRows(size_t numRows);
+        
+        void flush();
         
         static KEAAttributeTable* createKeaAtt(H5::H5File *keaImg, unsigned int band, unsigned int chunkSize=KEA_ATT_CHUNK_SIZE, unsigned int deflate=KEA_DEFLATE);
         void exportToKeaFile(H5::H5File *keaImg, unsigned int band, unsigned int chunkSize=KEA_ATT_CHUNK_SIZE, unsigned int deflate=KEA_DEFLATE);
@@ -103,6 +127,24 @@ namespace kealib{
         std::string bandPathBase;
 
         void updateSizeHeader(hsize_t nbools, hsize_t nints, hsize_t nfloats, hsize_t nstrings);
+
+        void getBoolFieldsDirect(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer) const;
+        void getIntFieldsDirect(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer) const;
+        void getFloatFieldsDirect(size_t startfid, size_t len, size_t colIdx, double *pfBuffer) const;
+        void getStringFieldsDirect(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *psBuffer) const;
+        void setBoolFieldsDirect(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer);
+        void setIntFieldsDirect(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer);
+        void setFloatFieldsDirect(size_t startfid, size_t len, size_t colIdx, double *pfBuffer);
+        void setStringFieldsDirect(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *papszStrList);
+
+        // write-back buffer for cell level edits - most recently used at the front
+        KEAATTChunkBuffer* findChunkBuffer(KEAFieldDataType dataType, size_t colIdx, size_t startfid, size_t len) const;
+        KEAATTChunkBuffer* getChunkBuffer(KEAFieldDataType dataType, size_t colIdx, size_t startfid, size_t len) const;
+        void writeChunkBuffer(KEAATTChunkBuffer *chunk) const;
+        void flushChunkBuffers(KEAFieldDataType dataType, size_t colIdx, size_t startfid, size_t len, bool discard) const;
+        void flushAllChunkBuffers(bool discard) const;
+        mutable std::list<KEAATTChunkBuffer> chunkBuffers;
+        mutable std::map<KEAATTChunkKey, std::list<KEAATTChunkBuffer>::iterator> chunkBufferIdx;
 };
     
 }
@@ -68,6 +68,7 @@ namespace kealib{
         void getFloatFields(size_t startfid, size_t len, size_t colIdx, double *pfBuffer) const;
         void getStringFields(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *psBuffer) const;
         void getNeighbours(size_t startfid, size_t len, std::vector<std::vector<size_t>* > *neighbours) const;
+        void getNeighbourBlock(size_t startfid, size_t len, std::vector<size_t> *rowEnds, std::vector<size_t> *neighbours) const;
         
         void setBoolField(size_t fid, size_t colIdx, bool value);
         void setIntField(size_t fid, size_t colIdx, int64_t value);
@@ -81,6 +82,7 @@ namespace kealib{
         void setNeighbours(size_t startfid, size_t len, std::vector<std::vector<size_t>* > *neighbours);
 
         KEAATTFeature* getFeature(size_t fid) const;
+        void getFeatures(size_t startfid, size_t len, KEAATTFeatureBlock *features) const;
         
         size_t getSize() const;
         
@@ -90,10 +92,12 @@ namespace kealib{
         void addAttStringField(KEAATTField field, const std::string &val);
         
         void addRows(size_t numRows);
+        void removeRows(size_t numRows);
         
         void exportToKeaFile(H5::H5File *keaImg, unsigned int band, unsigned int chunkSize=KEA_ATT_CHUNK_SIZE, unsigned int deflate=KEA_DEFLATE);
+        void exportToKeaFile(H5::H5File *keaImg, unsigned int band, unsigned int chunkSize, unsigned int deflate, KEAATTProgressFunc pfnProgress, void *pProgressData);
         
-        static KEAAttributeTable* createKeaAtt(H5::H5File *keaImg, unsigned int band);
+        static KEAAttributeTable* createKeaAtt(H5::H5File *keaImg, unsigned int band, KEAATTProgressFunc pfnProgress=nullptr, void *pProgressData=nullptr);
         
         ~KEAAttributeTableInMem();
     protected:
@@ -0,0 +1,91 @@
+/*
+ *  KEABandExpression.h
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without restriction,
+ *  including without limitation the rights to use, copy, modify,
+ *  merge, publish, distribute, sublicense, and/or sell copies of the
+ *  Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef KEABandExpression_H
+#define KEABandExpression_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "libkea/KEACommon.h"
+#include "libkea/KEAException.h"
+
+namespace kealib{
+
+    struct KEAExprNode;
+
+    /**
+     * An expression over the bands of an image, as held by a virtual band
+     * (see KEAImageIO::addVirtualImageBand). Bands are written b1, b2, etc.
+     * and combined with numbers by + - * / (and unary -), the comparisons
+     * < <= > >= == != (1 where true and 0 otherwise), parentheses and the
+     * functions abs, sqrt, log, exp, min, max and where(cond, a, b).
+     */
+    class KEA_EXPORT KEABandExpression
+    {
+    public:
+        /**
+         * Parses expression, throwing a KEAIOException if it isn't valid.
+         */
+        explicit KEABandExpression(const std::string &expression);
+        KEABandExpression(const KEABandExpression &other) = delete;
+        KEABandExpression& operator=(const KEABandExpression &other) = delete;
+
+        /**
+         * The expression written out again in full (with parentheses).
+         */
+        std::string toString() const;
+
+        /**
+         * The bands used, in ascending order.
+         */
+        const std::vector<uint32_t>& getBands() const;
+        bool usesBand(uint32_t band) const;
+        /**
+         * Replaces each band used with renumber(band).
+         */
+        void renumberBands(const std::function<uint32_t(uint32_t)> &renumber);
+
+        /**
+         * Sets out to the value of the expression for n pixels, inputs
+         * holding the values of each of getBands() in turn.
+         */
+        void evaluate(const std::vector<const double*> &inputs, size_t n, double *out) const;
+
+        virtual ~KEABandExpression();
+    protected:
+        std::unique_ptr<KEAExprNode> root;
+        std::vector<uint32_t> bands;
+    };
+
+}
+
+#endif
@@ -33,6 +33,7 @@
 
 #include "libkea/kea_export.h"
 
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -61,6 +62,7 @@ namespace kealib{
     static const std::string KEA_DATASETNAME_BAND( "/BAND" );
     
     static const std::string KEA_BANDNAME_DATA( "/DATA" );
+    static const std::string KEA_BANDNAME_EXPRESSION( "/EXPRESSION" ); // in place of DATA in virtual bands
     static const std::string KEA_BANDNAME_MASK( "/MASK" );
     static const std::string KEA_BANDNAME_DESCRIP( "/DESCRIPTION" );
     static const std::string KEA_BANDNAME_DT( "/DATATYPE" );
@@ -104,6 +106,14 @@ namespace kealib{
     
     static const std::string KEA_ATT_STRING_FIELD( "STRING" );
     
+    // reserved columns written by KEAImageIO::calcSegmentExtents
+    static const std::string KEA_ATT_SEG_MINX_FIELD( "SegMinX" );
+    static const std::string KEA_ATT_SEG_MINY_FIELD( "SegMinY" );
+    static const std::string KEA_ATT_SEG_MAXX_FIELD( "SegMaxX" );
+    static const std::string KEA_ATT_SEG_MAXY_FIELD( "SegMaxY" );
+    static const std::string KEA_ATT_PIXELCOUNT_FIELD( "Histogram" );
+    static const std::string KEA_ATT_PIXELCOUNT_USAGE( "PixelCount" );
+    
     static const std::string KEA_BANDNAME_OVERVIEWS( "/OVERVIEWS" );
     static const std::string KEA_OVERVIEWSNAME_OVERVIEW( "/OVERVIEWS/OVERVIEW" );
     
@@ -135,6 +145,11 @@ namespace kealib{
     static const unsigned int KEA_DEFLATE( 1 ); // 1
     static const hsize_t KEA_IMAGE_CHUNK_SIZE( 256 ); // 256
     static const hsize_t KEA_ATT_CHUNK_SIZE( 1000 ); // 1000
+    static const size_t KEA_ATT_WRITE_BUFFER_CHUNKS( 32 ); // 32
+    static const size_t KEA_ATT_PIPELINE_BLOCK_CHUNKS( 16 ); // 16
+    static const size_t KEA_ATT_COLUMN_CACHE_BYTES( 268435456 ); // 256 MB
+    static const size_t KEA_PREFETCH_CACHE_BYTES( 67108864 ); // 64 MB
+    static const uint64_t KEA_RELABEL_DROP( UINT64_MAX ); // see KEAImageIO::relabel
     
     enum KEADataType
     {
@@ -202,6 +217,52 @@ namespace kealib{
         double dfGCPZ;
     };
     
+    // The window of an image covered by a single segment (see KEAImageIO::readSegmentWindow).
+    // mask and each of values are row-major xSize by ySize.
+    struct KEASegmentWindow
+    {
+        uint64_t xOff = 0;
+        uint64_t yOff = 0;
+        uint64_t xSize = 0;
+        uint64_t ySize = 0;
+        std::vector<uint8_t> mask;
+        std::vector< std::vector<double> > values;
+    };
+    
+    // The statistics of an image band (see KEAImageIO::calcImageBandStats),
+    // calculated from the validCount pixels which aren't no data or nan.
+    struct KEABandStats
+    {
+        double min = 0;
+        double max = 0;
+        double mean = 0;
+        double stdDev = 0;
+        uint64_t validCount = 0;
+        std::vector<uint64_t> histogram;
+    };
+    
+    // Counts of the image data I/O done (see KEAImageIO::getIOStats). Raw
+    // bytes and chunks are only known where libkea reads and writes the
+    // stored chunks itself; otherwise decompression is within the time
+    // spent in HDF5. Cache hits are chunks found already prefetched (or
+    // evaluated, for virtual bands whose evaluation counts as decoding).
+    struct KEAIOStats
+    {
+        uint64_t bytesRead = 0;
+        uint64_t rawBytesRead = 0;
+        uint64_t bytesWritten = 0;
+        uint64_t rawBytesWritten = 0;
+        uint64_t chunksDecoded = 0;
+        uint64_t chunksEncoded = 0;
+        uint64_t cacheHits = 0;
+        uint64_t cacheMisses = 0;
+        uint64_t decodeNanos = 0;
+        uint64_t encodeNanos = 0;
+        uint64_t hdf5Nanos = 0;
+        uint64_t datasetOpens = 0;
+        uint64_t fileOpens = 0;
+    };
+    
     struct KEAImageGCP_HDF5
     {
         char *pszId;
@@ -305,6 +366,10 @@ namespace kealib{
         return strDT;
     }
     
+    // Splits [0, numItems) into numThreads ranges (0 being all of the
+    // cores) and waits for func(start, end, thread) to complete on each of
+    // them, the first being run on the calling thread.
+    KEA_EXPORT void runOnThreads(uint64_t numItems, unsigned int numThreads, const std::function<void(uint64_t, uint64_t, unsigned int)> &func);
     
 }
 
@@ -34,6 +34,10 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
 
 #include <H5Cpp.h>
 
@@ -44,6 +48,10 @@
 #include "libkea/KEAAttributeTableFile.h"
 
 namespace kealib{
+    
+    struct KEAPrefetchCache;
+    struct KEAIOCounters;
+    class KEABandExpression;
         
     class KEA_EXPORT KEAImageIO
     {
@@ -54,6 +62,71 @@ namespace kealib{
         
         void writeImageBlock2Band(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut, uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType);
         void readImageBlock2Band(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType);
+        /**
+         * Reads xSizeBuf x ySizeBuf pixels of band (or of overview if not 0)
+         * from xPxlOff/yPxlOff, taking every xStep/yStep pixel, into data in
+         * which pixels are pixelSpace and lines lineSpace elements apart. So
+         * decimated windows and interleaved buffers are read directly.
+         */
+        void readImageBlock2BandStrided(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeBuf, uint64_t ySizeBuf, uint64_t xStep, uint64_t yStep, uint64_t pixelSpace, uint64_t lineSpace, KEADataType inDataType);
+        /**
+         * Writes xSizeBuf x ySizeBuf pixels of band (or of overview if not 0)
+         * at xPxlOff/yPxlOff from data laid out as readImageBlock2BandStrided.
+         * The file is not flushed, being left to the file being closed, so
+         * a large write may be split across many calls.
+         */
+        void writeImageBlock2BandStrided(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeBuf, uint64_t ySizeBuf, uint64_t pixelSpace, uint64_t lineSpace, KEADataType inDataType);
+        /**
+         * Reads xSizeIn x ySizeIn pixels of band (or of overview if not 0)
+         * into data with lines xSizeBuf pixels apart. May be called from
+         * any number of threads at once: HDF5 is only called with
+         * getHDF5Mutex() held, just long enough to fetch the stored chunks,
+         * which are then decompressed and copied outside of it. Chunks that
+         * were never written are filled with the fill value, and those that
+         * can't be decoded here (other filters or types) are read through
+         * HDF5 with the lock held instead. Chunks already decoded by
+         * prefetchImageBlocks are used (once) without touching HDF5.
+         */
+        void readImageBlock2BandConcurrent(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, KEADataType inDataType);
+        /**
+         * Queues the chunks of band (or of overview if not 0) covering a
+         * window to be read and decoded on a background thread, ready for
+         * readImageBlock2BandConcurrent. Up to KEA_PREFETCH_CACHE_BYTES of
+         * them are kept, the oldest being dropped first. Only files opened
+         * read-only are prefetched; this is only advice so errors are ignored.
+         */
+        void prefetchImageBlocks(uint32_t band, uint32_t overview, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSize, uint64_t ySize);
+        /**
+         * Counts the image data I/O done for band (and its overviews), or
+         * for the whole image if band is 0, since it was opened or the
+         * counts were reset by resetIOStats (for band, or all if 0).
+         * File opens are only counted for the whole image.
+         */
+        KEAIOStats getIOStats(uint32_t band=0);
+        void resetIOStats(uint32_t band=0);
+        /**
+         * Writes the chunk of band (or of overview if not 0) at xPxlOff/yPxlOff
+         * from data with lines xSizeBuf pixels apart. May be called from any
+         * number of threads at once: the chunk is shuffled and compressed in
+         * the calling thread and only written with getHDF5Mutex() held.
+         * Windows that aren't a whole chunk (cut short only by the image
+         * edge), or that can't be encoded here, are written through HDF5
+         * with the lock held instead. The file is not flushed.
+         */
+        void writeImageChunkConcurrent(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut, uint64_t ySizeOut, uint64_t xSizeBuf, KEADataType inDataType);
+        /**
+         * Process wide lock held by the concurrent reads and writes when
+         * calling HDF5. Unless HDF5 is built threadsafe, other calls made
+         * while those are running must hold it too. It is recursive as
+         * files are reopened and closed by the file limits with it held.
+         */
+        static std::recursive_mutex& getHDF5Mutex();
+        /**
+         * Counts the pixels of a window of band (or of overview if not 0)
+         * within chunks which have been written to the file. The others are
+         * all the fill value. Returns false if HDF5 is too old to tell.
+         */
+        bool getAllocatedPixelCount(uint32_t band, uint32_t overview, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSize, uint64_t ySize, uint64_t *count);
         
         void createMask(uint32_t band, uint32_t deflate=KEA_DEFLATE);
         void writeImageBlock2BandMask(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut, uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType);
@@ -115,15 +188,125 @@ namespace kealib{
         void setAttributeTable(KEAAttributeTable* att, uint32_t band, uint32_t chunkSize=KEA_ATT_CHUNK_SIZE, uint32_t deflate=KEA_DEFLATE);
         bool attributeTablePresent(uint32_t band);
         uint32_t getAttributeTableChunkSize(uint32_t band);
+        /**
+         * Copies the attribute table of srcBand within srcIO over the table
+         * of dstBand as raw HDF5 objects, without decoding any of the data.
+         */
+        void copyAttributeTable(KEAImageIO *srcIO, uint32_t srcBand, uint32_t dstBand);
+        /**
+         * Replaces dstBand with a copy of srcBand within srcIO (its image
+         * data, mask, overviews, attribute table and metadata) made as raw
+         * HDF5 objects, so no chunks are decompressed. Returns false without
+         * changing anything if the image data isn't the same size, type,
+         * chunking and compression in both files.
+         */
+        bool copyImageBand(KEAImageIO *srcIO, uint32_t srcBand, uint32_t dstBand);
         
+        /**
+         * Calculates the minimum, maximum, mean and (population) standard
+         * deviation of a band in a single pass. If numBins is not 0 a histogram
+         * of numBins equal width bins from histMin to histMax is calculated
+         * as well, values outside of this range being counted in the first
+         * or last bin if includeOutOfRange or ignored otherwise. numThreads
+         * of 0 uses all of the available cores. getHDF5Mutex() is only held
+         * while the band is read, not while the values are counted.
+         */
+        void calcImageBandStats(uint32_t band, KEABandStats *stats, size_t numBins=0, double histMin=0, double histMax=0, bool includeOutOfRange=false, unsigned int numThreads=0);
+        
+        /**
+         * Calculates the pixel extent (the KEA_ATT_SEG_* columns) and pixel
+         * count (KEA_ATT_PIXELCOUNT_FIELD) of every segment within a thematic
+         * band, writing them to its attribute table. Empty segments have
+         * extents of -1. numThreads of 0 uses all of the available cores.
+         */
+        void calcSegmentExtents(uint32_t band, unsigned int numThreads=0);
+        /**
+         * Reads just the window covering segment fid (using the extents from
+         * calcSegmentExtents) returning the mask of its pixels and the values
+         * of valueBands within that window.
+         */
+        void readSegmentWindow(uint32_t band, size_t fid, const std::vector<uint32_t> &valueBands, KEASegmentWindow *window);
+        /**
+         * Writes dstBand by mapping each pixel of the thematic srcBand through
+         * the numeric attribute table column colIdx (the global column index).
+         * Pixels which are no data or outside the table are set to the no data
+         * value of dstBand (0 if not defined). Any overviews already created on
+         * dstBand are filled (nearest neighbour) in the same pass.
+         */
+        void applyRATColumn(uint32_t srcBand, size_t colIdx, uint32_t dstBand, unsigned int numThreads=0);
+        /**
+         * Loads the integer Red, Green, Blue and Alpha usage columns of the
+         * attribute table into lut, packed as 4 bytes (RGBA) per row with values
+         * clamped to 0-255. Returns false if any of the columns are missing.
+         */
+        bool getRGBALookupTable(uint32_t band, std::vector<uint8_t> *lut);
+        /**
+         * Renders a window of a thematic band (or of overview if not 0) through
+         * lut (see getRGBALookupTable) into rgba, 4 bytes per pixel. No data
+         * pixels and those outside of lut are left transparent (all 0).
+         */
+        void renderRGBA(uint32_t band, uint32_t overview, const std::vector<uint8_t> &lut, uint8_t *rgba, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSize, uint64_t ySize, unsigned int numThreads=0);
+        /**
+         * Replaces each value of a thematic band (and its overviews) with
+         * mapping[value]; values beyond mapping and no data are unchanged
+         * while those mapped to KEA_RELABEL_DROP become no data (or 0).
+         * The attribute table rows are moved the same way, the row with the
+         * largest Histogram value (or the first) mapped to each new row
+         * providing its values and the neighbours being merged, and the
+         * Histogram column is regenerated.
+         */
+        void relabel(uint32_t band, const std::vector<uint64_t> &mapping, unsigned int numThreads=0);
+        /**
+         * Relabels a thematic band (see relabel) so the values in use are
+         * consecutive from 0, in their existing order and skipping no data.
+         * Returns the mapping which was applied.
+         */
+        std::vector<uint64_t> compactLabels(uint32_t band, unsigned int numThreads=0);
+        /**
+         * Merges each segment of a thematic band with fewer than minSize
+         * pixels (the Histogram column) into its most similar neighbour, the
+         * smallest first, by the Euclidean distance of the featureCols
+         * (global column indexes) which are updated as pixel weighted means.
+         * The band is then relabelled as compactLabels, with the mapping
+         * applied being returned.
+         */
+        std::vector<uint64_t> eliminateSmallSegments(uint32_t band, uint64_t minSize, const std::vector<size_t> &featureCols, unsigned int numThreads=0);
+
         void close();
+        
+        /**
+         * Lets the file of an image opened read-only be closed to keep
+         * within the limits set by setFileLimits, in which case reopenFile
+         * is called to open it again the next time it is needed. Images
+         * whose attribute table has been read as kea_att_file are kept
+         * open from then on and no longer count towards the limits.
+         */
+        void setReopenable(const std::function<H5::H5File*()> &reopenFile);
+        /**
+         * Limits the reopenable images which have their files open at once
+         * to maxOpenFiles, and the total of their HDF5 chunk cache sizes to
+         * maxChunkCacheBytes (0 for no limit), closing the least recently
+         * used files first.
+         */
+        static void setFileLimits(size_t maxOpenFiles, size_t maxChunkCacheBytes);
 
         /**
          * Adds a new image band to the file.
          */
         virtual void addImageBand(const KEADataType dataType, const std::string &bandDescrip, const uint32_t imageBlockSize = KEA_IMAGE_CHUNK_SIZE, const uint32_t attBlockSize = KEA_ATT_CHUNK_SIZE, const uint32_t deflate = KEA_DEFLATE);
+        /**
+         * Adds a read-only virtual band to the file, holding expression
+         * (see KEABandExpression) over the bands already in it in place of
+         * image data. It is evaluated as dataType, a block at a time, when
+         * the band is read; pixels where any band used is no data are given
+         * the no data value of the virtual band once it has one. The blocks
+         * of files opened read-only are kept with the prefetched chunks.
+         */
+        virtual void addVirtualImageBand(const KEADataType dataType, const std::string &bandDescrip, const std::string &expression, const uint32_t imageBlockSize = KEA_IMAGE_CHUNK_SIZE, const uint32_t attBlockSize = KEA_ATT_CHUNK_SIZE);
+        bool isVirtualImageBand(uint32_t band);
+        std::string getVirtualImageBandExpression(uint32_t band);
         
-        // remove band from file
+        // remove band from file (virtual bands using it must be removed first)
         virtual void removeImageBand(const uint32_t bandIndex);
 
         static H5::H5File* createKEAImage(const std::string &fileName, KEADataType dataType, uint32_t xSize, uint32_t ySize, uint32_t numImgBands, std::vector<std::string> *bandDescrips=NULL, KEAImageSpatialInfo *spatialInfo=NULL, uint32_t imageBlockSize=KEA_IMAGE_CHUNK_SIZE, uint32_t attBlockSize=KEA_ATT_CHUNK_SIZE, int mdcElmts=KEA_MDC_NELMTS, hsize_t rdccNElmts=KEA_RDCC_NELMTS, hsize_t rdccNBytes=KEA_RDCC_NBYTES, double rdccW0=KEA_RDCC_W0, hsize_t sieveBuf=KEA_SIEVE_BUF, hsize_t metaBlockSize=KEA_META_BLOCKSIZE, uint32_t deflate=KEA_DEFLATE);
@@ -145,11 +328,11 @@ namespace kealib{
         static H5::DataType convertDatatypeKeaToH5Native( const KEADataType dataType);
 
         /**
-         * Adds an image band to the specified file. Does NOT flush the file
-         * buffer.
+         * Adds an image band to the specified file, or a virtual band if
+         * expression isn't empty. Does NOT flush the file buffer.
          *
          */
-        static void addImageBandToFile(H5::H5File *keaImgH5File, const KEADataType dataType, const uint32_t xSize, const uint32_t ySize, const uint32_t bandIndex, const std::string &bandDescrip, const uint32_t imageBlockSize, const uint32_t attBlockSize, const uint32_t deflate);
+        static void addImageBandToFile(H5::H5File *keaImgH5File, const KEADataType dataType, const uint32_t xSize, const uint32_t ySize, const uint32_t bandIndex, const std::string &bandDescrip, const uint32_t imageBlockSize, const uint32_t attBlockSize, const uint32_t deflate, const std::string &expression = "");
         
         /**
          * Remove and image band and rename higher bands so everything is contiguous. Does NOT flush the file
@@ -168,12 +351,69 @@ namespace kealib{
         
         static std::string readString(H5::DataSet& dataset, H5::DataType strDataType);
         
+        /**
+         * Called for rows [rowStart, rowEnd) of a strip of image data starting
+         * at image row yOff; thread is unique amongst concurrent calls.
+         */
+        typedef std::function<void(const void *data, uint64_t yOff, uint64_t rowStart, uint64_t rowEnd, unsigned int thread)> KEAStripFunc;
+        
+        /**
+         * Streams a band through memory in strips of whole chunk rows read as
+         * dataType. While one strip is passed to func, split across numThreads
+         * threads, the next is read. HDF5 is only called from this thread,
+         * with getHDF5Mutex() held just for each read.
+         */
+        void processBandStrips(uint32_t band, KEADataType dataType, unsigned int numThreads, const KEAStripFunc &func);
+        
+        static unsigned int getNumThreads(unsigned int numThreads);
+        
+        void transferImageBlockStrided(bool write, uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeBuf, uint64_t ySizeBuf, uint64_t xStep, uint64_t yStep, uint64_t pixelSpace, uint64_t lineSpace, KEADataType inDataType);
+        
+        /**
+         * The background thread started by prefetchImageBlocks and the work
+         * it does for each window. stopPrefetch waits for it to finish.
+         */
+        void runPrefetch();
+        void prefetchWindow(uint32_t band, uint32_t overview, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSize, uint64_t ySize);
+        void stopPrefetch();
+        
+        /**
+         * The file, reopening it first if it has been closed to keep within
+         * the file limits. It stays open for as long as the pointer returned
+         * is held. releaseFile lets it be closed again, and removeFromPool
+         * stops it being released; both need getHDF5Mutex() held.
+         */
+        std::shared_ptr<H5::H5File> getH5File();
+        void releaseFile();
+        void removeFromPool();
+        
+        KEAIOCounters& getIOCounters(uint32_t band);
+        
+        /**
+         * The expression of a virtual band, or null for other bands.
+         */
+        std::shared_ptr<KEABandExpression> getBandExpression(uint32_t band) const;
+        /**
+         * Reads from a virtual band as readImageBlock2BandStrided, evaluating
+         * each chunk covering the window unless it is cached. The bands used
+         * are read with readImageBlock2BandConcurrent if concurrent.
+         */
+        void readVirtualImageBlock(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeBuf, uint64_t ySizeBuf, uint64_t xStep, uint64_t yStep, uint64_t pixelSpace, uint64_t lineSpace, KEADataType inDataType, bool concurrent);
+        
         /********** PROTECTED MEMBERS **********/
         bool fileOpen;
-        H5::H5File *keaImgFile;
+        std::shared_ptr<H5::H5File> keaImgFile;
         KEAImageSpatialInfo *spatialInfoFile;
         uint32_t numImgBands;
         std::string keaVersion;
+        std::unique_ptr<KEAPrefetchCache> prefetchCache;
+        std::function<H5::H5File*()> reopenFile;
+        bool filePooled; // in the pool of reopenable images
+        std::list<KEAImageIO*>::iterator filePoolPos;
+        size_t fileCacheBytes;
+        std::vector<std::unique_ptr<KEAIOCounters> > ioCounters; // 0 for the image as a whole
+        std::mutex ioCountersMutex;
+        std::vector<std::shared_ptr<KEABandExpression> > bandExpressions; // of band-1, null unless virtual
     };
     
 }
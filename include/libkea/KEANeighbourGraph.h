@@ -0,0 +1,113 @@
+/*
+ *  KEANeighbourGraph.h
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person 
+ *  obtaining a copy of this software and associated documentation 
+ *  files (the "Software"), to deal in the Software without restriction, 
+ *  including without limitation the rights to use, copy, modify, 
+ *  merge, publish, distribute, sublicense, and/or sell copies of the 
+ *  Software, and to permit persons to whom the Software is furnished 
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be 
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR 
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION 
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef KEANeighbourGraph_H
+#define KEANeighbourGraph_H
+
+#include <functional>
+#include <vector>
+
+#include "libkea/KEACommon.h"
+#include "libkea/KEAException.h"
+#include "libkea/KEAAttributeTable.h"
+
+namespace kealib{
+    
+    enum KEANeighbourAggregate
+    {
+        kea_nagg_sum = 0,
+        kea_nagg_mean = 1,
+        kea_nagg_min = 2,
+        kea_nagg_max = 3
+    };
+    
+    // the component of nodes excluded from KEANeighbourGraph::connectedComponents
+    static const uint64_t KEA_NO_COMPONENT( UINT64_MAX );
+    
+    /**
+     * A compressed sparse row (CSR) view of the neighbours of the rows of an
+     * attribute table: the neighbours of row fid are held within
+     * [offsets[fid], offsets[fid+1]) of a single array.
+     */
+    class KEA_EXPORT KEANeighbourGraph
+    {
+    public:
+        KEANeighbourGraph();
+        
+        /**
+         * Loads the neighbours of att, blockRows rows at a time. Neighbours
+         * which are not rows of the table are ignored.
+         */
+        void load(const KEAAttributeTable *att, size_t blockRows=KEA_ATT_CHUNK_SIZE*KEA_ATT_PIPELINE_BLOCK_CHUNKS);
+        
+        size_t getNumNodes() const;
+        size_t getNumEdges() const;
+        size_t getNumNeighbours(size_t fid) const;
+        const size_t* getNeighbours(size_t fid) const;
+        
+        /**
+         * Visits each node reachable from start, breadth first, with its
+         * depth (edges from start). The neighbours of a node are only
+         * followed where visit returns true.
+         */
+        void breadthFirst(size_t start, const std::function<bool(size_t fid, size_t depth)> &visit) const;
+        /**
+         * As breadthFirst but depth first, depth being that within the
+         * traversal.
+         */
+        void depthFirst(size_t start, const std::function<bool(size_t fid, size_t depth)> &visit) const;
+        
+        /**
+         * Labels the connected components of the nodes where include[fid]
+         * is not 0, numbered from 0 in the order of their first node, with
+         * all other nodes given KEA_NO_COMPONENT. Returns the number of
+         * components.
+         */
+        size_t connectedComponents(const std::vector<uint8_t> &include, std::vector<uint64_t> *components, unsigned int numThreads=0) const;
+        /**
+         * As above, including the nodes for which predicate is true of their
+         * value within the numeric column colIdx (global index) of att.
+         */
+        size_t connectedComponents(const KEAAttributeTable *att, size_t colIdx, const std::function<bool(double)> &predicate, std::vector<uint64_t> *components, unsigned int numThreads=0) const;
+        
+        /**
+         * Sets out[fid] to the aggregate of vals over the neighbours of each
+         * node, or 0 where it has none.
+         */
+        void aggregateNeighbours(const std::vector<double> &vals, KEANeighbourAggregate aggregate, std::vector<double> *out, unsigned int numThreads=0) const;
+        
+        virtual ~KEANeighbourGraph();
+    protected:
+        std::vector<size_t> offsets;
+        std::vector<size_t> neighbours;
+    };
+    
+}
+
+#endif
@@ -204,8 +204,9 @@ def readBlockWithMargin(ds, band, xoff, yoff, xsize, ysize, margin, datatype,
             # The part of the final array we are filling
             imageSlice = (slice(notRead_top, slice_bottom), slice(notRead_left, slice_right))
             
-            block_margin[imageSlice] = extrat.getImageBlock(ds, band, xoff_margin_file, 
-                    yoff_margin_file, xSize_margin_file, ySize_margin_file) 
+            extrat.getImageBlock(ds, band, xoff_margin_file, 
+                    yoff_margin_file, xSize_margin_file, ySize_margin_file,
+                    out=block_margin[imageSlice])
             
         return block_margin
 
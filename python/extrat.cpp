@@ -32,6 +32,7 @@
 #include <string>
 #include <exception>
 #include <algorithm>
+#include <mutex>
 #include <unordered_map>
 
 #include <pybind11/pybind11.h>
@@ -145,6 +146,20 @@ void freeNeighbourLists(std::vector<std::vector<size_t>* > *pNeighbours)
     }
 }
 
+// Held around calls into libkea so other Python threads can run while it
+// reads and writes. libkea itself isn't thread safe so the HDF5 lock is
+// held instead (as the GDAL driver does). Python objects mustn't be touched
+// while one of these exists.
+class ReleaseGILForIO
+{
+public:
+    ReleaseGILForIO() : m_lock(kealib::KEAImageIO::getHDF5Mutex()) {}
+private:
+    // declared first so the GIL is released before waiting for the lock
+    pybind11::gil_scoped_release m_release;
+    std::lock_guard<std::recursive_mutex> m_lock;
+};
+
 // helper function to get the underlying KEA KEAImageIO object from GDAL
 // given a dataset.
 kealib::KEAImageIO *getImageIOFromDataset(pybind11::object &dataset)
@@ -185,6 +200,13 @@ kealib::KEAImageIO *getImageIOFromDataset(pybind11::object &dataset)
     return pImageIO;
 }
 
+// the band's RAT, which may have to be read from the file first
+kealib::KEAAttributeTable *getAttributeTable(kealib::KEAImageIO *pImageIO, uint32_t nBand)
+{
+    ReleaseGILForIO releaseGIL;
+    return pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+}
+
 template <typename T>
 pybind11::object snapshot_builder(const T& builder)
 {
@@ -239,6 +261,7 @@ pybind11::object getNeighbours(pybind11::object &dataset, uint32_t nBand, int &s
 
     try
     {
+        ReleaseGILForIO releaseGIL;
         kealib::KEAAttributeTable *pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
         if( pRAT == nullptr )
         {
@@ -299,7 +322,7 @@ void setNeighbours(pybind11::object &dataset, uint32_t nBand,
 
     try
     {
-        kealib::KEAAttributeTable *pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+        kealib::KEAAttributeTable *pRAT = getAttributeTable(pImageIO, nBand);
         if( pRAT == nullptr )
         {
             throw PyKeaLibException("No Attribute table in this file");
@@ -381,7 +404,10 @@ void setNeighbours(pybind11::object &dataset, uint32_t nBand,
             throw PyKeaLibException("Unknown data type");
         
         
-        pRAT->setNeighbours(startfid, cppneighbours.size(), &cppneighbours);
+        {
+            ReleaseGILForIO releaseGIL;
+            pRAT->setNeighbours(startfid, cppneighbours.size(), &cppneighbours);
+        }
         
         freeNeighbourLists(&cppneighbours);
     }
@@ -402,7 +428,7 @@ void addField(pybind11::object &dataset, uint32_t nBand,
 
     try
     {
-        kealib::KEAAttributeTable *pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+        kealib::KEAAttributeTable *pRAT = getAttributeTable(pImageIO, nBand);
         if( pRAT == nullptr )
         {
             throw PyKeaLibException("No Attribute table in this file");
@@ -410,19 +436,27 @@ void addField(pybind11::object &dataset, uint32_t nBand,
         
         if( nType == kealib::kea_att_bool)
         {
-            pRAT->addAttBoolField(name, initVal.cast<bool>(), usage);
+            bool val = initVal.cast<bool>();
+            ReleaseGILForIO releaseGIL;
+            pRAT->addAttBoolField(name, val, usage);
         }
         else if( nType == kealib::kea_att_int)
         {
-            pRAT->addAttIntField(name, initVal.cast<int64_t>(), usage);
+            int64_t val = initVal.cast<int64_t>();
+            ReleaseGILForIO releaseGIL;
+            pRAT->addAttIntField(name, val, usage);
         }
         else if( nType == kealib::kea_att_float)
         {
-            pRAT->addAttFloatField(name, initVal.cast<double>(), usage);
+            double val = initVal.cast<double>();
+            ReleaseGILForIO releaseGIL;
+            pRAT->addAttFloatField(name, val, usage);
         }
         else if( nType == kealib::kea_att_string)
         {
-            pRAT->addAttStringField(name, initVal.cast<std::string>(), usage);
+            std::string val = initVal.cast<std::string>();
+            ReleaseGILForIO releaseGIL;
+            pRAT->addAttStringField(name, val, usage);
         }
         else 
         {
@@ -442,11 +476,12 @@ size_t getNumFields(pybind11::object &dataset, uint32_t nBand)
 
     try
     {
-        kealib::KEAAttributeTable *pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+        kealib::KEAAttributeTable *pRAT = getAttributeTable(pImageIO, nBand);
         if( pRAT == nullptr )
         {
             throw PyKeaLibException("No Attribute table in this file");
         }
+        ReleaseGILForIO releaseGIL;
         return pRAT->getTotalNumOfCols();
     }
     catch(const kealib::KEAException &e)
@@ -461,12 +496,17 @@ pybind11::object getFieldByName(pybind11::object &dataset, uint32_t nBand, const
 
     try
     {
-        kealib::KEAAttributeTable *pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+        kealib::KEAAttributeTable *pRAT = getAttributeTable(pImageIO, nBand);
         if( pRAT == nullptr )
         {
             throw PyKeaLibException("No Attribute table in this file");
         }
-        return pybind11::cast(pRAT->getField(name));
+        kealib::KEAATTField field;
+        {
+            ReleaseGILForIO releaseGIL;
+            field = pRAT->getField(name);
+        }
+        return pybind11::cast(field);
     }
     catch(const kealib::KEAException &e)
     {
@@ -480,12 +520,17 @@ pybind11::object getFieldByIdx(pybind11::object &dataset, uint32_t nBand, int id
 
     try
     {
-        kealib::KEAAttributeTable *pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+        kealib::KEAAttributeTable *pRAT = getAttributeTable(pImageIO, nBand);
         if( pRAT == nullptr )
         {
             throw PyKeaLibException("No Attribute table in this file");
         }
-        return pybind11::cast(pRAT->getField(idx));
+        kealib::KEAATTField field;
+        {
+            ReleaseGILForIO releaseGIL;
+            field = pRAT->getField(idx);
+        }
+        return pybind11::cast(field);
     }
     catch(const kealib::KEAException &e)
     {
@@ -499,12 +544,13 @@ size_t getSize(pybind11::object &dataset, uint32_t nBand)
 
     try
     {
-        kealib::KEAAttributeTable *pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+        kealib::KEAAttributeTable *pRAT = getAttributeTable(pImageIO, nBand);
         if( pRAT == nullptr )
         {
             throw PyKeaLibException("No Attribute table in this file");
         }
-        return pRAT->getSize();    
+        ReleaseGILForIO releaseGIL;
+        return pRAT->getSize();
     }
     catch(const kealib::KEAException &e)
     {
@@ -518,12 +564,13 @@ void addRows(pybind11::object &dataset, uint32_t nBand, size_t numRows)
 
     try
     {
-        kealib::KEAAttributeTable *pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+        kealib::KEAAttributeTable *pRAT = getAttributeTable(pImageIO, nBand);
         if( pRAT == nullptr )
         {
             throw PyKeaLibException("No Attribute table in this file");
         }
-        pRAT->addRows(numRows);    
+        ReleaseGILForIO releaseGIL;
+        pRAT->addRows(numRows);
     }
     catch(const kealib::KEAException &e)
     {
@@ -538,7 +585,7 @@ pybind11::object getField(pybind11::object &dataset, uint32_t nBand, kealib::KEA
 
     try
     {
-        kealib::KEAAttributeTable *pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+        kealib::KEAAttributeTable *pRAT = getAttributeTable(pImageIO, nBand);
         if( pRAT == nullptr )
         {
             throw PyKeaLibException("No Attribute table in this file");
@@ -548,21 +595,30 @@ pybind11::object getField(pybind11::object &dataset, uint32_t nBand, kealib::KEA
         {
             auto result = pybind11::array_t<bool>(len);
             pybind11::buffer_info buf = result.request();
-            pRAT->getBoolFields(startfid, len, field.idx, static_cast<bool*>(buf.ptr));
+            {
+                ReleaseGILForIO releaseGIL;
+                pRAT->getBoolFields(startfid, len, field.idx, static_cast<bool*>(buf.ptr));
+            }
             return result;
         }
         else if(field.dataType == kealib::kea_att_int)
         {
             auto result = pybind11::array_t<int64_t>(len);
             pybind11::buffer_info buf = result.request();
-            pRAT->getIntFields(startfid, len, field.idx, static_cast<int64_t*>(buf.ptr));
+            {
+                ReleaseGILForIO releaseGIL;
+                pRAT->getIntFields(startfid, len, field.idx, static_cast<int64_t*>(buf.ptr));
+            }
             return result;
         }
         else if(field.dataType == kealib::kea_att_float)
         {
             auto result = pybind11::array_t<double>(len);
             pybind11::buffer_info buf = result.request();
-            pRAT->getFloatFields(startfid, len, field.idx, static_cast<double*>(buf.ptr));
+            {
+                ReleaseGILForIO releaseGIL;
+                pRAT->getFloatFields(startfid, len, field.idx, static_cast<double*>(buf.ptr));
+            }
             return result;
         }
         else if(field.dataType == kealib::kea_att_string)
@@ -570,7 +626,10 @@ pybind11::object getField(pybind11::object &dataset, uint32_t nBand, kealib::KEA
             ListOffsetBuilder<int64_t, NumpyBuilder<uint8_t>> builder;
             builder.content().set_parameters("\"__array__\": \"char\"");
             std::vector<std::string> buffer;
-            pRAT->getStringFields(startfid, len, field.idx, &buffer);
+            {
+                ReleaseGILForIO releaseGIL;
+                pRAT->getStringFields(startfid, len, field.idx, &buffer);
+            }
             for( auto itr = buffer.begin(); itr != buffer.end(); itr++)
             {
                 auto& subbuilder = builder.begin_list();
@@ -598,7 +657,7 @@ void setField(pybind11::object &dataset, uint32_t nBand, kealib::KEAATTField fie
 
     try
     {
-        kealib::KEAAttributeTable *pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+        kealib::KEAAttributeTable *pRAT = getAttributeTable(pImageIO, nBand);
         if( pRAT == nullptr )
         {
             throw PyKeaLibException("No Attribute table in this file");
@@ -608,19 +667,22 @@ void setField(pybind11::object &dataset, uint32_t nBand, kealib::KEAATTField fie
         {
             auto dataArray = data.cast<pybind11::array_t<bool>>();
             pybind11::buffer_info buf = dataArray.request();
-            pRAT->setBoolFields(startfid, dataArray.size(), field.idx, static_cast<bool*>(buf.ptr));
+            ReleaseGILForIO releaseGIL;
+            pRAT->setBoolFields(startfid, buf.size, field.idx, static_cast<bool*>(buf.ptr));
         }
         else if(field.dataType == kealib::kea_att_int)
         {
             auto dataArray = data.cast<pybind11::array_t<int64_t>>();
             pybind11::buffer_info buf = dataArray.request();
-            pRAT->setIntFields(startfid, dataArray.size(), field.idx, static_cast<int64_t*>(buf.ptr));
+            ReleaseGILForIO releaseGIL;
+            pRAT->setIntFields(startfid, buf.size, field.idx, static_cast<int64_t*>(buf.ptr));
         }
         else if(field.dataType == kealib::kea_att_float)
         {
             auto dataArray = data.cast<pybind11::array_t<double>>();
             pybind11::buffer_info buf = dataArray.request();
-            pRAT->setFloatFields(startfid, dataArray.size(), field.idx, static_cast<double*>(buf.ptr));
+            ReleaseGILForIO releaseGIL;
+            pRAT->setFloatFields(startfid, buf.size, field.idx, static_cast<double*>(buf.ptr));
         }
         else if(field.dataType == kealib::kea_att_string)
         {
@@ -688,6 +750,7 @@ void setField(pybind11::object &dataset, uint32_t nBand, kealib::KEAATTField fie
                 auto str = std::string(dataArrayNumpy.data(startIdx), thisLength);
                 stringList.at(n) = str;
             }
+            ReleaseGILForIO releaseGIL;
             pRAT->setStringFields(startfid, length, field.idx, &stringList);
         }
         else
@@ -706,7 +769,11 @@ pybind11::object getSpatialInfo(pybind11::object &dataset)
     kealib::KEAImageIO *pImageIO = getImageIOFromDataset(dataset);
     try
     {
-        auto spatialInfo = *(pImageIO->getSpatialInfo());
+        kealib::KEAImageSpatialInfo spatialInfo;
+        {
+            ReleaseGILForIO releaseGIL;
+            spatialInfo = *(pImageIO->getSpatialInfo());
+        }
         return pybind11::cast(spatialInfo);
     }
     catch(const kealib::KEAException &e)
@@ -720,6 +787,7 @@ kealib::KEADataType getImageBandDataType(pybind11::object &dataset, uint32_t nBa
     kealib::KEAImageIO *pImageIO = getImageIOFromDataset(dataset);
     try
     {
+        ReleaseGILForIO releaseGIL;
         return pImageIO->getImageBandDataType(nBand);
     }
     catch(const kealib::KEAException &e)
@@ -733,6 +801,7 @@ uint32_t getNumOfImageBands(pybind11::object &dataset)
     kealib::KEAImageIO *pImageIO = getImageIOFromDataset(dataset);
     try
     {
+        ReleaseGILForIO releaseGIL;
         return pImageIO->getNumOfImageBands();
     }
     catch(const kealib::KEAException &e)
@@ -747,6 +816,7 @@ double getNoDataValue(pybind11::object &dataset, uint32_t nBand)
     try
     {
         double dNoData;
+        ReleaseGILForIO releaseGIL;
         pImageIO->getNoDataValue(nBand, &dNoData, kealib::kea_64float);
         return dNoData;
     }
@@ -756,94 +826,158 @@ double getNoDataValue(pybind11::object &dataset, uint32_t nBand)
     }
 }
 
+// the numpy dtype matching a KEA data type
+pybind11::dtype getNumpyDataType(kealib::KEADataType dtype)
+{
+    switch( dtype )
+    {
+        case kealib::kea_8int:
+            return pybind11::dtype::of<int8_t>();
+        case kealib::kea_8uint:
+            return pybind11::dtype::of<uint8_t>();
+        case kealib::kea_16int:
+            return pybind11::dtype::of<int16_t>();
+        case kealib::kea_16uint:
+            return pybind11::dtype::of<uint16_t>();
+        case kealib::kea_32int:
+            return pybind11::dtype::of<int32_t>();
+        case kealib::kea_32uint:
+            return pybind11::dtype::of<uint32_t>();
+        case kealib::kea_64int:
+            return pybind11::dtype::of<int64_t>();
+        case kealib::kea_64uint:
+            return pybind11::dtype::of<uint64_t>();
+        case kealib::kea_32float:
+            return pybind11::dtype::of<float>();
+        case kealib::kea_64float:
+            return pybind11::dtype::of<double>();
+        default:
+            throw PyKeaLibException("Unsupported data type");
+    }
+}
+
+// Checks buf is a 2D array of the band's type with pixels and lines
+// whole elements apart (and lines not overlapping) and returns those
+// spacings in elements, as libkea takes them.
+void getBufferSpacing(const pybind11::buffer_info &buf, const pybind11::dtype &dtype,
+    uint64_t *pPixelSpace, uint64_t *pLineSpace)
+{
+    if( buf.ndim != 2 )
+    {
+        throw PyKeaLibException("Only support 2D arrays");
+    }
+    pybind11::dtype bufType(buf);
+    if( (bufType.kind() != dtype.kind()) || (bufType.itemsize() != dtype.itemsize()) )
+    {
+        throw PyKeaLibException("Array type does not match the band data type");
+    }
+    ssize_t nXSize = buf.shape[1];
+    ssize_t nYSize = buf.shape[0];
+    if( (nXSize == 0) || (nYSize == 0) )
+    {
+        // nothing will be read or written
+        *pPixelSpace = 1;
+        *pLineSpace = 1;
+        return;
+    }
+    // numpy doesn't care about the stride of a dimension of length 1
+    ssize_t nPixelStride = (nXSize > 1) ? buf.strides[1] : buf.itemsize;
+    ssize_t nLineStride = (nYSize > 1) ? buf.strides[0] : (nXSize * nPixelStride);
+    if( (nPixelStride <= 0) || (nLineStride <= 0) || ((nPixelStride % buf.itemsize) != 0) ||
+        ((nLineStride % buf.itemsize) != 0) ||
+        ((nYSize > 1) && (nLineStride < (((nXSize - 1) * nPixelStride) + buf.itemsize))) )
+    {
+        throw PyKeaLibException("Array strides are not supported");
+    }
+    *pPixelSpace = nPixelStride / buf.itemsize;
+    *pLineSpace = nLineStride / buf.itemsize;
+}
+
+// Read a block of the band into out (which can be any writable 2D buffer
+// of the band's type, such as a view into a larger array) or, if out is
+// None, into a new array.
 pybind11::object getImageBlock(pybind11::object &dataset, uint32_t nBand, 
-    uint64_t col, uint64_t row, uint64_t xsize, uint64_t ysize)
+    uint64_t col, uint64_t row, uint64_t xsize, uint64_t ysize, pybind11::object &out)
 {
     kealib::KEAImageIO *pImageIO = getImageIOFromDataset(dataset);
     try
     {
-        auto dtype = pImageIO->getImageBandDataType(nBand);
-        
-        if( dtype == kealib::kea_8int)
+        kealib::KEADataType dtype;
         {
-            auto result = pybind11::array_t<int8_t>({ysize, xsize});
-            pybind11::buffer_info buf = result.request();
-            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
-            return result;
+            ReleaseGILForIO releaseGIL;
+            dtype = pImageIO->getImageBandDataType(nBand);
         }
-        else if( dtype == kealib::kea_8uint)
-        {
-            auto result = pybind11::array_t<uint8_t>({ysize, xsize});
-            pybind11::buffer_info buf = result.request();
-            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
-            return result;
-        }
-        else if( dtype == kealib::kea_16int)
-        {
-            auto result = pybind11::array_t<int16_t>({ysize, xsize});
-            pybind11::buffer_info buf = result.request();
-            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
-            return result;
-        }
-        else if( dtype == kealib::kea_16uint)
-        {
-            auto result = pybind11::array_t<uint16_t>({ysize, xsize});
-            pybind11::buffer_info buf = result.request();
-            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
-            return result;
-        }
-        else if( dtype == kealib::kea_32int)
+        
+        pybind11::object result = out;
+        if( result.is_none() )
         {
-            auto result = pybind11::array_t<int32_t>({ysize, xsize});
-            pybind11::buffer_info buf = result.request();
-            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
-            return result;
+            result = pybind11::array(getNumpyDataType(dtype), {ysize, xsize});
         }
-        else if( dtype == kealib::kea_32uint)
+        pybind11::buffer_info buf = result.cast<pybind11::buffer>().request(true);
+        uint64_t pixelSpace, lineSpace;
+        getBufferSpacing(buf, getNumpyDataType(dtype), &pixelSpace, &lineSpace);
+        if( ((uint64_t)buf.shape[0] != ysize) || ((uint64_t)buf.shape[1] != xsize) )
         {
-            auto result = pybind11::array_t<uint32_t>({ysize, xsize});
-            pybind11::buffer_info buf = result.request();
-            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
-            return result;
+            throw PyKeaLibException("Array shape does not match ysize, xsize");
         }
-        else if( dtype == kealib::kea_64int)
+        
+        if( (xsize == 0) || (ysize == 0) )
         {
-            auto result = pybind11::array_t<int64_t>({ysize, xsize});
-            pybind11::buffer_info buf = result.request();
-            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
             return result;
         }
-        else if( dtype == kealib::kea_64uint)
+        if( (pixelSpace == 1) && (lineSpace >= xsize) )
         {
-            auto result = pybind11::array_t<uint64_t>({ysize, xsize});
-            pybind11::buffer_info buf = result.request();
-            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
-            return result;
+            // only holds the HDF5 lock while fetching the chunks, so other
+            // threads can read at the same time
+            pybind11::gil_scoped_release releaseGIL;
+            pImageIO->readImageBlock2BandConcurrent(nBand, 0, buf.ptr, col, row, xsize, ysize,
+                            lineSpace, dtype);
         }
-        else if( dtype == kealib::kea_32float)
+        else
         {
-            auto result = pybind11::array_t<float>({ysize, xsize});
-            pybind11::buffer_info buf = result.request();
-            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
-            return result;
+            ReleaseGILForIO releaseGIL;
+            pImageIO->readImageBlock2BandStrided(nBand, 0, buf.ptr, col, row, xsize, ysize,
+                            1, 1, pixelSpace, lineSpace, dtype);
         }
-        else if( dtype == kealib::kea_64float)
+        return result;
+    }
+    catch(const kealib::KEAException &e)
+    {
+        throw PyKeaLibException(e.what());
+    }
+}
+
+// Write a 2D buffer of the band's type to the band at col, row
+void setImageBlock(pybind11::object &dataset, uint32_t nBand, 
+    uint64_t col, uint64_t row, pybind11::buffer &data)
+{
+    kealib::KEAImageIO *pImageIO = getImageIOFromDataset(dataset);
+    try
+    {
+        kealib::KEADataType dtype;
         {
-            auto result = pybind11::array_t<double>({ysize, xsize});
-            pybind11::buffer_info buf = result.request();
-            pImageIO->readImageBlock2Band(nBand, buf.ptr, col, row, xsize, ysize, xsize, ysize, dtype);
-            return result;
+            ReleaseGILForIO releaseGIL;
+            dtype = pImageIO->getImageBandDataType(nBand);
         }
-        else
+        
+        pybind11::buffer_info buf = data.request();
+        uint64_t pixelSpace, lineSpace;
+        getBufferSpacing(buf, getNumpyDataType(dtype), &pixelSpace, &lineSpace);
+        uint64_t xsize = buf.shape[1];
+        uint64_t ysize = buf.shape[0];
+        
+        if( (xsize > 0) && (ysize > 0) )
         {
-            throw PyKeaLibException("Unsupported data type");
+            ReleaseGILForIO releaseGIL;
+            pImageIO->writeImageBlock2BandStrided(nBand, 0, buf.ptr, col, row, xsize, ysize,
+                            pixelSpace, lineSpace, dtype);
         }
     }
     catch(const kealib::KEAException &e)
     {
         throw PyKeaLibException(e.what());
     }
-} 
+}
 
 
 // class that holds the neighbours and accumulates new neighbours
@@ -936,6 +1070,7 @@ private:
                         cppneighbours.at(0) = pVec;
                         try
                         {
+                            ReleaseGILForIO releaseGIL;
                             m_pRAT->setNeighbours(val, 1, &cppneighbours);
                         }
                         catch(const kealib::KEAException &e)
@@ -1039,9 +1174,12 @@ NeighbourAccumulator::NeighbourAccumulator(pybind11::array &hist,
     
     try
     {
-        pImageIO->getNoDataValue(nBand, &m_ignore, kealib::kea_64float);
+        {
+            ReleaseGILForIO releaseGIL;
+            pImageIO->getNoDataValue(nBand, &m_ignore, kealib::kea_64float);
     
-        m_pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+            m_pRAT = pImageIO->getAttributeTable(kealib::kea_att_file, nBand);
+        }
         if( m_pRAT == nullptr )
         {
             throw PyKeaLibException("No Attribute table in this file");
@@ -1259,9 +1397,20 @@ PYBIND11_MODULE(extrat, m) {
     m.def("getNumOfImageBands", &getNumOfImageBands, pybind11::arg("dataset"));
     m.def("getNoDataValue", &getNoDataValue, pybind11::arg("dataset"),
         pybind11::arg("band"));
-    m.def("getImageBlock", &getImageBlock, "Get a block of data from the band",
+    m.def("getImageBlock", &getImageBlock, "Get a block of data from the band. "
+        "If out is given the data is read straight into it and it is returned, "
+        "otherwise a new array is. out can be any writable 2D array (or view of "
+        "one) of the band's data type and shape (ysize, xsize). The GIL is "
+        "released while reading.",
+        pybind11::arg("dataset"), pybind11::arg("band"), pybind11::arg("col"),
+        pybind11::arg("row"), pybind11::arg("xsize"), pybind11::arg("ysize"),
+        pybind11::arg("out") = pybind11::none());
+    m.def("setImageBlock", &setImageBlock, "Write a 2D array (or view of one) "
+        "of the band's data type to the band at col, row. This goes straight "
+        "to the file, so GDAL won't see it in blocks it has already cached. "
+        "The GIL is released while writing.",
         pybind11::arg("dataset"), pybind11::arg("band"), pybind11::arg("col"),
-        pybind11::arg("row"), pybind11::arg("xsize"), pybind11::arg("ysize"));
+        pybind11::arg("row"), pybind11::arg("data"));
         
     pybind11::class_<NeighbourAccumulator>(m, "NeighbourAccumulator")
         .def(pybind11::init<pybind11::array&, pybind11::object&, uint32_t>(),
@@ -174,6 +174,24 @@ def testMetadata(ds):
     assert extrat.getNumOfImageBands(ds) == 1
     assert extrat.getNoDataValue(ds, 1) == 90 # set in testseg.cpp
 
+def testImageBlock(ds):
+    """
+    Check blocks can be written and read back, including into views
+    """
+    data = numpy.arange(20 * 20, dtype=numpy.uint8).reshape((20, 20))
+    # every other column of a bigger array
+    towrite = numpy.zeros((20, 40), dtype=numpy.uint8)
+    towrite[:, ::2] = data
+    extrat.setImageBlock(ds, 1, 0, 0, towrite[:, ::2])
+    
+    assert (extrat.getImageBlock(ds, 1, 0, 0, 20, 20) == data).all()
+    
+    out = numpy.zeros((30, 30), dtype=numpy.uint8)
+    result = extrat.getImageBlock(ds, 1, 5, 10, 10, 5, out=out[2:7, 3:13])
+    assert (result == data[10:15, 5:15]).all()
+    assert (out[2:7, 3:13] == data[10:15, 5:15]).all()
+    assert out.sum() == data[10:15, 5:15].sum()
+
 def test():
     # First create our test file
     # Currently this is only done in C++ but could be altered in future
@@ -194,6 +212,8 @@ def test():
     testWriteRead(ds)
     
     testMetadata(ds)
+    
+    testImageBlock(ds)
 
 if __name__ == '__main__':
     test()
@@ -30,6 +30,8 @@
 
 #include "libkea/KEAAttributeTable.h"
 
+#include <memory>
+
 namespace kealib{
     
     KEAAttributeTable::KEAAttributeTable(KEAATTType keaAttType)
@@ -125,6 +127,88 @@ namespace kealib{
         }
     }
     
+    void KEAAttributeTable::getFeatures(size_t startfid, size_t len, KEAATTFeatureBlock *features) const
+    {
+        // built from the column reads, for tables without a faster way
+        features->reset(startfid, len, this->numBoolFields, this->numIntFields, this->numFloatFields, this->numStringFields);
+        if(len == 0)
+        {
+            return;
+        }
+        
+        std::unique_ptr<bool[]> boolVals(new bool[len]);
+        for(size_t j = 0; j < this->numBoolFields; ++j)
+        {
+            this->getBoolFields(startfid, len, j, boolVals.get());
+            for(size_t i = 0; i < len; ++i)
+            {
+                features->boolVals[(i*this->numBoolFields)+j] = boolVals[i];
+            }
+        }
+        std::vector<int64_t> intVals(len);
+        for(size_t j = 0; j < this->numIntFields; ++j)
+        {
+            this->getIntFields(startfid, len, j, intVals.data());
+            for(size_t i = 0; i < len; ++i)
+            {
+                features->intVals[(i*this->numIntFields)+j] = intVals[i];
+            }
+        }
+        std::vector<double> floatVals(len);
+        for(size_t j = 0; j < this->numFloatFields; ++j)
+        {
+            this->getFloatFields(startfid, len, j, floatVals.data());
+            for(size_t i = 0; i < len; ++i)
+            {
+                features->floatVals[(i*this->numFloatFields)+j] = floatVals[i];
+            }
+        }
+        std::vector<std::string> strVals;
+        for(size_t j = 0; j < this->numStringFields; ++j)
+        {
+            this->getStringFields(startfid, len, j, &strVals);
+            for(size_t i = 0; i < len; ++i)
+            {
+                features->setString(i, j, strVals[i].c_str(), strVals[i].size());
+            }
+        }
+        
+        std::vector<std::vector<size_t>* > neighbours;
+        try
+        {
+            this->getNeighbours(startfid, len, &neighbours);
+            for(size_t i = 0; i < len; ++i)
+            {
+                features->neighbours.insert(features->neighbours.end(), neighbours[i]->begin(), neighbours[i]->end());
+                features->neighbourOffsets[i+1] = features->neighbours.size();
+            }
+        }
+        catch(...)
+        {
+            for(std::vector<size_t> *rowNeighbours : neighbours)
+            {
+                delete rowNeighbours;
+            }
+            throw;
+        }
+        for(std::vector<size_t> *rowNeighbours : neighbours)
+        {
+            delete rowNeighbours;
+        }
+    }
+    
+    void KEAAttributeTable::getNeighbourBlock(size_t startfid, size_t len, std::vector<size_t> *rowEnds, std::vector<size_t> *neighbours) const
+    {
+        KEAATTFeatureBlock features;
+        this->getFeatures(startfid, len, &features);
+        size_t offset = neighbours->size();
+        neighbours->insert(neighbours->end(), features.neighbours.begin(), features.neighbours.end());
+        for(size_t i = 0; i < len; ++i)
+        {
+            rowEnds->push_back(offset + features.neighbourOffsets[i+1]);
+        }
+    }
+    
     void KEAAttributeTable::setBoolValue(size_t colIdx, bool value)
     {
         if(colIdx > numBoolFields)
@@ -276,7 +360,17 @@ namespace kealib{
     {
         return numOfCols;
     }
+
+    void KEAAttributeTable::removeRows(size_t)
+    {
+        throw KEAATTException("Removing rows is not supported by this attribute table.");
+    }
     
+    void KEAAttributeTable::flush()
+    {
+        // nothing buffered by default
+    }
+
     void KEAAttributeTable::addAttBoolField(const std::string &name, bool val, std::string usage)
     {
         try 
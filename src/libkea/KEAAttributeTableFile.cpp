@@ -45,6 +45,39 @@ namespace kealib{
         free(ptr);
     }
 
+    // Reads rows [startfid, startfid+len) of every column within a 2D table
+    // dataset in a single hyperslab into buffer (row-major).
+    static void readAllColumnRows(H5::H5File *keaImg, const std::string &datasetName, const H5::DataType &memType, void *buffer, size_t startfid, size_t len, size_t numRows, size_t numCols, const std::string &typeName, const H5::DSetMemXferPropList &xfer)
+    {
+        H5::DataSet dataset = keaImg->openDataSet(datasetName);
+        H5::DataSpace dataspace = dataset.getSpace();
+        if(dataspace.getSimpleExtentNdims() != 2)
+        {
+            throw KEAIOException("The " + typeName + " datasets needs to have 2 dimensions.");
+        }
+        
+        hsize_t dims[2];
+        dataspace.getSimpleExtentDims(dims);
+        if(numRows > dims[0])
+        {
+            throw KEAIOException("The number of features in " + typeName + " dataset is smaller than expected.");
+        }
+        if(numCols > dims[1])
+        {
+            throw KEAIOException("The number of " + typeName + " fields is smaller than expected.");
+        }
+        
+        hsize_t offset[2] = {startfid, 0};
+        hsize_t count[2] = {len, numCols};
+        dataspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+        H5::DataSpace memspace(2, count);
+        dataset.read(buffer, memType, memspace, dataspace, xfer);
+        
+        memspace.close();
+        dataspace.close();
+        dataset.close();
+    }
+
     KEAAttributeTableFile::KEAAttributeTableFile(H5::H5File *keaImgIn, const std::string &bandPathBaseIn, size_t numRowsIn, size_t chunkSizeIn, unsigned int deflateIn) : KEAAttributeTable(kea_att_file)
     {
         numRows = numRowsIn;
@@ -138,6 +171,69 @@ namespace kealib{
         return value;
     }
     
+    void KEAAttributeTableFile::getNeighbourBlock(size_t startfid, size_t len, std::vector<size_t> *rowEnds, std::vector<size_t> *neighbours) const
+    {
+        if((startfid+len) > numRows)
+        {
+            std::string message = std::string("Requested feature (") + sizet2Str(startfid+len) + std::string(") is not within the table.");
+            throw KEAATTException(message);
+        }
+        
+        try
+        {
+            // the neighbours are only present once they have been written.
+            std::string neighboursName = bandPathBase + KEA_ATT_NEIGHBOURS_DATA;
+            if((len == 0) || (H5Lexists(keaImg->getId(), neighboursName.c_str(), H5P_DEFAULT) <= 0))
+            {
+                rowEnds->insert(rowEnds->end(), len, neighbours->size());
+                return;
+            }
+            
+            H5::DataSet neighboursDataset = keaImg->openDataSet( neighboursName );
+            H5::DataSpace neighboursDataspace = neighboursDataset.getSpace();
+            if(neighboursDataspace.getSimpleExtentNdims() != 1)
+            {
+                throw KEAIOException("The neighbours datasets needs to have 1 dimension.");
+            }
+            hsize_t neighboursOffset[1] = {startfid};
+            hsize_t neighboursCount[1] = {len};
+            neighboursDataspace.selectHyperslab( H5S_SELECT_SET, neighboursCount, neighboursOffset );
+            H5::DataSpace neighboursMemspace( 1, neighboursCount );
+            
+            H5::DSetMemXferPropList xfer;
+            xfer.setVlenMemManager(kealibmalloc, nullptr, kealibfree, nullptr);
+            std::vector<VarLenFieldHDF> neighbourVals(len, VarLenFieldHDF());
+            H5::DataType intVarLenMemDT = H5::VarLenType(&H5::PredType::NATIVE_HSIZE);
+            neighboursDataset.read(neighbourVals.data(), intVarLenMemDT, neighboursMemspace, neighboursDataspace, xfer);
+            for(size_t i = 0; i < len; ++i)
+            {
+                if(neighbourVals[i].length > 0)
+                {
+                    const hsize_t *vals = (const hsize_t*)neighbourVals[i].p;
+                    neighbours->insert(neighbours->end(), vals, vals + neighbourVals[i].length);
+                }
+                free(neighbourVals[i].p);
+                rowEnds->push_back(neighbours->size());
+            }
+            
+            neighboursMemspace.close();
+            neighboursDataspace.close();
+            neighboursDataset.close();
+        }
+        catch(const H5::Exception &e)
+        {
+            throw KEAATTException(e.getDetailMsg());
+        }
+        catch (const KEAATTException &e)
+        {
+            throw e;
+        }
+        catch (const KEAIOException &e)
+        {
+            throw KEAATTException(e.what());
+        }
+    }
+    
     void KEAAttributeTableFile::setBoolField(size_t fid, const std::string &name, bool value)
     {
         try
@@ -318,7 +414,7 @@ namespace kealib{
     }
     
     // RFC40
-    void KEAAttributeTableFile::getBoolFields(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer) const
+    void KEAAttributeTableFile::getBoolFieldsDirect(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer) const
     {
         if((startfid+len) > numRows)
         {
@@ -415,7 +511,7 @@ namespace kealib{
         }
     }
     
-    void KEAAttributeTableFile::getIntFields(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer) const
+    void KEAAttributeTableFile::getIntFieldsDirect(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer) const
     {
         if((startfid+len) > numRows)
         {
@@ -505,7 +601,7 @@ namespace kealib{
         }
     }
     
-    void KEAAttributeTableFile::getFloatFields(size_t startfid, size_t len, size_t colIdx, double *pfBuffer) const
+    void KEAAttributeTableFile::getFloatFieldsDirect(size_t startfid, size_t len, size_t colIdx, double *pfBuffer) const
     {
         if((startfid+len) > numRows)
         {
@@ -595,7 +691,7 @@ namespace kealib{
         }
     }
     
-    void KEAAttributeTableFile::getStringFields(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *psBuffer) const
+    void KEAAttributeTableFile::getStringFieldsDirect(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *psBuffer) const
     {
         if((startfid+len) > numRows)
         {
@@ -850,7 +946,7 @@ namespace kealib{
     }
     
     // RFC40
-    void KEAAttributeTableFile::setBoolFields(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer)
+    void KEAAttributeTableFile::setBoolFieldsDirect(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer)
     {
         if((startfid+len) > numRows)
         {
@@ -948,7 +1044,7 @@ namespace kealib{
         }
     }
     
-    void KEAAttributeTableFile::setIntFields(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer)
+    void KEAAttributeTableFile::setIntFieldsDirect(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer)
     {
         if((startfid+len) > numRows)
         {
@@ -1038,7 +1134,7 @@ namespace kealib{
         }
     }
     
-    void KEAAttributeTableFile::setFloatFields(size_t startfid, size_t len, size_t colIdx, double *pfBuffer)
+    void KEAAttributeTableFile::setFloatFieldsDirect(size_t startfid, size_t len, size_t colIdx, double *pfBuffer)
     {
         if((startfid+len) > numRows)
         {
@@ -1128,7 +1224,7 @@ namespace kealib{
         }
     }
     
-    void KEAAttributeTableFile::setStringFields(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *papszStrList)
+    void KEAAttributeTableFile::setStringFieldsDirect(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *papszStrList)
     {
         if((startfid+len) > numRows)
         {
@@ -1348,12 +1444,444 @@ namespace kealib{
         
     }
     
+    // RFC40 - these go through the write-back buffer so reads observe
+    // any cell level edits which have not yet been written to the file
+    void KEAAttributeTableFile::getBoolFields(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer) const
+    {
+        KEAATTChunkBuffer *chunk = this->findChunkBuffer(kea_att_bool, colIdx, startfid, len);
+        if(chunk != nullptr)
+        {
+            size_t offset = startfid - chunk->startfid;
+            for(size_t i = 0; i < len; ++i)
+            {
+                pbBuffer[i] = (chunk->intVals[offset + i] != 0);
+            }
+            return;
+        }
+        this->flushChunkBuffers(kea_att_bool, colIdx, startfid, len, false);
+        this->getBoolFieldsDirect(startfid, len, colIdx, pbBuffer);
+    }
+    
+    void KEAAttributeTableFile::getIntFields(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer) const
+    {
+        KEAATTChunkBuffer *chunk = this->findChunkBuffer(kea_att_int, colIdx, startfid, len);
+        if(chunk != nullptr)
+        {
+            size_t offset = startfid - chunk->startfid;
+            std::copy(chunk->intVals.begin() + offset, chunk->intVals.begin() + offset + len, pnBuffer);
+            return;
+        }
+        this->flushChunkBuffers(kea_att_int, colIdx, startfid, len, false);
+        this->getIntFieldsDirect(startfid, len, colIdx, pnBuffer);
+    }
+    
+    void KEAAttributeTableFile::getFloatFields(size_t startfid, size_t len, size_t colIdx, double *pfBuffer) const
+    {
+        KEAATTChunkBuffer *chunk = this->findChunkBuffer(kea_att_float, colIdx, startfid, len);
+        if(chunk != nullptr)
+        {
+            size_t offset = startfid - chunk->startfid;
+            std::copy(chunk->floatVals.begin() + offset, chunk->floatVals.begin() + offset + len, pfBuffer);
+            return;
+        }
+        this->flushChunkBuffers(kea_att_float, colIdx, startfid, len, false);
+        this->getFloatFieldsDirect(startfid, len, colIdx, pfBuffer);
+    }
+    
+    void KEAAttributeTableFile::getStringFields(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *psBuffer) const
+    {
+        KEAATTChunkBuffer *chunk = this->findChunkBuffer(kea_att_string, colIdx, startfid, len);
+        if(chunk != nullptr)
+        {
+            size_t offset = startfid - chunk->startfid;
+            psBuffer->assign(chunk->strVals.begin() + offset, chunk->strVals.begin() + offset + len);
+            return;
+        }
+        this->flushChunkBuffers(kea_att_string, colIdx, startfid, len, false);
+        this->getStringFieldsDirect(startfid, len, colIdx, psBuffer);
+    }
+    
+    // RFC40 - edits which fall within a single chunk are collected in the
+    // write-back buffer, anything larger goes straight to the file
+    void KEAAttributeTableFile::setBoolFields(size_t startfid, size_t len, size_t colIdx, bool *pbBuffer)
+    {
+        KEAATTChunkBuffer *chunk = this->getChunkBuffer(kea_att_bool, colIdx, startfid, len);
+        if(chunk != nullptr)
+        {
+            size_t offset = startfid - chunk->startfid;
+            for(size_t i = 0; i < len; ++i)
+            {
+                chunk->intVals[offset + i] = pbBuffer[i]? 1:0;
+            }
+            chunk->dirty = true;
+            return;
+        }
+        this->flushChunkBuffers(kea_att_bool, colIdx, startfid, len, true);
+        this->setBoolFieldsDirect(startfid, len, colIdx, pbBuffer);
+    }
+    
+    void KEAAttributeTableFile::setIntFields(size_t startfid, size_t len, size_t colIdx, int64_t *pnBuffer)
+    {
+        KEAATTChunkBuffer *chunk = this->getChunkBuffer(kea_att_int, colIdx, startfid, len);
+        if(chunk != nullptr)
+        {
+            std::copy(pnBuffer, pnBuffer + len, chunk->intVals.begin() + (startfid - chunk->startfid));
+            chunk->dirty = true;
+            return;
+        }
+        this->flushChunkBuffers(kea_att_int, colIdx, startfid, len, true);
+        this->setIntFieldsDirect(startfid, len, colIdx, pnBuffer);
+    }
+    
+    void KEAAttributeTableFile::setFloatFields(size_t startfid, size_t len, size_t colIdx, double *pfBuffer)
+    {
+        KEAATTChunkBuffer *chunk = this->getChunkBuffer(kea_att_float, colIdx, startfid, len);
+        if(chunk != nullptr)
+        {
+            std::copy(pfBuffer, pfBuffer + len, chunk->floatVals.begin() + (startfid - chunk->startfid));
+            chunk->dirty = true;
+            return;
+        }
+        this->flushChunkBuffers(kea_att_float, colIdx, startfid, len, true);
+        this->setFloatFieldsDirect(startfid, len, colIdx, pfBuffer);
+    }
+    
+    void KEAAttributeTableFile::setStringFields(size_t startfid, size_t len, size_t colIdx, std::vector<std::string> *papszStrList)
+    {
+        if(papszStrList->size() != len)
+        {
+            throw KEAATTException("The number of items in the vector<std::string> passed was not equal to the length specified.");
+        }
+        
+        KEAATTChunkBuffer *chunk = this->getChunkBuffer(kea_att_string, colIdx, startfid, len);
+        if(chunk != nullptr)
+        {
+            std::copy(papszStrList->begin(), papszStrList->begin() + len, chunk->strVals.begin() + (startfid - chunk->startfid));
+            chunk->dirty = true;
+            return;
+        }
+        this->flushChunkBuffers(kea_att_string, colIdx, startfid, len, true);
+        this->setStringFieldsDirect(startfid, len, colIdx, papszStrList);
+    }
+    
+    // returns the cached chunk holding the whole of the range, if there is one
+    KEAATTChunkBuffer* KEAAttributeTableFile::findChunkBuffer(KEAFieldDataType dataType, size_t colIdx, size_t startfid, size_t len) const
+    {
+        if(chunkBuffers.empty() || (len == 0) || (chunkSize == 0))
+        {
+            return nullptr;
+        }
+        
+        size_t chunkIdx = startfid / chunkSize;
+        if(((startfid + len - 1) / chunkSize) != chunkIdx)
+        {
+            return nullptr;
+        }
+        
+        auto iterIdx = chunkBufferIdx.find(KEAATTChunkKey(dataType, colIdx, chunkIdx));
+        if(iterIdx == chunkBufferIdx.end())
+        {
+            return nullptr;
+        }
+        
+        KEAATTChunkBuffer *chunk = &(*iterIdx->second);
+        if((startfid + len) > (chunk->startfid + chunk->len))
+        {
+            return nullptr;
+        }
+        chunkBuffers.splice(chunkBuffers.begin(), chunkBuffers, iterIdx->second);
+        return chunk;
+    }
+    
+    // as findChunkBuffer but reads the chunk in from the file if it is not
+    // already cached. Returns nullptr if the range can't be buffered.
+    KEAATTChunkBuffer* KEAAttributeTableFile::getChunkBuffer(KEAFieldDataType dataType, size_t colIdx, size_t startfid, size_t len) const
+    {
+        if((len == 0) || (chunkSize == 0) || (len >= chunkSize) || ((startfid + len) > numRows))
+        {
+            return nullptr;
+        }
+        
+        size_t numCols = 0;
+        switch(dataType)
+        {
+            case kea_att_bool:
+                numCols = numBoolFields;
+                break;
+            case kea_att_int:
+                numCols = numIntFields;
+                break;
+            case kea_att_float:
+                numCols = numFloatFields;
+                break;
+            case kea_att_string:
+                numCols = numStringFields;
+                break;
+            default:
+                break;
+        }
+        if(colIdx >= numCols)
+        {
+            return nullptr;
+        }
+        
+        size_t chunkIdx = startfid / chunkSize;
+        if(((startfid + len - 1) / chunkSize) != chunkIdx)
+        {
+            return nullptr;
+        }
+        
+        KEAATTChunkBuffer *chunk = this->findChunkBuffer(dataType, colIdx, startfid, len);
+        if(chunk != nullptr)
+        {
+            return chunk;
+        }
+        
+        // make room by writing back the least recently used chunk
+        if(chunkBuffers.size() >= KEA_ATT_WRITE_BUFFER_CHUNKS)
+        {
+            KEAATTChunkBuffer *lastChunk = &chunkBuffers.back();
+            if(lastChunk->dirty)
+            {
+                this->writeChunkBuffer(lastChunk);
+            }
+            chunkBufferIdx.erase(KEAATTChunkKey(lastChunk->dataType, lastChunk->colIdx, lastChunk->startfid / chunkSize));
+            chunkBuffers.pop_back();
+        }
+        
+        KEAATTChunkBuffer newChunk;
+        newChunk.dataType = dataType;
+        newChunk.colIdx = colIdx;
+        newChunk.startfid = chunkIdx * chunkSize;
+        newChunk.len = std::min(chunkSize, numRows - newChunk.startfid);
+        newChunk.dirty = false;
+        switch(dataType)
+        {
+            case kea_att_bool:
+            {
+                bool *boolVals = new bool[newChunk.len];
+                try
+                {
+                    this->getBoolFieldsDirect(newChunk.startfid, newChunk.len, colIdx, boolVals);
+                }
+                catch(const KEAATTException &e)
+                {
+                    delete[] boolVals;
+                    throw e;
+                }
+                newChunk.intVals.assign(boolVals, boolVals + newChunk.len);
+                delete[] boolVals;
+                break;
+            }
+            case kea_att_int:
+                newChunk.intVals.resize(newChunk.len);
+                this->getIntFieldsDirect(newChunk.startfid, newChunk.len, colIdx, newChunk.intVals.data());
+                break;
+            case kea_att_float:
+                newChunk.floatVals.resize(newChunk.len);
+                this->getFloatFieldsDirect(newChunk.startfid, newChunk.len, colIdx, newChunk.floatVals.data());
+                break;
+            case kea_att_string:
+                this->getStringFieldsDirect(newChunk.startfid, newChunk.len, colIdx, &newChunk.strVals);
+                break;
+            default:
+                return nullptr;
+        }
+        
+        chunkBuffers.push_front(std::move(newChunk));
+        chunkBufferIdx[KEAATTChunkKey(dataType, colIdx, chunkIdx)] = chunkBuffers.begin();
+        return &chunkBuffers.front();
+    }
+    
+    void KEAAttributeTableFile::writeChunkBuffer(KEAATTChunkBuffer *chunk) const
+    {
+        // the buffer is mutable so this can be called from the const getters
+        KEAAttributeTableFile *table = const_cast<KEAAttributeTableFile*>(this);
+        switch(chunk->dataType)
+        {
+            case kea_att_bool:
+            {
+                bool *boolVals = new bool[chunk->len];
+                for(size_t i = 0; i < chunk->len; ++i)
+                {
+                    boolVals[i] = (chunk->intVals[i] != 0);
+                }
+                try
+                {
+                    table->setBoolFieldsDirect(chunk->startfid, chunk->len, chunk->colIdx, boolVals);
+                }
+                catch(const KEAException &e)
+                {
+                    delete[] boolVals;
+                    throw;
+                }
+                delete[] boolVals;
+                break;
+            }
+            case kea_att_int:
+                table->setIntFieldsDirect(chunk->startfid, chunk->len, chunk->colIdx, chunk->intVals.data());
+                break;
+            case kea_att_float:
+                table->setFloatFieldsDirect(chunk->startfid, chunk->len, chunk->colIdx, chunk->floatVals.data());
+                break;
+            case kea_att_string:
+                table->setStringFieldsDirect(chunk->startfid, chunk->len, chunk->colIdx, &chunk->strVals);
+                break;
+            default:
+                break;
+        }
+        chunk->dirty = false;
+    }
+    
+    // writes back any dirty chunks overlapping the range. If discard is true
+    // the chunks are also dropped as the file is about to be written directly.
+    void KEAAttributeTableFile::flushChunkBuffers(KEAFieldDataType dataType, size_t colIdx, size_t startfid, size_t len, bool discard) const
+    {
+        if(chunkBuffers.empty() || (len == 0) || (chunkSize == 0))
+        {
+            return;
+        }
+        
+        KEAATTChunkKey lastKey(dataType, colIdx, (startfid + len - 1) / chunkSize);
+        auto iterIdx = chunkBufferIdx.lower_bound(KEAATTChunkKey(dataType, colIdx, startfid / chunkSize));
+        while((iterIdx != chunkBufferIdx.end()) && !(lastKey < iterIdx->first))
+        {
+            if(iterIdx->second->dirty)
+            {
+                this->writeChunkBuffer(&(*iterIdx->second));
+            }
+            
+            if(discard)
+            {
+                chunkBuffers.erase(iterIdx->second);
+                iterIdx = chunkBufferIdx.erase(iterIdx);
+            }
+            else
+            {
+                ++iterIdx;
+            }
+        }
+    }
+    
+    void KEAAttributeTableFile::flushAllChunkBuffers(bool discard) const
+    {
+        // go through the index so the chunks are written in file order
+        for(auto iterIdx = chunkBufferIdx.begin(); iterIdx != chunkBufferIdx.end(); ++iterIdx)
+        {
+            if(iterIdx->second->dirty)
+            {
+                this->writeChunkBuffer(&(*iterIdx->second));
+            }
+        }
+        
+        if(discard)
+        {
+            chunkBuffers.clear();
+            chunkBufferIdx.clear();
+        }
+    }
+    
+    void KEAAttributeTableFile::flush()
+    {
+        this->flushAllChunkBuffers(false);
+    }
+    
     KEAATTFeature* KEAAttributeTableFile::getFeature(size_t fid) const
     {
         throw KEAATTException("KEAAttributeTableFile::getFeature(size_t fid) has not been implemented.");
         return nullptr;
     }
     
+    void KEAAttributeTableFile::getFeatures(size_t startfid, size_t len, KEAATTFeatureBlock *features) const
+    {
+        if((startfid+len) > numRows)
+        {
+            std::string message = std::string("Requested feature (") + sizet2Str(startfid+len) + std::string(") is not within the table.");
+            throw KEAATTException(message);
+        }
+        
+        features->reset(startfid, len, numBoolFields, numIntFields, numFloatFields, numStringFields);
+        if(len == 0)
+        {
+            return;
+        }
+        
+        try
+        {
+            // buffered cell edits need to be within the file before reading it directly.
+            this->flushAllChunkBuffers(false);
+            
+            H5::DSetMemXferPropList xfer;
+            xfer.setVlenMemManager(kealibmalloc, nullptr, kealibfree, nullptr);
+            
+            if(numBoolFields > 0)
+            {
+                readAllColumnRows(keaImg, bandPathBase + KEA_ATT_BOOL_DATA, H5::PredType::NATIVE_UINT8, features->boolVals.data(), startfid, len, numRows, numBoolFields, "boolean", xfer);
+            }
+            if(numIntFields > 0)
+            {
+                readAllColumnRows(keaImg, bandPathBase + KEA_ATT_INT_DATA, H5::PredType::NATIVE_INT64, features->intVals.data(), startfid, len, numRows, numIntFields, "integer", xfer);
+            }
+            if(numFloatFields > 0)
+            {
+                readAllColumnRows(keaImg, bandPathBase + KEA_ATT_FLOAT_DATA, H5::PredType::NATIVE_DOUBLE, features->floatVals.data(), startfid, len, numRows, numFloatFields, "float", xfer);
+            }
+            if(numStringFields > 0)
+            {
+                H5::CompType *strTypeMem = KEAAttributeTable::createKeaStringCompTypeMem();
+                std::vector<KEAString> stringVals(len * numStringFields, KEAString());
+                try
+                {
+                    readAllColumnRows(keaImg, bandPathBase + KEA_ATT_STRING_DATA, *strTypeMem, stringVals.data(), startfid, len, numRows, numStringFields, "string", xfer);
+                }
+                catch(const std::exception &e)
+                {
+                    delete strTypeMem;
+                    throw;
+                }
+                delete strTypeMem;
+                
+                for(size_t i = 0; i < len; ++i)
+                {
+                    for(size_t j = 0; j < numStringFields; ++j)
+                    {
+                        char *str = stringVals[(i*numStringFields)+j].str;
+                        if(str != nullptr)
+                        {
+                            features->setString(i, j, str, strlen(str));
+                            free(str);
+                        }
+                        else
+                        {
+                            features->setString(i, j, "", 0);
+                        }
+                    }
+                }
+            }
+            
+            std::vector<size_t> rowEnds;
+            rowEnds.reserve(len);
+            this->getNeighbourBlock(startfid, len, &rowEnds, &features->neighbours);
+            std::copy(rowEnds.begin(), rowEnds.end(), features->neighbourOffsets.begin() + 1);
+        }
+        catch(const H5::Exception &e)
+        {
+            throw KEAATTException(e.getDetailMsg());
+        }
+        catch (const KEAATTException &e)
+        {
+            throw e;
+        }
+        catch (const KEAIOException &e)
+        {
+            throw KEAATTException(e.what());
+        }
+        catch(const std::exception &e)
+        {
+            throw KEAATTException(e.what());
+        }
+    }
+    
     size_t KEAAttributeTableFile::getSize() const
     {
         return numRows;
@@ -1410,6 +1938,7 @@ namespace kealib{
     void KEAAttributeTableFile::addAttBoolField(KEAATTField field, bool val)
     {
         // field already been inserted into this->fields by base class
+        this->flushAllChunkBuffers(false);
         updateSizeHeader(numBoolFields+1, numIntFields, numFloatFields, numStringFields);
         
         // update BOOL_FIELDS
@@ -1546,6 +2075,7 @@ namespace kealib{
     void KEAAttributeTableFile::addAttIntField(KEAATTField field, int64_t val)
     {
         // field already been inserted into this->fields by base class
+        this->flushAllChunkBuffers(false);
         updateSizeHeader(numBoolFields, numIntFields+1, numFloatFields, numStringFields);
         
         // update INT_FIELDS
@@ -1681,6 +2211,7 @@ namespace kealib{
     void KEAAttributeTableFile::addAttFloatField(KEAATTField field, float val)
     {
         // field already been inserted into this->fields by base class
+        this->flushAllChunkBuffers(false);
         updateSizeHeader(numBoolFields, numIntFields, numFloatFields+1, numStringFields);
         
         // update FLOAT_FIELDS
@@ -1816,6 +2347,7 @@ namespace kealib{
     void KEAAttributeTableFile::addAttStringField(KEAATTField field, const std::string &val)
     {
         // field already been inserted into this->fields by base class
+        this->flushAllChunkBuffers(false);
         updateSizeHeader(numBoolFields, numIntFields, numFloatFields, numStringFields+1);
         
         // update string_FIELDS
@@ -1957,6 +2489,9 @@ namespace kealib{
     {
         if( numRowsIn > 0 )
         {
+            // the last chunk will grow so drop the buffered chunks
+            this->flushAllChunkBuffers(true);
+            
             // update header
             numRows += numRowsIn;
             updateSizeHeader(numBoolFields, numIntFields, numFloatFields, numStringFields);
@@ -2018,6 +2553,62 @@ namespace kealib{
         }
     }
     
+    void KEAAttributeTableFile::removeRows(size_t numRowsIn)
+    {
+        if(numRowsIn > numRows)
+        {
+            throw KEAATTException("Cannot remove more rows than are within the table.");
+        }
+        
+        if( numRowsIn > 0 )
+        {
+            // the buffered chunks may be beyond the end of the table
+            this->flushAllChunkBuffers(true);
+            
+            // update header
+            numRows -= numRowsIn;
+            updateSizeHeader(numBoolFields, numIntFields, numFloatFields, numStringFields);
+            
+            // shrink the various data tables if they exist
+            const std::string dataNames[4] = {KEA_ATT_BOOL_DATA, KEA_ATT_INT_DATA, KEA_ATT_FLOAT_DATA, KEA_ATT_STRING_DATA};
+            const size_t numCols[4] = {numBoolFields, numIntFields, numFloatFields, numStringFields};
+            try
+            {
+                for(int i = 0; i < 4; ++i)
+                {
+                    std::string dataName = bandPathBase + dataNames[i];
+                    if((numCols[i] > 0) && (H5Lexists(keaImg->getId(), dataName.c_str(), H5P_DEFAULT) > 0))
+                    {
+                        H5::DataSet dataset = keaImg->openDataSet(dataName);
+                        hsize_t shrinkDatasetTo[2];
+                        shrinkDatasetTo[0] = this->numRows;
+                        shrinkDatasetTo[1] = numCols[i];
+                        dataset.extend(shrinkDatasetTo);
+                        dataset.close();
+                    }
+                }
+                
+                std::string neighboursName = bandPathBase + KEA_ATT_NEIGHBOURS_DATA;
+                if(H5Lexists(keaImg->getId(), neighboursName.c_str(), H5P_DEFAULT) > 0)
+                {
+                    H5::DataSet neighboursDataset = keaImg->openDataSet(neighboursName);
+                    hsize_t neighboursDims[1];
+                    neighboursDataset.getSpace().getSimpleExtentDims(neighboursDims);
+                    if(neighboursDims[0] > this->numRows)
+                    {
+                        neighboursDims[0] = this->numRows;
+                        neighboursDataset.extend(neighboursDims);
+                    }
+                    neighboursDataset.close();
+                }
+            }
+            catch(const H5::Exception &e)
+            {
+                throw KEAATTException(e.getDetailMsg());
+            }
+        }
+    }
+    
     KEAAttributeTable* KEAAttributeTableFile::createKeaAtt(H5::H5File *keaImg, unsigned int band, unsigned int chunkSizeIn, unsigned int deflate)
     {
         // Create instance of class to populate and return.
@@ -2378,6 +2969,14 @@ namespace kealib{
     
     KEAAttributeTableFile::~KEAAttributeTableFile()
     {
+        try
+        {
+            this->flushAllChunkBuffers(true);
+        }
+        catch(const KEAException &e)
+        {
+            // can't throw from a destructor - call flush() first to see errors
+        }
     }
     
 }
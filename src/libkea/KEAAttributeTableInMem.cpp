@@ -29,10 +29,132 @@
  */
 
 #include "libkea/KEAAttributeTableInMem.h"
+#include <stdlib.h>
 #include <string.h>
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <thread>
 
 namespace kealib{
     
+    static void* kealibmalloc(size_t nSize, void* ignored)
+    {
+        return malloc(nSize);
+    }
+
+    static void kealibfree(void* ptr, void* ignored)
+    {
+        free(ptr);
+    }
+    
+    namespace
+    {
+        // A block of rows held in the row major layout used within the file.
+        struct KEAATTRowBlock
+        {
+            size_t rowOff = 0;
+            size_t numRows = 0;
+            bool ownsStrings = false;
+            std::vector<int> boolVals;
+            std::vector<int64_t> intVals;
+            std::vector<double> floatVals;
+            std::vector<KEAString> strVals;
+            std::vector<VarLenFieldHDF> neighbourVals;
+            
+            KEAATTRowBlock() = default;
+            // the variable length memory is owned so the block can't be copied
+            KEAATTRowBlock(const KEAATTRowBlock &other) = delete;
+            KEAATTRowBlock& operator=(const KEAATTRowBlock &other) = delete;
+            
+            // Frees the variable length memory (always malloc'd) held by the block.
+            void release()
+            {
+                if(ownsStrings)
+                {
+                    for(KEAString &strVal : strVals)
+                    {
+                        free(strVal.str);
+                        strVal.str = nullptr;
+                    }
+                }
+                for(VarLenFieldHDF &neighbourVal : neighbourVals)
+                {
+                    free(neighbourVal.p);
+                    neighbourVal.p = nullptr;
+                    neighbourVal.length = 0;
+                }
+                ownsStrings = false;
+            }
+            
+            ~KEAATTRowBlock()
+            {
+                release();
+            }
+        };
+    }
+    
+    // Splits the rows [0, numRows) across the available cores, with at
+    // least minRowsPerThread each, and waits for func(start, end) to
+    // complete on each range.
+    static void parallelForATTRows(size_t numRows, const std::function<void(size_t, size_t)> &func)
+    {
+        static const size_t minRowsPerThread = 1024;
+        size_t numThreads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), std::max<size_t>(numRows / minRowsPerThread, 1));
+        runOnThreads(numRows, (unsigned int)numThreads, [&func](uint64_t start, uint64_t end, unsigned int)
+        {
+            func(start, end);
+        });
+    }
+    
+    static void checkATTDataDims(const H5::DataSet &dataset, int nDims, size_t numRows, size_t numCols, const std::string &typeName)
+    {
+        H5::DataSpace dataspace = dataset.getSpace();
+        if(dataspace.getSimpleExtentNdims() != nDims)
+        {
+            throw KEAIOException("The " + typeName + " datasets needs to have " + ((nDims == 1)?"1 dimension.":"2 dimensions."));
+        }
+        
+        hsize_t dims[2] = {0, 0};
+        dataspace.getSimpleExtentDims(dims);
+        dataspace.close();
+        if(numRows > dims[0])
+        {
+            throw KEAIOException("The number of features in " + typeName + " dataset is smaller than expected.");
+        }
+        if((nDims == 2) && (numCols > dims[1]))
+        {
+            throw KEAIOException("The number of " + typeName + " fields is smaller than expected.");
+        }
+    }
+    
+    // Reads numRows rows from rowOff; numCols of 0 denotes a 1D dataset.
+    static void readATTRowBlock(const H5::DataSet &dataset, const H5::DataType &memType, void *buffer, size_t rowOff, size_t numRows, size_t numCols, const H5::DSetMemXferPropList &xfer)
+    {
+        int nDims = (numCols > 0)?2:1;
+        hsize_t offset[2] = {rowOff, 0};
+        hsize_t count[2] = {numRows, numCols};
+        H5::DataSpace fileDataspace = dataset.getSpace();
+        fileDataspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+        H5::DataSpace memDataspace(nDims, count);
+        dataset.read(buffer, memType, memDataspace, fileDataspace, xfer);
+        memDataspace.close();
+        fileDataspace.close();
+    }
+    
+    static void writeATTRowBlock(const H5::DataSet &dataset, const H5::DataType &memType, const void *buffer, size_t rowOff, size_t numRows, size_t numCols)
+    {
+        int nDims = (numCols > 0)?2:1;
+        hsize_t offset[2] = {rowOff, 0};
+        hsize_t count[2] = {numRows, numCols};
+        H5::DataSpace fileDataspace = dataset.getSpace();
+        fileDataspace.selectHyperslab(H5S_SELECT_SET, count, offset);
+        H5::DataSpace memDataspace(nDims, count);
+        dataset.write(buffer, memType, memDataspace, fileDataspace);
+        memDataspace.close();
+        fileDataspace.close();
+    }
+    
     KEAAttributeTableInMem::KEAAttributeTableInMem() : KEAAttributeTable(kea_att_mem)
     {
         attRows = new std::vector<KEAATTFeature*>();
@@ -504,7 +626,7 @@ namespace kealib{
         
         for( size_t n = 0; n < len; n++)
         {
-            attRows->at(n+startfid)->strFields->at(colIdx) = papszStrList->at(colIdx);
+            attRows->at(n+startfid)->strFields->at(colIdx) = papszStrList->at(n);
         }
     }
     
@@ -524,6 +646,50 @@ namespace kealib{
         return attRows->at(fid);
     }
         
+    void KEAAttributeTableInMem::getFeatures(size_t startfid, size_t len, KEAATTFeatureBlock *features) const
+    {
+        if((startfid+len) > attRows->size())
+        {
+            std::string message = std::string("Requested feature (") + sizet2Str(startfid+len) + std::string(") is not within the table.");
+            throw KEAATTException(message);
+        }
+        
+        features->reset(startfid, len, this->numBoolFields, this->numIntFields, this->numFloatFields, this->numStringFields);
+        for(size_t i = 0; i < len; ++i)
+        {
+            const KEAATTFeature *feat = attRows->at(startfid+i);
+            for(size_t j = 0; j < this->numBoolFields; ++j)
+            {
+                features->boolVals[(i*this->numBoolFields)+j] = feat->boolFields->at(j);
+            }
+            std::copy(feat->intFields->begin(), feat->intFields->begin() + this->numIntFields, features->intVals.begin() + (i*this->numIntFields));
+            std::copy(feat->floatFields->begin(), feat->floatFields->begin() + this->numFloatFields, features->floatVals.begin() + (i*this->numFloatFields));
+            for(size_t j = 0; j < this->numStringFields; ++j)
+            {
+                const std::string &str = feat->strFields->at(j);
+                features->setString(i, j, str.c_str(), str.size());
+            }
+            features->neighbours.insert(features->neighbours.end(), feat->neighbours->begin(), feat->neighbours->end());
+            features->neighbourOffsets[i+1] = features->neighbours.size();
+        }
+    }
+    
+    void KEAAttributeTableInMem::getNeighbourBlock(size_t startfid, size_t len, std::vector<size_t> *rowEnds, std::vector<size_t> *neighbours) const
+    {
+        if((startfid+len) > attRows->size())
+        {
+            std::string message = std::string("Requested feature (") + sizet2Str(startfid+len) + std::string(") is not within the table.");
+            throw KEAATTException(message);
+        }
+        
+        for(size_t i = 0; i < len; ++i)
+        {
+            const std::vector<size_t> *featNeighbours = attRows->at(startfid+i)->neighbours;
+            neighbours->insert(neighbours->end(), featNeighbours->begin(), featNeighbours->end());
+            rowEnds->push_back(neighbours->size());
+        }
+    }
+    
     size_t KEAAttributeTableInMem::getSize() const
     {
         return attRows->size();
@@ -573,7 +739,26 @@ namespace kealib{
         }
     }
     
+    void KEAAttributeTableInMem::removeRows(size_t numRows)
+    {
+        if(numRows > attRows->size())
+        {
+            throw KEAATTException("Cannot remove more rows than are within the table.");
+        }
+        
+        for(size_t i = 0; i < numRows; ++i)
+        {
+            this->deleteKeaFeature(attRows->back());
+            attRows->pop_back();
+        }
+    }
+    
     void KEAAttributeTableInMem::exportToKeaFile(H5::H5File *keaImg, unsigned int band, unsigned int chunkSize, unsigned int deflate)
+    {
+        this->exportToKeaFile(keaImg, band, chunkSize, deflate, nullptr, nullptr);
+    }
+    
+    void KEAAttributeTableInMem::exportToKeaFile(H5::H5File *keaImg, unsigned int band, unsigned int chunkSize, unsigned int deflate, KEAATTProgressFunc pfnProgress, void *pProgressData)
     {        
         try
         {
@@ -1221,7 +1406,7 @@ namespace kealib{
                         dimsStringChunk[1] = 1;
                         
                         KEAString fillValueStr = KEAString();
-                        fillValueStr.str = const_cast<char*>(std::string("").c_str());
+                        fillValueStr.str = const_cast<char*>("");
                         H5::DSetCreatPropList creationStringDSPList;
                         creationStringDSPList.setChunk(2, dimsStringChunk);
                         creationStringDSPList.setShuffle();
@@ -1503,7 +1688,7 @@ namespace kealib{
                     dimsStringChunk[1] = 1;
                     
                     KEAString fillValueStr = KEAString();
-                    fillValueStr.str = const_cast<char*>(std::string("").c_str());
+                    fillValueStr.str = const_cast<char*>("");
                     H5::DSetCreatPropList creationStringDSPList;
                     creationStringDSPList.setChunk(2, dimsStringChunk);
                     creationStringDSPList.setShuffle();
@@ -1539,306 +1724,106 @@ namespace kealib{
             }
                         
             // WRITE DATA INTO THE STRUCTURE.
-            size_t numOfBlocks = 0;
-            numOfBlocks = floor(((double)attRows->size()/chunkSize));
-            size_t remainRows = attRows->size() - (numOfBlocks * chunkSize);
-                        
-            int *boolData = nullptr;
-            if(this->numBoolFields > 0)
-            {
-                boolData = new int[this->numBoolFields*chunkSize];
-            }
-            int64_t *intData = nullptr;
-            if(this->numIntFields > 0)
-            {
-                intData = new int64_t[this->numIntFields*chunkSize];
-            }
-            double *floatData = nullptr;
-            if(this->numFloatFields > 0)
-            {
-                floatData = new double[this->numFloatFields*chunkSize];
-            }
-            KEAString *stringData = nullptr;
-            if(this->numStringFields > 0)
-            {
-                stringData = new KEAString[this->numStringFields*chunkSize];
-            }
+            // Blocks of rows are encoded into the on-disk row layout on worker
+            // threads while the previous block is written from this thread.
+            size_t numRows = attRows->size();
+            size_t blockRows = ((size_t)chunkSize) * KEA_ATT_PIPELINE_BLOCK_CHUNKS;
+            size_t numOfBlocks = (numRows + blockRows - 1) / blockRows;
+            H5::DataType neighboursMemDT = H5::VarLenType(&H5::PredType::NATIVE_HSIZE);
             
-            VarLenFieldHDF *neighbourVals = new VarLenFieldHDF[chunkSize];
-            
-            if(numOfBlocks > 0)
+            auto encodeBlock = [this](KEAATTRowBlock *block)
             {
-                hsize_t boolDataOffset[2];
-                boolDataOffset[0] = 0;
-                boolDataOffset[1] = 0;
-                hsize_t boolDataDims[2];
-                boolDataDims[0] = chunkSize;
-                boolDataDims[1] = this->numBoolFields;
-                
-                hsize_t intDataOffset[2];
-                intDataOffset[0] = 0;
-                intDataOffset[1] = 0;
-                hsize_t intDataDims[2];
-                intDataDims[0] = chunkSize;
-                intDataDims[1] = this->numIntFields;
-                
-                hsize_t floatDataOffset[2];
-                floatDataOffset[0] = 0;
-                floatDataOffset[1] = 0;
-                hsize_t floatDataDims[2];
-                floatDataDims[0] = chunkSize;
-                floatDataDims[1] = this->numFloatFields;
-                
-                hsize_t stringDataOffset[2];
-                stringDataOffset[0] = 0;
-                stringDataOffset[1] = 0;
-                hsize_t stringDataDims[2];
-                stringDataDims[0] = chunkSize;
-                stringDataDims[1] = this->numStringFields;
-                
-                hsize_t neighboursDataOffset[1];
-                neighboursDataOffset[0] = 0;
-                hsize_t neighboursDataDims[1];
-                neighboursDataDims[0] = chunkSize;
-                H5::DataType intVarLenMemDT = H5::VarLenType(&H5::PredType::NATIVE_HSIZE);
-                H5::DataSpace memNeighboursDataspace = H5::DataSpace(1, neighboursDataDims);
-                
-                size_t rowOff = 0;
-                KEAATTFeature *keaFeat = nullptr;
-                for(size_t n = 0; n < numOfBlocks; ++n)
+                parallelForATTRows(block->numRows, [this, block](size_t start, size_t end)
                 {
-                    rowOff = n * chunkSize;
-                    
-                    for(size_t i = 0; i < chunkSize; ++i)
+                    for(size_t i = start; i < end; ++i)
                     {
-                        keaFeat = attRows->at(rowOff+i);
+                        const KEAATTFeature *keaFeat = this->attRows->at(block->rowOff + i);
                         for(size_t j = 0; j < this->numBoolFields; ++j)
                         {
-                            boolData[(i*this->numBoolFields)+j] = keaFeat->boolFields->at(j);
+                            block->boolVals[(i*this->numBoolFields)+j] = keaFeat->boolFields->at(j);
                         }
                         for(size_t j = 0; j < this->numIntFields; ++j)
                         {
-                            intData[(i*this->numIntFields)+j] = keaFeat->intFields->at(j);
+                            block->intVals[(i*this->numIntFields)+j] = keaFeat->intFields->at(j);
                         }
                         for(size_t j = 0; j < this->numFloatFields; ++j)
                         {
-                            floatData[(i*this->numFloatFields)+j] = keaFeat->floatFields->at(j);
+                            block->floatVals[(i*this->numFloatFields)+j] = keaFeat->floatFields->at(j);
                         }
                         for(size_t j = 0; j < this->numStringFields; ++j)
                         {
-                            stringData[(i*this->numStringFields)+j].str = const_cast<char*>(keaFeat->strFields->at(j).c_str());
+                            block->strVals[(i*this->numStringFields)+j].str = const_cast<char*>(keaFeat->strFields->at(j).c_str());
                         }
                         
-                        neighbourVals[i].length = 0;
-                        neighbourVals[i].p = nullptr;
-                        if(keaFeat->neighbours->size() > 0)
+                        VarLenFieldHDF &neighbourVal = block->neighbourVals[i];
+                        neighbourVal.length = keaFeat->neighbours->size();
+                        neighbourVal.p = nullptr;
+                        if(neighbourVal.length > 0)
                         {
-                            neighbourVals[i].length = keaFeat->neighbours->size();
-                            neighbourVals[i].p = new hsize_t[keaFeat->neighbours->size()];
-                            for(unsigned int k = 0; k < keaFeat->neighbours->size(); ++k)
+                            hsize_t *neighbours = (hsize_t*)malloc(neighbourVal.length * sizeof(hsize_t));
+                            if(neighbours == nullptr)
                             {
-                                ((hsize_t*)neighbourVals[i].p)[k] = keaFeat->neighbours->at(k);
+                                neighbourVal.length = 0;
+                                throw std::bad_alloc();
                             }
+                            std::copy(keaFeat->neighbours->begin(), keaFeat->neighbours->end(), neighbours);
+                            neighbourVal.p = neighbours;
                         }
                     }
-                                        
-                    if(this->numBoolFields > 0)
-                    {
-                        boolDataOffset[0] = rowOff;
-                        boolDataOffset[1] = 0;
-                        
-                        H5::DataSpace boolWriteDataSpace = boolDataset->getSpace();
-                        boolWriteDataSpace.selectHyperslab(H5S_SELECT_SET, boolDataDims, boolDataOffset);
-                        H5::DataSpace newBoolDataspace = H5::DataSpace(2, boolDataDims);
-                        boolDataset->write(boolData, H5::PredType::NATIVE_INT, newBoolDataspace, boolWriteDataSpace);
-                        newBoolDataspace.close();
-                        boolWriteDataSpace.close();
-                    }
-                    
-                    if(this->numIntFields > 0)
-                    {
-                        intDataOffset[0] = rowOff;
-                        intDataOffset[1] = 0;
-                        
-                        H5::DataSpace intWriteDataSpace = intDataset->getSpace();
-                        intWriteDataSpace.selectHyperslab(H5S_SELECT_SET, intDataDims, intDataOffset);
-                        H5::DataSpace newIntDataspace = H5::DataSpace(2, intDataDims);
-                        intDataset->write(intData, H5::PredType::NATIVE_INT64, newIntDataspace, intWriteDataSpace);
-                        intWriteDataSpace.close();
-                        newIntDataspace.close();
-                    }
-                    
-                    if(this->numFloatFields > 0)
-                    {
-                        floatDataOffset[0] = rowOff;
-                        floatDataOffset[1] = 0;
-                        
-                        H5::DataSpace floatWriteDataSpace = floatDataset->getSpace();
-                        floatWriteDataSpace.selectHyperslab(H5S_SELECT_SET, floatDataDims, floatDataOffset);
-                        H5::DataSpace newFloatDataspace = H5::DataSpace(2, floatDataDims);
-                        floatDataset->write(floatData, H5::PredType::NATIVE_DOUBLE, newFloatDataspace, floatWriteDataSpace);
-                        floatWriteDataSpace.close();
-                        newFloatDataspace.close();
-                    }
-                    
-                    if(this->numStringFields > 0)
-                    {
-                        stringDataOffset[0] = rowOff;
-                        stringDataOffset[1] = 0;
-                        
-                        H5::DataSpace stringWriteDataSpace = strDataset->getSpace();
-                        stringWriteDataSpace.selectHyperslab(H5S_SELECT_SET, stringDataDims, stringDataOffset);
-                        H5::DataSpace newStringDataspace = H5::DataSpace(2, stringDataDims);
-                        strDataset->write(stringData, *strTypeMem, newStringDataspace, stringWriteDataSpace);
-                        stringWriteDataSpace.close();
-                        newStringDataspace.close();
-                    }
-                    
-                    neighboursDataOffset[0] = rowOff;
-                    
-                    H5::DataSpace neighboursWriteDataSpace = neighboursDataset->getSpace();
-                    neighboursWriteDataSpace.selectHyperslab(H5S_SELECT_SET, neighboursDataDims, neighboursDataOffset);
-                    neighboursDataset->write(neighbourVals, intVarLenMemDT, memNeighboursDataspace, neighboursWriteDataSpace);
-                    neighboursWriteDataSpace.close();
-                    
-                    for(size_t i = 0; i < chunkSize; ++i)
-                    {
-                        if(neighbourVals[i].length > 0)
-                        {
-                            neighbourVals[i].length = 0;
-                            delete[] ((hsize_t*)neighbourVals[i].p);
-                        }
-                    }
-                }
-                memNeighboursDataspace.close();
-            }
+                });
+            };
             
-            if(remainRows > 0)
+            KEAATTRowBlock blocks[2];
+            auto startEncode = [&](size_t n) -> std::future<void>
             {
-                size_t rowOff = numOfBlocks * chunkSize;
-                //size_t strOff = 0;
-                
-                hsize_t boolDataOffset[2];
-                boolDataOffset[0] = rowOff;
-                boolDataOffset[1] = 0;
-                hsize_t boolDataDims[2];
-                boolDataDims[0] = remainRows;
-                boolDataDims[1] = this->numBoolFields;
-                
-                hsize_t intDataOffset[2];
-                intDataOffset[0] = rowOff;
-                intDataOffset[1] = 0;
-                hsize_t intDataDims[2];
-                intDataDims[0] = remainRows;
-                intDataDims[1] = this->numIntFields;
-                
-                hsize_t floatDataOffset[2];
-                floatDataOffset[0] = rowOff;
-                floatDataOffset[1] = 0;
-                hsize_t floatDataDims[2];
-                floatDataDims[0] = remainRows;
-                floatDataDims[1] = this->numFloatFields;
-                
-                hsize_t stringDataOffset[2];
-                stringDataOffset[0] = rowOff;
-                stringDataOffset[1] = 0;
-                hsize_t stringDataDims[2];
-                stringDataDims[0] = remainRows;
-                stringDataDims[1] = this->numStringFields;
-                
-                hsize_t neighboursDataOffset[1];
-                neighboursDataOffset[0] = rowOff;
-                hsize_t neighboursDataDims[1];
-                neighboursDataDims[0] = remainRows;
-                H5::DataType intVarLenMemDT = H5::VarLenType(&H5::PredType::NATIVE_HSIZE);
-                
-                KEAATTFeature *keaFeat = nullptr;
-                for(size_t i = 0; i < remainRows; ++i)
+                KEAATTRowBlock &block = blocks[n % 2];
+                block.release();
+                block.rowOff = n * blockRows;
+                block.numRows = std::min(blockRows, numRows - block.rowOff);
+                block.boolVals.resize(block.numRows * this->numBoolFields);
+                block.intVals.resize(block.numRows * this->numIntFields);
+                block.floatVals.resize(block.numRows * this->numFloatFields);
+                block.strVals.resize(block.numRows * this->numStringFields);
+                block.neighbourVals.assign(block.numRows, VarLenFieldHDF());
+                return std::async(std::launch::async, encodeBlock, &block);
+            };
+            
+            std::future<void> encoded;
+            if(numOfBlocks > 0)
+            {
+                encoded = startEncode(0);
+            }
+            for(size_t n = 0; n < numOfBlocks; ++n)
+            {
+                KEAATTRowBlock &block = blocks[n % 2];
+                encoded.get();
+                if((n + 1) < numOfBlocks)
                 {
-                    keaFeat = attRows->at(rowOff+i);
-                    for(size_t j = 0; j < this->numBoolFields; ++j)
-                    {
-                        boolData[(i*this->numBoolFields)+j] = keaFeat->boolFields->at(j);
-                    }
-                    for(size_t j = 0; j < this->numIntFields; ++j)
-                    {
-                        intData[(i*this->numIntFields)+j] = keaFeat->intFields->at(j);
-                    }
-                    for(size_t j = 0; j < this->numFloatFields; ++j)
-                    {
-                        floatData[(i*this->numFloatFields)+j] = keaFeat->floatFields->at(j);
-                    }
-                    for(size_t j = 0; j < this->numStringFields; ++j)
-                    {
-                        stringData[(i*this->numStringFields)+j].str = const_cast<char*>(keaFeat->strFields->at(j).c_str());
-                    }
-                    neighbourVals[i].length = 0;
-                    neighbourVals[i].p = nullptr;
-                    if(keaFeat->neighbours->size() > 0)
-                    {
-                        neighbourVals[i].length = keaFeat->neighbours->size();
-                        neighbourVals[i].p = new hsize_t[keaFeat->neighbours->size()];
-                        for(unsigned int k = 0; k < keaFeat->neighbours->size(); ++k)
-                        {
-                            ((hsize_t*)neighbourVals[i].p)[k] = keaFeat->neighbours->at(k);
-                        }
-                    }
+                    encoded = startEncode(n + 1);
                 }
-                                
+                
                 if(this->numBoolFields > 0)
                 {
-                    H5::DataSpace boolWriteDataSpace = boolDataset->getSpace();
-                    boolWriteDataSpace.selectHyperslab(H5S_SELECT_SET, boolDataDims, boolDataOffset);
-                    H5::DataSpace newBoolDataspace = H5::DataSpace(2, boolDataDims);
-                    boolDataset->write(boolData, H5::PredType::NATIVE_INT, newBoolDataspace, boolWriteDataSpace);
-                    boolWriteDataSpace.close();
-                    newBoolDataspace.close();
+                    writeATTRowBlock(*boolDataset, H5::PredType::NATIVE_INT, block.boolVals.data(), block.rowOff, block.numRows, this->numBoolFields);
                 }
-                
                 if(this->numIntFields > 0)
                 {
-                    H5::DataSpace intWriteDataSpace = intDataset->getSpace();
-                    intWriteDataSpace.selectHyperslab(H5S_SELECT_SET, intDataDims, intDataOffset);
-                    H5::DataSpace newIntDataspace = H5::DataSpace(2, intDataDims);
-                    intDataset->write(intData, H5::PredType::NATIVE_INT64, newIntDataspace, intWriteDataSpace);
-                    newIntDataspace.close();
-                    intWriteDataSpace.close();
+                    writeATTRowBlock(*intDataset, H5::PredType::NATIVE_INT64, block.intVals.data(), block.rowOff, block.numRows, this->numIntFields);
                 }
-                
                 if(this->numFloatFields > 0)
                 {
-                    H5::DataSpace floatWriteDataSpace = floatDataset->getSpace();
-                    floatWriteDataSpace.selectHyperslab(H5S_SELECT_SET, floatDataDims, floatDataOffset);
-                    H5::DataSpace newFloatDataspace = H5::DataSpace(2, floatDataDims);
-                    floatDataset->write(floatData, H5::PredType::NATIVE_DOUBLE, newFloatDataspace, floatWriteDataSpace);
-                    newFloatDataspace.close();
-                    floatWriteDataSpace.close();
+                    writeATTRowBlock(*floatDataset, H5::PredType::NATIVE_DOUBLE, block.floatVals.data(), block.rowOff, block.numRows, this->numFloatFields);
                 }
-                
                 if(this->numStringFields > 0)
                 {
-                    H5::DataSpace stringWriteDataSpace = strDataset->getSpace();
-                    stringWriteDataSpace.selectHyperslab(H5S_SELECT_SET, stringDataDims, stringDataOffset);
-                    H5::DataSpace newStringDataspace = H5::DataSpace(2, stringDataDims);
-                    strDataset->write(stringData, *strTypeMem, newStringDataspace, stringWriteDataSpace);
-                    newStringDataspace.close();
-                    stringWriteDataSpace.close();
+                    writeATTRowBlock(*strDataset, *strTypeMem, block.strVals.data(), block.rowOff, block.numRows, this->numStringFields);
                 }
-                                
-                H5::DataSpace neighboursWriteDataSpace = neighboursDataset->getSpace();
-                neighboursWriteDataSpace.selectHyperslab(H5S_SELECT_SET, neighboursDataDims, neighboursDataOffset);
-                H5::DataSpace newNeighboursDataspace = H5::DataSpace(1, neighboursDataDims);
-                neighboursDataset->write(neighbourVals, intVarLenMemDT, newNeighboursDataspace, neighboursWriteDataSpace);
-                newNeighboursDataspace.close();
-                neighboursWriteDataSpace.close();
+                writeATTRowBlock(*neighboursDataset, neighboursMemDT, block.neighbourVals.data(), block.rowOff, block.numRows, 0);
+                block.release();
                 
-                for(size_t i = 0; i < remainRows; ++i)
+                if(pfnProgress != nullptr)
                 {
-                    if(neighbourVals[i].length > 0)
-                    {
-                        neighbourVals[i].length = 0;
-                        delete[] ((size_t*)neighbourVals[i].p);
-                    }
+                    pfnProgress(((double)(n + 1))/numOfBlocks, pProgressData);
                 }
             }
             
@@ -1881,29 +1866,24 @@ namespace kealib{
             
             if(this->numBoolFields > 0)
             {
-                delete[] boolData;
                 boolDataset->close();
                 delete boolDataset;
             }
             if(this->numIntFields > 0)
             {
-                delete[] intData;
                 intDataset->close();
                 delete intDataset;
             }
             if(this->numFloatFields > 0)
             {
-                delete[] floatData;
                 floatDataset->close();
                 delete floatDataset;
             }
             if(this->numStringFields > 0)
             {
-                delete[] stringData;
                 strDataset->close();
                 delete strDataset;
             }
-            delete[] neighbourVals;
             delete[] attSize;
             
             delete strTypeMem;
@@ -1930,7 +1910,7 @@ namespace kealib{
         }
     }
     
-    KEAAttributeTable* KEAAttributeTableInMem::createKeaAtt(H5::H5File *keaImg, unsigned int band)
+    KEAAttributeTable* KEAAttributeTableInMem::createKeaAtt(H5::H5File *keaImg, unsigned int band, KEAATTProgressFunc pfnProgress, void *pProgressData)
     {
         // Create instance of class to populate and return.
         KEAAttributeTableInMem *att = new KEAAttributeTableInMem();
@@ -2245,555 +2225,157 @@ namespace kealib{
                     }
                 }
                 
-                // Reserve space in vector.
-                att->attRows->reserve(attSize[0]);
-                
-                size_t numOfBlocks = 0;
-                numOfBlocks = floor(((double)attSize[0]/chunkSize));
-                size_t remainRows = attSize[0] - (numOfBlocks * chunkSize);
-                
-                KEAATTFeature *feat = nullptr;
-                size_t cFid = 0;
-                size_t rowOff = 0;
+                // The table is read in blocks of rows spanning all of the columns.
+                // While one block is decoded into features on worker threads the
+                // next block is read; HDF5 is only called from this thread as the
+                // library may not have been built threadsafe.
+                if(chunkSize == 0)
+                {
+                    chunkSize = KEA_ATT_CHUNK_SIZE;
+                }
+                size_t numRows = attSize[0];
+                att->attRows->resize(numRows, nullptr);
                 
                 H5::DataSet boolDataset;
-                H5::DataSpace boolDataspace;
-                H5::DataSpace boolFieldsMemspace;
-                int *boolVals = nullptr;
-                hsize_t boolFieldsOffset[2];
-                hsize_t boolFieldsCount[2];
-                hsize_t boolFieldsDimsRead[2];
-                hsize_t boolFieldsOffset_out[2];
-                hsize_t boolFieldsCount_out[2];
                 if(att->numBoolFields > 0)
                 {
                     boolDataset = keaImg->openDataSet( (bandPathBase + KEA_ATT_BOOL_DATA) );
-                    boolDataspace = boolDataset.getSpace();
-                    
-                    int boolNDims = boolDataspace.getSimpleExtentNdims();
-
-                    if(boolNDims != 2)
-                    {
-                        throw KEAIOException("The boolean datasets needs to have 2 dimensions.");
-                    }
-                    
-                    hsize_t *boolDims = new hsize_t[boolNDims];
-                    boolDataspace.getSimpleExtentDims(boolDims);
-                    
-                    if(attSize[0] > boolDims[0])
-                    {
-                        throw KEAIOException("The number of features in boolean dataset is smaller than expected.");
-                    }
-                    
-                    if(att->numBoolFields > boolDims[1])
-                    {
-                        throw KEAIOException("The number of boolean fields is smaller than expected.");
-                    }
-                    delete[] boolDims;
-                    
-                    boolVals = new int[chunkSize*att->numBoolFields];
-                    
-                    boolFieldsOffset[0] = 0;
-                    boolFieldsOffset[1] = 0;
-                    
-                    boolFieldsCount[0] = chunkSize;
-                    boolFieldsCount[1] = att->numBoolFields;
-                    
-                    boolDataspace.selectHyperslab( H5S_SELECT_SET, boolFieldsCount, boolFieldsOffset );
-                    
-                    boolFieldsDimsRead[0] = chunkSize;
-                    boolFieldsDimsRead[1] = att->numBoolFields;
-                    boolFieldsMemspace = H5::DataSpace( 2, boolFieldsDimsRead );
-                    
-                    boolFieldsOffset_out[0] = 0;
-                    boolFieldsOffset_out[1] = 0;
-                    
-                    boolFieldsCount_out[0] = chunkSize;
-                    boolFieldsCount_out[1] = att->numBoolFields;
-                    
-                    boolFieldsMemspace.selectHyperslab( H5S_SELECT_SET, boolFieldsCount_out, boolFieldsOffset_out );
+                    checkATTDataDims(boolDataset, 2, numRows, att->numBoolFields, "boolean");
                 }
                 
                 H5::DataSet intDataset;
-                H5::DataSpace intDataspace;
-                H5::DataSpace intFieldsMemspace;
-                int64_t *intVals = nullptr;
-                hsize_t intFieldsOffset[2];
-                hsize_t intFieldsCount[2];
-                hsize_t intFieldsDimsRead[2];
-                hsize_t intFieldsOffset_out[2];
-                hsize_t intFieldsCount_out[2];
                 if(att->numIntFields > 0)
                 {
                     intDataset = keaImg->openDataSet( (bandPathBase + KEA_ATT_INT_DATA) );
-                    intDataspace = intDataset.getSpace();
-                    
-                    int intNDims = intDataspace.getSimpleExtentNdims();
-                    
-                    if(intNDims != 2)
-                    {
-                        throw KEAIOException("The integer datasets needs to have 2 dimensions.");
-                    }
-                    
-                    hsize_t *intDims = new hsize_t[intNDims];
-                    intDataspace.getSimpleExtentDims(intDims);
-                    
-                    if(attSize[0] > intDims[0])
-                    {
-                        throw KEAIOException("The number of features in integer dataset is smaller than expected.");
-                    }
-                    
-                    if(att->numIntFields > intDims[1])
-                    {
-                        throw KEAIOException("The number of integer fields is smaller than expected.");
-                    }
-                    delete[] intDims;
-                    
-                    intVals = new int64_t[chunkSize*att->numIntFields];
-                    
-                    intFieldsOffset[0] = 0;
-                    intFieldsOffset[1] = 0;
-                    
-                    intFieldsCount[0] = chunkSize;
-                    intFieldsCount[1] = att->numIntFields;
-                    
-                    intDataspace.selectHyperslab( H5S_SELECT_SET, intFieldsCount, intFieldsOffset );
-                    
-                    intFieldsDimsRead[0] = chunkSize;
-                    intFieldsDimsRead[1] = att->numIntFields;
-                    intFieldsMemspace = H5::DataSpace( 2, intFieldsDimsRead );
-                    
-                    intFieldsOffset_out[0] = 0;
-                    intFieldsOffset_out[1] = 0;
-                    
-                    intFieldsCount_out[0] = chunkSize;
-                    intFieldsCount_out[1] = att->numIntFields;
-                    
-                    intFieldsMemspace.selectHyperslab( H5S_SELECT_SET, intFieldsCount_out, intFieldsOffset_out );
+                    checkATTDataDims(intDataset, 2, numRows, att->numIntFields, "integer");
                 }
                 
                 H5::DataSet floatDataset;
-                H5::DataSpace floatDataspace;
-                H5::DataSpace floatFieldsMemspace;
-                double *floatVals = nullptr;
-                hsize_t floatFieldsOffset[2];
-                hsize_t floatFieldsCount[2];
-                hsize_t floatFieldsDimsRead[2];
-                hsize_t floatFieldsOffset_out[2];
-                hsize_t floatFieldsCount_out[2];
                 if(att->numFloatFields > 0)
                 {
                     floatDataset = keaImg->openDataSet( (bandPathBase + KEA_ATT_FLOAT_DATA) );
-                    floatDataspace = floatDataset.getSpace();
-                    
-                    int floatNDims = floatDataspace.getSimpleExtentNdims();
-                    
-                    if(floatNDims != 2)
-                    {
-                        throw KEAIOException("The float datasets needs to have 2 dimensions.");
-                    }
-                    
-                    hsize_t *floatDims = new hsize_t[floatNDims];
-                    floatDataspace.getSimpleExtentDims(floatDims);
-                    
-                    if(attSize[0] > floatDims[0])
-                    {
-                        throw KEAIOException("The number of features in float dataset is smaller than expected.");
-                    }
-                    
-                    if(att->numFloatFields > floatDims[1])
-                    {
-                        throw KEAIOException("The number of float fields is smaller than expected.");
-                    }
-                    delete[] floatDims;
-                    
-                    floatVals = new double[chunkSize*att->numFloatFields];
-                    
-                    floatFieldsOffset[0] = 0;
-                    floatFieldsOffset[1] = 0;
-                    
-                    floatFieldsCount[0] = chunkSize;
-                    floatFieldsCount[1] = att->numFloatFields;
-                    
-                    floatDataspace.selectHyperslab( H5S_SELECT_SET, floatFieldsCount, floatFieldsOffset );
-                    
-                    floatFieldsDimsRead[0] = chunkSize;
-                    floatFieldsDimsRead[1] = att->numFloatFields;
-                    
-                    floatFieldsMemspace = H5::DataSpace( 2, floatFieldsDimsRead );
-                    
-                    floatFieldsOffset_out[0] = 0;
-                    floatFieldsOffset_out[1] = 0;
-                    
-                    floatFieldsCount_out[0] = chunkSize;
-                    floatFieldsCount_out[1] = att->numFloatFields;
-                    
-                    floatFieldsMemspace.selectHyperslab( H5S_SELECT_SET, floatFieldsCount_out, floatFieldsOffset_out );
+                    checkATTDataDims(floatDataset, 2, numRows, att->numFloatFields, "float");
                 }
-
                 
                 H5::DataSet strDataset;
-                H5::DataSpace strDataspace;
-                H5::DataSpace strFieldsMemspace;
-                H5::CompType *strTypeMem = KEAAttributeTable::createKeaStringCompTypeMem();
-                KEAString *stringVals = nullptr;
-                hsize_t strFieldsOffset[2];
-                hsize_t strFieldsCount[2];
-                hsize_t strFieldsDimsRead[2];
-                hsize_t strFieldsOffset_out[2];
-                hsize_t strFieldsCount_out[2];
                 if(att->numStringFields > 0)
                 {
                     strDataset = keaImg->openDataSet( (bandPathBase + KEA_ATT_STRING_DATA) );
-                    strDataspace = strDataset.getSpace();
-                    
-                    int strNDims = strDataspace.getSimpleExtentNdims();
-                    
-                    if(strNDims != 2)
-                    {
-                        throw KEAIOException("The string datasets needs to have 2 dimensions.");
-                    }
-                    
-                    hsize_t *strDims = new hsize_t[strNDims];
-                    strDataspace.getSimpleExtentDims(strDims);
-                    
-                    if(attSize[0] > strDims[0])
-                    {
-                        throw KEAIOException("The number of features in string dataset is smaller than expected.");
-                    }
-                    
-                    if(att->numStringFields > strDims[1])
-                    {
-                        throw KEAIOException("The number of string fields is smaller than expected.");
-                    }
-                    delete[] strDims;
-                    
-                    stringVals = new KEAString[chunkSize*att->numStringFields];
-                    
-                    strFieldsOffset[0] = 0;
-                    strFieldsOffset[1] = 0;
-                    
-                    strFieldsCount[0] = chunkSize;
-                    strFieldsCount[1] = att->numStringFields;
-                    strDataspace.selectHyperslab( H5S_SELECT_SET, strFieldsCount, strFieldsOffset );
-                    
-                    strFieldsDimsRead[0] = chunkSize;
-                    strFieldsDimsRead[1] = att->numStringFields;
-                    strFieldsMemspace = H5::DataSpace( 2, strFieldsDimsRead );
-                    
-                    strFieldsOffset_out[0] = 0;
-                    strFieldsOffset_out[1] = 0;
-                    
-                    strFieldsCount_out[0] = chunkSize;
-                    strFieldsCount_out[1] = att->numStringFields;
-                    
-                    strFieldsMemspace.selectHyperslab( H5S_SELECT_SET, strFieldsCount_out, strFieldsOffset_out );
+                    checkATTDataDims(strDataset, 2, numRows, att->numStringFields, "string");
                 }
                 
                 H5::DataSet neighboursDataset = keaImg->openDataSet( (bandPathBase + KEA_ATT_NEIGHBOURS_DATA) );
-                H5::DataSpace neighboursDataspace = neighboursDataset.getSpace();
+                checkATTDataDims(neighboursDataset, 1, numRows, 0, "neighbours");
                 
-                int neighboursNDims = neighboursDataspace.getSimpleExtentNdims();
-                if(neighboursNDims != 1)
-                {
-                    throw KEAIOException("The neighbours datasets needs to have 1 dimension.");
-                }
-                
-                /* Neighbours */
-                hsize_t *neighboursDims = new hsize_t[neighboursNDims];
-                neighboursDataspace.getSimpleExtentDims(neighboursDims);
-                if(attSize[0] > neighboursDims[0])
-                {
-                    throw KEAIOException("The number of features in neighbours dataset smaller than expected.");
-                }
-                delete[] neighboursDims;
-                
-                VarLenFieldHDF *neighbourVals = new VarLenFieldHDF[chunkSize];
+                H5::CompType *strTypeMem = KEAAttributeTable::createKeaStringCompTypeMem();
                 H5::DataType intVarLenMemDT = H5::VarLenType(&H5::PredType::NATIVE_HSIZE);
-                hsize_t neighboursOffset[1];
-                neighboursOffset[0] = 0;
-                hsize_t neighboursCount[1];
-                neighboursCount[0] = chunkSize;
-                neighboursDataspace.selectHyperslab( H5S_SELECT_SET, neighboursCount, neighboursOffset );
-                
-                hsize_t neighboursDimsRead[1]; 
-                neighboursDimsRead[0] = chunkSize;
-                H5::DataSpace neighboursMemspace( 1, neighboursDimsRead );
+                H5::DSetMemXferPropList xfer;
+                xfer.setVlenMemManager(kealibmalloc, nullptr, kealibfree, nullptr);
                 
-                hsize_t neighboursOffset_out[1];
-                neighboursOffset_out[0] = 0;
-                hsize_t neighboursCount_out[1];
-                neighboursCount_out[0] = chunkSize;
-                neighboursMemspace.selectHyperslab( H5S_SELECT_SET, neighboursCount_out, neighboursOffset_out );
-                                
-                if(numOfBlocks > 0)
-                {                   
-                    for(size_t n = 0; n < numOfBlocks; ++n)
+                auto decodeBlock = [att](KEAATTRowBlock *block)
+                {
+                    parallelForATTRows(block->numRows, [att, block](size_t start, size_t end)
                     {
-                        rowOff = (n*chunkSize);
-                        // Read data.
-                        neighboursOffset[0] = rowOff;
-                        neighboursDataspace.selectHyperslab( H5S_SELECT_SET, neighboursCount, neighboursOffset );
-                        neighboursDataset.read(neighbourVals, intVarLenMemDT, neighboursMemspace, neighboursDataspace);
-                        
-                        if(att->numBoolFields > 0)
-                        {
-                            boolFieldsOffset[0] = rowOff;
-                            boolDataspace.selectHyperslab( H5S_SELECT_SET, boolFieldsCount, boolFieldsOffset );
-                            boolDataset.read(boolVals, H5::PredType::NATIVE_INT, boolFieldsMemspace, boolDataspace);
-                        }
-                        
-                        if(att->numIntFields > 0)
-                        {
-                            intFieldsOffset[0] = rowOff;
-                            intDataspace.selectHyperslab( H5S_SELECT_SET, intFieldsCount, intFieldsOffset );
-                            intDataset.read(intVals, H5::PredType::NATIVE_INT64, intFieldsMemspace, intDataspace);
-                        }
-                        
-                        if(att->numFloatFields > 0)
-                        {
-                            floatFieldsOffset[0] = rowOff;
-                            floatDataspace.selectHyperslab( H5S_SELECT_SET, floatFieldsCount, floatFieldsOffset );
-                            floatDataset.read(floatVals, H5::PredType::NATIVE_DOUBLE, floatFieldsMemspace, floatDataspace);
-                        }
-                        
-                        if(att->numStringFields > 0)
-                        {
-                            strFieldsOffset[0] = rowOff;
-                            strDataspace.selectHyperslab( H5S_SELECT_SET, strFieldsCount, strFieldsOffset );
-                            strDataset.read(stringVals, *strTypeMem, strFieldsMemspace, strDataspace);
-                        }
-                        
-                        // Write data into KEAATTFeatures
-                        for(size_t i = 0; i < chunkSize; ++i)
+                        for(size_t i = start; i < end; ++i)
                         {
-                            feat = att->createKeaFeature();
-                            feat->fid = cFid++;
+                            KEAATTFeature *feat = att->createKeaFeature();
+                            feat->fid = block->rowOff + i;
                             
-                            if(att->numBoolFields > 0)
+                            for(size_t j = 0; j < att->numBoolFields; ++j)
                             {
-                                feat->boolFields->reserve(att->numBoolFields);
-                                for(hsize_t j = 0; j < att->numBoolFields; ++j)
-                                {
-                                    feat->boolFields->at(j) = boolVals[(i*att->numBoolFields)+j];
-                                }
+                                feat->boolFields->at(j) = block->boolVals[(i*att->numBoolFields)+j];
                             }
-                            
-                            if(att->numIntFields > 0)
+                            for(size_t j = 0; j < att->numIntFields; ++j)
                             {
-                                feat->intFields->reserve(att->numIntFields);
-                                for(hsize_t j = 0; j < att->numIntFields; ++j)
-                                {
-                                    feat->intFields->at(j) = intVals[(i*att->numIntFields)+j];
-                                }
+                                feat->intFields->at(j) = block->intVals[(i*att->numIntFields)+j];
                             }
-                            
-                            if(att->numFloatFields > 0)
+                            for(size_t j = 0; j < att->numFloatFields; ++j)
                             {
-                                feat->floatFields->reserve(att->numFloatFields);
-                                for(hsize_t j = 0; j < att->numFloatFields; ++j)
-                                {
-                                    feat->floatFields->at(j) = floatVals[(i*att->numFloatFields)+j];
-                                }
+                                feat->floatFields->at(j) = block->floatVals[(i*att->numFloatFields)+j];
                             }
-                            
-                            if(att->numStringFields > 0)
+                            for(size_t j = 0; j < att->numStringFields; ++j)
                             {
-                                feat->strFields->reserve(att->numStringFields);
-                                for(hsize_t j = 0; j < att->numStringFields; ++j)
+                                const char *str = block->strVals[(i*att->numStringFields)+j].str;
+                                if(str != nullptr)
                                 {
-                                    feat->strFields->at(j) = std::string(stringVals[(i*att->numStringFields)+j].str);
+                                    feat->strFields->at(j) = str;
                                 }
                             }
                             
-                            if(neighbourVals[i].length > 0)
+                            const VarLenFieldHDF &neighbourVal = block->neighbourVals[i];
+                            if(neighbourVal.length > 0)
                             {
-                                feat->neighbours->reserve(neighbourVals[i].length);
-                                for(hsize_t n = 0; n < neighbourVals[i].length; ++n)
-                                {
-                                    feat->neighbours->push_back(((size_t*)neighbourVals[i].p)[n]);
-                                }
-                                delete[] ((size_t*)neighbourVals[i].p);
+                                const hsize_t *neighbours = (const hsize_t*)neighbourVal.p;
+                                feat->neighbours->assign(neighbours, neighbours + neighbourVal.length);
                             }
-                                                        
-                            att->attRows->push_back(feat);
-                        }                        
-                    }
-                }
+                            
+                            (*att->attRows)[block->rowOff + i] = feat;
+                        }
+                    });
+                };
+                
+                size_t blockRows = chunkSize * KEA_ATT_PIPELINE_BLOCK_CHUNKS;
+                size_t numOfBlocks = (numRows + blockRows - 1) / blockRows;
                 
-                if(remainRows > 0)
+                // The future is declared after the blocks so a pending decode
+                // is always waited upon before its buffers are released.
+                KEAATTRowBlock blocks[2];
+                std::future<void> decoded;
+                for(size_t n = 0; n < numOfBlocks; ++n)
                 {
-                    rowOff = (numOfBlocks*chunkSize);
-                    // Read data.
-                    neighboursOffset[0] = rowOff;
-                    neighboursCount[0] = remainRows;
-                    neighboursDataspace.selectHyperslab( H5S_SELECT_SET, neighboursCount, neighboursOffset );
-                    
-                    neighboursDimsRead[0] = remainRows;
-                    neighboursMemspace = H5::DataSpace( 1, neighboursDimsRead );
-                    neighboursDataset.read(neighbourVals, intVarLenMemDT, neighboursMemspace, neighboursDataspace);
+                    KEAATTRowBlock &block = blocks[n % 2];
+                    block.release();
+                    block.ownsStrings = true;
+                    block.rowOff = n * blockRows;
+                    block.numRows = std::min(blockRows, numRows - block.rowOff);
                     
                     if(att->numBoolFields > 0)
                     {
-                        boolFieldsOffset[0] = rowOff;
-                        boolFieldsOffset[1] = 0;
-                        boolFieldsCount[0] = remainRows;
-                        boolFieldsCount[1] = att->numBoolFields;
-                        boolDataspace.selectHyperslab( H5S_SELECT_SET, boolFieldsCount, boolFieldsOffset );
-                        
-                        boolFieldsDimsRead[0] = remainRows;
-                        boolFieldsDimsRead[1] = att->numBoolFields;
-                        boolFieldsMemspace = H5::DataSpace( 2, boolFieldsDimsRead );
-                        
-                        boolFieldsOffset_out[0] = 0;
-                        boolFieldsOffset_out[1] = 0;
-                        boolFieldsCount_out[0] = remainRows;
-                        boolFieldsCount_out[1] = att->numBoolFields;
-                        boolFieldsMemspace.selectHyperslab( H5S_SELECT_SET, boolFieldsCount_out, boolFieldsOffset_out );
-                        
-                        boolDataset.read(boolVals, H5::PredType::NATIVE_INT, boolFieldsMemspace, boolDataspace);
+                        block.boolVals.resize(block.numRows * att->numBoolFields);
+                        readATTRowBlock(boolDataset, H5::PredType::NATIVE_INT, block.boolVals.data(), block.rowOff, block.numRows, att->numBoolFields, xfer);
                     }
-                    
                     if(att->numIntFields > 0)
                     {
-                        intFieldsOffset[0] = rowOff;
-                        intFieldsOffset[1] = 0;
-                        intFieldsCount[0] = remainRows;
-                        intFieldsCount[1] = att->numIntFields;
-                        intDataspace.selectHyperslab( H5S_SELECT_SET, intFieldsCount, intFieldsOffset );
-                        
-                        intFieldsDimsRead[0] = remainRows;
-                        intFieldsDimsRead[1] = att->numIntFields;
-                        intFieldsMemspace = H5::DataSpace( 2, intFieldsDimsRead );
-                        
-                        intFieldsOffset_out[0] = 0;
-                        intFieldsOffset_out[1] = 0;
-                        intFieldsCount_out[0] = remainRows;
-                        intFieldsCount_out[1] = att->numIntFields;
-                        intFieldsMemspace.selectHyperslab( H5S_SELECT_SET, intFieldsCount_out, intFieldsOffset_out );
-
-                        intDataset.read(intVals, H5::PredType::NATIVE_INT64, intFieldsMemspace, intDataspace);
+                        block.intVals.resize(block.numRows * att->numIntFields);
+                        readATTRowBlock(intDataset, H5::PredType::NATIVE_INT64, block.intVals.data(), block.rowOff, block.numRows, att->numIntFields, xfer);
                     }
-                    
                     if(att->numFloatFields > 0)
                     {
-                        floatFieldsOffset[0] = rowOff;
-                        floatFieldsOffset[1] = 0;
-                        floatFieldsCount[0] = remainRows;
-                        floatFieldsCount[1] = att->numFloatFields;
-                        floatDataspace.selectHyperslab( H5S_SELECT_SET, floatFieldsCount, floatFieldsOffset );
-                        
-                        floatFieldsDimsRead[0] = remainRows;
-                        floatFieldsDimsRead[1] = att->numFloatFields;
-                        floatFieldsMemspace = H5::DataSpace( 2, floatFieldsDimsRead );
-                        
-                        floatFieldsOffset_out[0] = 0;
-                        floatFieldsOffset_out[1] = 0;
-                        floatFieldsCount_out[0] = remainRows;
-                        floatFieldsCount_out[1] = att->numFloatFields;
-                        floatFieldsMemspace.selectHyperslab( H5S_SELECT_SET, floatFieldsCount_out, floatFieldsOffset_out );
-                        
-                        floatDataset.read(floatVals, H5::PredType::NATIVE_DOUBLE, floatFieldsMemspace, floatDataspace);
+                        block.floatVals.resize(block.numRows * att->numFloatFields);
+                        readATTRowBlock(floatDataset, H5::PredType::NATIVE_DOUBLE, block.floatVals.data(), block.rowOff, block.numRows, att->numFloatFields, xfer);
                     }
-                    
                     if(att->numStringFields > 0)
                     {
-                        strFieldsOffset[0] = rowOff;
-                        strFieldsOffset[1] = 0;
-                        strFieldsCount[0] = remainRows;
-                        strFieldsCount[1] = att->numStringFields;
-                        strDataspace.selectHyperslab( H5S_SELECT_SET, strFieldsCount, strFieldsOffset );
-                        
-                        strFieldsDimsRead[0] = remainRows;
-                        strFieldsDimsRead[1] = att->numStringFields;
-                        strFieldsMemspace = H5::DataSpace( 2, strFieldsDimsRead );
-                        
-                        strFieldsOffset_out[0] = 0;
-                        strFieldsOffset_out[1] = 0;
-                        strFieldsCount_out[0] = remainRows;
-                        strFieldsCount_out[1] = att->numStringFields;
-                        strFieldsMemspace.selectHyperslab( H5S_SELECT_SET, strFieldsCount_out, strFieldsOffset_out );
-                        
-                        strDataset.read(stringVals, *strTypeMem, strFieldsMemspace, strDataspace);
+                        block.strVals.assign(block.numRows * att->numStringFields, KEAString());
+                        readATTRowBlock(strDataset, *strTypeMem, block.strVals.data(), block.rowOff, block.numRows, att->numStringFields, xfer);
                     }
+                    block.neighbourVals.assign(block.numRows, VarLenFieldHDF());
+                    readATTRowBlock(neighboursDataset, intVarLenMemDT, block.neighbourVals.data(), block.rowOff, block.numRows, 0, xfer);
                     
-                    // Write data into KEAATTFeatures
-                    for(size_t i = 0; i < remainRows; ++i)
+                    if(decoded.valid())
                     {
-                        feat = att->createKeaFeature();
-                        feat->fid = cFid++;
-                        
-                        if(att->numBoolFields > 0)
-                        {
-                            feat->boolFields->reserve(att->numBoolFields);
-                            for(hsize_t j = 0; j < att->numBoolFields; ++j)
-                            {
-                                feat->boolFields->at(j) = boolVals[(i*att->numBoolFields)+j];
-                            }
-                        }
-                        
-                        if(att->numIntFields > 0)
+                        decoded.get();
+                        if(pfnProgress != nullptr)
                         {
-                            feat->intFields->reserve(att->numIntFields);
-                            for(hsize_t j = 0; j < att->numIntFields; ++j)
-                            {
-                                feat->intFields->at(j) = intVals[(i*att->numIntFields)+j];
-                            }
-                        }
-                        
-                        if(att->numFloatFields > 0)
-                        {
-                            feat->floatFields->reserve(att->numFloatFields);
-                            for(hsize_t j = 0; j < att->numFloatFields; ++j)
-                            {
-                                feat->floatFields->at(j) = floatVals[(i*att->numFloatFields)+j];
-                            }
+                            pfnProgress(((double)n)/numOfBlocks, pProgressData);
                         }
-                        
-                        if(att->numStringFields > 0)
-                        {
-                            feat->strFields->reserve(att->numStringFields);
-                            for(hsize_t j = 0; j < att->numStringFields; ++j)
-                            {
-                                feat->strFields->at(j) = std::string(stringVals[(i*att->numStringFields)+j].str);
-                            }
-                        }
-                        
-                        if(neighbourVals[i].length > 0)
-                        {
-                            feat->neighbours->reserve(neighbourVals[i].length);
-                            for(hsize_t n = 0; n < neighbourVals[i].length; ++n)
-                            {
-                                feat->neighbours->push_back(((size_t*)neighbourVals[i].p)[n]);
-                            }
-                            delete[] ((size_t*)neighbourVals[i].p);
-                        }
-                        
-                        att->attRows->push_back(feat);
-                    }    
+                    }
+                    decoded = std::async(std::launch::async, decodeBlock, &block);
+                }
+                if(decoded.valid())
+                {
+                    decoded.get();
+                }
+                if(pfnProgress != nullptr)
+                {
+                    pfnProgress(1.0, pProgressData);
                 }
                 
                 boolDataset.close();
-                boolDataspace.close();
-                boolFieldsMemspace.close();
-                
                 intDataset.close();
-                intDataspace.close();
-                intFieldsMemspace.close();
-                
                 floatDataset.close();
-                floatDataspace.close();
-                floatFieldsMemspace.close();
-                
                 strDataset.close();
-                strDataspace.close();
-                strFieldsMemspace.close();
-                
                 neighboursDataset.close();
-                neighboursDataspace.close();
-                neighboursMemspace.close();
-                
-                delete[] neighbourVals;
                 
                 delete strTypeMem;
             }
@@ -0,0 +1,706 @@
+/*
+ *  KEABandExpression.cpp
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without restriction,
+ *  including without limitation the rights to use, copy, modify,
+ *  merge, publish, distribute, sublicense, and/or sell copies of the
+ *  Software, and to permit persons to whom the Software is furnished
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "libkea/KEABandExpression.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <locale>
+#include <sstream>
+
+namespace kealib{
+
+    enum KEAExprOp
+    {
+        kea_expr_const,
+        kea_expr_band,
+        kea_expr_add,
+        kea_expr_sub,
+        kea_expr_mul,
+        kea_expr_div,
+        kea_expr_neg,
+        kea_expr_lt,
+        kea_expr_le,
+        kea_expr_gt,
+        kea_expr_ge,
+        kea_expr_eq,
+        kea_expr_ne,
+        kea_expr_abs,
+        kea_expr_sqrt,
+        kea_expr_log,
+        kea_expr_exp,
+        kea_expr_min,
+        kea_expr_max,
+        kea_expr_where,
+        kea_expr_normdiff // (a - b) / (a + b) of two bands, as used for NDVI
+    };
+
+    struct KEAExprNode
+    {
+        KEAExprOp op = kea_expr_const;
+        double value = 0;  // of kea_expr_const
+        uint32_t band = 0; // of kea_expr_band
+        size_t input = 0;  // index of band within KEABandExpression::getBands
+        std::unique_ptr<KEAExprNode> args[3];
+    };
+
+    // The functions which may be called and how many arguments they take.
+    struct KEAExprFunction
+    {
+        const char *name;
+        KEAExprOp op;
+        size_t numArgs;
+    };
+    static const KEAExprFunction exprFunctions[] = {
+        {"abs", kea_expr_abs, 1},
+        {"sqrt", kea_expr_sqrt, 1},
+        {"log", kea_expr_log, 1},
+        {"exp", kea_expr_exp, 1},
+        {"min", kea_expr_min, 2},
+        {"max", kea_expr_max, 2},
+        {"where", kea_expr_where, 3}
+    };
+
+    static std::unique_ptr<KEAExprNode> makeExprNode(KEAExprOp op, std::unique_ptr<KEAExprNode> a, std::unique_ptr<KEAExprNode> b=nullptr, std::unique_ptr<KEAExprNode> c=nullptr)
+    {
+        std::unique_ptr<KEAExprNode> node(new KEAExprNode());
+        node->op = op;
+        node->args[0] = std::move(a);
+        node->args[1] = std::move(b);
+        node->args[2] = std::move(c);
+        return node;
+    }
+
+    static bool isBandNode(const KEAExprNode *node, uint32_t band)
+    {
+        return (node->op == kea_expr_band) && (node->band == band);
+    }
+
+    // Recursive descent over comparisons, then + and -, then * and /,
+    // then unary - and finally numbers, bands, calls and parentheses.
+    class KEAExprParser
+    {
+    public:
+        explicit KEAExprParser(const std::string &textIn) : text(textIn), pos(0)
+        {
+        }
+
+        std::unique_ptr<KEAExprNode> parse()
+        {
+            std::unique_ptr<KEAExprNode> node = this->parseComparison();
+            this->skipSpace();
+            if(this->pos < this->text.size())
+            {
+                this->fail("unexpected \'" + this->text.substr(this->pos, 1) + "\'");
+            }
+            return node;
+        }
+
+    private:
+        const std::string &text;
+        size_t pos;
+
+        void fail(const std::string &reason)
+        {
+            throw KEAIOException("Could not parse the expression \'" + this->text + "\' at character " + sizet2Str(this->pos + 1) + ": " + reason + ".");
+        }
+
+        void skipSpace()
+        {
+            while((this->pos < this->text.size()) && isspace((unsigned char)this->text[this->pos]))
+            {
+                ++this->pos;
+            }
+        }
+
+        bool accept(const char *token)
+        {
+            this->skipSpace();
+            if(this->text.compare(this->pos, strlen(token), token) == 0)
+            {
+                this->pos += strlen(token);
+                return true;
+            }
+            return false;
+        }
+
+        std::unique_ptr<KEAExprNode> parseComparison()
+        {
+            std::unique_ptr<KEAExprNode> node = this->parseAdditive();
+            while(true)
+            {
+                KEAExprOp op;
+                if(this->accept("<="))
+                    op = kea_expr_le;
+                else if(this->accept(">="))
+                    op = kea_expr_ge;
+                else if(this->accept("=="))
+                    op = kea_expr_eq;
+                else if(this->accept("!="))
+                    op = kea_expr_ne;
+                else if(this->accept("<"))
+                    op = kea_expr_lt;
+                else if(this->accept(">"))
+                    op = kea_expr_gt;
+                else
+                    return node;
+                node = makeExprNode(op, std::move(node), this->parseAdditive());
+            }
+        }
+
+        std::unique_ptr<KEAExprNode> parseAdditive()
+        {
+            std::unique_ptr<KEAExprNode> node = this->parseTerm();
+            while(true)
+            {
+                if(this->accept("+"))
+                    node = makeExprNode(kea_expr_add, std::move(node), this->parseTerm());
+                else if(this->accept("-"))
+                    node = makeExprNode(kea_expr_sub, std::move(node), this->parseTerm());
+                else
+                    return node;
+            }
+        }
+
+        std::unique_ptr<KEAExprNode> parseTerm()
+        {
+            std::unique_ptr<KEAExprNode> node = this->parseUnary();
+            while(true)
+            {
+                if(this->accept("*"))
+                {
+                    node = makeExprNode(kea_expr_mul, std::move(node), this->parseUnary());
+                }
+                else if(this->accept("/"))
+                {
+                    node = makeExprNode(kea_expr_div, std::move(node), this->parseUnary());
+                    // (bA - bB) / (bA + bB) has a kernel of its own
+                    const KEAExprNode *num = node->args[0].get();
+                    const KEAExprNode *den = node->args[1].get();
+                    if((num->op == kea_expr_sub) && (num->args[0]->op == kea_expr_band) && (num->args[1]->op == kea_expr_band) && (den->op == kea_expr_add) &&
+                       ((isBandNode(den->args[0].get(), num->args[0]->band) && isBandNode(den->args[1].get(), num->args[1]->band)) ||
+                        (isBandNode(den->args[0].get(), num->args[1]->band) && isBandNode(den->args[1].get(), num->args[0]->band))))
+                    {
+                        std::unique_ptr<KEAExprNode> sub = std::move(node->args[0]);
+                        node = makeExprNode(kea_expr_normdiff, std::move(sub->args[0]), std::move(sub->args[1]));
+                    }
+                }
+                else
+                {
+                    return node;
+                }
+            }
+        }
+
+        std::unique_ptr<KEAExprNode> parseUnary()
+        {
+            if(this->accept("-"))
+            {
+                return makeExprNode(kea_expr_neg, this->parseUnary());
+            }
+            if(this->accept("+"))
+            {
+                return this->parseUnary();
+            }
+            return this->parsePrimary();
+        }
+
+        std::unique_ptr<KEAExprNode> parsePrimary()
+        {
+            this->skipSpace();
+            if(this->pos >= this->text.size())
+            {
+                this->fail("the expression ended early");
+            }
+
+            if(this->accept("("))
+            {
+                std::unique_ptr<KEAExprNode> node = this->parseComparison();
+                if(!this->accept(")"))
+                {
+                    this->fail("\')\' expected");
+                }
+                return node;
+            }
+
+            char first = this->text[this->pos];
+            if(isdigit((unsigned char)first) || (first == '.'))
+            {
+                return this->parseNumber();
+            }
+            if(!isalpha((unsigned char)first))
+            {
+                this->fail("unexpected \'" + this->text.substr(this->pos, 1) + "\'");
+            }
+
+            size_t start = this->pos;
+            while((this->pos < this->text.size()) && (isalnum((unsigned char)this->text[this->pos]) || (this->text[this->pos] == '_')))
+            {
+                ++this->pos;
+            }
+            std::string name = this->text.substr(start, this->pos - start);
+
+            // bands are b (or B) followed by their number
+            if(((name[0] == 'b') || (name[0] == 'B')) && (name.size() > 1) &&
+               (name.find_first_not_of("0123456789", 1) == std::string::npos))
+            {
+                std::istringstream bandStr(name.substr(1));
+                uint64_t band = 0;
+                bandStr >> band;
+                if((band == 0) || (band > std::numeric_limits<uint32_t>::max()))
+                {
+                    this->pos = start;
+                    this->fail("bands are numbered from 1");
+                }
+                std::unique_ptr<KEAExprNode> node(new KEAExprNode());
+                node->op = kea_expr_band;
+                node->band = (uint32_t)band;
+                return node;
+            }
+
+            std::string lowerName = name;
+            std::transform(lowerName.begin(), lowerName.end(), lowerName.begin(), [](unsigned char c) { return (char)tolower(c); });
+            for(const KEAExprFunction &function : exprFunctions)
+            {
+                if(lowerName != function.name)
+                {
+                    continue;
+                }
+                if(!this->accept("("))
+                {
+                    this->fail("\'(\' expected after " + name);
+                }
+                std::unique_ptr<KEAExprNode> args[3];
+                for(size_t i = 0; i < function.numArgs; ++i)
+                {
+                    if((i > 0) && !this->accept(","))
+                    {
+                        this->fail(name + " takes " + sizet2Str(function.numArgs) + " arguments");
+                    }
+                    args[i] = this->parseComparison();
+                }
+                if(!this->accept(")"))
+                {
+                    this->fail("\')\' expected");
+                }
+                return makeExprNode(function.op, std::move(args[0]), std::move(args[1]), std::move(args[2]));
+            }
+
+            this->pos = start;
+            this->fail("unknown name \'" + name + "\'");
+            return nullptr;
+        }
+
+        std::unique_ptr<KEAExprNode> parseNumber()
+        {
+            size_t start = this->pos;
+            while((this->pos < this->text.size()) && (isdigit((unsigned char)this->text[this->pos]) || (this->text[this->pos] == '.')))
+            {
+                ++this->pos;
+            }
+            if((this->pos < this->text.size()) && ((this->text[this->pos] == 'e') || (this->text[this->pos] == 'E')))
+            {
+                ++this->pos;
+                if((this->pos < this->text.size()) && ((this->text[this->pos] == '+') || (this->text[this->pos] == '-')))
+                {
+                    ++this->pos;
+                }
+                while((this->pos < this->text.size()) && isdigit((unsigned char)this->text[this->pos]))
+                {
+                    ++this->pos;
+                }
+            }
+
+            // not affected by the locale, unlike strtod
+            std::istringstream numberStr(this->text.substr(start, this->pos - start));
+            numberStr.imbue(std::locale::classic());
+            double value = 0;
+            numberStr >> value;
+            if(numberStr.fail() || !numberStr.eof())
+            {
+                this->pos = start;
+                this->fail("invalid number");
+            }
+            std::unique_ptr<KEAExprNode> node(new KEAExprNode());
+            node->op = kea_expr_const;
+            node->value = value;
+            return node;
+        }
+    };
+
+    static void collectBands(const KEAExprNode *node, std::vector<uint32_t> *bands)
+    {
+        if(node->op == kea_expr_band)
+        {
+            bands->push_back(node->band);
+        }
+        for(const std::unique_ptr<KEAExprNode> &arg : node->args)
+        {
+            if(arg)
+            {
+                collectBands(arg.get(), bands);
+            }
+        }
+    }
+
+    static void setBandInputs(KEAExprNode *node, const std::vector<uint32_t> &bands)
+    {
+        if(node->op == kea_expr_band)
+        {
+            node->input = std::lower_bound(bands.begin(), bands.end(), node->band) - bands.begin();
+        }
+        for(std::unique_ptr<KEAExprNode> &arg : node->args)
+        {
+            if(arg)
+            {
+                setBandInputs(arg.get(), bands);
+            }
+        }
+    }
+
+    static void renumberNode(KEAExprNode *node, const std::function<uint32_t(uint32_t)> &renumber)
+    {
+        if(node->op == kea_expr_band)
+        {
+            node->band = renumber(node->band);
+        }
+        for(std::unique_ptr<KEAExprNode> &arg : node->args)
+        {
+            if(arg)
+            {
+                renumberNode(arg.get(), renumber);
+            }
+        }
+    }
+
+    static std::string nodeToString(const KEAExprNode *node)
+    {
+        static const char *binaryOps[] = {"+", "-", "*", "/"};
+        static const char *compareOps[] = {"<", "<=", ">", ">=", "==", "!="};
+        switch(node->op)
+        {
+            case kea_expr_const:
+            {
+                // as few digits as will read back the same
+                std::ostringstream valueStr;
+                valueStr.imbue(std::locale::classic());
+                valueStr.precision(15);
+                valueStr << node->value;
+                std::istringstream check(valueStr.str());
+                check.imbue(std::locale::classic());
+                double checkValue = 0;
+                check >> checkValue;
+                if(checkValue != node->value)
+                {
+                    valueStr.str("");
+                    valueStr.precision(std::numeric_limits<double>::max_digits10);
+                    valueStr << node->value;
+                }
+                return valueStr.str();
+            }
+            case kea_expr_band:
+                return "b" + uint2Str(node->band);
+            case kea_expr_add:
+            case kea_expr_sub:
+            case kea_expr_mul:
+            case kea_expr_div:
+                return "(" + nodeToString(node->args[0].get()) + " " + binaryOps[node->op - kea_expr_add] + " " + nodeToString(node->args[1].get()) + ")";
+            case kea_expr_lt:
+            case kea_expr_le:
+            case kea_expr_gt:
+            case kea_expr_ge:
+            case kea_expr_eq:
+            case kea_expr_ne:
+                return "(" + nodeToString(node->args[0].get()) + " " + compareOps[node->op - kea_expr_lt] + " " + nodeToString(node->args[1].get()) + ")";
+            case kea_expr_neg:
+                return "(-" + nodeToString(node->args[0].get()) + ")";
+            case kea_expr_normdiff:
+            {
+                std::string a = nodeToString(node->args[0].get());
+                std::string b = nodeToString(node->args[1].get());
+                return "((" + a + " - " + b + ") / (" + a + " + " + b + "))";
+            }
+            default:
+                break;
+        }
+
+        std::string str;
+        for(const KEAExprFunction &function : exprFunctions)
+        {
+            if(function.op == node->op)
+            {
+                str = std::string(function.name) + "(";
+                for(size_t i = 0; i < function.numArgs; ++i)
+                {
+                    str += ((i > 0) ? ", " : "") + nodeToString(node->args[i].get());
+                }
+                str += ")";
+            }
+        }
+        return str;
+    }
+
+    // The values of a node for the pixels being evaluated, either one for
+    // each pixel or, where they are all the same, just value.
+    struct KEAExprValues
+    {
+        const double *vals;
+        double value;
+    };
+
+    struct KEAExprAdd { static double apply(double a, double b) { return a + b; } };
+    struct KEAExprSub { static double apply(double a, double b) { return a - b; } };
+    struct KEAExprMul { static double apply(double a, double b) { return a * b; } };
+    struct KEAExprDiv { static double apply(double a, double b) { return a / b; } };
+    struct KEAExprLess { static double apply(double a, double b) { return (a < b) ? 1.0 : 0.0; } };
+    struct KEAExprLessEq { static double apply(double a, double b) { return (a <= b) ? 1.0 : 0.0; } };
+    struct KEAExprGreater { static double apply(double a, double b) { return (a > b) ? 1.0 : 0.0; } };
+    struct KEAExprGreaterEq { static double apply(double a, double b) { return (a >= b) ? 1.0 : 0.0; } };
+    struct KEAExprEqual { static double apply(double a, double b) { return (a == b) ? 1.0 : 0.0; } };
+    struct KEAExprNotEqual { static double apply(double a, double b) { return (a != b) ? 1.0 : 0.0; } };
+    struct KEAExprMin { static double apply(double a, double b) { return (b < a) ? b : a; } };
+    struct KEAExprMax { static double apply(double a, double b) { return (a < b) ? b : a; } };
+    struct KEAExprNormDiff { static double apply(double a, double b) { return (a - b) / (a + b); } };
+    struct KEAExprNeg { static double apply(double a) { return -a; } };
+    struct KEAExprAbs { static double apply(double a) { return std::fabs(a); } };
+    struct KEAExprSqrt { static double apply(double a) { return std::sqrt(a); } };
+    struct KEAExprLog { static double apply(double a) { return std::log(a); } };
+    struct KEAExprExp { static double apply(double a) { return std::exp(a); } };
+
+    // Applies Op to each pixel into buf (which a may already be within),
+    // with a loop for each combination of varying operands so that they
+    // are simple enough to be vectorised.
+    template<typename Op>
+    static KEAExprValues applyBinary(const KEAExprValues &a, const KEAExprValues &b, size_t n, std::vector<double> *buf)
+    {
+        if((a.vals == nullptr) && (b.vals == nullptr))
+        {
+            return {nullptr, Op::apply(a.value, b.value)};
+        }
+        buf->resize(n);
+        double *out = buf->data();
+        if((a.vals != nullptr) && (b.vals != nullptr))
+        {
+            const double *aVals = a.vals;
+            const double *bVals = b.vals;
+            for(size_t i = 0; i < n; ++i)
+            {
+                out[i] = Op::apply(aVals[i], bVals[i]);
+            }
+        }
+        else if(a.vals != nullptr)
+        {
+            const double *aVals = a.vals;
+            const double bValue = b.value;
+            for(size_t i = 0; i < n; ++i)
+            {
+                out[i] = Op::apply(aVals[i], bValue);
+            }
+        }
+        else
+        {
+            const double aValue = a.value;
+            const double *bVals = b.vals;
+            for(size_t i = 0; i < n; ++i)
+            {
+                out[i] = Op::apply(aValue, bVals[i]);
+            }
+        }
+        return {out, 0};
+    }
+
+    template<typename Op>
+    static KEAExprValues applyUnary(const KEAExprValues &a, size_t n, std::vector<double> *buf)
+    {
+        if(a.vals == nullptr)
+        {
+            return {nullptr, Op::apply(a.value)};
+        }
+        buf->resize(n);
+        double *out = buf->data();
+        const double *aVals = a.vals;
+        for(size_t i = 0; i < n; ++i)
+        {
+            out[i] = Op::apply(aVals[i]);
+        }
+        return {out, 0};
+    }
+
+    static KEAExprValues applyWhere(const KEAExprValues &cond, const KEAExprValues &a, const KEAExprValues &b, size_t n, std::vector<double> *buf)
+    {
+        if(cond.vals == nullptr)
+        {
+            // a and b may be in buffers which are about to be released
+            const KEAExprValues &chosen = (cond.value != 0) ? a : b;
+            if(chosen.vals == nullptr)
+            {
+                return chosen;
+            }
+            buf->assign(chosen.vals, chosen.vals + n);
+            return {buf->data(), 0};
+        }
+        buf->resize(n);
+        double *out = buf->data();
+        for(size_t i = 0; i < n; ++i)
+        {
+            out[i] = (cond.vals[i] != 0) ? ((a.vals != nullptr) ? a.vals[i] : a.value) : ((b.vals != nullptr) ? b.vals[i] : b.value);
+        }
+        return {out, 0};
+    }
+
+    // The first argument is worked out within buf, where the result then
+    // replaces it, and any others in buffers of their own.
+    static KEAExprValues evaluateNode(const KEAExprNode *node, const std::vector<const double*> &inputs, size_t n, std::vector<double> *buf)
+    {
+        if(node->op == kea_expr_const)
+        {
+            return {nullptr, node->value};
+        }
+        if(node->op == kea_expr_band)
+        {
+            return {inputs[node->input], 0};
+        }
+
+        KEAExprValues a = evaluateNode(node->args[0].get(), inputs, n, buf);
+        std::vector<double> bufB;
+        std::vector<double> bufC;
+        KEAExprValues b = {nullptr, 0};
+        KEAExprValues c = {nullptr, 0};
+        if(node->args[1])
+        {
+            b = evaluateNode(node->args[1].get(), inputs, n, &bufB);
+        }
+        if(node->args[2])
+        {
+            c = evaluateNode(node->args[2].get(), inputs, n, &bufC);
+        }
+
+        switch(node->op)
+        {
+            case kea_expr_add:
+                return applyBinary<KEAExprAdd>(a, b, n, buf);
+            case kea_expr_sub:
+                return applyBinary<KEAExprSub>(a, b, n, buf);
+            case kea_expr_mul:
+                return applyBinary<KEAExprMul>(a, b, n, buf);
+            case kea_expr_div:
+                return applyBinary<KEAExprDiv>(a, b, n, buf);
+            case kea_expr_lt:
+                return applyBinary<KEAExprLess>(a, b, n, buf);
+            case kea_expr_le:
+                return applyBinary<KEAExprLessEq>(a, b, n, buf);
+            case kea_expr_gt:
+                return applyBinary<KEAExprGreater>(a, b, n, buf);
+            case kea_expr_ge:
+                return applyBinary<KEAExprGreaterEq>(a, b, n, buf);
+            case kea_expr_eq:
+                return applyBinary<KEAExprEqual>(a, b, n, buf);
+            case kea_expr_ne:
+                return applyBinary<KEAExprNotEqual>(a, b, n, buf);
+            case kea_expr_min:
+                return applyBinary<KEAExprMin>(a, b, n, buf);
+            case kea_expr_max:
+                return applyBinary<KEAExprMax>(a, b, n, buf);
+            case kea_expr_normdiff:
+                return applyBinary<KEAExprNormDiff>(a, b, n, buf);
+            case kea_expr_neg:
+                return applyUnary<KEAExprNeg>(a, n, buf);
+            case kea_expr_abs:
+                return applyUnary<KEAExprAbs>(a, n, buf);
+            case kea_expr_sqrt:
+                return applyUnary<KEAExprSqrt>(a, n, buf);
+            case kea_expr_log:
+                return applyUnary<KEAExprLog>(a, n, buf);
+            case kea_expr_exp:
+                return applyUnary<KEAExprExp>(a, n, buf);
+            case kea_expr_where:
+                return applyWhere(a, b, c, n, buf);
+            default:
+                throw KEAIOException("The expression could not be evaluated.");
+        }
+    }
+
+    KEABandExpression::KEABandExpression(const std::string &expression)
+    {
+        KEAExprParser parser(expression);
+        this->root = parser.parse();
+        this->renumberBands([](uint32_t band) { return band; });
+    }
+
+    std::string KEABandExpression::toString() const
+    {
+        return nodeToString(this->root.get());
+    }
+
+    const std::vector<uint32_t>& KEABandExpression::getBands() const
+    {
+        return this->bands;
+    }
+
+    bool KEABandExpression::usesBand(uint32_t band) const
+    {
+        return std::binary_search(this->bands.begin(), this->bands.end(), band);
+    }
+
+    void KEABandExpression::renumberBands(const std::function<uint32_t(uint32_t)> &renumber)
+    {
+        renumberNode(this->root.get(), renumber);
+        this->bands.clear();
+        collectBands(this->root.get(), &this->bands);
+        std::sort(this->bands.begin(), this->bands.end());
+        this->bands.erase(std::unique(this->bands.begin(), this->bands.end()), this->bands.end());
+        setBandInputs(this->root.get(), this->bands);
+    }
+
+    void KEABandExpression::evaluate(const std::vector<const double*> &inputs, size_t n, double *out) const
+    {
+        if(inputs.size() < this->bands.size())
+        {
+            throw KEAIOException("Values are needed for each of the bands used by the expression.");
+        }
+        std::vector<double> buf;
+        KEAExprValues result = evaluateNode(this->root.get(), inputs, n, &buf);
+        if(result.vals == nullptr)
+        {
+            std::fill(out, out + n, result.value);
+        }
+        else
+        {
+            std::copy(result.vals, result.vals + n, out);
+        }
+    }
+
+    KEABandExpression::~KEABandExpression()
+    {
+    }
+
+}
@@ -29,9 +29,35 @@
  */
 
 #include "libkea/KEAImageIO.h"
+#include "libkea/KEABandExpression.h"
 
 #include <string.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+
+#ifdef KEA_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+// reading and writing stored chunks directly is needed for concurrent access
+#if H5_VERSION_GE(1,10,3)
+#define KEA_HAVE_DIRECT_CHUNK_IO
+#endif
 
 namespace kealib{
 
@@ -45,9 +71,470 @@ namespace kealib{
         free(ptr);
     }
 
+    void runOnThreads(uint64_t numItems, unsigned int numThreads, const std::function<void(uint64_t, uint64_t, unsigned int)> &func)
+    {
+        if(numThreads == 0)
+        {
+            numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+        numThreads = (unsigned int)std::max<uint64_t>(std::min<uint64_t>(numThreads, numItems), 1);
+        uint64_t itemsPerThread = (numItems + numThreads - 1) / numThreads;
+        std::vector<std::future<void> > tasks;
+        for(unsigned int t = 1; t < numThreads; ++t)
+        {
+            uint64_t start = std::min(t * itemsPerThread, numItems);
+            uint64_t end = std::min(start + itemsPerThread, numItems);
+            tasks.push_back(std::async(std::launch::async, func, start, end, t));
+        }
+        func(0, std::min(itemsPerThread, numItems), 0);
+        for(std::future<void> &task : tasks)
+        {
+            task.get();
+        }
+    }
+    
+    // Writes vals to the named column of att, creating it as an integer
+    // column if required.
+    static void writeATTColumn(KEAAttributeTable *att, const std::string &name, const std::string &usage, std::vector<int64_t> &vals)
+    {
+        if(!att->hasField(name))
+        {
+            att->addAttIntField(name, 0, usage);
+        }
+        
+        KEAATTField field = att->getField(name);
+        if(field.dataType == kea_att_int)
+        {
+            att->setIntFields(0, vals.size(), field.idx, vals.data());
+        }
+        else if(field.dataType == kea_att_float)
+        {
+            std::vector<double> floatVals(vals.begin(), vals.end());
+            att->setFloatFields(0, floatVals.size(), field.idx, floatVals.data());
+        }
+        else
+        {
+            throw KEAATTException("The column \'" + name + "\' is not numeric.");
+        }
+    }
+
+    // Reads rows [start, start+len) of a numeric (or boolean) column as
+    // doubles.
+    static void readATTColumn(const KEAAttributeTable *att, const KEAATTField &field, size_t start, size_t len, std::vector<double> *vals)
+    {
+        vals->resize(len);
+        if(len == 0)
+        {
+            return;
+        }
+        if(field.dataType == kea_att_float)
+        {
+            att->getFloatFields(start, len, field.idx, vals->data());
+        }
+        else if(field.dataType == kea_att_int)
+        {
+            std::vector<int64_t> intVals(len);
+            att->getIntFields(start, len, field.idx, intVals.data());
+            std::copy(intVals.begin(), intVals.end(), vals->begin());
+        }
+        else if(field.dataType == kea_att_bool)
+        {
+            std::unique_ptr<bool[]> boolVals(new bool[len]);
+            att->getBoolFields(start, len, field.idx, boolVals.get());
+            for(size_t i = 0; i < len; ++i)
+            {
+                (*vals)[i] = boolVals[i]?1:0;
+            }
+        }
+        else
+        {
+            throw KEAATTException("The column \'" + field.name + "\' is not numeric.");
+        }
+    }
+    
+    // Builds the relabel mapping which numbers the used labels consecutively
+    // from 0, in order and skipping no data, dropping all others. No data
+    // keeps its value, and its row if that is within the new range.
+    static void buildCompactMapping(const std::vector<bool> &used, bool noDataDefined, uint64_t noDataVal, std::vector<uint64_t> *mapping)
+    {
+        mapping->assign(used.size(), KEA_RELABEL_DROP);
+        uint64_t nextLabel = 0;
+        for(uint64_t label = 0; label < used.size(); ++label)
+        {
+            if(used[label] && !(noDataDefined && (label == noDataVal)))
+            {
+                if(noDataDefined && (nextLabel == noDataVal))
+                {
+                    ++nextLabel;
+                }
+                (*mapping)[label] = nextLabel++;
+            }
+        }
+        if(noDataDefined && (noDataVal < used.size()) && (noDataVal < nextLabel))
+        {
+            (*mapping)[noDataVal] = noDataVal;
+        }
+    }
+    
+    // Moves each value of an attribute table column from its old row to
+    // mapping[row] (rows beyond mapping are unchanged), srcRows giving the
+    // old row used for each new row. The column is rewritten a block of new
+    // rows at a time through readBlock/writeBlock. Old rows are read before
+    // the block holding them is rewritten, so only the values moving to a
+    // later block are held until it is reached.
+    template<typename T, typename ReadFunc, typename WriteFunc>
+    static void permuteATTColumn(const std::vector<uint64_t> &mapping, const std::vector<uint64_t> &srcRows, size_t oldSize, ReadFunc readBlock, WriteFunc writeBlock)
+    {
+        size_t blockRows = KEA_ATT_CHUNK_SIZE * KEA_ATT_PIPELINE_BLOCK_CHUNKS;
+        size_t newSize = srcRows.size();
+        std::unordered_map<size_t, T> heldVals;
+        std::vector<T> newVals;
+        std::vector<T> oldVals;
+        std::vector<size_t> readRows;
+        for(size_t start = 0; start < newSize; start += blockRows)
+        {
+            size_t end = std::min(start + blockRows, newSize);
+            newVals.assign(end - start, T());
+            
+            // the old rows needed which are still in the table: the sources
+            // of this block not yet overwritten and those of this block
+            // moving to a later one.
+            readRows.clear();
+            for(size_t newRow = start; newRow < end; ++newRow)
+            {
+                uint64_t row = srcRows[newRow];
+                if(row == KEA_RELABEL_DROP)
+                {
+                    continue;
+                }
+                if(row >= start)
+                {
+                    readRows.push_back(row);
+                }
+                else
+                {
+                    auto held = heldVals.find(newRow);
+                    if(held != heldVals.end())
+                    {
+                        newVals[newRow - start] = std::move(held->second);
+                        heldVals.erase(held);
+                    }
+                }
+            }
+            for(size_t row = start; row < std::min(end, oldSize); ++row)
+            {
+                uint64_t newRow = (row < mapping.size())?mapping[row]:row;
+                if((newRow != KEA_RELABEL_DROP) && (newRow >= end) && (srcRows[newRow] == row))
+                {
+                    readRows.push_back(row);
+                }
+            }
+            std::sort(readRows.begin(), readRows.end());
+            
+            for(size_t i = 0; i < readRows.size();)
+            {
+                size_t readStart = readRows[i];
+                size_t j = i;
+                while((j < readRows.size()) && ((readRows[j] - readStart) < blockRows))
+                {
+                    ++j;
+                }
+                size_t len = (readRows[j - 1] - readStart) + 1;
+                oldVals.resize(len);
+                readBlock(readStart, len, oldVals.data());
+                for(; i < j; ++i)
+                {
+                    size_t row = readRows[i];
+                    uint64_t newRow = (row < mapping.size())?mapping[row]:row;
+                    T &dest = (newRow < end) ? newVals[newRow - start] : heldVals[newRow];
+                    dest = std::move(oldVals[row - readStart]);
+                }
+            }
+            
+            writeBlock(start, end - start, newVals.data());
+        }
+    }
+
+    // Calls func with a null pointer to the C++ type of dataType.
+    template<typename Func>
+    static void dispatchDataType(KEADataType dataType, Func func)
+    {
+        switch(dataType)
+        {
+            case kea_8int:
+                func((int8_t*)nullptr);
+                break;
+            case kea_16int:
+                func((int16_t*)nullptr);
+                break;
+            case kea_32int:
+                func((int32_t*)nullptr);
+                break;
+            case kea_64int:
+                func((int64_t*)nullptr);
+                break;
+            case kea_8uint:
+                func((uint8_t*)nullptr);
+                break;
+            case kea_16uint:
+                func((uint16_t*)nullptr);
+                break;
+            case kea_32uint:
+                func((uint32_t*)nullptr);
+                break;
+            case kea_64uint:
+                func((uint64_t*)nullptr);
+                break;
+            case kea_32float:
+                func((float*)nullptr);
+                break;
+            case kea_64float:
+                func((double*)nullptr);
+                break;
+            default:
+                throw KEAIOException("The data type is not supported.");
+        }
+    }
+    
+    template<typename T>
+    static void pixelsToDoubles(const void *in, size_t n, double *out)
+    {
+        const T *vals = (const T*)in;
+        for(size_t i = 0; i < n; ++i)
+        {
+            out[i] = (double)vals[i];
+        }
+    }
+    
+    // Converts doubles to pixels of type T as HDF5 would, clamping them to
+    // the range of integer types with nan becoming 0.
+    template<typename T>
+    static typename std::enable_if<std::is_integral<T>::value>::type doublesToPixels(const double *in, size_t n, void *out)
+    {
+        const double lowest = (double)std::numeric_limits<T>::lowest();
+        const double highest = (double)std::numeric_limits<T>::max();
+        T *vals = (T*)out;
+        for(size_t i = 0; i < n; ++i)
+        {
+            double val = in[i];
+            vals[i] = std::isnan(val) ? 0 : (val <= lowest) ? std::numeric_limits<T>::lowest() : (val >= highest) ? std::numeric_limits<T>::max() : (T)val;
+        }
+    }
+    
+    template<typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type doublesToPixels(const double *in, size_t n, void *out)
+    {
+        T *vals = (T*)out;
+        for(size_t i = 0; i < n; ++i)
+        {
+            vals[i] = (T)in[i];
+        }
+    }
+    
+    // The counters behind KEAImageIO::getIOStats for a band (or the image
+    // as a whole), updated from any thread.
+    struct KEAIOCounters
+    {
+        std::atomic<uint64_t> bytesRead{0};
+        std::atomic<uint64_t> rawBytesRead{0};
+        std::atomic<uint64_t> bytesWritten{0};
+        std::atomic<uint64_t> rawBytesWritten{0};
+        std::atomic<uint64_t> chunksDecoded{0};
+        std::atomic<uint64_t> chunksEncoded{0};
+        std::atomic<uint64_t> cacheHits{0};
+        std::atomic<uint64_t> cacheMisses{0};
+        std::atomic<uint64_t> decodeNanos{0};
+        std::atomic<uint64_t> encodeNanos{0};
+        std::atomic<uint64_t> hdf5Nanos{0};
+        std::atomic<uint64_t> datasetOpens{0};
+        std::atomic<uint64_t> fileOpens{0};
+        
+        void addTo(KEAIOStats *stats) const
+        {
+            stats->bytesRead += bytesRead;
+            stats->rawBytesRead += rawBytesRead;
+            stats->bytesWritten += bytesWritten;
+            stats->rawBytesWritten += rawBytesWritten;
+            stats->chunksDecoded += chunksDecoded;
+            stats->chunksEncoded += chunksEncoded;
+            stats->cacheHits += cacheHits;
+            stats->cacheMisses += cacheMisses;
+            stats->decodeNanos += decodeNanos;
+            stats->encodeNanos += encodeNanos;
+            stats->hdf5Nanos += hdf5Nanos;
+            stats->datasetOpens += datasetOpens;
+            stats->fileOpens += fileOpens;
+        }
+        
+        void reset()
+        {
+            bytesRead = 0;
+            rawBytesRead = 0;
+            bytesWritten = 0;
+            rawBytesWritten = 0;
+            chunksDecoded = 0;
+            chunksEncoded = 0;
+            cacheHits = 0;
+            cacheMisses = 0;
+            decodeNanos = 0;
+            encodeNanos = 0;
+            hdf5Nanos = 0;
+            datasetOpens = 0;
+            fileOpens = 0;
+        }
+    };
+    
+    // Adds the time from when it is made until it is destroyed (or stop is
+    // called) to a counter of nanoseconds.
+    class KEAIOTimer
+    {
+    public:
+        explicit KEAIOTimer(std::atomic<uint64_t> &nanosIn) : nanos(&nanosIn), start(std::chrono::steady_clock::now())
+        {
+        }
+        
+        ~KEAIOTimer()
+        {
+            this->stop();
+        }
+        
+        void stop()
+        {
+            if(this->nanos != nullptr)
+            {
+                *this->nanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count();
+                this->nanos = nullptr;
+            }
+        }
+        
+    private:
+        std::atomic<uint64_t> *nanos;
+        std::chrono::steady_clock::time_point start;
+    };
+    
+    // Chunks decoded ahead of time by the prefetch thread, waiting to be
+    // used by readImageBlock2BandConcurrent, and the windows still to do.
+    struct KEAPrefetchCache
+    {
+        // band, overview and the offset of the chunk
+        typedef std::tuple<uint32_t, uint32_t, uint64_t, uint64_t> ChunkKey;
+        struct Window
+        {
+            uint32_t band;
+            uint32_t overview;
+            uint64_t xPxlOff;
+            uint64_t yPxlOff;
+            uint64_t xSize;
+            uint64_t ySize;
+        };
+        
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<Window> pending;
+        std::thread worker;
+        std::atomic<bool> stop{false};
+        
+        // oldest first, so they are the first dropped
+        std::list< std::pair<ChunkKey, std::vector<uint8_t> > > chunks;
+        std::map<ChunkKey, std::list< std::pair<ChunkKey, std::vector<uint8_t> > >::iterator> index;
+        size_t bytes = 0;
+        
+        bool contains(const ChunkKey &key)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return index.find(key) != index.end();
+        }
+        
+        // moves the chunk into data if it is here
+        bool take(const ChunkKey &key, std::vector<uint8_t> *data)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = index.find(key);
+            if(found == index.end())
+            {
+                return false;
+            }
+            data->swap(found->second->second);
+            bytes -= data->size();
+            chunks.erase(found->second);
+            index.erase(found);
+            return true;
+        }
+        
+        // copies the chunk into data if it is here, keeping it for longest
+        bool get(const ChunkKey &key, std::vector<uint8_t> *data)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto found = index.find(key);
+            if(found == index.end())
+            {
+                return false;
+            }
+            chunks.splice(chunks.end(), chunks, found->second);
+            *data = found->second->second;
+            return true;
+        }
+        
+        void put(const ChunkKey &key, std::vector<uint8_t> &&data)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(index.find(key) != index.end())
+            {
+                return;
+            }
+            bytes += data.size();
+            chunks.emplace_back(key, std::move(data));
+            index[key] = std::prev(chunks.end());
+            while((bytes > KEA_PREFETCH_CACHE_BYTES) && !chunks.empty())
+            {
+                bytes -= chunks.front().second.size();
+                index.erase(chunks.front().first);
+                chunks.pop_front();
+            }
+        }
+    };
+    
+    // Reopenable images with their files open, least recently used first,
+    // and the limits set by KEAImageIO::setFileLimits.
+    struct KEAFilePool
+    {
+        std::mutex mutex;
+        std::list<KEAImageIO*> files;
+        size_t maxOpenFiles = 0;
+        size_t maxCacheBytes = 0;
+        size_t cacheBytes = 0;
+        
+        bool overLimits() const
+        {
+            return ((maxOpenFiles > 0) && (files.size() > maxOpenFiles)) ||
+                   ((maxCacheBytes > 0) && (cacheBytes > maxCacheBytes));
+        }
+    };
+    
+    static KEAFilePool& getFilePool()
+    {
+        static KEAFilePool filePool;
+        return filePool;
+    }
+    
+    // The file is shared with the calls using it, so one released to keep
+    // within the file limits is only closed once they are all done with it.
+    static std::shared_ptr<H5::H5File> shareH5File(H5::H5File *keaImgH5File)
+    {
+        return std::shared_ptr<H5::H5File>(keaImgH5File, [](H5::H5File *file)
+        {
+            std::lock_guard<std::recursive_mutex> lock(KEAImageIO::getHDF5Mutex());
+            delete file;
+        });
+    }
+    
     KEAImageIO::KEAImageIO()
     {
         this->fileOpen = false;
+        this->keaImgFile = nullptr;
+        this->prefetchCache.reset(new KEAPrefetchCache());
+        this->filePooled = false;
+        this->fileCacheBytes = 0;
     }
     
     std::string KEAImageIO::readString(H5::DataSet& dataset, H5::DataType strDataType)
@@ -72,8 +559,9 @@ namespace kealib{
     {
         try 
         {
-            this->keaImgFile = keaImgH5File;
+            this->keaImgFile = shareH5File(keaImgH5File);
             this->spatialInfoFile = new KEAImageSpatialInfo();
+            this->getIOCounters(0).fileOpens++;
             
             // READ KEA VERSION NUMBER
             try
@@ -96,7 +584,7 @@ namespace kealib{
                 dimsValue[0] = 1;
                 H5::DataSpace valueDataSpace(1, dimsValue);
                 uint32_t value[1];
-                H5::DataSet datasetNumImgBands = this->keaImgFile->openDataSet( KEA_DATASETNAME_HEADER_NUMBANDS );
+                H5::DataSet datasetNumImgBands = this->getH5File()->openDataSet( KEA_DATASETNAME_HEADER_NUMBANDS );
                 datasetNumImgBands.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
                 this->numImgBands = value[0];
                 datasetNumImgBands.close();
@@ -106,6 +594,26 @@ namespace kealib{
             {
                 throw KEAIOException("The number of image bands was not specified.");
             }
+            
+            // READ THE EXPRESSIONS OF ANY VIRTUAL BANDS
+            try 
+            {
+                this->bandExpressions.assign(this->numImgBands, nullptr);
+                for(uint32_t band = 1; band <= this->numImgBands; ++band)
+                {
+                    std::string expressionName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_EXPRESSION;
+                    if(H5Lexists(this->getH5File()->getId(), expressionName.c_str(), H5P_DEFAULT) > 0)
+                    {
+                        H5::DataSet datasetExpression = this->getH5File()->openDataSet( expressionName );
+                        this->bandExpressions[band - 1] = std::make_shared<KEABandExpression>(readString(datasetExpression, datasetExpression.getDataType()));
+                        datasetExpression.close();
+                    }
+                }
+            } 
+            catch ( const H5::Exception &e) 
+            {
+                throw KEAIOException("The virtual band expressions could not be read.");
+            }
                         
             // READ TL COORDINATES
             try 
@@ -114,7 +622,7 @@ namespace kealib{
                 dimsValue[0] = 2;
                 H5::DataSpace valueDataSpace(1, dimsValue);
                 double values[2];
-                H5::DataSet datasetSpatialTL = this->keaImgFile->openDataSet( KEA_DATASETNAME_HEADER_TL );
+                H5::DataSet datasetSpatialTL = this->getH5File()->openDataSet( KEA_DATASETNAME_HEADER_TL );
                 datasetSpatialTL.read(values, H5::PredType::NATIVE_DOUBLE, valueDataSpace);
                 this->spatialInfoFile->tlX = values[0];
                 this->spatialInfoFile->tlY = values[1];
@@ -133,7 +641,7 @@ namespace kealib{
                 dimsValue[0] = 2;
                 H5::DataSpace valueDataSpace(1, dimsValue);
                 double values[2];
-                H5::DataSet spatialResDataset = this->keaImgFile->openDataSet( KEA_DATASETNAME_HEADER_RES );
+                H5::DataSet spatialResDataset = this->getH5File()->openDataSet( KEA_DATASETNAME_HEADER_RES );
                 spatialResDataset.read(values, H5::PredType::NATIVE_DOUBLE, valueDataSpace);
                 this->spatialInfoFile->xRes = values[0];
                 this->spatialInfoFile->yRes = values[1];
@@ -152,7 +660,7 @@ namespace kealib{
                 dimsValue[0] = 2;
                 H5::DataSpace valueDataSpace(1, dimsValue);
                 double values[2];
-                H5::DataSet spatialRotDataset = this->keaImgFile->openDataSet( KEA_DATASETNAME_HEADER_ROT );
+                H5::DataSet spatialRotDataset = this->getH5File()->openDataSet( KEA_DATASETNAME_HEADER_ROT );
                 spatialRotDataset.read(values, H5::PredType::NATIVE_DOUBLE, valueDataSpace);
                 this->spatialInfoFile->xRot = values[0];
                 this->spatialInfoFile->yRot = values[1];
@@ -171,7 +679,7 @@ namespace kealib{
                 dimsValue[0] = 2;
                 H5::DataSpace valueDataSpace(1, dimsValue);
                 uint64_t values[2];
-                H5::DataSet spatialSizeDataset = this->keaImgFile->openDataSet( KEA_DATASETNAME_HEADER_SIZE );
+                H5::DataSet spatialSizeDataset = this->getH5File()->openDataSet( KEA_DATASETNAME_HEADER_SIZE );
                 spatialSizeDataset.read(values, H5::PredType::NATIVE_UINT64, valueDataSpace);
                 this->spatialInfoFile->xSize = values[0];
                 this->spatialInfoFile->ySize = values[1];
@@ -186,7 +694,7 @@ namespace kealib{
             // READ WKT STRING
             try 
             {
-                H5::DataSet datasetSpatialReference = this->keaImgFile->openDataSet( KEA_DATASETNAME_HEADER_WKT );
+                H5::DataSet datasetSpatialReference = this->getH5File()->openDataSet( KEA_DATASETNAME_HEADER_WKT );
                 H5::DataType strDataType = datasetSpatialReference.getDataType();
                 this->spatialInfoFile->wktString = readString(datasetSpatialReference, strDataType);
                 datasetSpatialReference.close();
@@ -226,6 +734,10 @@ namespace kealib{
             {
                throw KEAIOException("Band is not present within image."); 
             }
+            else if(this->getBandExpression(band))
+            {
+                throw KEAIOException("Virtual bands are read-only.");
+            }
             
             uint64_t endXPxl = xPxlOff + xSizeOut;
             uint64_t endYPxl = yPxlOff + ySizeOut;
@@ -256,8 +768,11 @@ namespace kealib{
             // OPEN BAND DATASET AND WRITE IMAGE DATA
             try 
             {
+                KEAIOCounters &counters = this->getIOCounters(band);
+                KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+                counters.datasetOpens++;
                 std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
-                H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( imageBandPath + KEA_BANDNAME_DATA );
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( imageBandPath + KEA_BANDNAME_DATA );
                 H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();                
                 
                 hsize_t imgOffset[2];
@@ -305,12 +820,13 @@ namespace kealib{
                 }
                 
                 imgBandDataset.write( data, imgBandDT, write2BandDataspace, imgBandDataspace);
+                counters.bytesWritten += xSizeOut * ySizeOut * imgBandDT.getSize();
                                 
                 imgBandDataset.close();
                 imgBandDataspace.close();
                 write2BandDataspace.close();
                 
-                this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
+                this->getH5File()->flush(H5F_SCOPE_GLOBAL);
             } 
             catch ( const H5::Exception &e) 
             {
@@ -385,14 +901,27 @@ namespace kealib{
                 throw KEAIOException("End Y Pixel is not within image.");  
             }
             
+            // VIRTUAL BANDS ARE EVALUATED INSTEAD
+            if(this->getBandExpression(band))
+            {
+                if((xSizeIn > 0) && (ySizeIn > 0))
+                {
+                    this->readVirtualImageBlock(band, data, xPxlOff, yPxlOff, xSizeIn, ySizeIn, 1, 1, 1, xSizeBuf, inDataType, false);
+                }
+                return;
+            }
+            
             // GET NATIVE DATASET
             H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
 
             // OPEN BAND DATASET AND READ IMAGE DATA
             try 
             {
+                KEAIOCounters &counters = this->getIOCounters(band);
+                KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+                counters.datasetOpens++;
                 std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
-                H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( imageBandPath + KEA_BANDNAME_DATA );
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( imageBandPath + KEA_BANDNAME_DATA );
                 H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();                
                 
                 hsize_t dataOffset[2];
@@ -440,6 +969,7 @@ namespace kealib{
                 }
                 
                 imgBandDataset.read( data, imgBandDT, read2BandDataspace, imgBandDataspace);
+                counters.bytesRead += xSizeIn * ySizeIn * imgBandDT.getSize();
                 
                 imgBandDataset.close();
                 imgBandDataspace.close();
@@ -478,402 +1008,648 @@ namespace kealib{
   
     
     
-    void KEAImageIO::createMask(uint32_t band, uint32_t deflate)
+    void KEAImageIO::readImageBlock2BandStrided(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeBuf, uint64_t ySizeBuf, uint64_t xStep, uint64_t yStep, uint64_t pixelSpace, uint64_t lineSpace, KEADataType inDataType)
     {
-        if(!this->fileOpen)
-        {
-            throw KEAIOException("Image was not open.");
-        }
-        
-        if(!this->maskCreated(band))
-        {
-            uint32_t blockSize2Use = getImageBlockSize(band);
-            int initFillVal = 255;
-            hsize_t dimsImageBandChunk[] = { blockSize2Use, blockSize2Use };
-            H5::DSetCreatPropList initParamsImgBand;
-            initParamsImgBand.setChunk(2, dimsImageBandChunk);
-            initParamsImgBand.setShuffle();
-            initParamsImgBand.setDeflate(deflate);
-            initParamsImgBand.setFillValue( H5::PredType::NATIVE_INT, &initFillVal);
-            
-            H5::StrType strdatatypeLen6(H5::PredType::C_S1, 6);
-            H5::StrType strdatatypeLen4(H5::PredType::C_S1, 4);
-            const H5std_string strClassVal ("IMAGE");
-            const H5std_string strImgVerVal ("1.2");
-            H5::DataSpace attr_dataspace = H5::DataSpace(H5S_SCALAR);
-            
-            std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
-            hsize_t imageBandDims[] = { spatialInfoFile->ySize, spatialInfoFile->xSize };
-            H5::DataSpace imgBandDataSpace(2, imageBandDims);
-            H5::DataSet imgBandDataSet = this->keaImgFile->createDataSet((imageBandPath+KEA_BANDNAME_MASK), H5::PredType::STD_U8LE, imgBandDataSpace, initParamsImgBand);
-            H5::Attribute classAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_CLASS, strdatatypeLen6, attr_dataspace);
-            classAttribute.write(strdatatypeLen6, strClassVal);
-            classAttribute.close();
-            
-            H5::Attribute imgVerAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_IMAGE_VERSION, strdatatypeLen4, attr_dataspace);
-            imgVerAttribute.write(strdatatypeLen4, strImgVerVal);
-            imgVerAttribute.close();
-            
-            imgBandDataSet.close();
-            imgBandDataSpace.close();
-        }
+        this->transferImageBlockStrided(false, band, overview, data, xPxlOff, yPxlOff, xSizeBuf, ySizeBuf, xStep, yStep, pixelSpace, lineSpace, inDataType);
     }
     
-    void KEAImageIO::writeImageBlock2BandMask(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut, uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
+    void KEAImageIO::writeImageBlock2BandStrided(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeBuf, uint64_t ySizeBuf, uint64_t pixelSpace, uint64_t lineSpace, KEADataType inDataType)
+    {
+        this->transferImageBlockStrided(true, band, overview, data, xPxlOff, yPxlOff, xSizeBuf, ySizeBuf, 1, 1, pixelSpace, lineSpace, inDataType);
+    }
+    
+    void KEAImageIO::transferImageBlockStrided(bool write, uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeBuf, uint64_t ySizeBuf, uint64_t xStep, uint64_t yStep, uint64_t pixelSpace, uint64_t lineSpace, KEADataType inDataType)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        try
+        try 
         {
-            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
             if(band == 0)
             {
                 throw KEAIOException("KEA Image Bands start at 1.");
             }
             else if(band > this->numImgBands)
             {
-                throw KEAIOException("Band is not present within image.");
-            }
-            
-            uint64_t endXPxl = xPxlOff + xSizeOut;
-            uint64_t endYPxl = yPxlOff + ySizeOut;
-            
-            if(xPxlOff > this->spatialInfoFile->xSize)
-            {
-                throw KEAIOException("Start X Pixel is not within image.");
+                throw KEAIOException("Band is not present within image."); 
             }
-            
-            if(endXPxl > this->spatialInfoFile->xSize)
+            if((xStep == 0) || (yStep == 0) || (pixelSpace == 0) || ((ySizeBuf > 1) && (lineSpace < (((xSizeBuf - 1) * pixelSpace) + 1))))
             {
-                throw KEAIOException("End X Pixel is not within image.");
+                throw KEAIOException("The buffer layout is not valid, lines may not overlap.");
             }
-            
-            if(yPxlOff > this->spatialInfoFile->ySize)
+            if((xSizeBuf == 0) || (ySizeBuf == 0))
             {
-                throw KEAIOException("Start Y Pixel is not within image.");
+                return;
             }
-            
-            if(endYPxl > this->spatialInfoFile->ySize)
+            if((overview == 0) && this->getBandExpression(band))
             {
-                throw KEAIOException("End Y Pixel is not within image.");
+                if(write)
+                {
+                    throw KEAIOException("Virtual bands are read-only.");
+                }
+                this->readVirtualImageBlock(band, data, xPxlOff, yPxlOff, xSizeBuf, ySizeBuf, xStep, yStep, pixelSpace, lineSpace, inDataType, false);
+                return;
             }
             
-            // GET NATIVE DATASET
             H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
             
-            // OPEN BAND DATASET AND WRITE IMAGE DATA
-            try
+            try 
             {
-                std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
-                H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( imageBandPath + KEA_BANDNAME_MASK );
+                KEAIOCounters &counters = this->getIOCounters(band);
+                KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+                counters.datasetOpens++;
+                std::string datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DATA;
+                if(overview > 0)
+                {
+                    datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
+                }
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( datasetName );
                 H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();
                 
-                hsize_t imgOffset[2];
-                imgOffset[0] = yPxlOff;
-                imgOffset[1] = xPxlOff;
-                hsize_t dataDims[2];
-                dataDims[0] = ySizeBuf;
-                dataDims[1] = xSizeBuf;
-                H5::DataSpace write2BandDataspace = H5::DataSpace(2, dataDims);
+                hsize_t imgDims[2];
+                imgBandDataspace.getSimpleExtentDims(imgDims);
+                if((xPxlOff + ((xSizeBuf - 1) * xStep)) >= imgDims[1])
+                {
+                    throw KEAIOException("End X Pixel is not within image.");
+                }
+                if((yPxlOff + ((ySizeBuf - 1) * yStep)) >= imgDims[0])
+                {
+                    throw KEAIOException("End Y Pixel is not within image.");
+                }
                 
-                if((ySizeOut != ySizeBuf) | (xSizeOut != xSizeBuf))
+                hsize_t imgOffset[2] = {yPxlOff, xPxlOff};
+                hsize_t imgStride[2] = {yStep, xStep};
+                hsize_t selectCount[2] = {ySizeBuf, xSizeBuf};
+                imgBandDataspace.selectHyperslab(H5S_SELECT_SET, selectCount, imgOffset, imgStride);
+                
+                // the buffer is described as whole lines of which every
+                // pixelSpace element is selected.
+                hsize_t memDims[2] = {ySizeBuf, (ySizeBuf > 1)?lineSpace:(((xSizeBuf - 1) * pixelSpace) + 1)};
+                hsize_t memOffset[2] = {0, 0};
+                hsize_t memStride[2] = {1, pixelSpace};
+                H5::DataSpace memDataspace = H5::DataSpace(2, memDims);
+                memDataspace.selectHyperslab(H5S_SELECT_SET, selectCount, memOffset, memStride);
+                
+                if(write)
                 {
-                    hsize_t dataSelectMemDims[2];
-                    dataSelectMemDims[0] = ySizeOut;
-                    dataSelectMemDims[1] = 1;
-                    
-                    hsize_t dataOffDims[2];
-                    dataOffDims[0] = 0;
-                    dataOffDims[1] = 0;
-                    
-                    hsize_t dataSelectStrideDims[2];
-                    dataSelectStrideDims[0] = 1;
-                    if(xSizeBuf == xSizeOut)
-                    {
-                        dataSelectStrideDims[1] = 1;
-                    }
-                    else
-                    {
-                        dataSelectStrideDims[1] = xSizeBuf - xSizeOut;
-                    }
-                    
-                    hsize_t dataSelectBlockSizeDims[2];
-                    dataSelectBlockSizeDims[0] = 1;
-                    dataSelectBlockSizeDims[1] = xSizeOut;
-                    write2BandDataspace.selectHyperslab(H5S_SELECT_SET, dataSelectMemDims, dataOffDims, dataSelectStrideDims, dataSelectBlockSizeDims);
-                    
-                    hsize_t dataOutDims[2];
-                    dataOutDims[0] = ySizeOut;
-                    dataOutDims[1] = xSizeOut;
-                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataOutDims, imgOffset);
+                    imgBandDataset.write(data, imgBandDT, memDataspace, imgBandDataspace);
+                    counters.bytesWritten += xSizeBuf * ySizeBuf * imgBandDT.getSize();
                 }
                 else
                 {
-                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataDims, imgOffset);
+                    imgBandDataset.read(data, imgBandDT, memDataspace, imgBandDataspace);
+                    counters.bytesRead += xSizeBuf * ySizeBuf * imgBandDT.getSize();
                 }
                 
-                imgBandDataset.write( data, imgBandDT, write2BandDataspace, imgBandDataspace);
-                
                 imgBandDataset.close();
                 imgBandDataspace.close();
-                write2BandDataspace.close();
-                
-                this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-            }
-            catch ( const H5::Exception &e)
+                memDataspace.close();
+            } 
+            catch ( const H5::Exception &e) 
             {
-                throw KEAIOException("Could not write image data.");
+                throw KEAIOException(write?"Could not write image data.":"Could not read image data.");
             }
         }
         catch(const KEAIOException &e)
         {
             throw e;
         }
-        catch( const H5::FileIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSetIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSpaceIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataTypeIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
     }
     
-    void KEAImageIO::readImageBlock2BandMask(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
+    std::shared_ptr<KEABandExpression> KEAImageIO::getBandExpression(uint32_t band) const
     {
-        if(!this->fileOpen)
+        if((band == 0) || (band > this->bandExpressions.size()))
         {
-            throw KEAIOException("Image was not open.");
+            return nullptr;
         }
-        
-        try
+        return this->bandExpressions[band - 1];
+    }
+    
+    void KEAImageIO::readVirtualImageBlock(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeBuf, uint64_t ySizeBuf, uint64_t xStep, uint64_t yStep, uint64_t pixelSpace, uint64_t lineSpace, KEADataType inDataType, bool concurrent)
+    {
+        std::shared_ptr<KEABandExpression> expression = this->getBandExpression(band);
+        const std::vector<uint32_t> &inBands = expression->getBands();
+        uint64_t xSize = this->spatialInfoFile->xSize;
+        uint64_t ySize = this->spatialInfoFile->ySize;
+        uint64_t xLast = xPxlOff + ((xSizeBuf - 1) * xStep);
+        uint64_t yLast = yPxlOff + ((ySizeBuf - 1) * yStep);
+        if(xLast >= xSize)
         {
-            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
-            if(band == 0)
-            {
-                throw KEAIOException("KEA Image Bands start at 1.");
-            }
-            else if(band > this->numImgBands)
-            {
-                throw KEAIOException("Band is not present within image.");
-            }
-            
-            uint64_t endXPxl = xPxlOff + xSizeIn;
-            uint64_t endYPxl = yPxlOff + ySizeIn;
-            
-            if(xPxlOff > this->spatialInfoFile->xSize)
+            throw KEAIOException("End X Pixel is not within image.");
+        }
+        if(yLast >= ySize)
+        {
+            throw KEAIOException("End Y Pixel is not within image.");
+        }
+        
+        // everything else needed is read up front, with the lock held if
+        // the bands are to be read concurrently
+        KEADataType bandDataType = kea_undefined;
+        uint64_t blockSize = 0;
+        bool cacheable = false;
+        double noDataVal = 0;
+        bool noDataDefined = false;
+        std::vector<KEADataType> inDataTypes(inBands.size());
+        std::vector<double> inNoDataVals(inBands.size(), 0);
+        std::vector<bool> inNoDataDefined(inBands.size(), false);
+        {
+            std::unique_lock<std::recursive_mutex> lock(getHDF5Mutex(), std::defer_lock);
+            if(concurrent)
             {
-                throw KEAIOException("Start X Pixel is not within image.");
+                lock.lock();
             }
-            
-            if(endXPxl > this->spatialInfoFile->xSize)
+            auto getNoData = [this](uint32_t noDataBand, double *val)
             {
-                throw KEAIOException("End X Pixel is not within image.");
-            }
-            
-            if(yPxlOff > this->spatialInfoFile->ySize)
+                try
+                {
+                    this->getNoDataValue(noDataBand, val, kea_64float);
+                    return true;
+                }
+                catch(const KEAIOException &)
+                {
+                    return false;
+                }
+            };
+            bandDataType = this->getImageBandDataType(band);
+            blockSize = this->getImageBlockSize(band);
+            // the bands used can't change while the file is read-only
+            unsigned int intent = 0;
+            cacheable = (H5Fget_intent(this->getH5File()->getId(), &intent) >= 0) && !(intent & H5F_ACC_RDWR);
+            noDataDefined = getNoData(band, &noDataVal);
+            for(size_t i = 0; i < inBands.size(); ++i)
             {
-                throw KEAIOException("Start Y Pixel is not within image.");
+                inDataTypes[i] = this->getImageBandDataType(inBands[i]);
+                inNoDataDefined[i] = noDataDefined && getNoData(inBands[i], &inNoDataVals[i]);
             }
-            
-            if(endYPxl > this->spatialInfoFile->ySize)
+        }
+        if(blockSize == 0)
+        {
+            blockSize = KEA_IMAGE_CHUNK_SIZE;
+        }
+        
+        size_t bandPxlSize = 0;
+        size_t outPxlSize = 0;
+        dispatchDataType(bandDataType, [&bandPxlSize](auto *type) { bandPxlSize = sizeof(*type); });
+        dispatchDataType(inDataType, [&outPxlSize](auto *type) { outPxlSize = sizeof(*type); });
+        KEAIOCounters &counters = this->getIOCounters(band);
+        uint8_t *outData = (uint8_t*)data;
+        std::vector<uint8_t> chunk;
+        std::vector<uint8_t> converted;
+        std::vector<uint8_t> inChunk;
+        std::vector<double> values;
+        std::vector<std::vector<double> > inValues(inBands.size());
+        std::vector<const double*> inputs(inBands.size());
+        
+        for(uint64_t chunkY = (yPxlOff / blockSize) * blockSize; chunkY <= yLast; chunkY += blockSize)
+        {
+            // the rows of the window within this row of chunks, if any
+            uint64_t chunkRows = std::min(blockSize, ySize - chunkY);
+            uint64_t firstRow = (chunkY > yPxlOff) ? (((chunkY - yPxlOff) + yStep - 1) / yStep) : 0;
+            if((yPxlOff + (firstRow * yStep)) >= (chunkY + chunkRows))
             {
-                throw KEAIOException("End Y Pixel is not within image.");
+                continue;
             }
+            uint64_t lastRow = std::min(ySizeBuf - 1, ((chunkY + chunkRows - 1) - yPxlOff) / yStep);
             
-            // GET NATIVE DATASET
-            H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
-            
-            // OPEN BAND DATASET AND READ IMAGE DATA
-            try
+            for(uint64_t chunkX = (xPxlOff / blockSize) * blockSize; chunkX <= xLast; chunkX += blockSize)
             {
-                std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
-                H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( imageBandPath + KEA_BANDNAME_MASK );
-                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();
-                
-                hsize_t dataOffset[2];
-                dataOffset[0] = yPxlOff;
-                dataOffset[1] = xPxlOff;
-                hsize_t dataDims[2];
-                dataDims[0] = ySizeBuf;
-                dataDims[1] = xSizeBuf;
-                H5::DataSpace read2BandDataspace = H5::DataSpace(2, dataDims);
+                uint64_t chunkCols = std::min(blockSize, xSize - chunkX);
+                uint64_t firstCol = (chunkX > xPxlOff) ? (((chunkX - xPxlOff) + xStep - 1) / xStep) : 0;
+                if((xPxlOff + (firstCol * xStep)) >= (chunkX + chunkCols))
+                {
+                    continue;
+                }
+                uint64_t lastCol = std::min(xSizeBuf - 1, ((chunkX + chunkCols - 1) - xPxlOff) / xStep);
+                size_t numPxls = chunkCols * chunkRows;
                 
-                if((ySizeBuf != ySizeIn) | (xSizeBuf != xSizeIn))
+                KEAPrefetchCache::ChunkKey key(band, 0, chunkY, chunkX);
+                if(cacheable && this->prefetchCache->get(key, &chunk))
                 {
-                    hsize_t dataSelectMemDims[2];
-                    dataSelectMemDims[0] = ySizeIn;
-                    dataSelectMemDims[1] = 1;
-                    
-                    hsize_t dataOffDims[2];
-                    dataOffDims[0] = 0;
-                    dataOffDims[1] = 0;
+                    counters.cacheHits++;
+                }
+                else
+                {
+                    counters.cacheMisses++;
+                    for(size_t i = 0; i < inBands.size(); ++i)
+                    {
+                        dispatchDataType(inDataTypes[i], [&](auto *type)
+                        {
+                            inChunk.resize(numPxls * sizeof(*type));
+                            if(concurrent)
+                            {
+                                this->readImageBlock2BandConcurrent(inBands[i], 0, inChunk.data(), chunkX, chunkY, chunkCols, chunkRows, chunkCols, inDataTypes[i]);
+                            }
+                            else
+                            {
+                                this->readImageBlock2Band(inBands[i], inChunk.data(), chunkX, chunkY, chunkCols, chunkRows, chunkCols, chunkRows, inDataTypes[i]);
+                            }
+                            inValues[i].resize(numPxls);
+                            pixelsToDoubles<typename std::remove_pointer<decltype(type)>::type>(inChunk.data(), numPxls, inValues[i].data());
+                        });
+                        inputs[i] = inValues[i].data();
+                    }
                     
-                    hsize_t dataSelectStrideDims[2];
-                    dataSelectStrideDims[0] = 1;
-                    if(xSizeBuf == xSizeIn)
+                    KEAIOTimer evaluateTimer(counters.decodeNanos);
+                    values.resize(numPxls);
+                    expression->evaluate(inputs, numPxls, values.data());
+                    if(noDataDefined)
                     {
-                        dataSelectStrideDims[1] = 1;
+                        for(size_t i = 0; i < inBands.size(); ++i)
+                        {
+                            if(!inNoDataDefined[i])
+                            {
+                                continue;
+                            }
+                            const double *inVals = inValues[i].data();
+                            const double inNoDataVal = inNoDataVals[i];
+                            for(size_t n = 0; n < numPxls; ++n)
+                            {
+                                values[n] = (inVals[n] == inNoDataVal) ? noDataVal : values[n];
+                            }
+                        }
                     }
-                    else
+                    chunk.resize(numPxls * bandPxlSize);
+                    dispatchDataType(bandDataType, [&](auto *type)
                     {
-                        dataSelectStrideDims[1] = xSizeBuf - xSizeIn;
+                        doublesToPixels<typename std::remove_pointer<decltype(type)>::type>(values.data(), numPxls, chunk.data());
+                    });
+                    evaluateTimer.stop();
+                    counters.chunksDecoded++;
+                    if(cacheable)
+                    {
+                        this->prefetchCache->put(key, std::vector<uint8_t>(chunk));
                     }
-                    
-                    hsize_t dataSelectBlockSizeDims[2];
-                    dataSelectBlockSizeDims[0] = 1;
-                    dataSelectBlockSizeDims[1] = xSizeIn;
-                    read2BandDataspace.selectHyperslab(H5S_SELECT_SET, dataSelectMemDims, dataOffDims, dataSelectStrideDims, dataSelectBlockSizeDims);
-                    
-                    hsize_t dataInDims[2];
-                    dataInDims[0] = ySizeIn;
-                    dataInDims[1] = xSizeIn;
-                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataInDims, dataOffset);
                 }
-                else
+                
+                // converted as a band read as another type would be
+                const uint8_t *chunkData = chunk.data();
+                if(inDataType != bandDataType)
                 {
-                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataDims, dataOffset);
+                    values.resize(numPxls);
+                    dispatchDataType(bandDataType, [&](auto *type)
+                    {
+                        pixelsToDoubles<typename std::remove_pointer<decltype(type)>::type>(chunk.data(), numPxls, values.data());
+                    });
+                    converted.resize(numPxls * outPxlSize);
+                    dispatchDataType(inDataType, [&](auto *type)
+                    {
+                        doublesToPixels<typename std::remove_pointer<decltype(type)>::type>(values.data(), numPxls, converted.data());
+                    });
+                    chunkData = converted.data();
                 }
                 
-                imgBandDataset.read( data, imgBandDT, read2BandDataspace, imgBandDataspace);
-                
-                imgBandDataset.close();
-                imgBandDataspace.close();
-                read2BandDataspace.close();
-            }
-            catch ( const H5::Exception &e)
-            {
-                throw KEAIOException("Could not read image data.");
+                for(uint64_t row = firstRow; row <= lastRow; ++row)
+                {
+                    const uint8_t *inRow = chunkData + (((yPxlOff + (row * yStep)) - chunkY) * chunkCols * outPxlSize);
+                    uint8_t *outRow = outData + (row * lineSpace * outPxlSize);
+                    if((xStep == 1) && (pixelSpace == 1))
+                    {
+                        memcpy(outRow + (firstCol * outPxlSize), inRow + (((xPxlOff + firstCol) - chunkX) * outPxlSize), ((lastCol - firstCol) + 1) * outPxlSize);
+                        continue;
+                    }
+                    for(uint64_t col = firstCol; col <= lastCol; ++col)
+                    {
+                        memcpy(outRow + (col * pixelSpace * outPxlSize), inRow + (((xPxlOff + (col * xStep)) - chunkX) * outPxlSize), outPxlSize);
+                    }
+                }
             }
         }
-        catch(const KEAIOException &e)
+        counters.bytesRead += xSizeBuf * ySizeBuf * outPxlSize;
+    }
+    
+    // Finds the chunk size of dataset and where in its filter pipeline the
+    // shuffle and deflate filters are (-1 if not used). Returns false unless
+    // the chunks hold memType and only the pipeline libkea writes (shuffle
+    // then deflate) is used, so they can be coded without HDF5.
+    static bool getChunkFilters(const H5::DataSet &dataset, const H5::DataType &memType, hsize_t *chunkDims, int *shuffleIdx, int *deflateIdx, unsigned int *deflateLevel)
+    {
+        H5::DSetCreatPropList creationPList = dataset.getCreatePlist();
+        if((creationPList.getLayout() != H5D_CHUNKED) || !(dataset.getDataType() == memType))
         {
-            throw e;
+            return false;
         }
-        catch( const H5::FileIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSetIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSpaceIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataTypeIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-        catch ( const std::exception &e)
+        creationPList.getChunk(2, chunkDims);
+        
+        bool codable = true;
+        *shuffleIdx = -1;
+        *deflateIdx = -1;
+        int numFilters = creationPList.getNfilters();
+        for(int i = 0; i < numFilters; ++i)
+        {
+            unsigned int flags = 0;
+            size_t numVals = 1;
+            unsigned int vals[1] = {0};
+            unsigned int filterConfig = 0;
+            H5Z_filter_t filter = H5Pget_filter2(creationPList.getId(), i, &flags, &numVals, vals, 0, nullptr, &filterConfig);
+            if((filter == H5Z_FILTER_SHUFFLE) && (*shuffleIdx < 0) && (*deflateIdx < 0))
+            {
+                *shuffleIdx = i;
+            }
+#ifdef KEA_HAVE_ZLIB
+            else if((filter == H5Z_FILTER_DEFLATE) && (*deflateIdx < 0))
+            {
+                *deflateIdx = i;
+                *deflateLevel = (numVals > 0) ? vals[0] : Z_DEFAULT_COMPRESSION;
+            }
+#endif
+            else
+            {
+                codable = false;
+            }
+        }
+        return codable;
+    }
+    
+    // Gets the value unwritten chunks of dataset read as, as memType. Left
+    // as it is (normally zeroed) if no fill value is defined.
+    static void getChunkFillValue(const H5::DataSet &dataset, const H5::DataType &memType, void *fillValue)
+    {
+        H5::DSetCreatPropList creationPList = dataset.getCreatePlist();
+        H5D_fill_value_t fillStatus = H5D_FILL_VALUE_UNDEFINED;
+        if((H5Pfill_value_defined(creationPList.getId(), &fillStatus) >= 0) && (fillStatus != H5D_FILL_VALUE_UNDEFINED))
         {
-            throw KEAIOException(e.what());
+            creationPList.getFillValue(memType, fillValue);
         }
     }
     
-    bool KEAImageIO::maskCreated(uint32_t band)
+#ifdef KEA_HAVE_DIRECT_CHUNK_IO
+    // Gets the stored size of the chunk at chunkOffset, returning false if
+    // it has never been written (so isn't allocated in the file).
+    static bool getChunkStorageSize(const H5::DataSet &dataset, const hsize_t *chunkOffset, hsize_t *storedBytes)
     {
-        if(!this->fileOpen)
+        herr_t status = -1;
+        *storedBytes = 0;
+        // older HDF5 reports an unallocated chunk as an error
+        H5E_BEGIN_TRY
         {
-            throw KEAIOException("Image was not open.");
+            status = H5Dget_chunk_storage_size(dataset.getId(), chunkOffset, storedBytes);
         }
-        
-        // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
-        if(band == 0)
+        H5E_END_TRY;
+        return (status >= 0) && (*storedBytes > 0);
+    }
+    
+    // Undoes the filters (see getChunkFilters) not skipped in filterMask on
+    // a stored chunk. Returns the chunkBytes decoded, which are in raw,
+    // inflated or unshuffled (each at least chunkBytes long).
+    static const uint8_t* decodeChunk(const std::vector<uint8_t> &raw, uint32_t filterMask, int shuffleIdx, int deflateIdx, size_t pxlSize, size_t chunkBytes, std::vector<uint8_t> &inflated, std::vector<uint8_t> &unshuffled)
+    {
+        const uint8_t *chunk = raw.data();
+        size_t chunkLen = raw.size();
+#ifdef KEA_HAVE_ZLIB
+        if((deflateIdx >= 0) && !(filterMask & (1u << deflateIdx)))
         {
-            throw KEAIOException("KEA Image Bands start at 1.");
+            uLongf inflatedLen = chunkBytes;
+            if((uncompress(inflated.data(), &inflatedLen, chunk, chunkLen) != Z_OK) || (inflatedLen != chunkBytes))
+            {
+                throw KEAIOException("Could not decompress image data.");
+            }
+            chunk = inflated.data();
+            chunkLen = inflatedLen;
         }
-        else if(band > this->numImgBands)
+#endif
+        if(chunkLen != chunkBytes)
         {
-            throw KEAIOException("Band is not present within image.");
+            throw KEAIOException("Image chunk is not the expected size.");
         }
-        
-        bool maskPresent = false;
-        std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
-        try
+        if((shuffleIdx >= 0) && !(filterMask & (1u << shuffleIdx)) && (pxlSize > 1))
         {
-            H5::Group imgBandGrp = this->keaImgFile->openGroup(imageBandPath);
-            hsize_t numItems = imgBandGrp.getNumObjs();
-            for(hsize_t i = 0; i < numItems; ++i)
+            // the shuffle filter stores byte n of every element together
+            size_t numElmts = chunkBytes / pxlSize;
+            for(size_t b = 0; b < pxlSize; ++b)
             {
-                //std::cout << "Item: " << imgBandGrp.getObjnameByIdx(i) << std::endl;
-                if(imgBandGrp.getObjnameByIdx(i) == "MASK")
+                const uint8_t *bytes = chunk + (b * numElmts);
+                for(size_t n = 0; n < numElmts; ++n)
                 {
-                    maskPresent = true;
-                    break;
+                    unshuffled[(n * pxlSize) + b] = bytes[n];
                 }
             }
-            imgBandGrp.close();
-            //H5::DataSet imgBandDataset = this->keaImgFile->openDataSet(imageBandPath+KEA_BANDNAME_MASK);
-            //imgBandDataset.close();
-            
-        }
-        catch (const H5::Exception &e)
-        {
-            maskPresent = false;
+            chunk = unshuffled.data();
         }
-        
-        return maskPresent;
+        return chunk;
     }
+#endif
     
+    std::recursive_mutex& KEAImageIO::getHDF5Mutex()
+    {
+        static std::recursive_mutex hdf5Mutex;
+        return hdf5Mutex;
+    }
     
-    void KEAImageIO::setImageMetaData(const std::string &name, const std::string &value)
+    void KEAImageIO::readImageBlock2BandConcurrent(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, KEADataType inDataType)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        // FORM META-DATA PATH WITHIN THE H5 FILE 
-        std::string metaDataH5Path = KEA_DATASETNAME_METADATA + std::string("/") + name;
-        
-        // WRITE IMAGE META DATA
         try 
         {
-            // OPEN DATASET OR CREATE NEW DATASET IF IT DOES NOT EXIST
-            H5::StrType strTypeAll(0, H5T_VARIABLE);
-            H5::DataSet datasetMetaData;
+            if(band == 0)
+            {
+                throw KEAIOException("KEA Image Bands start at 1.");
+            }
+            else if(band > this->numImgBands)
+            {
+                throw KEAIOException("Band is not present within image."); 
+            }
+            if(xSizeBuf < xSizeIn)
+            {
+                throw KEAIOException("The buffer is narrower than the window read.");
+            }
+            if((xSizeIn == 0) || (ySizeIn == 0))
+            {
+                return;
+            }
+            if((overview == 0) && this->getBandExpression(band))
+            {
+                // the bands used are read concurrently and then evaluated here
+                this->readVirtualImageBlock(band, data, xPxlOff, yPxlOff, xSizeIn, ySizeIn, 1, 1, 1, xSizeBuf, inDataType, true);
+                return;
+            }
+            
+            std::string datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DATA;
+            if(overview > 0)
+            {
+                datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
+            }
+            // HDF5 types are only created under the lock
+            size_t pxlSize = 0;
+            dispatchDataType(inDataType, [&pxlSize](auto *type) { pxlSize = sizeof(*type); });
+            KEAIOCounters &counters = this->getIOCounters(band);
+            
+            // find out how the chunks are stored. The dataset is reopened for
+            // each locked section so no HDF5 object outlives the lock.
+            hsize_t chunkDims[2] = {0, 0};
+            int shuffleIdx = -1;
+            int deflateIdx = -1;
+            bool decodable = false;
+            std::vector<uint8_t> fillValue(pxlSize, 0);
             try 
             {
-                datasetMetaData = this->keaImgFile->openDataSet( metaDataH5Path );
+                std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+                KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+                counters.datasetOpens++;
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( datasetName );
+                H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
+                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();
+                hsize_t imgDims[2];
+                imgBandDataspace.getSimpleExtentDims(imgDims);
+                if((xPxlOff + xSizeIn) > imgDims[1])
+                {
+                    throw KEAIOException("End X Pixel is not within image.");
+                }
+                if((yPxlOff + ySizeIn) > imgDims[0])
+                {
+                    throw KEAIOException("End Y Pixel is not within image.");
+                }
+                
+                unsigned int deflateLevel = 0;
+                decodable = getChunkFilters(imgBandDataset, imgBandDT, chunkDims, &shuffleIdx, &deflateIdx, &deflateLevel);
+                if(decodable)
+                {
+                    getChunkFillValue(imgBandDataset, imgBandDT, fillValue.data());
+                }
             }
-            catch (const H5::Exception &e)
+            catch ( const H5::Exception &e) 
             {
-                hsize_t	dimsForStr[1];
-                dimsForStr[0] = 1; // number of lines;
-                H5::DataSpace dataspaceStrAll(1, dimsForStr);
-                datasetMetaData = this->keaImgFile->createDataSet(metaDataH5Path, strTypeAll, dataspaceStrAll);
-
+                throw KEAIOException("Could not read image data.");
             }
-            // WRITE DATA INTO THE DATASET
-            const char *wStrdata[1];
-            wStrdata[0] = value.c_str();			
-            datasetMetaData.write((void*)wStrdata, strTypeAll);
-            datasetMetaData.close();
             
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-        }
-        catch (const H5::Exception &e) 
-        {
-            throw KEAIOException("Could not set image meta-data.");
+#ifdef KEA_HAVE_DIRECT_CHUNK_IO
+            if(!decodable)
+#endif
+            {
+                std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+                this->transferImageBlockStrided(false, band, overview, data, xPxlOff, yPxlOff, xSizeIn, ySizeIn, 1, 1, 1, xSizeBuf, inDataType);
+                return;
+            }
+            
+#ifdef KEA_HAVE_DIRECT_CHUNK_IO
+            uint64_t xEnd = xPxlOff + xSizeIn;
+            uint64_t yEnd = yPxlOff + ySizeIn;
+            uint64_t chunkColStart = xPxlOff / chunkDims[1];
+            uint64_t numChunkCols = ((xEnd - 1) / chunkDims[1]) - chunkColStart + 1;
+            size_t chunkBytes = chunkDims[0] * chunkDims[1] * pxlSize;
+            
+            std::vector<std::vector<uint8_t> > rawChunks(numChunkCols);
+            std::vector<uint32_t> filterMasks(numChunkCols, 0);
+            std::vector<bool> allocated(numChunkCols, true);
+            std::vector<std::vector<uint8_t> > prefetched(numChunkCols);
+            std::vector<bool> cached(numChunkCols, false);
+            std::vector<uint8_t> inflated(chunkBytes);
+            std::vector<uint8_t> unshuffled(chunkBytes);
+            uint8_t *outData = (uint8_t*)data;
+            
+            // a row of chunks at a time - fetched under the lock then decoded
+            for(uint64_t chunkRow = yPxlOff / chunkDims[0]; (chunkRow * chunkDims[0]) < yEnd; ++chunkRow)
+            {
+                uint64_t chunkY = chunkRow * chunkDims[0];
+                uint64_t yStart = std::max(yPxlOff, chunkY);
+                uint64_t yStop = std::min<uint64_t>(yEnd, chunkY + chunkDims[0]);
+                
+                // HDF5 isn't needed at all if the row has been prefetched
+                bool allCached = true;
+                for(uint64_t i = 0; i < numChunkCols; ++i)
+                {
+                    KEAPrefetchCache::ChunkKey key(band, overview, chunkY, (chunkColStart + i) * chunkDims[1]);
+                    cached[i] = this->prefetchCache->take(key, &prefetched[i]);
+                    if(cached[i])
+                    {
+                        allocated[i] = true;
+                        counters.cacheHits++;
+                    }
+                    else
+                    {
+                        counters.cacheMisses++;
+                    }
+                    allCached = allCached && cached[i];
+                }
+                
+                try 
+                {
+                    if(!allCached)
+                    {
+                        std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+                        KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+                        counters.datasetOpens++;
+                        H5::DataSet imgBandDataset = this->getH5File()->openDataSet( datasetName );
+                        for(uint64_t i = 0; i < numChunkCols; ++i)
+                        {
+                            if(cached[i])
+                            {
+                                continue;
+                            }
+                            hsize_t chunkOffset[2] = {chunkY, (chunkColStart + i) * chunkDims[1]};
+                            hsize_t storedBytes = 0;
+                            allocated[i] = getChunkStorageSize(imgBandDataset, chunkOffset, &storedBytes);
+                            if(!allocated[i])
+                            {
+                                continue;
+                            }
+                            rawChunks[i].resize(storedBytes);
+                            if(H5Dread_chunk(imgBandDataset.getId(), H5P_DEFAULT, chunkOffset, &filterMasks[i], rawChunks[i].data()) < 0)
+                            {
+                                throw KEAIOException("Could not read image data.");
+                            }
+                            counters.rawBytesRead += storedBytes;
+                        }
+                    }
+                }
+                catch ( const H5::Exception &e) 
+                {
+                    throw KEAIOException("Could not read image data.");
+                }
+                
+                for(uint64_t i = 0; i < numChunkCols; ++i)
+                {
+                    uint64_t chunkX = (chunkColStart + i) * chunkDims[1];
+                    uint64_t xStart = std::max(xPxlOff, chunkX);
+                    uint64_t xStop = std::min<uint64_t>(xEnd, chunkX + chunkDims[1]);
+                    
+                    // unwritten chunks are all the fill value, nothing to decode
+                    if(!allocated[i])
+                    {
+                        for(uint64_t y = yStart; y < yStop; ++y)
+                        {
+                            uint8_t *outRow = outData + ((((y - yPxlOff) * xSizeBuf) + (xStart - xPxlOff)) * pxlSize);
+                            for(uint64_t x = xStart; x < xStop; ++x, outRow += pxlSize)
+                            {
+                                memcpy(outRow, fillValue.data(), pxlSize);
+                            }
+                        }
+                        continue;
+                    }
+                    
+                    const uint8_t *chunk = nullptr;
+                    if(cached[i])
+                    {
+                        chunk = prefetched[i].data();
+                    }
+                    else
+                    {
+                        KEAIOTimer decodeTimer(counters.decodeNanos);
+                        chunk = decodeChunk(rawChunks[i], filterMasks[i], shuffleIdx, deflateIdx, pxlSize, chunkBytes, inflated, unshuffled);
+                        counters.chunksDecoded++;
+                    }
+                    
+                    for(uint64_t y = yStart; y < yStop; ++y)
+                    {
+                        memcpy(outData + ((((y - yPxlOff) * xSizeBuf) + (xStart - xPxlOff)) * pxlSize),
+                               chunk + ((((y - chunkY) * chunkDims[1]) + (xStart - chunkX)) * pxlSize),
+                               (xStop - xStart) * pxlSize);
+                    }
+                }
+            }
+            counters.bytesRead += xSizeIn * ySizeIn * pxlSize;
+#endif
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
             throw e;
         }
@@ -883,28 +1659,178 @@ namespace kealib{
         }
     }
     
-    std::string KEAImageIO::getImageMetaData(const std::string &name)
+    void KEAImageIO::writeImageChunkConcurrent(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut, uint64_t ySizeOut, uint64_t xSizeBuf, KEADataType inDataType)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        std::string metaDataH5Path = KEA_DATASETNAME_METADATA + std::string("/") + name;
-        std::string value = "";
-        // READ IMAGE META-DATA
         try 
         {
-            H5::DataSet datasetMetaData = this->keaImgFile->openDataSet( metaDataH5Path );
-            H5::DataType strDataType = datasetMetaData.getDataType();
-            value = readString(datasetMetaData, strDataType);
-            datasetMetaData.close();
-        } 
-        catch ( const H5::Exception &e) 
-        {
-            throw KEAIOException("Meta-data variable was not accessable.");
+            if(band == 0)
+            {
+                throw KEAIOException("KEA Image Bands start at 1.");
+            }
+            else if(band > this->numImgBands)
+            {
+                throw KEAIOException("Band is not present within image."); 
+            }
+            if(xSizeBuf < xSizeOut)
+            {
+                throw KEAIOException("The buffer is narrower than the window written.");
+            }
+            if((overview == 0) && this->getBandExpression(band))
+            {
+                throw KEAIOException("Virtual bands are read-only.");
+            }
+            if((xSizeOut == 0) || (ySizeOut == 0))
+            {
+                return;
+            }
+            
+            std::string datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DATA;
+            if(overview > 0)
+            {
+                datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
+            }
+            size_t pxlSize = 0;
+            dispatchDataType(inDataType, [&pxlSize](auto *type) { pxlSize = sizeof(*type); });
+            KEAIOCounters &counters = this->getIOCounters(band);
+            
+            hsize_t chunkDims[2] = {0, 0};
+            hsize_t imgDims[2] = {0, 0};
+            int shuffleIdx = -1;
+            int deflateIdx = -1;
+            unsigned int deflateLevel = 0;
+            bool codable = false;
+            std::vector<uint8_t> fillValue(pxlSize, 0);
+            try 
+            {
+                std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+                KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+                counters.datasetOpens++;
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( datasetName );
+                H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
+                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();
+                imgBandDataspace.getSimpleExtentDims(imgDims);
+                if((xPxlOff + xSizeOut) > imgDims[1])
+                {
+                    throw KEAIOException("End X Pixel is not within image.");
+                }
+                if((yPxlOff + ySizeOut) > imgDims[0])
+                {
+                    throw KEAIOException("End Y Pixel is not within image.");
+                }
+                
+                codable = getChunkFilters(imgBandDataset, imgBandDT, chunkDims, &shuffleIdx, &deflateIdx, &deflateLevel);
+                if(codable)
+                {
+                    getChunkFillValue(imgBandDataset, imgBandDT, fillValue.data());
+                }
+            }
+            catch ( const H5::Exception &e) 
+            {
+                throw KEAIOException("Could not write image data.");
+            }
+            
+            // only whole chunks (cut short by the image edge) are written directly
+            codable = codable && ((xPxlOff % chunkDims[1]) == 0) && ((yPxlOff % chunkDims[0]) == 0) &&
+                        (xSizeOut == std::min<uint64_t>(chunkDims[1], imgDims[1] - xPxlOff)) &&
+                        (ySizeOut == std::min<uint64_t>(chunkDims[0], imgDims[0] - yPxlOff));
+            
+#ifdef KEA_HAVE_DIRECT_CHUNK_IO
+            if(!codable)
+#endif
+            {
+                std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+                this->transferImageBlockStrided(true, band, overview, data, xPxlOff, yPxlOff, xSizeOut, ySizeOut, 1, 1, 1, xSizeBuf, inDataType);
+                return;
+            }
+            
+#ifdef KEA_HAVE_DIRECT_CHUNK_IO
+            size_t numElmts = chunkDims[0] * chunkDims[1];
+            size_t chunkBytes = numElmts * pxlSize;
+            std::vector<uint8_t> chunk(chunkBytes);
+            const uint8_t *inData = (const uint8_t*)data;
+            KEAIOTimer encodeTimer(counters.encodeNanos);
+            
+            // edge chunks are stored whole, padded with the fill value
+            if((xSizeOut < chunkDims[1]) || (ySizeOut < chunkDims[0]))
+            {
+                for(size_t n = 0; n < numElmts; ++n)
+                {
+                    memcpy(chunk.data() + (n * pxlSize), fillValue.data(), pxlSize);
+                }
+            }
+            for(uint64_t y = 0; y < ySizeOut; ++y)
+            {
+                memcpy(chunk.data() + (y * chunkDims[1] * pxlSize), inData + (y * xSizeBuf * pxlSize), xSizeOut * pxlSize);
+            }
+            
+            if((shuffleIdx >= 0) && (pxlSize > 1))
+            {
+                std::vector<uint8_t> shuffled(chunkBytes);
+                for(size_t b = 0; b < pxlSize; ++b)
+                {
+                    uint8_t *bytes = shuffled.data() + (b * numElmts);
+                    for(size_t n = 0; n < numElmts; ++n)
+                    {
+                        bytes[n] = chunk[(n * pxlSize) + b];
+                    }
+                }
+                chunk.swap(shuffled);
+            }
+            
+            const uint8_t *encoded = chunk.data();
+            size_t encodedLen = chunkBytes;
+            uint32_t filterMask = 0;
+#ifdef KEA_HAVE_ZLIB
+            std::vector<uint8_t> deflated;
+            if(deflateIdx >= 0)
+            {
+                uLongf deflatedLen = compressBound(chunkBytes);
+                deflated.resize(deflatedLen);
+                if(compress2(deflated.data(), &deflatedLen, chunk.data(), chunkBytes, deflateLevel) != Z_OK)
+                {
+                    throw KEAIOException("Could not compress image data.");
+                }
+                // as HDF5 does, chunks that don't get smaller are stored as they are
+                if(deflatedLen < chunkBytes)
+                {
+                    encoded = deflated.data();
+                    encodedLen = deflatedLen;
+                }
+                else
+                {
+                    filterMask |= (1u << deflateIdx);
+                }
+            }
+#endif
+            encodeTimer.stop();
+            counters.chunksEncoded++;
+            
+            try 
+            {
+                std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+                KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+                counters.datasetOpens++;
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( datasetName );
+                hsize_t chunkOffset[2] = {yPxlOff, xPxlOff};
+                if(H5Dwrite_chunk(imgBandDataset.getId(), H5P_DEFAULT, filterMask, chunkOffset, encodedLen, encoded) < 0)
+                {
+                    throw KEAIOException("Could not write image data.");
+                }
+                counters.rawBytesWritten += encodedLen;
+                counters.bytesWritten += xSizeOut * ySizeOut * pxlSize;
+            }
+            catch ( const H5::Exception &e) 
+            {
+                throw KEAIOException("Could not write image data.");
+            }
+#endif
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
             throw e;
         }
@@ -912,797 +1838,745 @@ namespace kealib{
         {
             throw KEAIOException(e.what());
         }
-        
-        return value;
     }
     
-    std::vector<std::string> KEAImageIO::getImageMetaDataNames()
+    KEAIOStats KEAImageIO::getIOStats(uint32_t band)
     {
-        if(!this->fileOpen)
-        {
-            throw KEAIOException("Image was not open.");
-        }
-        
-        std::vector<std::string> metaDataNames;
-        
-        try 
+        KEAIOStats stats;
+        std::lock_guard<std::mutex> lock(this->ioCountersMutex);
+        for(size_t i = 0; i < this->ioCounters.size(); ++i)
         {
-            // Try to open dataset with overviewName
-            H5::Group imgBandMetaDataGrp = this->keaImgFile->openGroup(KEA_DATASETNAME_METADATA);
-            hsize_t numMetaDataItems = imgBandMetaDataGrp.getNumObjs();
-            
-            for(hsize_t i = 0; i < numMetaDataItems; ++i)
+            if((band == 0) || (band == i))
             {
-                metaDataNames.push_back(imgBandMetaDataGrp.getObjnameByIdx(i));
+                this->ioCounters[i]->addTo(&stats);
             }
         }
-        catch (const H5::Exception &e)
-        {
-            throw KEAIOException("Could not retrieve image meta data.");
-        }
-        catch ( const KEAIOException &e)
+        return stats;
+    }
+    
+    void KEAImageIO::resetIOStats(uint32_t band)
+    {
+        std::lock_guard<std::mutex> lock(this->ioCountersMutex);
+        for(size_t i = 0; i < this->ioCounters.size(); ++i)
         {
-            throw e;
+            if((band == 0) || (band == i))
+            {
+                this->ioCounters[i]->reset();
+            }
         }
-        catch ( const std::exception &e)
+    }
+    
+    KEAIOCounters& KEAImageIO::getIOCounters(uint32_t band)
+    {
+        std::lock_guard<std::mutex> lock(this->ioCountersMutex);
+        while(this->ioCounters.size() <= band)
         {
-            throw KEAIOException(e.what());
+            this->ioCounters.emplace_back(new KEAIOCounters());
         }
-        
-        return metaDataNames;
+        return *this->ioCounters[band];
     }
     
-    std::vector< std::pair<std::string, std::string> > KEAImageIO::getImageMetaData()
+    void KEAImageIO::prefetchImageBlocks(uint32_t band, uint32_t overview, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSize, uint64_t ySize)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        std::vector< std::pair<std::string, std::string> > metaData;
-        
-        try 
+        if(band == 0)
         {
-            // Try to open dataset with overviewName
-            H5::Group imgBandMetaDataGrp = this->keaImgFile->openGroup(KEA_DATASETNAME_METADATA);
-            hsize_t numMetaDataItems = imgBandMetaDataGrp.getNumObjs();
-            std::string name = "";
-            std::string value = "";
-            
-            for(hsize_t i = 0; i < numMetaDataItems; ++i)
-            {
-                name = imgBandMetaDataGrp.getObjnameByIdx(i);
-                value = this->getImageMetaData(name);
-                metaData.push_back(std::pair<std::string, std::string>(name,value));
-            }
+            throw KEAIOException("KEA Image Bands start at 1.");
         }
-        catch (const KEAIOException &e)
+        else if(band > this->numImgBands)
         {
-            throw e;
+            throw KEAIOException("Band is not present within image."); 
         }
-        catch (const H5::Exception &e)
+        if((xSize == 0) || (ySize == 0))
         {
-            throw KEAIOException("Could not retrieve image meta data.");
+            return;
         }
-        catch ( const std::exception &e)
+        
+        // it is the bands a virtual band uses which will be read
+        std::shared_ptr<KEABandExpression> expression = this->getBandExpression(band);
+        if((overview == 0) && expression)
         {
-            throw KEAIOException(e.what());
+            for(uint32_t inBand : expression->getBands())
+            {
+                this->prefetchImageBlocks(inBand, 0, xPxlOff, yPxlOff, xSize, ySize);
+            }
+            return;
         }
         
-        return metaData;
+#ifdef KEA_HAVE_DIRECT_CHUNK_IO
+        KEAPrefetchCache &cache = *this->prefetchCache;
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.pending.push_back({band, overview, xPxlOff, yPxlOff, xSize, ySize});
+        if(!cache.worker.joinable())
+        {
+            cache.worker = std::thread(&KEAImageIO::runPrefetch, this);
+        }
+        cache.wake.notify_one();
+#endif
     }
     
-    void KEAImageIO::setImageMetaData(const std::vector< std::pair<std::string, std::string> > &data)
+    void KEAImageIO::runPrefetch()
     {
-        if(!this->fileOpen)
-        {
-            throw KEAIOException("Image was not open.");
-        }
-        
-        try 
+        KEAPrefetchCache &cache = *this->prefetchCache;
+        std::unique_lock<std::mutex> lock(cache.mutex);
+        while(true)
         {
-            for(auto iterMetaData = data.begin(); iterMetaData != data.end(); ++iterMetaData)
+            cache.wake.wait(lock, [&cache]() { return cache.stop || !cache.pending.empty(); });
+            if(cache.stop)
             {
-                this->setImageMetaData(iterMetaData->first, iterMetaData->second);
+                return;
             }
-            
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-        }
-        catch (const H5::Exception &e)
-        {
-            throw KEAIOException("Could not set image band meta data.");
-        }
-        catch ( const KEAIOException &e)
-        {
-            throw e;
-        }
-        catch ( const std::exception &e)
-        {
-            throw KEAIOException(e.what());
+            KEAPrefetchCache::Window window = cache.pending.front();
+            cache.pending.pop_front();
+            lock.unlock();
+            try
+            {
+                this->prefetchWindow(window.band, window.overview, window.xPxlOff, window.yPxlOff, window.xSize, window.ySize);
+            }
+            catch(...)
+            {
+                // only advice - the read will report any problem
+            }
+            lock.lock();
         }
     }
     
-    void KEAImageIO::setImageBandMetaData(uint32_t band, const std::string &name, const std::string &value)
+    void KEAImageIO::prefetchWindow(uint32_t band, uint32_t overview, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSize, uint64_t ySize)
     {
-        if(!this->fileOpen)
+#ifdef KEA_HAVE_DIRECT_CHUNK_IO
+        KEAPrefetchCache &cache = *this->prefetchCache;
+        KEAIOCounters &counters = this->getIOCounters(band);
+        std::string datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DATA;
+        if(overview > 0)
         {
-            throw KEAIOException("Image was not open.");
+            datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
         }
         
-        // FORM META-DATA PATH WITHIN THE H5 FILE 
-        std::string metaDataH5Path = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA + std::string("/") + name;
-        
-        // WRITE IMAGE BAND META DATA
-        try 
-        {
-            // OPEN DATASET OR CREATE NEW DATASET IF IT DOES NOT EXIST
-            H5::StrType strTypeAll(0, H5T_VARIABLE);
-            H5::DataSet datasetMetaData;
-            try 
+        hsize_t chunkDims[2] = {0, 0};
+        int shuffleIdx = -1;
+        int deflateIdx = -1;
+        size_t pxlSize = 0;
+        {
+            std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+            // not worth reopening a file closed by the file limits, and
+            // chunks of a file being written could change after they are cached
+            unsigned int intent = 0;
+            if((this->keaImgFile == nullptr) || (H5Fget_intent(this->keaImgFile->getId(), &intent) < 0) || (intent & H5F_ACC_RDWR))
             {
-                datasetMetaData = this->keaImgFile->openDataSet( metaDataH5Path );
+                return;
             }
-            catch (const H5::Exception &e)
+            KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+            counters.datasetOpens++;
+            H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( datasetName );
+            H5::DataType imgBandDT = convertDatatypeKeaToH5Native(this->getImageBandDataType(band));
+            pxlSize = imgBandDT.getSize();
+            unsigned int deflateLevel = 0;
+            if(!getChunkFilters(imgBandDataset, imgBandDT, chunkDims, &shuffleIdx, &deflateIdx, &deflateLevel))
             {
-                hsize_t	dimsForStr[1];
-                dimsForStr[0] = 1; // number of lines;
-                H5::DataSpace dataspaceStrAll(1, dimsForStr);
-                datasetMetaData = this->keaImgFile->createDataSet(metaDataH5Path, strTypeAll, dataspaceStrAll);
-                
+                return;
             }
-            // WRITE DATA INTO THE DATASET
-            const char *wStrdata[1];
-            wStrdata[0] = value.c_str();			
-            datasetMetaData.write((void*)wStrdata, strTypeAll);
-            datasetMetaData.close();
             
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-        }
-        catch (const H5::Exception &e) 
-        {
-            throw KEAIOException("Could not set image band meta-data.");
-        }
-        catch ( const KEAIOException &e)
-        {
-            throw e;
+            hsize_t imgDims[2];
+            imgBandDataset.getSpace().getSimpleExtentDims(imgDims);
+            if((xPxlOff >= imgDims[1]) || (yPxlOff >= imgDims[0]))
+            {
+                return;
+            }
+            xSize = std::min<uint64_t>(xSize, imgDims[1] - xPxlOff);
+            ySize = std::min<uint64_t>(ySize, imgDims[0] - yPxlOff);
         }
-        catch ( const std::exception &e)
+        
+        uint64_t xEnd = xPxlOff + xSize;
+        uint64_t yEnd = yPxlOff + ySize;
+        uint64_t chunkColStart = xPxlOff / chunkDims[1];
+        uint64_t numChunkCols = ((xEnd - 1) / chunkDims[1]) - chunkColStart + 1;
+        size_t chunkBytes = chunkDims[0] * chunkDims[1] * pxlSize;
+        std::vector<std::vector<uint8_t> > rawChunks(numChunkCols);
+        std::vector<uint32_t> filterMasks(numChunkCols, 0);
+        std::vector<bool> fetched(numChunkCols, false);
+        std::vector<uint8_t> inflated(chunkBytes);
+        std::vector<uint8_t> unshuffled(chunkBytes);
+        
+        // no more than the cache holds, or the start would be dropped for the end
+        size_t windowBytes = 0;
+        for(uint64_t chunkY = (yPxlOff / chunkDims[0]) * chunkDims[0]; (chunkY < yEnd) && !cache.stop; chunkY += chunkDims[0])
         {
-            throw KEAIOException(e.what());
+            {
+                std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+                if(this->keaImgFile == nullptr)
+                {
+                    return;
+                }
+                KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+                counters.datasetOpens++;
+                H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( datasetName );
+                for(uint64_t i = 0; i < numChunkCols; ++i)
+                {
+                    hsize_t chunkOffset[2] = {chunkY, (chunkColStart + i) * chunkDims[1]};
+                    hsize_t storedBytes = 0;
+                    // unwritten chunks are quick to fill when read anyway
+                    fetched[i] = !cache.contains(KEAPrefetchCache::ChunkKey(band, overview, chunkOffset[0], chunkOffset[1])) &&
+                                 getChunkStorageSize(imgBandDataset, chunkOffset, &storedBytes);
+                    if(!fetched[i])
+                    {
+                        continue;
+                    }
+                    rawChunks[i].resize(storedBytes);
+                    if(H5Dread_chunk(imgBandDataset.getId(), H5P_DEFAULT, chunkOffset, &filterMasks[i], rawChunks[i].data()) < 0)
+                    {
+                        throw KEAIOException("Could not read image data.");
+                    }
+                    counters.rawBytesRead += storedBytes;
+                }
+            }
+            
+            for(uint64_t i = 0; i < numChunkCols; ++i)
+            {
+                if(!fetched[i])
+                {
+                    continue;
+                }
+                windowBytes += chunkBytes;
+                if(windowBytes > KEA_PREFETCH_CACHE_BYTES)
+                {
+                    return;
+                }
+                KEAIOTimer decodeTimer(counters.decodeNanos);
+                const uint8_t *chunk = decodeChunk(rawChunks[i], filterMasks[i], shuffleIdx, deflateIdx, pxlSize, chunkBytes, inflated, unshuffled);
+                decodeTimer.stop();
+                counters.chunksDecoded++;
+                cache.put(KEAPrefetchCache::ChunkKey(band, overview, chunkY, (chunkColStart + i) * chunkDims[1]), std::vector<uint8_t>(chunk, chunk + chunkBytes));
+            }
         }
+#endif
     }
     
-    std::string KEAImageIO::getImageBandMetaData(uint32_t band, const std::string &name)
+    void KEAImageIO::stopPrefetch()
     {
-        if(!this->fileOpen)
-        {
-            throw KEAIOException("Image was not open.");
-        }
-        
-        std::string metaDataH5Path = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA + std::string("/") + name;
-        std::string value = "";
-        // READ IMAGE BAND META-DATA
-        try 
-        {
-            H5::DataSet datasetMetaData = this->keaImgFile->openDataSet( metaDataH5Path );
-            H5::DataType strDataType = datasetMetaData.getDataType();
-            value = readString(datasetMetaData, strDataType);
-            datasetMetaData.close();
-        } 
-        catch ( const H5::Exception &e) 
-        {
-            throw KEAIOException("Meta-data variable was not accessable.");
-        }
-        catch ( const KEAIOException &e)
+        KEAPrefetchCache &cache = *this->prefetchCache;
         {
-            throw e;
+            std::lock_guard<std::mutex> lock(cache.mutex);
+            cache.stop = true;
+            cache.wake.notify_one();
         }
-        catch ( const std::exception &e)
+        if(cache.worker.joinable())
         {
-            throw KEAIOException(e.what());
+            cache.worker.join();
         }
         
-        return value;
+        // ready to start again if another file is opened
+        std::lock_guard<std::mutex> lock(cache.mutex);
+        cache.stop = false;
+        cache.pending.clear();
+        cache.chunks.clear();
+        cache.index.clear();
+        cache.bytes = 0;
     }
     
-    std::vector<std::string> KEAImageIO::getImageBandMetaDataNames(uint32_t band)
+    bool KEAImageIO::getAllocatedPixelCount(uint32_t band, uint32_t overview, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSize, uint64_t ySize, uint64_t *count)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        std::vector<std::string> metaDataNames;
-        
-        std::string metaDataGroupName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA;
         try 
         {
-            // Try to open dataset with overviewName
-            H5::Group imgBandMetaDataGrp = this->keaImgFile->openGroup(metaDataGroupName);
-            hsize_t numMetaDataItems = imgBandMetaDataGrp.getNumObjs();
+            if(band == 0)
+            {
+                throw KEAIOException("KEA Image Bands start at 1.");
+            }
+            else if(band > this->numImgBands)
+            {
+                throw KEAIOException("Band is not present within image."); 
+            }
+            *count = 0;
             
-            for(hsize_t i = 0; i < numMetaDataItems; ++i)
+            // virtual bands have a value everywhere
+            if((overview == 0) && this->getBandExpression(band))
             {
-                metaDataNames.push_back(imgBandMetaDataGrp.getObjnameByIdx(i));
+                if(((xPxlOff + xSize) > this->spatialInfoFile->xSize) || ((yPxlOff + ySize) > this->spatialInfoFile->ySize))
+                {
+                    throw KEAIOException("The window is not within image.");
+                }
+                *count = xSize * ySize;
+                return true;
             }
-        }
-        catch (const H5::Exception &e)
-        {
-            throw KEAIOException("Could not retrieve image band meta data.");
-        }
-        catch ( const KEAIOException &e)
-        {
-            throw e;
-        }
-        catch ( const std::exception &e)
-        {
-            throw KEAIOException(e.what());
-        }
-        
-        return metaDataNames;
-    }
-    
-    std::vector< std::pair<std::string, std::string> > KEAImageIO::getImageBandMetaData(uint32_t band)
-    {
-        if(!this->fileOpen)
-        {
-            throw KEAIOException("Image was not open.");
-        }
-        
-        std::vector< std::pair<std::string, std::string> > metaData;
-        
-        std::string metaDataGroupName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA;
-        try 
-        {
-            // Try to open dataset with overviewName
-            H5::Group imgBandMetaDataGrp = this->keaImgFile->openGroup(metaDataGroupName);
-            hsize_t numMetaDataItems = imgBandMetaDataGrp.getNumObjs();
-            std::string name = "";
-            std::string value = "";
             
-            for(hsize_t i = 0; i < numMetaDataItems; ++i)
+#ifdef KEA_HAVE_DIRECT_CHUNK_IO
+            std::string datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DATA;
+            if(overview > 0)
             {
-                name = imgBandMetaDataGrp.getObjnameByIdx(i);
-                value = this->getImageBandMetaData(band, name);
-                metaData.push_back(std::pair<std::string, std::string>(name,value));
+                datasetName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
             }
-        }
-        catch (const H5::Exception &e)
-        {
-            throw KEAIOException("Could not retrieve image band meta data.");
-        }
-        catch ( const KEAIOException &e)
-        {
-            throw e;
-        }
-        catch ( const std::exception &e)
-        {
-            throw KEAIOException(e.what());
-        }
-        
-        return metaData;
-    }
-    
-    void KEAImageIO::setImageBandMetaData(uint32_t band, const std::vector< std::pair<std::string, std::string> > &data)
-    {
-        if(!this->fileOpen)
-        {
-            throw KEAIOException("Image was not open.");
-        }
-        
-        try 
-        {
-            for(auto iterMetaData = data.begin(); iterMetaData != data.end(); ++iterMetaData)
+            H5::DataSet imgBandDataset = this->getH5File()->openDataSet( datasetName );
+            H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();
+            hsize_t imgDims[2];
+            imgBandDataspace.getSimpleExtentDims(imgDims);
+            if((xPxlOff + xSize) > imgDims[1])
             {
-                this->setImageBandMetaData(band, iterMetaData->first, iterMetaData->second);
+                throw KEAIOException("End X Pixel is not within image.");
+            }
+            if((yPxlOff + ySize) > imgDims[0])
+            {
+                throw KEAIOException("End Y Pixel is not within image.");
+            }
+            if((xSize == 0) || (ySize == 0))
+            {
+                return true;
             }
             
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-        }
-        catch (const H5::Exception &e)
-        {
-            throw KEAIOException("Could not set image band meta data.");
+            H5::DSetCreatPropList creationPList = imgBandDataset.getCreatePlist();
+            if(creationPList.getLayout() != H5D_CHUNKED)
+            {
+                *count = xSize * ySize;
+                return true;
+            }
+            hsize_t chunkDims[2] = {0, 0};
+            creationPList.getChunk(2, chunkDims);
+            
+            // chunks only get allocated when they leave the chunk cache
+            unsigned int intent = 0;
+            if((H5Fget_intent(this->getH5File()->getId(), &intent) >= 0) && (intent & H5F_ACC_RDWR))
+            {
+                H5Dflush(imgBandDataset.getId());
+            }
+            if(imgBandDataset.getStorageSize() == 0)
+            {
+                return true;
+            }
+            
+            uint64_t xEnd = xPxlOff + xSize;
+            uint64_t yEnd = yPxlOff + ySize;
+            for(uint64_t chunkY = (yPxlOff / chunkDims[0]) * chunkDims[0]; chunkY < yEnd; chunkY += chunkDims[0])
+            {
+                uint64_t rows = std::min<uint64_t>(yEnd, chunkY + chunkDims[0]) - std::max(yPxlOff, chunkY);
+                for(uint64_t chunkX = (xPxlOff / chunkDims[1]) * chunkDims[1]; chunkX < xEnd; chunkX += chunkDims[1])
+                {
+                    hsize_t chunkOffset[2] = {chunkY, chunkX};
+                    hsize_t storedBytes = 0;
+                    if(getChunkStorageSize(imgBandDataset, chunkOffset, &storedBytes))
+                    {
+                        *count += rows * (std::min<uint64_t>(xEnd, chunkX + chunkDims[1]) - std::max(xPxlOff, chunkX));
+                    }
+                }
+            }
+            return true;
+#else
+            return false;
+#endif
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
             throw e;
         }
+        catch( const H5::Exception &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
     }
     
-    void KEAImageIO::setImageBandDescription(uint32_t band, const std::string &description)
+    void KEAImageIO::createMask(uint32_t band, uint32_t deflate)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        std::string bandName = KEA_DATASETNAME_BAND + uint2Str(band);
-        
-        // WRITE IMAGE BAND DESCRIPTION
-        try 
-        {
-            H5::StrType strTypeAll(0, H5T_VARIABLE);
-            H5::DataSet datasetBandDescription = this->keaImgFile->openDataSet( bandName+KEA_BANDNAME_DESCRIP );
-            const char *wStrdata[1];
-            wStrdata[0] = description.c_str();			
-            datasetBandDescription.write((void*)wStrdata, strTypeAll);
-            datasetBandDescription.close();
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-        }
-        catch (const H5::Exception &e) 
-        {
-            throw KEAIOException("Could not set image band description.");
-        }
-        catch ( const KEAIOException &e)
-        {
-            throw e;
-        }
-        catch ( const std::exception &e)
+        if(!this->maskCreated(band))
         {
-            throw KEAIOException(e.what());
+            uint32_t blockSize2Use = getImageBlockSize(band);
+            int initFillVal = 255;
+            hsize_t dimsImageBandChunk[] = { blockSize2Use, blockSize2Use };
+            H5::DSetCreatPropList initParamsImgBand;
+            initParamsImgBand.setChunk(2, dimsImageBandChunk);
+            initParamsImgBand.setShuffle();
+            initParamsImgBand.setDeflate(deflate);
+            initParamsImgBand.setFillValue( H5::PredType::NATIVE_INT, &initFillVal);
+            
+            H5::StrType strdatatypeLen6(H5::PredType::C_S1, 6);
+            H5::StrType strdatatypeLen4(H5::PredType::C_S1, 4);
+            const H5std_string strClassVal ("IMAGE");
+            const H5std_string strImgVerVal ("1.2");
+            H5::DataSpace attr_dataspace = H5::DataSpace(H5S_SCALAR);
+            
+            std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+            hsize_t imageBandDims[] = { spatialInfoFile->ySize, spatialInfoFile->xSize };
+            H5::DataSpace imgBandDataSpace(2, imageBandDims);
+            H5::DataSet imgBandDataSet = this->getH5File()->createDataSet((imageBandPath+KEA_BANDNAME_MASK), H5::PredType::STD_U8LE, imgBandDataSpace, initParamsImgBand);
+            H5::Attribute classAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_CLASS, strdatatypeLen6, attr_dataspace);
+            classAttribute.write(strdatatypeLen6, strClassVal);
+            classAttribute.close();
+            
+            H5::Attribute imgVerAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_IMAGE_VERSION, strdatatypeLen4, attr_dataspace);
+            imgVerAttribute.write(strdatatypeLen4, strImgVerVal);
+            imgVerAttribute.close();
+            
+            imgBandDataSet.close();
+            imgBandDataSpace.close();
         }
     }
     
-    std::string KEAImageIO::getImageBandDescription(uint32_t band)
+    void KEAImageIO::writeImageBlock2BandMask(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut, uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        std::string bandName = KEA_DATASETNAME_BAND + uint2Str(band) + std::string("/") + KEA_BANDNAME_DESCRIP;
-        std::string description = "";
-        // READ IMAGE BAND DESCRIPTION
-        try 
-        {
-            H5::DataSet datasetBandDescription = this->keaImgFile->openDataSet( bandName );
-            H5::DataType strDataType = datasetBandDescription.getDataType();
-            description = readString(datasetBandDescription, strDataType);
-            datasetBandDescription.close();
-        } 
-        catch ( const H5::Exception &e) 
-        {
-            throw KEAIOException("Could not read band description.");
-        }
-        catch ( const KEAIOException &e)
-        {
-            throw e;
-        }
-        catch ( const std::exception &e)
-        {
-            throw KEAIOException(e.what());
-        }
-        
-        return description;
-    }
-    
-    
-    
-    void KEAImageIO::setNoDataValue(uint32_t band, const void *data, KEADataType inDataType)
-    {
-        if(!this->fileOpen)
+        try
         {
-            throw KEAIOException("Image was not open.");
-        }
-        
-        // READ IMAGE DATA TYPE
-        try 
-        {    
-            std::string noDataValPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_NO_DATA_VAL;
-            H5::DataSet datasetImgNDV;
-            H5::Attribute noDataDefAttribute;
-            
-            try 
+            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+            if(band == 0)
             {
-                datasetImgNDV = this->keaImgFile->openDataSet( noDataValPath );
+                throw KEAIOException("KEA Image Bands start at 1.");
             }
-            catch (const H5::Exception &e)
+            else if(band > this->numImgBands)
             {
-                hsize_t	dimsForNDV[1];
-                dimsForNDV[0] = 1; // number of lines;
-                H5::DataSpace dataspaceNDV(1, dimsForNDV);
-                
-                KEADataType imgDataType = this->getImageBandDataType(band);
-                H5::DataType imgBandDT = convertDatatypeKeaToH5STD(imgDataType);
-
-                datasetImgNDV = this->keaImgFile->createDataSet(noDataValPath, imgBandDT, dataspaceNDV);
+                throw KEAIOException("Band is not present within image.");
             }
             
-            try
+            uint64_t endXPxl = xPxlOff + xSizeOut;
+            uint64_t endYPxl = yPxlOff + ySizeOut;
+            
+            if(xPxlOff > this->spatialInfoFile->xSize)
             {
-                noDataDefAttribute = datasetImgNDV.openAttribute(KEA_NODATA_DEFINED);
+                throw KEAIOException("Start X Pixel is not within image.");
             }
-            catch (const H5::Exception &e)
+            
+            if(endXPxl > this->spatialInfoFile->xSize)
             {
-                H5::DataSpace attr_dataspace = H5::DataSpace(H5S_SCALAR);
-                noDataDefAttribute = datasetImgNDV.createAttribute(KEA_NODATA_DEFINED, H5::PredType::STD_I8LE, attr_dataspace);
+                throw KEAIOException("End X Pixel is not within image.");
             }
             
-            int val = 1;
-            noDataDefAttribute.write(H5::PredType::NATIVE_INT, &val);
-            noDataDefAttribute.close();
+            if(yPxlOff > this->spatialInfoFile->ySize)
+            {
+                throw KEAIOException("Start Y Pixel is not within image.");
+            }
             
-            H5::DataType dataDT = convertDatatypeKeaToH5Native(inDataType);
-            datasetImgNDV.write( data, dataDT );
-            datasetImgNDV.close();
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-        } 
-        catch ( const H5::Exception &e) 
-        {
-            throw KEAIOException("The image data type was not specified.");
-        }
-        catch ( const KEAIOException &e)
-        {
-            throw e;
-        }
-        catch ( const std::exception &e)
-        {
-            throw KEAIOException(e.what());
-        }
-    }
-    
-    void KEAImageIO::getNoDataValue(uint32_t band, void *data, KEADataType inDataType)
-    {
-        if(!this->fileOpen)
-        {
-            throw KEAIOException("Image was not open.");
-        }
-        
-        
-        // READ IMAGE BAND NO DATA VALUE
-        try 
-        {            
+            if(endYPxl > this->spatialInfoFile->ySize)
+            {
+                throw KEAIOException("End Y Pixel is not within image.");
+            }
+            
+            // GET NATIVE DATASET
             H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
-            hsize_t dimsValue[1];
-            dimsValue[0] = 1;
-            H5::DataSpace valueDataSpace(1, dimsValue);
-            H5::DataSet datasetImgNDV = this->keaImgFile->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_NO_DATA_VAL );
             
-            bool noDataDefined = true;
+            // OPEN BAND DATASET AND WRITE IMAGE DATA
             try
             {
-                H5::Attribute noDataDefAttribute = datasetImgNDV.openAttribute(KEA_NODATA_DEFINED);
-                int val = 1;
-                noDataDefAttribute.read(H5::PredType::NATIVE_INT, &val);
-                noDataDefAttribute.close();
+                std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( imageBandPath + KEA_BANDNAME_MASK );
+                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();
                 
-                if(val == 0)
+                hsize_t imgOffset[2];
+                imgOffset[0] = yPxlOff;
+                imgOffset[1] = xPxlOff;
+                hsize_t dataDims[2];
+                dataDims[0] = ySizeBuf;
+                dataDims[1] = xSizeBuf;
+                H5::DataSpace write2BandDataspace = H5::DataSpace(2, dataDims);
+                
+                if((ySizeOut != ySizeBuf) | (xSizeOut != xSizeBuf))
                 {
-                    noDataDefined = false;
+                    hsize_t dataSelectMemDims[2];
+                    dataSelectMemDims[0] = ySizeOut;
+                    dataSelectMemDims[1] = 1;
+                    
+                    hsize_t dataOffDims[2];
+                    dataOffDims[0] = 0;
+                    dataOffDims[1] = 0;
+                    
+                    hsize_t dataSelectStrideDims[2];
+                    dataSelectStrideDims[0] = 1;
+                    if(xSizeBuf == xSizeOut)
+                    {
+                        dataSelectStrideDims[1] = 1;
+                    }
+                    else
+                    {
+                        dataSelectStrideDims[1] = xSizeBuf - xSizeOut;
+                    }
+                    
+                    hsize_t dataSelectBlockSizeDims[2];
+                    dataSelectBlockSizeDims[0] = 1;
+                    dataSelectBlockSizeDims[1] = xSizeOut;
+                    write2BandDataspace.selectHyperslab(H5S_SELECT_SET, dataSelectMemDims, dataOffDims, dataSelectStrideDims, dataSelectBlockSizeDims);
+                    
+                    hsize_t dataOutDims[2];
+                    dataOutDims[0] = ySizeOut;
+                    dataOutDims[1] = xSizeOut;
+                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataOutDims, imgOffset);
                 }
+                else
+                {
+                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataDims, imgOffset);
+                }
+                
+                imgBandDataset.write( data, imgBandDT, write2BandDataspace, imgBandDataspace);
+                
+                imgBandDataset.close();
+                imgBandDataspace.close();
+                write2BandDataspace.close();
+                
+                this->getH5File()->flush(H5F_SCOPE_GLOBAL);
             }
             catch ( const H5::Exception &e)
             {
-                noDataDefined = true;
-            }
-            
-            if(noDataDefined)
-            {
-                datasetImgNDV.read(data, imgBandDT, valueDataSpace);
-            }
-            else
-            {
-                throw KEAIOException("The image band no data value was not defined.");
+                throw KEAIOException("Could not write image data.");
             }
-            datasetImgNDV.close();
-            valueDataSpace.close();
-        } 
-        catch ( const H5::Exception &e) 
-        {
-            throw KEAIOException("The image band no data value was not specified.");
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
             throw e;
         }
+        catch( const H5::FileIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSetIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSpaceIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataTypeIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
     }
     
-    void KEAImageIO::undefineNoDataValue(uint32_t band)
+    void KEAImageIO::readImageBlock2BandMask(uint32_t band, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        
-        // UNDEFINE THE NO DATA VALUE
         try
         {
-            H5::DataSet datasetImgNDV = this->keaImgFile->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_NO_DATA_VAL );
-            try
+            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+            if(band == 0)
             {
-                H5::Attribute noDataDefAttribute = datasetImgNDV.openAttribute(KEA_NODATA_DEFINED);
-                int val = 0;
-                noDataDefAttribute.write(H5::PredType::NATIVE_INT, &val);
-                noDataDefAttribute.close();
+                throw KEAIOException("KEA Image Bands start at 1.");
             }
-            catch ( const H5::Exception &e)
+            else if(band > this->numImgBands)
             {
-                H5::DataSpace attr_dataspace = H5::DataSpace(H5S_SCALAR);
-                H5::Attribute noDataDefAttribute = datasetImgNDV.createAttribute(KEA_NODATA_DEFINED, H5::PredType::STD_I8LE, attr_dataspace);
-                int val = 0;
-                noDataDefAttribute.write(H5::PredType::NATIVE_INT, &val);
-                noDataDefAttribute.close();
+                throw KEAIOException("Band is not present within image.");
             }
             
-            datasetImgNDV.close();
-        }
-        catch ( const H5::Exception &e)
-        {
-            throw KEAIOException("The image band no data value had not been created.");
-        }
-        catch ( const KEAIOException &e)
-        {
-            throw e;
-        }
-        catch ( const std::exception &e)
-        {
-            throw KEAIOException(e.what());
-        }
-    }
-    
-    std::vector<KEAImageGCP*>* KEAImageIO::getGCPs()
-    {
-        if(!this->fileOpen)
-        {
-            throw KEAIOException("Image was not open.");
-        }
-        
-        std::vector<KEAImageGCP*> *gcps = new std::vector<KEAImageGCP*>();
-        
-        
-        try
-        {            
-            uint32_t numGCPs = 0;
-            // Get the number of GCPs
-            try
+            uint64_t endXPxl = xPxlOff + xSizeIn;
+            uint64_t endYPxl = yPxlOff + ySizeIn;
+            
+            if(xPxlOff > this->spatialInfoFile->xSize)
             {
-                hsize_t dimsValue[1];
-                dimsValue[0] = 1;
-                H5::DataSpace valueDataSpace(1, dimsValue);
-                uint32_t value[1];
-                H5::DataSet datasetNumGCPs = this->keaImgFile->openDataSet( KEA_GCPS_NUM );
-                datasetNumGCPs.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
-                numGCPs = value[0];
-                datasetNumGCPs.close();
-                valueDataSpace.close();
+                throw KEAIOException("Start X Pixel is not within image.");
             }
-            catch (const H5::Exception &e)
+            
+            if(endXPxl > this->spatialInfoFile->xSize)
             {
-                throw KEAIOException("Could not read the number of GCPs.");
+                throw KEAIOException("End X Pixel is not within image.");
             }
-            catch ( const KEAIOException &e)
+            
+            if(yPxlOff > this->spatialInfoFile->ySize)
             {
-                throw e;
+                throw KEAIOException("Start Y Pixel is not within image.");
             }
-            catch ( const std::exception &e)
+            
+            if(endYPxl > this->spatialInfoFile->ySize)
             {
-                throw KEAIOException(e.what());
+                throw KEAIOException("End Y Pixel is not within image.");
             }
-
-            KEAImageGCP_HDF5 *gcpsHDF = new KEAImageGCP_HDF5[numGCPs];
             
+            // GET NATIVE DATASET
+            H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
+            
+            // OPEN BAND DATASET AND READ IMAGE DATA
             try
             {
-                H5::CompType *fieldDtMem = this->createGCPCompTypeMem();
-                H5::DataSet gcpsDataset = this->keaImgFile->openDataSet( KEA_GCPS_DATA );
-                
-                H5::DataSpace gcpsDataspace = gcpsDataset.getSpace();
-                hsize_t boolFieldOff[1];
-                boolFieldOff[0] = 0;
+                std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( imageBandPath + KEA_BANDNAME_MASK );
+                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();
                 
-                hsize_t boolFieldsDims[1];
-                boolFieldsDims[0] = numGCPs;
-                H5::DataSpace gcpsMemspace(1, boolFieldsDims);
+                hsize_t dataOffset[2];
+                dataOffset[0] = yPxlOff;
+                dataOffset[1] = xPxlOff;
+                hsize_t dataDims[2];
+                dataDims[0] = ySizeBuf;
+                dataDims[1] = xSizeBuf;
+                H5::DataSpace read2BandDataspace = H5::DataSpace(2, dataDims);
                 
-                gcpsDataspace.selectHyperslab( H5S_SELECT_SET, boolFieldsDims, boolFieldOff );
-                H5::DSetMemXferPropList xfer;
-                /* Ensures that malloc()/free() are from the same C runtime */
-                xfer.setVlenMemManager(kealibmalloc, nullptr, kealibfree, nullptr);
-                gcpsDataset.read(gcpsHDF, *fieldDtMem, gcpsMemspace, gcpsDataspace, xfer);
+                if((ySizeBuf != ySizeIn) | (xSizeBuf != xSizeIn))
+                {
+                    hsize_t dataSelectMemDims[2];
+                    dataSelectMemDims[0] = ySizeIn;
+                    dataSelectMemDims[1] = 1;
+                    
+                    hsize_t dataOffDims[2];
+                    dataOffDims[0] = 0;
+                    dataOffDims[1] = 0;
+                    
+                    hsize_t dataSelectStrideDims[2];
+                    dataSelectStrideDims[0] = 1;
+                    if(xSizeBuf == xSizeIn)
+                    {
+                        dataSelectStrideDims[1] = 1;
+                    }
+                    else
+                    {
+                        dataSelectStrideDims[1] = xSizeBuf - xSizeIn;
+                    }
+                    
+                    hsize_t dataSelectBlockSizeDims[2];
+                    dataSelectBlockSizeDims[0] = 1;
+                    dataSelectBlockSizeDims[1] = xSizeIn;
+                    read2BandDataspace.selectHyperslab(H5S_SELECT_SET, dataSelectMemDims, dataOffDims, dataSelectStrideDims, dataSelectBlockSizeDims);
+                    
+                    hsize_t dataInDims[2];
+                    dataInDims[0] = ySizeIn;
+                    dataInDims[1] = xSizeIn;
+                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataInDims, dataOffset);
+                }
+                else
+                {
+                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataDims, dataOffset);
+                }
                 
-                gcpsDataset.close();
-                gcpsDataspace.close();
-                gcpsMemspace.close();
+                imgBandDataset.read( data, imgBandDT, read2BandDataspace, imgBandDataspace);
                 
-                delete fieldDtMem;
-            }
-            catch( const H5::Exception &e )
-            {
-                throw KEAIOException(e.getDetailMsg());
+                imgBandDataset.close();
+                imgBandDataspace.close();
+                read2BandDataspace.close();
             }
-            
-            KEAImageGCP *tmpGCP = nullptr;
-            for(uint32_t i = 0; i < numGCPs; ++i)
+            catch ( const H5::Exception &e)
             {
-                tmpGCP = new KEAImageGCP();
-                tmpGCP->pszId = std::string(gcpsHDF[i].pszId);
-                free(gcpsHDF[i].pszId);
-                tmpGCP->pszInfo = std::string(gcpsHDF[i].pszInfo);
-                free(gcpsHDF[i].pszInfo);
-                tmpGCP->dfGCPLine = gcpsHDF[i].dfGCPLine;
-                tmpGCP->dfGCPPixel = gcpsHDF[i].dfGCPPixel;
-                tmpGCP->dfGCPX = gcpsHDF[i].dfGCPX;
-                tmpGCP->dfGCPY = gcpsHDF[i].dfGCPY;
-                tmpGCP->dfGCPZ = gcpsHDF[i].dfGCPZ;
-                gcps->push_back(tmpGCP);
+                throw KEAIOException("Could not read image data.");
             }
-            
-            delete[] gcpsHDF;
-        }
-        catch (const H5::Exception &e)
-        {
-            throw KEAIOException(e.getCDetailMsg());
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
             throw e;
         }
+        catch( const H5::FileIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSetIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSpaceIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataTypeIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
-        
-        return gcps;
     }
     
-    void KEAImageIO::setGCPs(std::vector<KEAImageGCP*> *gcps, const std::string &projWKT)
+    bool KEAImageIO::maskCreated(uint32_t band)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        uint32_t numGCPs = gcps->size();
-        
-        KEAImageGCP_HDF5 *gcpsHDF = new KEAImageGCP_HDF5[numGCPs];
-        
-        uint32_t i = 0;
-        for(auto iterGCP = gcps->begin(); iterGCP != gcps->end(); ++iterGCP)
+        // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+        if(band == 0)
         {
-            // Copy the char from one to the other for PSZ ID.
-            const size_t lenPSZId = strlen((*iterGCP)->pszId.c_str());
-            gcpsHDF[i].pszId = new char[lenPSZId + 1];
-            strncpy(gcpsHDF[i].pszId, (*iterGCP)->pszId.c_str(), lenPSZId);
-            gcpsHDF[i].pszId[lenPSZId] = '\0';
-            
-            // Copy the char from one to the other for PSZ INFO.
-            const size_t lenPSZInfo = strlen((*iterGCP)->pszInfo.c_str());
-            gcpsHDF[i].pszInfo = new char[lenPSZInfo + 1];
-            strncpy(gcpsHDF[i].pszInfo, (*iterGCP)->pszInfo.c_str(), lenPSZInfo);
-            gcpsHDF[i].pszInfo[lenPSZInfo] = '\0';
-            
-            gcpsHDF[i].dfGCPPixel = (*iterGCP)->dfGCPPixel;
-            gcpsHDF[i].dfGCPLine = (*iterGCP)->dfGCPLine;
-            gcpsHDF[i].dfGCPX = (*iterGCP)->dfGCPX;
-            gcpsHDF[i].dfGCPY = (*iterGCP)->dfGCPY;
-            gcpsHDF[i].dfGCPZ = (*iterGCP)->dfGCPZ;            
-            
-            ++i;
+            throw KEAIOException("KEA Image Bands start at 1.");
+        }
+        else if(band > this->numImgBands)
+        {
+            throw KEAIOException("Band is not present within image.");
         }
         
+        bool maskPresent = false;
+        std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
         try
         {
-            // Open or create the GCPs dataset 
-            try
+            H5::Group imgBandGrp = this->getH5File()->openGroup(imageBandPath);
+            hsize_t numItems = imgBandGrp.getNumObjs();
+            for(hsize_t i = 0; i < numItems; ++i)
             {
-                H5::DataSet gcpsDataset = this->keaImgFile->openDataSet(KEA_GCPS_DATA);
-                H5::DataSpace gcpsWriteDataSpace = gcpsDataset.getSpace();
-                
-                H5::CompType *fieldDtMem = this->createGCPCompTypeMem();
-                
-                hsize_t gcpsDataDims[1];
-                gcpsWriteDataSpace.getSimpleExtentDims(gcpsDataDims);
-                
-                if(numGCPs > gcpsDataDims[0])
+                //std::cout << "Item: " << imgBandGrp.getObjnameByIdx(i) << std::endl;
+                if(imgBandGrp.getObjnameByIdx(i) == "MASK")
                 {
-                    hsize_t extendGCPsDatasetTo[1];
-                    extendGCPsDatasetTo[0] = numGCPs;
-                    gcpsDataset.extend( extendGCPsDatasetTo );
+                    maskPresent = true;
+                    break;
                 }
-                
-                hsize_t gcpsOffset[1];
-                gcpsOffset[0] = 0;
-                gcpsDataDims[0] = numGCPs;
-                
-                gcpsWriteDataSpace.close();
-                gcpsWriteDataSpace = gcpsDataset.getSpace();
-                gcpsWriteDataSpace.selectHyperslab(H5S_SELECT_SET, gcpsDataDims, gcpsOffset);
-                H5::DataSpace newGCPsDataspace = H5::DataSpace(1, gcpsDataDims);
-                
-                gcpsDataset.write(gcpsHDF, *fieldDtMem, newGCPsDataspace, gcpsWriteDataSpace);
-                
-                gcpsWriteDataSpace.close();
-                newGCPsDataspace.close();
-                gcpsDataset.close();
-                
-                delete fieldDtMem;
             }
-            catch ( const H5::Exception &e)
+            imgBandGrp.close();
+            //H5::DataSet imgBandDataset = this->getH5File()->openDataSet(imageBandPath+KEA_BANDNAME_MASK);
+            //imgBandDataset.close();
+            
+        }
+        catch (const H5::Exception &e)
+        {
+            maskPresent = false;
+        }
+        
+        return maskPresent;
+    }
+    
+    
+    void KEAImageIO::setImageMetaData(const std::string &name, const std::string &value)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        // FORM META-DATA PATH WITHIN THE H5 FILE 
+        std::string metaDataH5Path = KEA_DATASETNAME_METADATA + std::string("/") + name;
+        
+        // WRITE IMAGE META DATA
+        try 
+        {
+            // OPEN DATASET OR CREATE NEW DATASET IF IT DOES NOT EXIST
+            H5::StrType strTypeAll(0, H5T_VARIABLE);
+            H5::DataSet datasetMetaData;
+            try 
             {
-                H5::CompType *fieldDtDisk = this->createGCPCompTypeDisk();
-                H5::CompType *fieldDtMem = this->createGCPCompTypeMem();
-                
-                hsize_t initDimsGCPsDS[1];
-                initDimsGCPsDS[0] = numGCPs;
-                hsize_t maxDimsGCPsDS[1];
-                maxDimsGCPsDS[0] = H5S_UNLIMITED;
-                H5::DataSpace gcpsDataSpace = H5::DataSpace(1, initDimsGCPsDS, maxDimsGCPsDS);
-                
-                hsize_t dimsGCPsChunk[1];
-                dimsGCPsChunk[0] = numGCPs;
-                
-                H5::DSetCreatPropList creationGCPsDSPList;
-                creationGCPsDSPList.setChunk(1, dimsGCPsChunk);
-                creationGCPsDSPList.setShuffle();
-                creationGCPsDSPList.setDeflate(1);
-                H5::DataSet gcpsDataset = this->keaImgFile->createDataSet(KEA_GCPS_DATA, *fieldDtDisk, gcpsDataSpace, creationGCPsDSPList);
-                
-                hsize_t gcpsOffset[1];
-                gcpsOffset[0] = 0;
-                hsize_t gcpsDataDims[1];
-                gcpsDataDims[0] = numGCPs;
-                
-                H5::DataSpace gcpsWriteDataSpace = gcpsDataset.getSpace();
-                gcpsWriteDataSpace.selectHyperslab(H5S_SELECT_SET, gcpsDataDims, gcpsOffset);
-                H5::DataSpace newGCPsDataspace = H5::DataSpace(1, gcpsDataDims);
-                
-                gcpsDataset.write(gcpsHDF, *fieldDtMem, newGCPsDataspace, gcpsWriteDataSpace);
-                
-                gcpsDataSpace.close();
-                gcpsWriteDataSpace.close();
-                newGCPsDataspace.close();
-                gcpsDataset.close();                
-                
-                delete fieldDtDisk;
-                delete fieldDtMem;
-            }
-            
-            
-            // Set the number of GCPs
-            try
-            {
-                H5::DataSet numBandsDataset;
-                try
-                {
-                    // open the dataset
-                    numBandsDataset = this->keaImgFile->openDataSet(KEA_GCPS_NUM);
-                }
-                catch (const H5::Exception &e)
-                {
-                    // create the dataset if it does not exist
-                    hsize_t dimsNumBands[] = { 1 };
-                    H5::DataSpace numBandsDataSpace(1, dimsNumBands);
-                    numBandsDataset = this->keaImgFile->createDataSet(KEA_GCPS_NUM, H5::PredType::STD_U32LE, numBandsDataSpace);
-                    numBandsDataSpace.close();
-                }
-                numBandsDataset.write(&numGCPs, H5::PredType::NATIVE_UINT32);
-                numBandsDataset.close();
+                datasetMetaData = this->getH5File()->openDataSet( metaDataH5Path );
             }
             catch (const H5::Exception &e)
             {
-                throw KEAIOException("Could not write the number of GCPs.");
-            }
-            catch ( const KEAIOException &e)
-            {
-                throw e;
-            }
-            catch ( const std::exception &e)
-            {
-                throw KEAIOException(e.what());
+                hsize_t	dimsForStr[1];
+                dimsForStr[0] = 1; // number of lines;
+                H5::DataSpace dataspaceStrAll(1, dimsForStr);
+                datasetMetaData = this->getH5File()->createDataSet(metaDataH5Path, strTypeAll, dataspaceStrAll);
+
             }
+            // WRITE DATA INTO THE DATASET
+            const char *wStrdata[1];
+            wStrdata[0] = value.c_str();			
+            datasetMetaData.write((void*)wStrdata, strTypeAll);
+            datasetMetaData.close();
+            
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
         }
-        catch (const H5::Exception &e)
+        catch (const H5::Exception &e) 
         {
-            throw KEAIOException(e.getCDetailMsg());
+            throw KEAIOException("Could not set image meta-data.");
         }
         catch ( const KEAIOException &e)
         {
@@ -1712,20 +2586,28 @@ namespace kealib{
         {
             throw KEAIOException(e.what());
         }
-        
-        for(uint32_t j = 0; j < i; j++)
+    }
+    
+    std::string KEAImageIO::getImageMetaData(const std::string &name)
+    {
+        if(!this->fileOpen)
         {
-            delete[] gcpsHDF[j].pszId;
-            delete[] gcpsHDF[j].pszInfo;
+            throw KEAIOException("Image was not open.");
         }
         
-        delete[] gcpsHDF;
-        
-        
-        // Set the projection string
-        try
+        std::string metaDataH5Path = KEA_DATASETNAME_METADATA + std::string("/") + name;
+        std::string value = "";
+        // READ IMAGE META-DATA
+        try 
         {
-            this->setGCPProjection(projWKT);
+            H5::DataSet datasetMetaData = this->getH5File()->openDataSet( metaDataH5Path );
+            H5::DataType strDataType = datasetMetaData.getDataType();
+            value = readString(datasetMetaData, strDataType);
+            datasetMetaData.close();
+        } 
+        catch ( const H5::Exception &e) 
+        {
+            throw KEAIOException("Meta-data variable was not accessable.");
         }
         catch ( const KEAIOException &e)
         {
@@ -1736,90 +2618,104 @@ namespace kealib{
             throw KEAIOException(e.what());
         }
         
+        return value;
     }
     
-    uint32_t KEAImageIO::getGCPCount()
+    std::vector<std::string> KEAImageIO::getImageMetaDataNames()
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        // READ NUMBER OF GCPs
-        uint32_t numGCPs = 0;
-        try
+        std::vector<std::string> metaDataNames;
+        
+        try 
         {
-            hsize_t dimsValue[1];
-            dimsValue[0] = 1;
-            H5::DataSpace valueDataSpace(1, dimsValue);
-            uint32_t value[1];
-            H5::DataSet datasetNumGCPs = this->keaImgFile->openDataSet( KEA_GCPS_NUM );
-            datasetNumGCPs.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
-            numGCPs = value[0];
-            datasetNumGCPs.close();
-            valueDataSpace.close();
+            // Try to open dataset with overviewName
+            H5::Group imgBandMetaDataGrp = this->getH5File()->openGroup(KEA_DATASETNAME_METADATA);
+            hsize_t numMetaDataItems = imgBandMetaDataGrp.getNumObjs();
+            
+            for(hsize_t i = 0; i < numMetaDataItems; ++i)
+            {
+                metaDataNames.push_back(imgBandMetaDataGrp.getObjnameByIdx(i));
+            }
         }
-        catch ( const H5::Exception &e)
+        catch (const H5::Exception &e)
         {
-            throw KEAIOException("The number of image bands was not specified.");
+            throw KEAIOException("Could not retrieve image meta data.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
         }
         
-        return numGCPs;
+        return metaDataNames;
     }
     
-    std::string KEAImageIO::getGCPProjection()
+    std::vector< std::pair<std::string, std::string> > KEAImageIO::getImageMetaData()
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        // READ WKT STRING
-        std::string gcpProj = "";
-        try
+        std::vector< std::pair<std::string, std::string> > metaData;
+        
+        try 
         {
-            H5::DataSet datasetGCPSpatialReference = this->keaImgFile->openDataSet( KEA_GCPS_PROJ );
-            H5::DataType strDataType = datasetGCPSpatialReference.getDataType();
-            gcpProj = readString(datasetGCPSpatialReference, strDataType);
-            datasetGCPSpatialReference.close();
+            // Try to open dataset with overviewName
+            H5::Group imgBandMetaDataGrp = this->getH5File()->openGroup(KEA_DATASETNAME_METADATA);
+            hsize_t numMetaDataItems = imgBandMetaDataGrp.getNumObjs();
+            std::string name = "";
+            std::string value = "";
+            
+            for(hsize_t i = 0; i < numMetaDataItems; ++i)
+            {
+                name = imgBandMetaDataGrp.getObjnameByIdx(i);
+                value = this->getImageMetaData(name);
+                metaData.push_back(std::pair<std::string, std::string>(name,value));
+            }
         }
-        catch ( const H5::Exception &e)
+        catch (const KEAIOException &e)
         {
-            throw KEAIOException("The spatial reference was not specified.");
+            throw e;
+        }
+        catch (const H5::Exception &e)
+        {
+            throw KEAIOException("Could not retrieve image meta data.");
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
         }
         
-        return gcpProj;
+        return metaData;
     }
     
-    void KEAImageIO::setGCPProjection(const std::string &projWKT)
+    void KEAImageIO::setImageMetaData(const std::vector< std::pair<std::string, std::string> > &data)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        // SET THE WKT STRING SPATAIL REFERENCE IN GLOBAL HEADER
-        try
+        try 
         {
-            const char *wStrdata[1];
-            H5::DataSet datasetSpatialReference = this->keaImgFile->openDataSet(KEA_GCPS_PROJ);
-            H5::DataType strDataType = datasetSpatialReference.getDataType();
-            wStrdata[0] = projWKT.c_str();
-            datasetSpatialReference.write((void*)wStrdata, strDataType);
-            datasetSpatialReference.close();
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
+            for(auto iterMetaData = data.begin(); iterMetaData != data.end(); ++iterMetaData)
+            {
+                this->setImageMetaData(iterMetaData->first, iterMetaData->second);
+            }
+            
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
         }
         catch (const H5::Exception &e)
         {
-            const char *wStrdata[1];
-			hsize_t	dimsForStr[1];
-			dimsForStr[0] = 1; // number of lines;
-            H5::DataSpace dataspaceStrAll(1, dimsForStr);
-            H5::StrType strTypeAll(0, H5T_VARIABLE);
-            H5::DataSet datasetSpatialReference = this->keaImgFile->createDataSet(KEA_GCPS_PROJ, strTypeAll, dataspaceStrAll);
-			wStrdata[0] = projWKT.c_str();
-			datasetSpatialReference.write((void*)wStrdata, strTypeAll);
-			datasetSpatialReference.close();
+            throw KEAIOException("Could not set image band meta data.");
         }
         catch ( const KEAIOException &e)
         {
@@ -1831,50 +2727,45 @@ namespace kealib{
         }
     }
     
-    void KEAImageIO::setSpatialInfo(KEAImageSpatialInfo *inSpatialInfo)
+    void KEAImageIO::setImageBandMetaData(uint32_t band, const std::string &name, const std::string &value)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
+        // FORM META-DATA PATH WITHIN THE H5 FILE 
+        std::string metaDataH5Path = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA + std::string("/") + name;
+        
+        // WRITE IMAGE BAND META DATA
         try 
         {
-            // SET X AND Y TL IN GLOBAL HEADER
-            double doubleVals[2];
-            doubleVals[0] = inSpatialInfo->tlX;
-            doubleVals[1] = inSpatialInfo->tlY;
-            H5::DataSet spatialTLDataset = this->keaImgFile->openDataSet(KEA_DATASETNAME_HEADER_TL);
-			spatialTLDataset.write( doubleVals, H5::PredType::NATIVE_DOUBLE );
-            spatialTLDataset.close();
-            
-            // SET X AND Y RESOLUTION IN GLOBAL HEADER
-            doubleVals[0] = inSpatialInfo->xRes;
-            doubleVals[1] = inSpatialInfo->yRes;
-            H5::DataSet spatialResDataset = this->keaImgFile->openDataSet(KEA_DATASETNAME_HEADER_RES);
-			spatialResDataset.write( doubleVals, H5::PredType::NATIVE_DOUBLE );
-            spatialResDataset.close();
-            
-            // SET X AND Y ROTATION IN GLOBAL HEADER
-            doubleVals[0] = inSpatialInfo->xRot;
-            doubleVals[1] = inSpatialInfo->yRot;
-            H5::DataSet spatialRotDataset = this->keaImgFile->openDataSet(KEA_DATASETNAME_HEADER_ROT);
-			spatialRotDataset.write( doubleVals, H5::PredType::NATIVE_DOUBLE );
-            spatialRotDataset.close();
-            
-            // SET THE WKT STRING SPATAIL REFERENCE IN GLOBAL HEADER
-			const char *wStrdata[1];
-            H5::DataSet datasetSpatialReference = this->keaImgFile->openDataSet(KEA_DATASETNAME_HEADER_WKT);
-            H5::DataType strDataType = datasetSpatialReference.getDataType();
-			wStrdata[0] = inSpatialInfo->wktString.c_str();			
-			datasetSpatialReference.write((void*)wStrdata, strDataType);
-			datasetSpatialReference.close();
+            // OPEN DATASET OR CREATE NEW DATASET IF IT DOES NOT EXIST
+            H5::StrType strTypeAll(0, H5T_VARIABLE);
+            H5::DataSet datasetMetaData;
+            try 
+            {
+                datasetMetaData = this->getH5File()->openDataSet( metaDataH5Path );
+            }
+            catch (const H5::Exception &e)
+            {
+                hsize_t	dimsForStr[1];
+                dimsForStr[0] = 1; // number of lines;
+                H5::DataSpace dataspaceStrAll(1, dimsForStr);
+                datasetMetaData = this->getH5File()->createDataSet(metaDataH5Path, strTypeAll, dataspaceStrAll);
+                
+            }
+            // WRITE DATA INTO THE DATASET
+            const char *wStrdata[1];
+            wStrdata[0] = value.c_str();			
+            datasetMetaData.write((void*)wStrdata, strTypeAll);
+            datasetMetaData.close();
             
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-        } 
-        catch (const H5::Exception &e)
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        }
+        catch (const H5::Exception &e) 
         {
-            throw KEAIOException(e.getCDetailMsg());
+            throw KEAIOException("Could not set image band meta-data.");
         }
         catch ( const KEAIOException &e)
         {
@@ -1886,35 +2777,1649 @@ namespace kealib{
         }
     }
     
-    KEAImageSpatialInfo* KEAImageIO::getSpatialInfo()
+    std::string KEAImageIO::getImageBandMetaData(uint32_t band, const std::string &name)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        std::string metaDataH5Path = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA + std::string("/") + name;
+        std::string value = "";
+        // READ IMAGE BAND META-DATA
+        try 
+        {
+            H5::DataSet datasetMetaData = this->getH5File()->openDataSet( metaDataH5Path );
+            H5::DataType strDataType = datasetMetaData.getDataType();
+            value = readString(datasetMetaData, strDataType);
+            datasetMetaData.close();
+        } 
+        catch ( const H5::Exception &e) 
+        {
+            throw KEAIOException("Meta-data variable was not accessable.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return value;
+    }
+    
+    std::vector<std::string> KEAImageIO::getImageBandMetaDataNames(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        std::vector<std::string> metaDataNames;
+        
+        std::string metaDataGroupName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA;
+        try 
+        {
+            // Try to open dataset with overviewName
+            H5::Group imgBandMetaDataGrp = this->getH5File()->openGroup(metaDataGroupName);
+            hsize_t numMetaDataItems = imgBandMetaDataGrp.getNumObjs();
+            
+            for(hsize_t i = 0; i < numMetaDataItems; ++i)
+            {
+                metaDataNames.push_back(imgBandMetaDataGrp.getObjnameByIdx(i));
+            }
+        }
+        catch (const H5::Exception &e)
+        {
+            throw KEAIOException("Could not retrieve image band meta data.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return metaDataNames;
+    }
+    
+    std::vector< std::pair<std::string, std::string> > KEAImageIO::getImageBandMetaData(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        std::vector< std::pair<std::string, std::string> > metaData;
+        
+        std::string metaDataGroupName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_METADATA;
+        try 
+        {
+            // Try to open dataset with overviewName
+            H5::Group imgBandMetaDataGrp = this->getH5File()->openGroup(metaDataGroupName);
+            hsize_t numMetaDataItems = imgBandMetaDataGrp.getNumObjs();
+            std::string name = "";
+            std::string value = "";
+            
+            for(hsize_t i = 0; i < numMetaDataItems; ++i)
+            {
+                name = imgBandMetaDataGrp.getObjnameByIdx(i);
+                value = this->getImageBandMetaData(band, name);
+                metaData.push_back(std::pair<std::string, std::string>(name,value));
+            }
+        }
+        catch (const H5::Exception &e)
+        {
+            throw KEAIOException("Could not retrieve image band meta data.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return metaData;
+    }
+    
+    void KEAImageIO::setImageBandMetaData(uint32_t band, const std::vector< std::pair<std::string, std::string> > &data)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        try 
+        {
+            for(auto iterMetaData = data.begin(); iterMetaData != data.end(); ++iterMetaData)
+            {
+                this->setImageBandMetaData(band, iterMetaData->first, iterMetaData->second);
+            }
+            
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        }
+        catch (const H5::Exception &e)
+        {
+            throw KEAIOException("Could not set image band meta data.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    void KEAImageIO::setImageBandDescription(uint32_t band, const std::string &description)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        std::string bandName = KEA_DATASETNAME_BAND + uint2Str(band);
+        
+        // WRITE IMAGE BAND DESCRIPTION
+        try 
+        {
+            H5::StrType strTypeAll(0, H5T_VARIABLE);
+            H5::DataSet datasetBandDescription = this->getH5File()->openDataSet( bandName+KEA_BANDNAME_DESCRIP );
+            const char *wStrdata[1];
+            wStrdata[0] = description.c_str();			
+            datasetBandDescription.write((void*)wStrdata, strTypeAll);
+            datasetBandDescription.close();
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        }
+        catch (const H5::Exception &e) 
+        {
+            throw KEAIOException("Could not set image band description.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    std::string KEAImageIO::getImageBandDescription(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        std::string bandName = KEA_DATASETNAME_BAND + uint2Str(band) + std::string("/") + KEA_BANDNAME_DESCRIP;
+        std::string description = "";
+        // READ IMAGE BAND DESCRIPTION
+        try 
+        {
+            H5::DataSet datasetBandDescription = this->getH5File()->openDataSet( bandName );
+            H5::DataType strDataType = datasetBandDescription.getDataType();
+            description = readString(datasetBandDescription, strDataType);
+            datasetBandDescription.close();
+        } 
+        catch ( const H5::Exception &e) 
+        {
+            throw KEAIOException("Could not read band description.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return description;
+    }
+    
+    
+    
+    void KEAImageIO::setNoDataValue(uint32_t band, const void *data, KEADataType inDataType)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        // READ IMAGE DATA TYPE
+        try 
+        {    
+            std::string noDataValPath = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_NO_DATA_VAL;
+            H5::DataSet datasetImgNDV;
+            H5::Attribute noDataDefAttribute;
+            
+            try 
+            {
+                datasetImgNDV = this->getH5File()->openDataSet( noDataValPath );
+            }
+            catch (const H5::Exception &e)
+            {
+                hsize_t	dimsForNDV[1];
+                dimsForNDV[0] = 1; // number of lines;
+                H5::DataSpace dataspaceNDV(1, dimsForNDV);
+                
+                KEADataType imgDataType = this->getImageBandDataType(band);
+                H5::DataType imgBandDT = convertDatatypeKeaToH5STD(imgDataType);
+
+                datasetImgNDV = this->getH5File()->createDataSet(noDataValPath, imgBandDT, dataspaceNDV);
+            }
+            
+            try
+            {
+                noDataDefAttribute = datasetImgNDV.openAttribute(KEA_NODATA_DEFINED);
+            }
+            catch (const H5::Exception &e)
+            {
+                H5::DataSpace attr_dataspace = H5::DataSpace(H5S_SCALAR);
+                noDataDefAttribute = datasetImgNDV.createAttribute(KEA_NODATA_DEFINED, H5::PredType::STD_I8LE, attr_dataspace);
+            }
+            
+            int val = 1;
+            noDataDefAttribute.write(H5::PredType::NATIVE_INT, &val);
+            noDataDefAttribute.close();
+            
+            H5::DataType dataDT = convertDatatypeKeaToH5Native(inDataType);
+            datasetImgNDV.write( data, dataDT );
+            datasetImgNDV.close();
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        } 
+        catch ( const H5::Exception &e) 
+        {
+            throw KEAIOException("The image data type was not specified.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    void KEAImageIO::getNoDataValue(uint32_t band, void *data, KEADataType inDataType)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        
+        // READ IMAGE BAND NO DATA VALUE
+        try 
+        {            
+            H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
+            hsize_t dimsValue[1];
+            dimsValue[0] = 1;
+            H5::DataSpace valueDataSpace(1, dimsValue);
+            H5::DataSet datasetImgNDV = this->getH5File()->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_NO_DATA_VAL );
+            
+            bool noDataDefined = true;
+            try
+            {
+                H5::Attribute noDataDefAttribute = datasetImgNDV.openAttribute(KEA_NODATA_DEFINED);
+                int val = 1;
+                noDataDefAttribute.read(H5::PredType::NATIVE_INT, &val);
+                noDataDefAttribute.close();
+                
+                if(val == 0)
+                {
+                    noDataDefined = false;
+                }
+            }
+            catch ( const H5::Exception &e)
+            {
+                noDataDefined = true;
+            }
+            
+            if(noDataDefined)
+            {
+                datasetImgNDV.read(data, imgBandDT, valueDataSpace);
+            }
+            else
+            {
+                throw KEAIOException("The image band no data value was not defined.");
+            }
+            datasetImgNDV.close();
+            valueDataSpace.close();
+        } 
+        catch ( const H5::Exception &e) 
+        {
+            throw KEAIOException("The image band no data value was not specified.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    void KEAImageIO::undefineNoDataValue(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        
+        // UNDEFINE THE NO DATA VALUE
+        try
+        {
+            H5::DataSet datasetImgNDV = this->getH5File()->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_NO_DATA_VAL );
+            try
+            {
+                H5::Attribute noDataDefAttribute = datasetImgNDV.openAttribute(KEA_NODATA_DEFINED);
+                int val = 0;
+                noDataDefAttribute.write(H5::PredType::NATIVE_INT, &val);
+                noDataDefAttribute.close();
+            }
+            catch ( const H5::Exception &e)
+            {
+                H5::DataSpace attr_dataspace = H5::DataSpace(H5S_SCALAR);
+                H5::Attribute noDataDefAttribute = datasetImgNDV.createAttribute(KEA_NODATA_DEFINED, H5::PredType::STD_I8LE, attr_dataspace);
+                int val = 0;
+                noDataDefAttribute.write(H5::PredType::NATIVE_INT, &val);
+                noDataDefAttribute.close();
+            }
+            
+            datasetImgNDV.close();
+        }
+        catch ( const H5::Exception &e)
+        {
+            throw KEAIOException("The image band no data value had not been created.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    std::vector<KEAImageGCP*>* KEAImageIO::getGCPs()
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        std::vector<KEAImageGCP*> *gcps = new std::vector<KEAImageGCP*>();
+        
+        
+        try
+        {            
+            uint32_t numGCPs = 0;
+            // Get the number of GCPs
+            try
+            {
+                hsize_t dimsValue[1];
+                dimsValue[0] = 1;
+                H5::DataSpace valueDataSpace(1, dimsValue);
+                uint32_t value[1];
+                H5::DataSet datasetNumGCPs = this->getH5File()->openDataSet( KEA_GCPS_NUM );
+                datasetNumGCPs.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
+                numGCPs = value[0];
+                datasetNumGCPs.close();
+                valueDataSpace.close();
+            }
+            catch (const H5::Exception &e)
+            {
+                throw KEAIOException("Could not read the number of GCPs.");
+            }
+            catch ( const KEAIOException &e)
+            {
+                throw e;
+            }
+            catch ( const std::exception &e)
+            {
+                throw KEAIOException(e.what());
+            }
+
+            KEAImageGCP_HDF5 *gcpsHDF = new KEAImageGCP_HDF5[numGCPs];
+            
+            try
+            {
+                H5::CompType *fieldDtMem = this->createGCPCompTypeMem();
+                H5::DataSet gcpsDataset = this->getH5File()->openDataSet( KEA_GCPS_DATA );
+                
+                H5::DataSpace gcpsDataspace = gcpsDataset.getSpace();
+                hsize_t boolFieldOff[1];
+                boolFieldOff[0] = 0;
+                
+                hsize_t boolFieldsDims[1];
+                boolFieldsDims[0] = numGCPs;
+                H5::DataSpace gcpsMemspace(1, boolFieldsDims);
+                
+                gcpsDataspace.selectHyperslab( H5S_SELECT_SET, boolFieldsDims, boolFieldOff );
+                H5::DSetMemXferPropList xfer;
+                /* Ensures that malloc()/free() are from the same C runtime */
+                xfer.setVlenMemManager(kealibmalloc, nullptr, kealibfree, nullptr);
+                gcpsDataset.read(gcpsHDF, *fieldDtMem, gcpsMemspace, gcpsDataspace, xfer);
+                
+                gcpsDataset.close();
+                gcpsDataspace.close();
+                gcpsMemspace.close();
+                
+                delete fieldDtMem;
+            }
+            catch( const H5::Exception &e )
+            {
+                throw KEAIOException(e.getDetailMsg());
+            }
+            
+            KEAImageGCP *tmpGCP = nullptr;
+            for(uint32_t i = 0; i < numGCPs; ++i)
+            {
+                tmpGCP = new KEAImageGCP();
+                tmpGCP->pszId = std::string(gcpsHDF[i].pszId);
+                free(gcpsHDF[i].pszId);
+                tmpGCP->pszInfo = std::string(gcpsHDF[i].pszInfo);
+                free(gcpsHDF[i].pszInfo);
+                tmpGCP->dfGCPLine = gcpsHDF[i].dfGCPLine;
+                tmpGCP->dfGCPPixel = gcpsHDF[i].dfGCPPixel;
+                tmpGCP->dfGCPX = gcpsHDF[i].dfGCPX;
+                tmpGCP->dfGCPY = gcpsHDF[i].dfGCPY;
+                tmpGCP->dfGCPZ = gcpsHDF[i].dfGCPZ;
+                gcps->push_back(tmpGCP);
+            }
+            
+            delete[] gcpsHDF;
+        }
+        catch (const H5::Exception &e)
+        {
+            throw KEAIOException(e.getCDetailMsg());
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return gcps;
+    }
+    
+    void KEAImageIO::setGCPs(std::vector<KEAImageGCP*> *gcps, const std::string &projWKT)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        uint32_t numGCPs = gcps->size();
+        
+        KEAImageGCP_HDF5 *gcpsHDF = new KEAImageGCP_HDF5[numGCPs];
+        
+        uint32_t i = 0;
+        for(auto iterGCP = gcps->begin(); iterGCP != gcps->end(); ++iterGCP)
+        {
+            // Copy the char from one to the other for PSZ ID.
+            const size_t lenPSZId = strlen((*iterGCP)->pszId.c_str());
+            gcpsHDF[i].pszId = new char[lenPSZId + 1];
+            strncpy(gcpsHDF[i].pszId, (*iterGCP)->pszId.c_str(), lenPSZId);
+            gcpsHDF[i].pszId[lenPSZId] = '\0';
+            
+            // Copy the char from one to the other for PSZ INFO.
+            const size_t lenPSZInfo = strlen((*iterGCP)->pszInfo.c_str());
+            gcpsHDF[i].pszInfo = new char[lenPSZInfo + 1];
+            strncpy(gcpsHDF[i].pszInfo, (*iterGCP)->pszInfo.c_str(), lenPSZInfo);
+            gcpsHDF[i].pszInfo[lenPSZInfo] = '\0';
+            
+            gcpsHDF[i].dfGCPPixel = (*iterGCP)->dfGCPPixel;
+            gcpsHDF[i].dfGCPLine = (*iterGCP)->dfGCPLine;
+            gcpsHDF[i].dfGCPX = (*iterGCP)->dfGCPX;
+            gcpsHDF[i].dfGCPY = (*iterGCP)->dfGCPY;
+            gcpsHDF[i].dfGCPZ = (*iterGCP)->dfGCPZ;            
+            
+            ++i;
+        }
+        
+        try
+        {
+            // Open or create the GCPs dataset 
+            try
+            {
+                H5::DataSet gcpsDataset = this->getH5File()->openDataSet(KEA_GCPS_DATA);
+                H5::DataSpace gcpsWriteDataSpace = gcpsDataset.getSpace();
+                
+                H5::CompType *fieldDtMem = this->createGCPCompTypeMem();
+                
+                hsize_t gcpsDataDims[1];
+                gcpsWriteDataSpace.getSimpleExtentDims(gcpsDataDims);
+                
+                if(numGCPs > gcpsDataDims[0])
+                {
+                    hsize_t extendGCPsDatasetTo[1];
+                    extendGCPsDatasetTo[0] = numGCPs;
+                    gcpsDataset.extend( extendGCPsDatasetTo );
+                }
+                
+                hsize_t gcpsOffset[1];
+                gcpsOffset[0] = 0;
+                gcpsDataDims[0] = numGCPs;
+                
+                gcpsWriteDataSpace.close();
+                gcpsWriteDataSpace = gcpsDataset.getSpace();
+                gcpsWriteDataSpace.selectHyperslab(H5S_SELECT_SET, gcpsDataDims, gcpsOffset);
+                H5::DataSpace newGCPsDataspace = H5::DataSpace(1, gcpsDataDims);
+                
+                gcpsDataset.write(gcpsHDF, *fieldDtMem, newGCPsDataspace, gcpsWriteDataSpace);
+                
+                gcpsWriteDataSpace.close();
+                newGCPsDataspace.close();
+                gcpsDataset.close();
+                
+                delete fieldDtMem;
+            }
+            catch ( const H5::Exception &e)
+            {
+                H5::CompType *fieldDtDisk = this->createGCPCompTypeDisk();
+                H5::CompType *fieldDtMem = this->createGCPCompTypeMem();
+                
+                hsize_t initDimsGCPsDS[1];
+                initDimsGCPsDS[0] = numGCPs;
+                hsize_t maxDimsGCPsDS[1];
+                maxDimsGCPsDS[0] = H5S_UNLIMITED;
+                H5::DataSpace gcpsDataSpace = H5::DataSpace(1, initDimsGCPsDS, maxDimsGCPsDS);
+                
+                hsize_t dimsGCPsChunk[1];
+                dimsGCPsChunk[0] = numGCPs;
+                
+                H5::DSetCreatPropList creationGCPsDSPList;
+                creationGCPsDSPList.setChunk(1, dimsGCPsChunk);
+                creationGCPsDSPList.setShuffle();
+                creationGCPsDSPList.setDeflate(1);
+                H5::DataSet gcpsDataset = this->getH5File()->createDataSet(KEA_GCPS_DATA, *fieldDtDisk, gcpsDataSpace, creationGCPsDSPList);
+                
+                hsize_t gcpsOffset[1];
+                gcpsOffset[0] = 0;
+                hsize_t gcpsDataDims[1];
+                gcpsDataDims[0] = numGCPs;
+                
+                H5::DataSpace gcpsWriteDataSpace = gcpsDataset.getSpace();
+                gcpsWriteDataSpace.selectHyperslab(H5S_SELECT_SET, gcpsDataDims, gcpsOffset);
+                H5::DataSpace newGCPsDataspace = H5::DataSpace(1, gcpsDataDims);
+                
+                gcpsDataset.write(gcpsHDF, *fieldDtMem, newGCPsDataspace, gcpsWriteDataSpace);
+                
+                gcpsDataSpace.close();
+                gcpsWriteDataSpace.close();
+                newGCPsDataspace.close();
+                gcpsDataset.close();                
+                
+                delete fieldDtDisk;
+                delete fieldDtMem;
+            }
+            
+            
+            // Set the number of GCPs
+            try
+            {
+                H5::DataSet numBandsDataset;
+                try
+                {
+                    // open the dataset
+                    numBandsDataset = this->getH5File()->openDataSet(KEA_GCPS_NUM);
+                }
+                catch (const H5::Exception &e)
+                {
+                    // create the dataset if it does not exist
+                    hsize_t dimsNumBands[] = { 1 };
+                    H5::DataSpace numBandsDataSpace(1, dimsNumBands);
+                    numBandsDataset = this->getH5File()->createDataSet(KEA_GCPS_NUM, H5::PredType::STD_U32LE, numBandsDataSpace);
+                    numBandsDataSpace.close();
+                }
+                numBandsDataset.write(&numGCPs, H5::PredType::NATIVE_UINT32);
+                numBandsDataset.close();
+            }
+            catch (const H5::Exception &e)
+            {
+                throw KEAIOException("Could not write the number of GCPs.");
+            }
+            catch ( const KEAIOException &e)
+            {
+                throw e;
+            }
+            catch ( const std::exception &e)
+            {
+                throw KEAIOException(e.what());
+            }
+        }
+        catch (const H5::Exception &e)
+        {
+            throw KEAIOException(e.getCDetailMsg());
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        for(uint32_t j = 0; j < i; j++)
+        {
+            delete[] gcpsHDF[j].pszId;
+            delete[] gcpsHDF[j].pszInfo;
+        }
+        
+        delete[] gcpsHDF;
+        
+        
+        // Set the projection string
+        try
+        {
+            this->setGCPProjection(projWKT);
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+    }
+    
+    uint32_t KEAImageIO::getGCPCount()
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        // READ NUMBER OF GCPs
+        uint32_t numGCPs = 0;
+        try
+        {
+            hsize_t dimsValue[1];
+            dimsValue[0] = 1;
+            H5::DataSpace valueDataSpace(1, dimsValue);
+            uint32_t value[1];
+            H5::DataSet datasetNumGCPs = this->getH5File()->openDataSet( KEA_GCPS_NUM );
+            datasetNumGCPs.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
+            numGCPs = value[0];
+            datasetNumGCPs.close();
+            valueDataSpace.close();
+        }
+        catch ( const H5::Exception &e)
+        {
+            throw KEAIOException("The number of image bands was not specified.");
+        }
+        
+        return numGCPs;
+    }
+    
+    std::string KEAImageIO::getGCPProjection()
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        // READ WKT STRING
+        std::string gcpProj = "";
+        try
+        {
+            H5::DataSet datasetGCPSpatialReference = this->getH5File()->openDataSet( KEA_GCPS_PROJ );
+            H5::DataType strDataType = datasetGCPSpatialReference.getDataType();
+            gcpProj = readString(datasetGCPSpatialReference, strDataType);
+            datasetGCPSpatialReference.close();
+        }
+        catch ( const H5::Exception &e)
+        {
+            throw KEAIOException("The spatial reference was not specified.");
+        }
+        
+        return gcpProj;
+    }
+    
+    void KEAImageIO::setGCPProjection(const std::string &projWKT)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        // SET THE WKT STRING SPATAIL REFERENCE IN GLOBAL HEADER
+        try
+        {
+            const char *wStrdata[1];
+            H5::DataSet datasetSpatialReference = this->getH5File()->openDataSet(KEA_GCPS_PROJ);
+            H5::DataType strDataType = datasetSpatialReference.getDataType();
+            wStrdata[0] = projWKT.c_str();
+            datasetSpatialReference.write((void*)wStrdata, strDataType);
+            datasetSpatialReference.close();
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        }
+        catch (const H5::Exception &e)
+        {
+            const char *wStrdata[1];
+			hsize_t	dimsForStr[1];
+			dimsForStr[0] = 1; // number of lines;
+            H5::DataSpace dataspaceStrAll(1, dimsForStr);
+            H5::StrType strTypeAll(0, H5T_VARIABLE);
+            H5::DataSet datasetSpatialReference = this->getH5File()->createDataSet(KEA_GCPS_PROJ, strTypeAll, dataspaceStrAll);
+			wStrdata[0] = projWKT.c_str();
+			datasetSpatialReference.write((void*)wStrdata, strTypeAll);
+			datasetSpatialReference.close();
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    void KEAImageIO::setSpatialInfo(KEAImageSpatialInfo *inSpatialInfo)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        try 
+        {
+            // SET X AND Y TL IN GLOBAL HEADER
+            double doubleVals[2];
+            doubleVals[0] = inSpatialInfo->tlX;
+            doubleVals[1] = inSpatialInfo->tlY;
+            H5::DataSet spatialTLDataset = this->getH5File()->openDataSet(KEA_DATASETNAME_HEADER_TL);
+			spatialTLDataset.write( doubleVals, H5::PredType::NATIVE_DOUBLE );
+            spatialTLDataset.close();
+            
+            // SET X AND Y RESOLUTION IN GLOBAL HEADER
+            doubleVals[0] = inSpatialInfo->xRes;
+            doubleVals[1] = inSpatialInfo->yRes;
+            H5::DataSet spatialResDataset = this->getH5File()->openDataSet(KEA_DATASETNAME_HEADER_RES);
+			spatialResDataset.write( doubleVals, H5::PredType::NATIVE_DOUBLE );
+            spatialResDataset.close();
+            
+            // SET X AND Y ROTATION IN GLOBAL HEADER
+            doubleVals[0] = inSpatialInfo->xRot;
+            doubleVals[1] = inSpatialInfo->yRot;
+            H5::DataSet spatialRotDataset = this->getH5File()->openDataSet(KEA_DATASETNAME_HEADER_ROT);
+			spatialRotDataset.write( doubleVals, H5::PredType::NATIVE_DOUBLE );
+            spatialRotDataset.close();
+            
+            // SET THE WKT STRING SPATAIL REFERENCE IN GLOBAL HEADER
+			const char *wStrdata[1];
+            H5::DataSet datasetSpatialReference = this->getH5File()->openDataSet(KEA_DATASETNAME_HEADER_WKT);
+            H5::DataType strDataType = datasetSpatialReference.getDataType();
+			wStrdata[0] = inSpatialInfo->wktString.c_str();			
+			datasetSpatialReference.write((void*)wStrdata, strDataType);
+			datasetSpatialReference.close();
+            
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        } 
+        catch (const H5::Exception &e)
+        {
+            throw KEAIOException(e.getCDetailMsg());
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    KEAImageSpatialInfo* KEAImageIO::getSpatialInfo()
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        return spatialInfoFile;
+    }
+    
+    uint32_t KEAImageIO::getNumOfImageBands()
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        return this->numImgBands;
+    }
+    
+    uint32_t KEAImageIO::getImageBlockSize(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        uint32_t imgBlockSize = 0;
+        
+        try 
+        {
+            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+            if(band == 0)
+            {
+                throw KEAIOException("KEA Image Bands start at 1.");
+            }
+            else if(band > this->numImgBands)
+            {
+                throw KEAIOException("Band is not present within image."); 
+            }
+            
+            // OPEN BAND DATASET
+            try 
+            {
+                // held by the expression of virtual bands
+                std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( imageBandPath + (this->getBandExpression(band) ? KEA_BANDNAME_EXPRESSION : KEA_BANDNAME_DATA) );
+                H5::Attribute blockSizeAtt = imgBandDataset.openAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE);
+                blockSizeAtt.read(H5::PredType::NATIVE_UINT32, &imgBlockSize);
+                imgBandDataset.close();
+                blockSizeAtt.close();
+            } 
+            catch ( const H5::Exception &e) 
+            {
+                throw KEAIOException("Could not get image block size.");
+            }            
+        }
+        catch(const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch( const H5::FileIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSetIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSpaceIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataTypeIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return imgBlockSize;
+    }
+
+    uint32_t KEAImageIO::getAttributeTableChunkSize(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        uint32_t attChunkSize = 0;
+        
+        try 
+        {
+            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+            if(band == 0)
+            {
+                throw KEAIOException("KEA Image Bands start at 1.");
+            }
+            else if(band > this->numImgBands)
+            {
+                throw KEAIOException("Band is not present within image."); 
+            }
+            
+            // OPEN BAND DATASET
+            try 
+            {
+                hsize_t dimsValue[1];
+                dimsValue[0] = 1;
+                H5::DataSpace valueDataSpace(1, dimsValue);
+                std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
+                H5::DataSet datasetAttSize = this->getH5File()->openDataSet( imageBandPath + KEA_ATT_CHUNKSIZE_HEADER);
+                datasetAttSize.read(&attChunkSize, H5::PredType::NATIVE_UINT32, valueDataSpace);
+                datasetAttSize.close();
+                valueDataSpace.close();
+            } 
+            catch ( const H5::Exception &e) 
+            {
+                throw KEAIOException("Could not get image block size.");
+            }            
+        }
+        catch(const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch( const H5::FileIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSetIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSpaceIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataTypeIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return attChunkSize;
+    }
+    
+    KEADataType KEAImageIO::getImageBandDataType(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        KEADataType imgDataType = kealib::kea_undefined;
+        
+        // READ IMAGE DATA TYPE
+        try 
+        {
+            hsize_t dimsValue[1];
+            dimsValue[0] = 1;
+            H5::DataSpace valueDataSpace(1, dimsValue);
+            uint32_t value[1];
+            H5::DataSet datasetImgDT = this->getH5File()->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DT );
+            datasetImgDT.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
+            imgDataType = (KEADataType)value[0];
+            datasetImgDT.close();
+            valueDataSpace.close();
+        } 
+        catch ( const H5::Exception &e) 
+        {
+            throw KEAIOException("The image band data type was not specified.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return imgDataType;
+    }
+    
+    bool KEAImageIO::isVirtualImageBand(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        if((band == 0) || (band > this->numImgBands))
+        {
+            throw KEAIOException("Band is not present within image.");
+        }
+        return (this->getBandExpression(band) != nullptr);
+    }
+    
+    std::string KEAImageIO::getVirtualImageBandExpression(uint32_t band)
+    {
+        if(!this->isVirtualImageBand(band))
+        {
+            throw KEAIOException("Band " + uint2Str(band) + " is not a virtual band.");
+        }
+        return this->getBandExpression(band)->toString();
+    }
+    
+    std::string KEAImageIO::getKEAImageVersion() 
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        return this->keaVersion;
+    }
+    
+    void KEAImageIO::setImageBandLayerType(uint32_t band, KEALayerType imgLayerType)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+                
+        // WRITE IMAGE LAYER TYPE
+        try 
+        {
+            uint32_t value = (uint32_t)imgLayerType;
+            H5::DataSet datasetImgLT = this->getH5File()->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_TYPE );
+            datasetImgLT.write(&value, H5::PredType::NATIVE_UINT32);
+            datasetImgLT.close();
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        } 
+        catch ( const H5::Exception &e) 
+        {
+            throw KEAIOException("The image band data type was not specified.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    KEALayerType KEAImageIO::getImageBandLayerType(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        KEALayerType imgLayerType = kea_continuous;
+        
+        // READ IMAGE LAYER TYPE
+        try 
+        {
+            hsize_t dimsValue[1];
+            dimsValue[0] = 1;
+            H5::DataSpace valueDataSpace(1, dimsValue);
+            uint32_t value[1];
+            H5::DataSet datasetImgLT = this->getH5File()->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_TYPE );
+            datasetImgLT.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
+            imgLayerType = (KEALayerType)value[0];
+            datasetImgLT.close();
+            valueDataSpace.close();
+        } 
+        catch ( const H5::Exception &e) 
+        {
+            throw KEAIOException("The image band data type was not specified.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return imgLayerType;
+    }
+    
+    void KEAImageIO::setImageBandClrInterp(uint32_t band, KEABandClrInterp imgLayerClrInterp)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        // WRITE IMAGE LAYER USAGE
+        uint32_t value = (uint32_t) imgLayerClrInterp;
+        try 
+        {
+            H5::DataSet datasetImgLU = this->getH5File()->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_USAGE );
+            datasetImgLU.write(&value, H5::PredType::NATIVE_UINT32);
+            datasetImgLU.close();
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        } 
+        catch ( const H5::Exception &e) 
+        {
+            hsize_t dimsUsage[1];
+            dimsUsage[0] = 1;
+            H5::DataSpace usageDataSpace(1, dimsUsage);
+            H5::DataSet usageDataset = this->getH5File()->createDataSet((KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_USAGE), H5::PredType::STD_U8LE, usageDataSpace);
+            usageDataset.write( &value, H5::PredType::NATIVE_UINT32 );
+            usageDataset.close();
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    KEABandClrInterp KEAImageIO::getImageBandClrInterp(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        KEABandClrInterp imgLayerClrInterp = kea_generic;
+        
+        // READ IMAGE LAYER USAGE
+        try 
+        {
+            hsize_t dimsValue[1];
+            dimsValue[0] = 1;
+            H5::DataSpace valueDataSpace(1, dimsValue);
+            uint32_t value[1];
+            H5::DataSet datasetImgLU = this->getH5File()->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_USAGE );
+            datasetImgLU.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
+            imgLayerClrInterp = (KEABandClrInterp)value[0];
+            datasetImgLU.close();
+            valueDataSpace.close();
+        } 
+        catch ( const H5::Exception &e) 
+        {
+            //throw KEAIOException("The image band data type was not specified.");
+            imgLayerClrInterp = kea_generic; // Field was not present within the file.
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return imgLayerClrInterp;
+    }
+    
+    void KEAImageIO::createOverview(uint32_t band, uint32_t overview, uint64_t xSize, uint64_t ySize)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
+                
+        try 
+        {
+            // Try to open dataset with overviewName
+            H5::DataSet imgBandDataset = this->getH5File()->openDataSet( overviewName );
+            this->getH5File()->unlink(overviewName);
+        }
+        catch (const H5::Exception &e)
+        {
+            // Do nothing as dataset does not exist.
+        }
+        
+        try 
+        {
+            KEADataType imgDataType = this->getImageBandDataType(band);
+            
+            H5::DataType imgBandDT = convertDatatypeKeaToH5STD(imgDataType);
+            int initFillVal = 0;
+            
+            hsize_t imageBandDims[2];
+            imageBandDims[0] = ySize;
+            imageBandDims[1] = xSize;
+            H5::DataSpace imgBandDataSpace(2, imageBandDims);
+            
+            hsize_t dimsImageBandChunk[2];
+            // Make sure that the chuck size is not bigger than the dataset.
+            uint32_t imgBlockSize = this->getImageBlockSize(band);
+            uint64_t smallestAxis = 0;
+            if(xSize < ySize)
+            {
+                smallestAxis = xSize;
+            }
+            else
+            {
+                smallestAxis = ySize;
+            }
+            if(smallestAxis < imgBlockSize)
+            {
+                dimsImageBandChunk[0] = smallestAxis;
+                dimsImageBandChunk[1] = smallestAxis;
+            }
+            else
+            {
+                dimsImageBandChunk[0] = imgBlockSize;
+                dimsImageBandChunk[1] = imgBlockSize;
+            }
+			
+            
+            H5::DSetCreatPropList initParamsImgBand;
+			initParamsImgBand.setChunk(2, dimsImageBandChunk);			
+			initParamsImgBand.setShuffle();
+            initParamsImgBand.setDeflate(KEA_DEFLATE);
+			initParamsImgBand.setFillValue( H5::PredType::NATIVE_INT, &initFillVal);
+            
+            H5::StrType strdatatypeLen6(H5::PredType::C_S1, 6);
+            H5::StrType strdatatypeLen4(H5::PredType::C_S1, 4);
+            const H5std_string strClassVal ("IMAGE");
+            const H5std_string strImgVerVal ("1.2");
+            H5::DataSpace attr_dataspace = H5::DataSpace(H5S_SCALAR);
+                        
+            // CREATE THE IMAGE DATA ARRAY
+            H5::DataSet imgBandDataSet = this->getH5File()->createDataSet(overviewName, imgBandDT, imgBandDataSpace, initParamsImgBand);
+            
+            H5::Attribute classAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_CLASS, strdatatypeLen6, attr_dataspace);
+            classAttribute.write(strdatatypeLen6, strClassVal); 
+            classAttribute.close();
+            
+            H5::Attribute imgVerAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_IMAGE_VERSION, strdatatypeLen4, attr_dataspace);
+            imgVerAttribute.write(strdatatypeLen4, strImgVerVal);
+            imgVerAttribute.close();
+            
+            H5::Attribute blockSizeAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE, H5::PredType::STD_U16LE, attr_dataspace);
+            uint32_t blockSizeTmp = dimsImageBandChunk[0]; // copy into a temporary variable to write to the file - fixing a bug on solaris.
+            blockSizeAttribute.write(H5::PredType::NATIVE_UINT32, &blockSizeTmp);
+            blockSizeAttribute.close();
+            
+            imgBandDataSet.close();
+            
+            attr_dataspace.close();
+            imgBandDataSet.close();
+            
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        }
+        catch (const H5::Exception &e)
+        {
+            throw KEAIOException(e.getCDetailMsg());
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    void KEAImageIO::removeOverview(uint32_t band, uint32_t overview)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
+        
+        try 
+        {
+            // Try to open dataset with overviewName
+            H5::DataSet imgBandDataset = this->getH5File()->openDataSet( overviewName );
+            this->getH5File()->unlink(overviewName);
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        }
+        catch (const H5::Exception &e)
+        {
+            // Do nothing as dataset does not exist.
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+    }
+    
+    uint32_t KEAImageIO::getOverviewBlockSize(uint32_t band, uint32_t overview)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        uint32_t ovBlockSize = 0;
+        
+        try 
+        {
+            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+            if(band == 0)
+            {
+                throw KEAIOException("KEA Image Bands start at 1.");
+            }
+            else if(band > this->numImgBands)
+            {
+                throw KEAIOException("Band is not present within image."); 
+            }
+            
+            // OPEN BAND DATASET
+            try 
+            {
+                std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( overviewName );
+                H5::Attribute blockSizeAtt = imgBandDataset.openAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE);
+                blockSizeAtt.read(H5::PredType::NATIVE_UINT32, &ovBlockSize);
+                imgBandDataset.close();
+                blockSizeAtt.close();
+            } 
+            catch ( const H5::Exception &e) 
+            {
+                throw KEAIOException("Could not retrieve the overview block size.");
+            }            
+        }
+        catch(const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch( const H5::FileIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSetIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSpaceIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataTypeIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        
+        return ovBlockSize;
+    }
+    
+    void KEAImageIO::writeToOverview(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut, uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        try 
+        {
+            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+            if(band == 0)
+            {
+                throw KEAIOException("KEA Image Bands start at 1.");
+            }
+            else if(band > this->numImgBands)
+            {
+                throw KEAIOException("Band is not present within image."); 
+            }
+            
+            // GET NATIVE DATASET
+            H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
+
+            // OPEN BAND DATASET AND WRITE IMAGE DATA
+            try 
+            {
+                KEAIOCounters &counters = this->getIOCounters(band);
+                KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+                counters.datasetOpens++;
+                std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( overviewName );
+                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();                
+                
+                hsize_t imgOffset[2];
+                imgOffset[0] = yPxlOff;
+                imgOffset[1] = xPxlOff;
+                hsize_t dataDims[2];
+                dataDims[0] = ySizeBuf;
+                dataDims[1] = xSizeBuf;
+                H5::DataSpace write2BandDataspace = H5::DataSpace(2, dataDims);
+                
+                if((ySizeOut != ySizeBuf) | (xSizeOut != xSizeBuf))
+                {                    
+                    hsize_t dataSelectMemDims[2];
+                    dataSelectMemDims[0] = ySizeOut;
+                    dataSelectMemDims[1] = 1;
+
+                    hsize_t dataOffDims[2];
+                    dataOffDims[0] = 0;
+                    dataOffDims[1] = 0;
+
+                    hsize_t dataSelectStrideDims[2];
+                    dataSelectStrideDims[0] = 1;
+                    if(xSizeBuf == xSizeOut)
+                    {
+                        dataSelectStrideDims[1] = 1;
+                    }
+                    else
+                    {
+                        dataSelectStrideDims[1] = xSizeBuf - xSizeOut;
+                    }
+
+                    hsize_t dataSelectBlockSizeDims[2];
+                    dataSelectBlockSizeDims[0] = 1;
+                    dataSelectBlockSizeDims[1] = xSizeOut;
+                    write2BandDataspace.selectHyperslab(H5S_SELECT_SET, dataSelectMemDims, dataOffDims, dataSelectStrideDims, dataSelectBlockSizeDims);
+                    
+                    hsize_t dataOutDims[2];
+                    dataOutDims[0] = ySizeOut;
+                    dataOutDims[1] = xSizeOut;
+                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataOutDims, imgOffset);
+                }
+                else
+                {
+                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataDims, imgOffset);
+                }
+                
+                imgBandDataset.write( data, imgBandDT, write2BandDataspace, imgBandDataspace);
+                counters.bytesWritten += xSizeOut * ySizeOut * imgBandDT.getSize();
+                
+                imgBandDataset.close();
+                imgBandDataspace.close();
+                write2BandDataspace.close();
+            } 
+            catch ( const H5::Exception &e) 
+            {
+                throw KEAIOException("Could not write image data.");
+            }
+            
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        }
+        catch(const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch( const H5::FileIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSetIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSpaceIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataTypeIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    void KEAImageIO::readFromOverview(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        try 
+        {
+            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
+            if(band == 0)
+            {
+                throw KEAIOException("KEA Image Bands start at 1.");
+            }
+            else if(band > this->numImgBands)
+            {
+                throw KEAIOException("Band is not present within image."); 
+            }
+            
+            // GET NATIVE DATASET
+            H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
+            
+            // OPEN BAND DATASET AND READ IMAGE DATA
+            try 
+            {
+                KEAIOCounters &counters = this->getIOCounters(band);
+                KEAIOTimer hdf5Timer(counters.hdf5Nanos);
+                counters.datasetOpens++;
+                std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( overviewName );
+                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();                
+                
+                hsize_t dataOffset[2];
+                dataOffset[0] = yPxlOff;
+                dataOffset[1] = xPxlOff;
+                hsize_t dataDims[2];
+                dataDims[0] = ySizeBuf;
+                dataDims[1] = xSizeBuf;
+                H5::DataSpace read2BandDataspace = H5::DataSpace(2, dataDims);
+                
+                if((ySizeBuf != ySizeIn) | (xSizeBuf != xSizeIn))
+                {
+                    hsize_t dataSelectMemDims[2];
+                    dataSelectMemDims[0] = ySizeIn;
+                    dataSelectMemDims[1] = 1;
+
+                    hsize_t dataOffDims[2];
+                    dataOffDims[0] = 0;
+                    dataOffDims[1] = 0;
+
+                    hsize_t dataSelectStrideDims[2];
+                    dataSelectStrideDims[0] = 1;
+                    if(xSizeBuf == xSizeIn)
+                    {
+                        dataSelectStrideDims[1] = 1;
+                    }
+                    else
+                    {
+                        dataSelectStrideDims[1] = xSizeBuf - xSizeIn;
+                    }
+
+                    hsize_t dataSelectBlockSizeDims[2];
+                    dataSelectBlockSizeDims[0] = 1;
+                    dataSelectBlockSizeDims[1] = xSizeIn;
+                    read2BandDataspace.selectHyperslab(H5S_SELECT_SET, dataSelectMemDims, dataOffDims, dataSelectStrideDims, dataSelectBlockSizeDims);
+                    
+                    hsize_t dataInDims[2];
+                    dataInDims[0] = ySizeIn;
+                    dataInDims[1] = xSizeIn;
+                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataInDims, dataOffset);
+                }
+                else
+                {
+                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataDims, dataOffset);
+                }
+                imgBandDataset.read( data, imgBandDT, read2BandDataspace, imgBandDataspace);
+                counters.bytesRead += xSizeIn * ySizeIn * imgBandDT.getSize();
+                
+                imgBandDataset.close();
+                imgBandDataspace.close();
+                read2BandDataspace.close();
+            } 
+            catch ( const H5::Exception &e) 
+            {
+                throw KEAIOException("Could not read from image overview.");
+            }            
+        }
+        catch(const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch( const H5::FileIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSetIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataSpaceIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+		catch( const H5::DataTypeIException &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    uint32_t KEAImageIO::getNumOfOverviews(uint32_t band)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        return spatialInfoFile;
-    }
-    
-    uint32_t KEAImageIO::getNumOfImageBands()
-    {
-        if(!this->fileOpen)
+        std::string overviewGroupName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_OVERVIEWS;
+        uint32_t numOverviews = 0;
+        try 
         {
-            throw KEAIOException("Image was not open.");
+            // Try to open dataset with overviewName
+            H5::Group imgOverviewsGrp = this->getH5File()->openGroup(overviewGroupName);
+            numOverviews = imgOverviewsGrp.getNumObjs();
+        }
+        catch (const H5::Exception &e)
+        {
+            throw KEAIOException("Could not retrieve the number of image band overviews.");
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
         }
         
-        return this->numImgBands;
+        return numOverviews;
     }
     
-    uint32_t KEAImageIO::getImageBlockSize(uint32_t band)
+    void KEAImageIO::getOverviewSize(uint32_t band, uint32_t overview, uint64_t *xSize, uint64_t *ySize)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        uint32_t imgBlockSize = 0;
-        
         try 
         {
             // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
@@ -1926,105 +4431,155 @@ namespace kealib{
             {
                 throw KEAIOException("Band is not present within image."); 
             }
-            
-            // OPEN BAND DATASET
+                        
+            // OPEN BAND DATASET AND READ THE IMAGE DIMENSIONS
             try 
             {
-                std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
-                H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( imageBandPath + KEA_BANDNAME_DATA );
-                H5::Attribute blockSizeAtt = imgBandDataset.openAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE);
-                blockSizeAtt.read(H5::PredType::NATIVE_UINT32, &imgBlockSize);
+                std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
+                H5::DataSet imgBandDataset = this->getH5File()->openDataSet( overviewName );
+                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();                
+                
+                uint32_t nDims = imgBandDataspace.getSimpleExtentNdims();
+                if(nDims != 2)
+                {
+                    throw KEAIOException("The number of dimensions for the overview must be 2.");
+                }
+                hsize_t dims[2];
+                imgBandDataspace.getSimpleExtentDims(dims);
+                
+                *xSize = dims[1];
+                *ySize = dims[0];
+
                 imgBandDataset.close();
-                blockSizeAtt.close();
             } 
+            catch(const KEAIOException &e)
+            {
+                throw e;
+            }
             catch ( const H5::Exception &e) 
             {
-                throw KEAIOException("Could not get image block size.");
+                throw KEAIOException("Could not read from image overview.");
             }            
         }
-        catch(const KEAIOException &e)
+        catch( const H5::Exception &e )
+		{
+			throw KEAIOException("Could not get the overview size.");
+		}
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    KEAAttributeTable* KEAImageIO::getAttributeTable(KEAATTType type, uint32_t band)
+    {
+        KEAAttributeTable *att = nullptr;
+        try 
+        {
+            if(type == kea_att_mem)
+            {
+                att = kealib::KEAAttributeTableInMem::createKeaAtt(this->getH5File().get(), band);
+            }
+            else if(type == kea_att_file)
+            {
+                // the table keeps using the file so it can't be closed
+                std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+                std::shared_ptr<H5::H5File> keaImgH5File = this->getH5File();
+                this->removeFromPool();
+                att = kealib::KEAAttributeTableFile::createKeaAtt(keaImgH5File.get(), band);
+            }
+            else
+            {
+                throw KEAATTException("The attribute table type was not recognised.");
+            }
+        }
+        catch(const KEAATTException &e)
+        {
+            throw e;
+        }
+        catch ( const KEAIOException &e)
         {
             throw e;
         }
-        catch( const H5::FileIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSetIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSpaceIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataTypeIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
         
-        return imgBlockSize;
+        return att;
     }
-
-    uint32_t KEAImageIO::getAttributeTableChunkSize(uint32_t band)
+    
+    void KEAImageIO::setAttributeTable(KEAAttributeTable* att, uint32_t band, uint32_t chunkSize, uint32_t deflate)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        uint32_t attChunkSize = 0;
+        try 
+        {
+            att->exportToKeaFile(this->getH5File().get(), band, chunkSize, deflate);
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+        }
+        catch(const KEAATTException &e)
+        {
+            throw e;
+        }
+        catch ( const KEAIOException &e)
+        {
+            throw e;
+        }
+        catch ( const std::exception &e)
+        {
+            throw KEAIOException(e.what());
+        }
+    }
+    
+    bool KEAImageIO::attributeTablePresent(uint32_t band)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
         
+        bool attPresent = false;
         try 
         {
-            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
-            if(band == 0)
-            {
-                throw KEAIOException("KEA Image Bands start at 1.");
-            }
-            else if(band > this->numImgBands)
-            {
-                throw KEAIOException("Band is not present within image."); 
-            }
-            
-            // OPEN BAND DATASET
+            std::string bandPathBase = KEA_DATASETNAME_BAND + uint2Str(band);
+            hsize_t attSize[5];
             try 
-            {
+            {   
                 hsize_t dimsValue[1];
-                dimsValue[0] = 1;
+                dimsValue[0] = 5;
                 H5::DataSpace valueDataSpace(1, dimsValue);
-                std::string imageBandPath = KEA_DATASETNAME_BAND + uint2Str(band);
-                H5::DataSet datasetAttSize = this->keaImgFile->openDataSet( imageBandPath + KEA_ATT_CHUNKSIZE_HEADER);
-                datasetAttSize.read(&attChunkSize, H5::PredType::NATIVE_UINT32, valueDataSpace);
+                H5::DataSet datasetAttSize = this->getH5File()->openDataSet( bandPathBase + KEA_ATT_SIZE_HEADER );
+                datasetAttSize.read(attSize, H5::PredType::STD_U64LE, valueDataSpace);
                 datasetAttSize.close();
                 valueDataSpace.close();
             } 
-            catch ( const H5::Exception &e) 
+            catch (const H5::Exception &e) 
             {
-                throw KEAIOException("Could not get image block size.");
-            }            
+                throw KEAIOException("The attribute table size field is not present.");
+            }
+            
+            if(attSize[0] > 0)
+            {
+                attPresent = true;
+            }
         }
         catch(const KEAIOException &e)
         {
             throw e;
         }
-        catch( const H5::FileIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSetIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSpaceIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataTypeIException &e )
+        catch(const KEAATTException &e)
+        {
+            throw e;
+        }
+        catch( const H5::Exception &e )
 		{
 			throw KEAIOException(e.getCDetailMsg());
 		}
@@ -2032,611 +4587,1385 @@ namespace kealib{
         {
             throw KEAIOException(e.what());
         }
-        
-        return attChunkSize;
+        return attPresent;
     }
     
-    KEADataType KEAImageIO::getImageBandDataType(uint32_t band)
+    void KEAImageIO::copyAttributeTable(KEAImageIO *srcIO, uint32_t srcBand, uint32_t dstBand)
     {
-        if(!this->fileOpen)
+        if(!this->fileOpen || (srcIO == nullptr) || !srcIO->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        KEADataType imgDataType = kealib::kea_undefined;
         
-        // READ IMAGE DATA TYPE
-        try 
+        if((srcIO == this) && (srcBand == dstBand))
         {
-            hsize_t dimsValue[1];
-            dimsValue[0] = 1;
-            H5::DataSpace valueDataSpace(1, dimsValue);
-            uint32_t value[1];
-            H5::DataSet datasetImgDT = this->keaImgFile->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_DT );
-            datasetImgDT.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
-            imgDataType = (KEADataType)value[0];
-            datasetImgDT.close();
-            valueDataSpace.close();
-        } 
-        catch ( const H5::Exception &e) 
+            return;
+        }
+        
+        try 
         {
-            throw KEAIOException("The image band data type was not specified.");
+            std::string srcName = KEA_DATASETNAME_BAND + uint2Str(srcBand) + KEA_BANDNAME_ATT;
+            std::string dstName = KEA_DATASETNAME_BAND + uint2Str(dstBand) + KEA_BANDNAME_ATT;
+            std::string tmpName = dstName + "_COPY";
+            
+            // Copy alongside the existing table first so the destination
+            // band is never left without a table if the copy fails.
+            if(H5Ocopy(srcIO->getH5File()->getId(), srcName.c_str(), this->getH5File()->getId(), tmpName.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0)
+            {
+                throw KEAIOException("Could not copy the attribute table.");
+            }
+            
+            if(H5Lexists(this->getH5File()->getId(), dstName.c_str(), H5P_DEFAULT) > 0)
+            {
+                this->getH5File()->unlink(dstName);
+            }
+            this->getH5File()->move(tmpName, dstName);
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
             throw e;
         }
+        catch( const H5::Exception &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
-        
-        return imgDataType;
     }
     
-    std::string KEAImageIO::getKEAImageVersion() 
+    bool KEAImageIO::copyImageBand(KEAImageIO *srcIO, uint32_t srcBand, uint32_t dstBand)
     {
-        if(!this->fileOpen)
+        if(!this->fileOpen || (srcIO == nullptr) || !srcIO->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
-        
-        return this->keaVersion;
-    }
-    
-    void KEAImageIO::setImageBandLayerType(uint32_t band, KEALayerType imgLayerType)
-    {
-        if(!this->fileOpen)
+        if((srcBand == 0) || (srcBand > srcIO->numImgBands) || (dstBand == 0) || (dstBand > this->numImgBands))
+        {
+            throw KEAIOException("Band is not present within image.");
+        }
+        if(srcIO == this)
+        {
+            return (srcBand == dstBand);
+        }
+        // the expression of a virtual band would refer to the wrong bands
+        if(srcIO->getBandExpression(srcBand) || this->getBandExpression(dstBand))
         {
-            throw KEAIOException("Image was not open.");
+            return false;
         }
-                
-        // WRITE IMAGE LAYER TYPE
+        
         try 
         {
-            uint32_t value = (uint32_t)imgLayerType;
-            H5::DataSet datasetImgLT = this->keaImgFile->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_TYPE );
-            datasetImgLT.write(&value, H5::PredType::NATIVE_UINT32);
-            datasetImgLT.close();
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-        } 
-        catch ( const H5::Exception &e) 
-        {
-            throw KEAIOException("The image band data type was not specified.");
+            std::string srcName = KEA_DATASETNAME_BAND + uint2Str(srcBand);
+            std::string dstName = KEA_DATASETNAME_BAND + uint2Str(dstBand);
+            
+            // the stored chunks are only usable as they are if the image
+            // data is laid out and filtered the same in both files
+            {
+                H5::DataSet srcDataset = srcIO->getH5File()->openDataSet(srcName + KEA_BANDNAME_DATA);
+                H5::DataSet dstDataset = this->getH5File()->openDataSet(dstName + KEA_BANDNAME_DATA);
+                hsize_t srcDims[2] = {0, 0};
+                hsize_t dstDims[2] = {0, 0};
+                srcDataset.getSpace().getSimpleExtentDims(srcDims);
+                dstDataset.getSpace().getSimpleExtentDims(dstDims);
+                H5::DSetCreatPropList srcCreationPList = srcDataset.getCreatePlist();
+                H5::DSetCreatPropList dstCreationPList = dstDataset.getCreatePlist();
+                if((srcDims[0] != dstDims[0]) || (srcDims[1] != dstDims[1]) ||
+                   !(srcDataset.getDataType() == dstDataset.getDataType()) ||
+                   (H5Pequal(srcCreationPList.getId(), dstCreationPList.getId()) <= 0))
+                {
+                    return false;
+                }
+            }
+            
+            std::string tmpName = dstName + "_COPY";
+            if(H5Ocopy(srcIO->getH5File()->getId(), srcName.c_str(), this->getH5File()->getId(), tmpName.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0)
+            {
+                throw KEAIOException("Could not copy the image band.");
+            }
+            this->getH5File()->unlink(dstName);
+            this->getH5File()->move(tmpName, dstName);
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
             throw e;
         }
+        catch( const H5::Exception &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
+        return true;
     }
     
-    KEALayerType KEAImageIO::getImageBandLayerType(uint32_t band)
+    void KEAImageIO::calcImageBandStats(uint32_t band, KEABandStats *stats, size_t numBins, double histMin, double histMax, bool includeOutOfRange, unsigned int numThreads)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
+        if((numBins > 0) && !(histMax > histMin))
+        {
+            throw KEAIOException("The histogram maximum must be greater than the minimum.");
+        }
         
-        KEALayerType imgLayerType = kea_continuous;
+        // the running mean and sum of squared differences (Welford) of the
+        // values seen by each thread, combined at the end.
+        struct BandAccum
+        {
+            double min = 0;
+            double max = 0;
+            double mean = 0;
+            double m2 = 0;
+            uint64_t count = 0;
+            std::vector<uint64_t> histogram;
+        };
         
-        // READ IMAGE LAYER TYPE
-        try 
-        {
-            hsize_t dimsValue[1];
-            dimsValue[0] = 1;
-            H5::DataSpace valueDataSpace(1, dimsValue);
-            uint32_t value[1];
-            H5::DataSet datasetImgLT = this->keaImgFile->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_TYPE );
-            datasetImgLT.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
-            imgLayerType = (KEALayerType)value[0];
-            datasetImgLT.close();
-            valueDataSpace.close();
-        } 
-        catch ( const H5::Exception &e) 
+        try
         {
-            throw KEAIOException("The image band data type was not specified.");
+            bool noDataDefined = false;
+            double noDataVal = 0;
+            try
+            {
+                std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+                this->getNoDataValue(band, &noDataVal, kea_64float);
+                noDataDefined = true;
+            }
+            catch(const KEAIOException &e)
+            {
+                noDataDefined = false;
+            }
+            
+            numThreads = getNumThreads(numThreads);
+            std::vector<BandAccum> threadAccums(numThreads);
+            for(BandAccum &accum : threadAccums)
+            {
+                accum.histogram.resize(numBins, 0);
+            }
+            uint64_t xSize = this->spatialInfoFile->xSize;
+            const double binScale = (numBins > 0) ? (numBins / (histMax - histMin)) : 0;
+            this->processBandStrips(band, kea_64float, numThreads, [&](const void *data, uint64_t, uint64_t rowStart, uint64_t rowEnd, unsigned int thread)
+            {
+                BandAccum &accum = threadAccums[thread];
+                const double *values = ((const double*)data) + (rowStart * xSize);
+                const double *valuesEnd = ((const double*)data) + (rowEnd * xSize);
+                for(; values < valuesEnd; ++values)
+                {
+                    double value = *values;
+                    if(std::isnan(value) || (noDataDefined && (value == noDataVal)))
+                    {
+                        continue;
+                    }
+                    if(accum.count == 0)
+                    {
+                        accum.min = value;
+                        accum.max = value;
+                    }
+                    else
+                    {
+                        accum.min = std::min(accum.min, value);
+                        accum.max = std::max(accum.max, value);
+                    }
+                    ++accum.count;
+                    double delta = value - accum.mean;
+                    accum.mean += delta / accum.count;
+                    accum.m2 += delta * (value - accum.mean);
+                    
+                    if(numBins > 0)
+                    {
+                        double bin = std::floor((value - histMin) * binScale);
+                        if(bin < 0)
+                        {
+                            if(!includeOutOfRange)
+                            {
+                                continue;
+                            }
+                            bin = 0;
+                        }
+                        else if(bin >= numBins)
+                        {
+                            if(!includeOutOfRange)
+                            {
+                                continue;
+                            }
+                            bin = numBins - 1;
+                        }
+                        ++accum.histogram[(size_t)bin];
+                    }
+                }
+            });
+            
+            // merge the threads (Chan et al.'s pairwise update)
+            BandAccum total;
+            total.histogram.resize(numBins, 0);
+            for(const BandAccum &accum : threadAccums)
+            {
+                for(size_t i = 0; i < numBins; ++i)
+                {
+                    total.histogram[i] += accum.histogram[i];
+                }
+                if(accum.count == 0)
+                {
+                    continue;
+                }
+                if(total.count == 0)
+                {
+                    total.min = accum.min;
+                    total.max = accum.max;
+                }
+                else
+                {
+                    total.min = std::min(total.min, accum.min);
+                    total.max = std::max(total.max, accum.max);
+                }
+                uint64_t count = total.count + accum.count;
+                double delta = accum.mean - total.mean;
+                total.mean += delta * accum.count / count;
+                total.m2 += accum.m2 + (delta * delta * total.count * accum.count / count);
+                total.count = count;
+            }
+            
+            stats->min = total.min;
+            stats->max = total.max;
+            stats->mean = total.mean;
+            stats->stdDev = (total.count > 0) ? std::sqrt(total.m2 / total.count) : 0;
+            stats->validCount = total.count;
+            stats->histogram.swap(total.histogram);
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
             throw e;
         }
+        catch( const H5::Exception &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
-        
-        return imgLayerType;
     }
     
-    void KEAImageIO::setImageBandClrInterp(uint32_t band, KEABandClrInterp imgLayerClrInterp)
+    void KEAImageIO::calcSegmentExtents(uint32_t band, unsigned int numThreads)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        // WRITE IMAGE LAYER USAGE
-        uint32_t value = (uint32_t) imgLayerClrInterp;
+        struct SegExtent
+        {
+            int64_t minX = -1;
+            int64_t minY = -1;
+            int64_t maxX = -1;
+            int64_t maxY = -1;
+            int64_t count = 0;
+        };
+        
+        KEAAttributeTable *att = nullptr;
         try 
         {
-            H5::DataSet datasetImgLU = this->keaImgFile->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_USAGE );
-            datasetImgLU.write(&value, H5::PredType::NATIVE_UINT32);
-            datasetImgLU.close();
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-        } 
-        catch ( const H5::Exception &e) 
-        {
-            hsize_t dimsUsage[1];
-            dimsUsage[0] = 1;
-            H5::DataSpace usageDataSpace(1, dimsUsage);
-            H5::DataSet usageDataset = this->keaImgFile->createDataSet((KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_USAGE), H5::PredType::STD_U8LE, usageDataSpace);
-            usageDataset.write( &value, H5::PredType::NATIVE_UINT32 );
-            usageDataset.close();
+            bool noDataDefined = false;
+            uint64_t noDataVal = 0;
+            try
+            {
+                this->getNoDataValue(band, &noDataVal, kea_64uint);
+                noDataDefined = true;
+            }
+            catch(const KEAIOException &e)
+            {
+                noDataDefined = false;
+            }
+            
+            // each thread collects the segments within its part of a strip,
+            // which are then merged into the one table for the image, so
+            // memory only grows with the number of segments present.
+            att = this->getAttributeTable(kea_att_file, band);
+            size_t numSegs = att->getSize();
+            std::vector<int64_t> minX(numSegs, -1);
+            std::vector<int64_t> minY(numSegs, -1);
+            std::vector<int64_t> maxX(numSegs, -1);
+            std::vector<int64_t> maxY(numSegs, -1);
+            std::vector<int64_t> count(numSegs, 0);
+            std::mutex extentsMutex;
+            uint64_t xSize = this->spatialInfoFile->xSize;
+            this->processBandStrips(band, kea_64uint, getNumThreads(numThreads), [&](const void *data, uint64_t yOff, uint64_t rowStart, uint64_t rowEnd, unsigned int)
+            {
+                std::unordered_map<uint64_t, SegExtent> extents;
+                const uint64_t *labels = (const uint64_t*)data;
+                uint64_t lastLabel = 0;
+                SegExtent *extent = nullptr;
+                for(uint64_t row = rowStart; row < rowEnd; ++row)
+                {
+                    int64_t y = yOff + row;
+                    const uint64_t *rowLabels = labels + (row * xSize);
+                    for(uint64_t x = 0; x < xSize; ++x)
+                    {
+                        uint64_t label = rowLabels[x];
+                        if(noDataDefined && (label == noDataVal))
+                        {
+                            continue;
+                        }
+                        // segments are mostly runs of pixels along a row
+                        if((extent == nullptr) || (label != lastLabel))
+                        {
+                            extent = &extents[label];
+                            lastLabel = label;
+                        }
+                        if(extent->count == 0)
+                        {
+                            extent->minX = x;
+                            extent->maxX = x;
+                            extent->minY = y;
+                            extent->maxY = y;
+                        }
+                        else
+                        {
+                            extent->minX = std::min<int64_t>(extent->minX, x);
+                            extent->maxX = std::max<int64_t>(extent->maxX, x);
+                            extent->maxY = y;
+                        }
+                        ++extent->count;
+                    }
+                }
+                
+                std::lock_guard<std::mutex> lock(extentsMutex);
+                for(const std::pair<const uint64_t, SegExtent> &item : extents)
+                {
+                    size_t i = item.first;
+                    const SegExtent &segExtent = item.second;
+                    if(i >= numSegs)
+                    {
+                        numSegs = i + 1;
+                        minX.resize(numSegs, -1);
+                        minY.resize(numSegs, -1);
+                        maxX.resize(numSegs, -1);
+                        maxY.resize(numSegs, -1);
+                        count.resize(numSegs, 0);
+                    }
+                    if(count[i] == 0)
+                    {
+                        minX[i] = segExtent.minX;
+                        minY[i] = segExtent.minY;
+                        maxX[i] = segExtent.maxX;
+                        maxY[i] = segExtent.maxY;
+                    }
+                    else
+                    {
+                        minX[i] = std::min(minX[i], segExtent.minX);
+                        minY[i] = std::min(minY[i], segExtent.minY);
+                        maxX[i] = std::max(maxX[i], segExtent.maxX);
+                        maxY[i] = std::max(maxY[i], segExtent.maxY);
+                    }
+                    count[i] += segExtent.count;
+                }
+            });
+            
+            if(numSegs > att->getSize())
+            {
+                att->addRows(numSegs - att->getSize());
+            }
+            writeATTColumn(att, KEA_ATT_SEG_MINX_FIELD, "Generic", minX);
+            writeATTColumn(att, KEA_ATT_SEG_MINY_FIELD, "Generic", minY);
+            writeATTColumn(att, KEA_ATT_SEG_MAXX_FIELD, "Generic", maxX);
+            writeATTColumn(att, KEA_ATT_SEG_MAXY_FIELD, "Generic", maxY);
+            writeATTColumn(att, KEA_ATT_PIXELCOUNT_FIELD, KEA_ATT_PIXELCOUNT_USAGE, count);
+            
+            KEAAttributeTable::destroyAttributeTable(att);
+            att = nullptr;
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAException &e)
         {
-            throw e;
+            KEAAttributeTable::destroyAttributeTable(att);
+            throw KEAIOException(e.what());
         }
+        catch( const H5::Exception &e )
+		{
+            KEAAttributeTable::destroyAttributeTable(att);
+			throw KEAIOException(e.getCDetailMsg());
+		}
         catch ( const std::exception &e)
         {
+            KEAAttributeTable::destroyAttributeTable(att);
             throw KEAIOException(e.what());
         }
     }
     
-    KEABandClrInterp KEAImageIO::getImageBandClrInterp(uint32_t band)
+    void KEAImageIO::readSegmentWindow(uint32_t band, size_t fid, const std::vector<uint32_t> &valueBands, KEASegmentWindow *window)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        KEABandClrInterp imgLayerClrInterp = kea_generic;
-        
-        // READ IMAGE LAYER USAGE
+        KEAAttributeTable *att = nullptr;
         try 
         {
-            hsize_t dimsValue[1];
-            dimsValue[0] = 1;
-            H5::DataSpace valueDataSpace(1, dimsValue);
-            uint32_t value[1];
-            H5::DataSet datasetImgLU = this->keaImgFile->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_USAGE );
-            datasetImgLU.read(value, H5::PredType::NATIVE_UINT32, valueDataSpace);
-            imgLayerClrInterp = (KEABandClrInterp)value[0];
-            datasetImgLU.close();
-            valueDataSpace.close();
-        } 
-        catch ( const H5::Exception &e) 
-        {
-            //throw KEAIOException("The image band data type was not specified.");
-            imgLayerClrInterp = kea_generic; // Field was not present within the file.
+            att = this->getAttributeTable(kea_att_file, band);
+            if(!att->hasField(KEA_ATT_SEG_MINX_FIELD) || !att->hasField(KEA_ATT_SEG_MINY_FIELD) || 
+               !att->hasField(KEA_ATT_SEG_MAXX_FIELD) || !att->hasField(KEA_ATT_SEG_MAXY_FIELD))
+            {
+                throw KEAIOException("The segment extents have not been calculated (see calcSegmentExtents).");
+            }
+            if(fid >= att->getSize())
+            {
+                throw KEAIOException("Requested segment (" + sizet2Str(fid) + ") is not within the attribute table.");
+            }
+            
+            int64_t minX = att->getIntField(fid, att->getFieldIndex(KEA_ATT_SEG_MINX_FIELD));
+            int64_t minY = att->getIntField(fid, att->getFieldIndex(KEA_ATT_SEG_MINY_FIELD));
+            int64_t maxX = att->getIntField(fid, att->getFieldIndex(KEA_ATT_SEG_MAXX_FIELD));
+            int64_t maxY = att->getIntField(fid, att->getFieldIndex(KEA_ATT_SEG_MAXY_FIELD));
+            KEAAttributeTable::destroyAttributeTable(att);
+            att = nullptr;
+            
+            window->mask.clear();
+            window->values.assign(valueBands.size(), std::vector<double>());
+            if((minX < 0) || (minY < 0) || (maxX < minX) || (maxY < minY))
+            {
+                // segment has no pixels.
+                window->xOff = 0;
+                window->yOff = 0;
+                window->xSize = 0;
+                window->ySize = 0;
+                return;
+            }
+            
+            window->xOff = minX;
+            window->yOff = minY;
+            window->xSize = (maxX - minX) + 1;
+            window->ySize = (maxY - minY) + 1;
+            uint64_t numPxls = window->xSize * window->ySize;
+            
+            std::vector<uint64_t> labels(numPxls);
+            this->readImageBlock2Band(band, labels.data(), window->xOff, window->yOff, window->xSize, window->ySize, window->xSize, window->ySize, kea_64uint);
+            window->mask.resize(numPxls);
+            for(uint64_t i = 0; i < numPxls; ++i)
+            {
+                window->mask[i] = (labels[i] == fid)?1:0;
+            }
+            
+            for(size_t n = 0; n < valueBands.size(); ++n)
+            {
+                window->values[n].resize(numPxls);
+                this->readImageBlock2Band(valueBands[n], window->values[n].data(), window->xOff, window->yOff, window->xSize, window->ySize, window->xSize, window->ySize, kea_64float);
+            }
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
+            KEAAttributeTable::destroyAttributeTable(att);
             throw e;
         }
+        catch(const KEAException &e)
+        {
+            KEAAttributeTable::destroyAttributeTable(att);
+            throw KEAIOException(e.what());
+        }
         catch ( const std::exception &e)
         {
+            KEAAttributeTable::destroyAttributeTable(att);
             throw KEAIOException(e.what());
         }
-        
-        return imgLayerClrInterp;
     }
     
-    void KEAImageIO::createOverview(uint32_t band, uint32_t overview, uint64_t xSize, uint64_t ySize)
+    void KEAImageIO::applyRATColumn(uint32_t srcBand, size_t colIdx, uint32_t dstBand, unsigned int numThreads)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
-                
-        try 
-        {
-            // Try to open dataset with overviewName
-            H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( overviewName );
-            this->keaImgFile->unlink(overviewName);
-        }
-        catch (const H5::Exception &e)
-        {
-            // Do nothing as dataset does not exist.
-        }
+        struct OverviewInfo
+        {
+            uint32_t overview;
+            uint64_t xSize;
+            uint64_t ySize;
+            std::vector<uint64_t> srcRows;
+            std::vector<uint64_t> srcCols;
+        };
+        
+        struct ApplyStrip
+        {
+            uint64_t yOff = 0;
+            uint64_t nRows = 0;
+            std::vector<uint64_t> labels;
+            std::vector<double> out;
+            // only used when the column is too large to be held in memory
+            std::vector<double> column;
+            uint64_t columnOff = 0;
+            std::vector<uint64_t> ovYOff;
+            std::vector<uint64_t> ovRows;
+            std::vector< std::vector<double> > ovOut;
+        };
         
+        KEAAttributeTable *att = nullptr;
         try 
         {
-            KEADataType imgDataType = this->getImageBandDataType(band);
+            att = this->getAttributeTable(kea_att_file, srcBand);
+            KEAATTField field = att->getField(colIdx);
+            if(field.dataType == kea_att_string)
+            {
+                throw KEAIOException("Only numeric attribute table columns can be applied to a band.");
+            }
+            uint64_t numRows = att->getSize();
             
-            H5::DataType imgBandDT = convertDatatypeKeaToH5STD(imgDataType);
-            int initFillVal = 0;
+            auto readColumn = [&](uint64_t start, uint64_t len, std::vector<double> *vals)
+            {
+                readATTColumn(att, field, start, len, vals);
+            };
             
-            hsize_t imageBandDims[2];
-            imageBandDims[0] = ySize;
-            imageBandDims[1] = xSize;
-            H5::DataSpace imgBandDataSpace(2, imageBandDims);
+            // the column is cached whole where it fits within the budget,
+            // otherwise just the range of labels within each strip is read.
+            bool cacheColumn = (numRows * sizeof(double)) <= KEA_ATT_COLUMN_CACHE_BYTES;
+            std::vector<double> column;
+            if(cacheColumn)
+            {
+                readColumn(0, numRows, &column);
+            }
             
-            hsize_t dimsImageBandChunk[2];
-            // Make sure that the chuck size is not bigger than the dataset.
-            uint32_t imgBlockSize = this->getImageBlockSize(band);
-            uint64_t smallestAxis = 0;
-            if(xSize < ySize)
+            bool srcNoDataDefined = false;
+            uint64_t srcNoData = 0;
+            try
+            {
+                this->getNoDataValue(srcBand, &srcNoData, kea_64uint);
+                srcNoDataDefined = true;
+            }
+            catch(const KEAIOException &e)
+            {
+                srcNoDataDefined = false;
+            }
+            double dstNoData = 0;
+            try
+            {
+                this->getNoDataValue(dstBand, &dstNoData, kea_64float);
+            }
+            catch(const KEAIOException &e)
+            {
+                dstNoData = 0;
+            }
+            
+            uint64_t xSize = this->spatialInfoFile->xSize;
+            uint64_t ySize = this->spatialInfoFile->ySize;
+            std::vector<OverviewInfo> overviews(this->getNumOfOverviews(dstBand));
+            for(size_t i = 0; i < overviews.size(); ++i)
+            {
+                OverviewInfo &ovInfo = overviews[i];
+                ovInfo.overview = i + 1;
+                this->getOverviewSize(dstBand, ovInfo.overview, &ovInfo.xSize, &ovInfo.ySize);
+                ovInfo.srcRows.resize(ovInfo.ySize);
+                for(uint64_t y = 0; y < ovInfo.ySize; ++y)
+                {
+                    ovInfo.srcRows[y] = std::min<uint64_t>(((y * 2 + 1) * ySize) / (ovInfo.ySize * 2), ySize - 1);
+                }
+                ovInfo.srcCols.resize(ovInfo.xSize);
+                for(uint64_t x = 0; x < ovInfo.xSize; ++x)
+                {
+                    ovInfo.srcCols[x] = std::min<uint64_t>(((x * 2 + 1) * xSize) / (ovInfo.xSize * 2), xSize - 1);
+                }
+            }
+            
+            numThreads = getNumThreads(numThreads);
+            auto gatherStrip = [&, numThreads](ApplyStrip *strip)
+            {
+                const double *colVals = cacheColumn?column.data():strip->column.data();
+                uint64_t colOff = cacheColumn?0:strip->columnOff;
+                uint64_t colLen = cacheColumn?column.size():strip->column.size();
+                auto lookup = [&](uint64_t label) -> double
+                {
+                    if((srcNoDataDefined && (label == srcNoData)) || (label < colOff) || ((label - colOff) >= colLen))
+                    {
+                        return dstNoData;
+                    }
+                    return colVals[label - colOff];
+                };
+                
+                runOnThreads(strip->nRows, numThreads, [&](uint64_t start, uint64_t end, unsigned int)
+                {
+                    for(uint64_t i = start * xSize; i < end * xSize; ++i)
+                    {
+                        strip->out[i] = lookup(strip->labels[i]);
+                    }
+                });
+                
+                for(size_t n = 0; n < overviews.size(); ++n)
+                {
+                    const OverviewInfo &ovInfo = overviews[n];
+                    std::vector<double> &ovOut = strip->ovOut[n];
+                    for(uint64_t y = 0; y < strip->ovRows[n]; ++y)
+                    {
+                        const uint64_t *rowLabels = strip->labels.data() + ((ovInfo.srcRows[strip->ovYOff[n] + y] - strip->yOff) * xSize);
+                        for(uint64_t x = 0; x < ovInfo.xSize; ++x)
+                        {
+                            ovOut[(y * ovInfo.xSize) + x] = lookup(rowLabels[ovInfo.srcCols[x]]);
+                        }
+                    }
+                }
+            };
+            
+            auto writeStrip = [&](ApplyStrip &strip)
             {
-                smallestAxis = xSize;
-            }
-            else
+                this->writeImageBlock2Band(dstBand, strip.out.data(), 0, strip.yOff, xSize, strip.nRows, xSize, strip.nRows, kea_64float);
+                for(size_t n = 0; n < overviews.size(); ++n)
+                {
+                    if(strip.ovRows[n] > 0)
+                    {
+                        this->writeToOverview(dstBand, overviews[n].overview, strip.ovOut[n].data(), 0, strip.ovYOff[n], overviews[n].xSize, strip.ovRows[n], overviews[n].xSize, strip.ovRows[n], kea_64float);
+                    }
+                }
+            };
+            
+            uint64_t stripRows = this->getImageBlockSize(srcBand);
+            if(stripRows == 0)
             {
-                smallestAxis = ySize;
+                stripRows = KEA_IMAGE_CHUNK_SIZE;
             }
-            if(smallestAxis < imgBlockSize)
+            
+            // While one strip is gathered on the worker threads the previous
+            // strip is written and the next read; HDF5 is only used here.
+            ApplyStrip strips[2];
+            std::future<void> gathered;
+            uint64_t stripIdx = 0;
+            for(uint64_t yOff = 0; yOff < ySize; yOff += stripRows, ++stripIdx)
             {
-                dimsImageBandChunk[0] = smallestAxis;
-                dimsImageBandChunk[1] = smallestAxis;
+                ApplyStrip &strip = strips[stripIdx % 2];
+                strip.yOff = yOff;
+                strip.nRows = std::min(stripRows, ySize - yOff);
+                strip.labels.resize(xSize * strip.nRows);
+                strip.out.resize(xSize * strip.nRows);
+                this->readImageBlock2Band(srcBand, strip.labels.data(), 0, yOff, xSize, strip.nRows, xSize, strip.nRows, kea_64uint);
+                
+                if(!cacheColumn)
+                {
+                    uint64_t minLabel = numRows;
+                    uint64_t maxLabel = 0;
+                    for(uint64_t label : strip.labels)
+                    {
+                        if((label < numRows) && !(srcNoDataDefined && (label == srcNoData)))
+                        {
+                            minLabel = std::min(minLabel, label);
+                            maxLabel = std::max(maxLabel, label);
+                        }
+                    }
+                    strip.columnOff = minLabel;
+                    readColumn(minLabel, (minLabel < numRows)?((maxLabel - minLabel) + 1):0, &strip.column);
+                }
+                
+                strip.ovYOff.assign(overviews.size(), 0);
+                strip.ovRows.assign(overviews.size(), 0);
+                strip.ovOut.resize(overviews.size());
+                for(size_t n = 0; n < overviews.size(); ++n)
+                {
+                    const std::vector<uint64_t> &srcRows = overviews[n].srcRows;
+                    uint64_t ovStart = std::lower_bound(srcRows.begin(), srcRows.end(), yOff) - srcRows.begin();
+                    uint64_t ovEnd = std::lower_bound(srcRows.begin(), srcRows.end(), yOff + strip.nRows) - srcRows.begin();
+                    strip.ovYOff[n] = ovStart;
+                    strip.ovRows[n] = ovEnd - ovStart;
+                    strip.ovOut[n].resize(strip.ovRows[n] * overviews[n].xSize);
+                }
+                
+                if(gathered.valid())
+                {
+                    gathered.get();
+                    gathered = std::async(std::launch::async, gatherStrip, &strip);
+                    writeStrip(strips[(stripIdx + 1) % 2]);
+                }
+                else
+                {
+                    gathered = std::async(std::launch::async, gatherStrip, &strip);
+                }
             }
-            else
+            if(gathered.valid())
             {
-                dimsImageBandChunk[0] = imgBlockSize;
-                dimsImageBandChunk[1] = imgBlockSize;
+                gathered.get();
+                writeStrip(strips[(stripIdx + 1) % 2]);
             }
-			
-            
-            H5::DSetCreatPropList initParamsImgBand;
-			initParamsImgBand.setChunk(2, dimsImageBandChunk);			
-			initParamsImgBand.setShuffle();
-            initParamsImgBand.setDeflate(KEA_DEFLATE);
-			initParamsImgBand.setFillValue( H5::PredType::NATIVE_INT, &initFillVal);
-            
-            H5::StrType strdatatypeLen6(H5::PredType::C_S1, 6);
-            H5::StrType strdatatypeLen4(H5::PredType::C_S1, 4);
-            const H5std_string strClassVal ("IMAGE");
-            const H5std_string strImgVerVal ("1.2");
-            H5::DataSpace attr_dataspace = H5::DataSpace(H5S_SCALAR);
-                        
-            // CREATE THE IMAGE DATA ARRAY
-            H5::DataSet imgBandDataSet = this->keaImgFile->createDataSet(overviewName, imgBandDT, imgBandDataSpace, initParamsImgBand);
-            
-            H5::Attribute classAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_CLASS, strdatatypeLen6, attr_dataspace);
-            classAttribute.write(strdatatypeLen6, strClassVal); 
-            classAttribute.close();
-            
-            H5::Attribute imgVerAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_IMAGE_VERSION, strdatatypeLen4, attr_dataspace);
-            imgVerAttribute.write(strdatatypeLen4, strImgVerVal);
-            imgVerAttribute.close();
-            
-            H5::Attribute blockSizeAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE, H5::PredType::STD_U16LE, attr_dataspace);
-            uint32_t blockSizeTmp = dimsImageBandChunk[0]; // copy into a temporary variable to write to the file - fixing a bug on solaris.
-            blockSizeAttribute.write(H5::PredType::NATIVE_UINT32, &blockSizeTmp);
-            blockSizeAttribute.close();
-            
-            imgBandDataSet.close();
-            
-            attr_dataspace.close();
-            imgBandDataSet.close();
             
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
+            KEAAttributeTable::destroyAttributeTable(att);
+            att = nullptr;
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
         }
-        catch (const H5::Exception &e)
+        catch(const KEAIOException &e)
         {
-            throw KEAIOException(e.getCDetailMsg());
+            KEAAttributeTable::destroyAttributeTable(att);
+            throw e;
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAException &e)
         {
-            throw e;
+            KEAAttributeTable::destroyAttributeTable(att);
+            throw KEAIOException(e.what());
         }
+        catch( const H5::Exception &e )
+		{
+            KEAAttributeTable::destroyAttributeTable(att);
+			throw KEAIOException(e.getCDetailMsg());
+		}
         catch ( const std::exception &e)
         {
+            KEAAttributeTable::destroyAttributeTable(att);
             throw KEAIOException(e.what());
         }
     }
     
-    void KEAImageIO::removeOverview(uint32_t band, uint32_t overview)
+    bool KEAImageIO::getRGBALookupTable(uint32_t band, std::vector<uint8_t> *lut)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
-        
+        static const char *usages[4] = {"Red", "Green", "Blue", "Alpha"};
+        KEAAttributeTable *att = nullptr;
+        bool found = false;
         try 
         {
-            // Try to open dataset with overviewName
-            H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( overviewName );
-            this->keaImgFile->unlink(overviewName);
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
+            att = this->getAttributeTable(kea_att_file, band);
+            
+            int colIdxs[4] = {-1, -1, -1, -1};
+            std::vector<std::string> names = att->getFieldNames();
+            for(const std::string &name : names)
+            {
+                KEAATTField field = att->getField(name);
+                for(int c = 0; c < 4; ++c)
+                {
+                    if((field.dataType == kea_att_int) && (field.usage == usages[c]))
+                    {
+                        colIdxs[c] = field.idx;
+                    }
+                }
+            }
+            
+            found = (colIdxs[0] != -1) && (colIdxs[1] != -1) && (colIdxs[2] != -1) && (colIdxs[3] != -1);
+            if(found)
+            {
+                size_t numRows = att->getSize();
+                size_t blockRows = KEA_ATT_CHUNK_SIZE * KEA_ATT_PIPELINE_BLOCK_CHUNKS;
+                std::vector<int64_t> vals(std::min(numRows, blockRows));
+                lut->resize(numRows * 4);
+                for(size_t start = 0; start < numRows; start += blockRows)
+                {
+                    size_t len = std::min(blockRows, numRows - start);
+                    for(int c = 0; c < 4; ++c)
+                    {
+                        att->getIntFields(start, len, colIdxs[c], vals.data());
+                        for(size_t i = 0; i < len; ++i)
+                        {
+                            (*lut)[((start + i) * 4) + c] = (uint8_t)std::min<int64_t>(std::max<int64_t>(vals[i], 0), 255);
+                        }
+                    }
+                }
+            }
+            
+            KEAAttributeTable::destroyAttributeTable(att);
+            att = nullptr;
         }
-        catch (const H5::Exception &e)
+        catch(const KEAIOException &e)
         {
-            // Do nothing as dataset does not exist.
+            KEAAttributeTable::destroyAttributeTable(att);
+            throw e;
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAException &e)
         {
-            throw e;
+            KEAAttributeTable::destroyAttributeTable(att);
+            throw KEAIOException(e.what());
         }
         catch ( const std::exception &e)
         {
+            KEAAttributeTable::destroyAttributeTable(att);
             throw KEAIOException(e.what());
         }
-        
+        return found;
     }
     
-    uint32_t KEAImageIO::getOverviewBlockSize(uint32_t band, uint32_t overview)
+    void KEAImageIO::renderRGBA(uint32_t band, uint32_t overview, const std::vector<uint8_t> &lut, uint8_t *rgba, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSize, uint64_t ySize, unsigned int numThreads)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        uint32_t ovBlockSize = 0;
-        
         try 
         {
-            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
-            if(band == 0)
+            std::vector<uint64_t> labels(xSize * ySize);
+            if(overview == 0)
             {
-                throw KEAIOException("KEA Image Bands start at 1.");
+                this->readImageBlock2Band(band, labels.data(), xPxlOff, yPxlOff, xSize, ySize, xSize, ySize, kea_64uint);
             }
-            else if(band > this->numImgBands)
+            else
             {
-                throw KEAIOException("Band is not present within image."); 
+                this->readFromOverview(band, overview, labels.data(), xPxlOff, yPxlOff, xSize, ySize, xSize, ySize, kea_64uint);
             }
             
-            // OPEN BAND DATASET
-            try 
+            bool noDataDefined = false;
+            uint64_t noDataVal = 0;
+            try
             {
-                std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
-                H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( overviewName );
-                H5::Attribute blockSizeAtt = imgBandDataset.openAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE);
-                blockSizeAtt.read(H5::PredType::NATIVE_UINT32, &ovBlockSize);
-                imgBandDataset.close();
-                blockSizeAtt.close();
-            } 
-            catch ( const H5::Exception &e) 
+                this->getNoDataValue(band, &noDataVal, kea_64uint);
+                noDataDefined = true;
+            }
+            catch(const KEAIOException &e)
             {
-                throw KEAIOException("Could not retrieve the overview block size.");
-            }            
+                noDataDefined = false;
+            }
+            
+            uint64_t numEntries = lut.size() / 4;
+            const uint8_t *lutVals = lut.data();
+            runOnThreads(ySize, getNumThreads(numThreads), [&](uint64_t start, uint64_t end, unsigned int)
+            {
+                for(uint64_t i = start * xSize; i < end * xSize; ++i)
+                {
+                    uint64_t label = labels[i];
+                    if((label >= numEntries) || (noDataDefined && (label == noDataVal)))
+                    {
+                        memset(rgba + (i * 4), 0, 4);
+                    }
+                    else
+                    {
+                        memcpy(rgba + (i * 4), lutVals + (label * 4), 4);
+                    }
+                }
+            });
         }
         catch(const KEAIOException &e)
         {
             throw e;
         }
-        catch( const H5::FileIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSetIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSpaceIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataTypeIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
-        
-        return ovBlockSize;
     }
     
-    void KEAImageIO::writeToOverview(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeOut, uint64_t ySizeOut, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
+    void KEAImageIO::relabel(uint32_t band, const std::vector<uint64_t> &mapping, unsigned int numThreads)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
+        struct RelabelStrip
+        {
+            uint64_t yOff = 0;
+            uint64_t nRows = 0;
+            std::vector<uint64_t> labels;
+        };
+        
+        KEAAttributeTable *att = nullptr;
+        std::vector<std::vector<size_t>* > blockNeighbours;
         try 
         {
-            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
-            if(band == 0)
+            bool noDataDefined = false;
+            uint64_t noDataVal = 0;
+            try
             {
-                throw KEAIOException("KEA Image Bands start at 1.");
+                this->getNoDataValue(band, &noDataVal, kea_64uint);
+                noDataDefined = true;
             }
-            else if(band > this->numImgBands)
+            catch(const KEAIOException &e)
             {
-                throw KEAIOException("Band is not present within image."); 
+                noDataDefined = false;
+            }
+            uint64_t dropVal = noDataDefined?noDataVal:0;
+            
+            // the pixel counts of the new values are collected by each thread
+            // for its part of a strip while the base band is remapped, then
+            // merged into the one table, sized from the mapping, so memory
+            // only grows with the labels present.
+            numThreads = getNumThreads(numThreads);
+            uint64_t maxNewLabel = 0;
+            for(uint64_t newLabel : mapping)
+            {
+                if(newLabel != KEA_RELABEL_DROP)
+                {
+                    maxNewLabel = std::max(maxNewLabel, newLabel + 1);
+                }
+            }
+            std::vector<int64_t> counts(maxNewLabel, 0);
+            std::mutex countsMutex;
+            uint32_t numOverviews = this->getNumOfOverviews(band);
+            for(uint32_t overview = 0; overview <= numOverviews; ++overview)
+            {
+                uint64_t xSize = this->spatialInfoFile->xSize;
+                uint64_t ySize = this->spatialInfoFile->ySize;
+                uint64_t stripRows = 0;
+                if(overview == 0)
+                {
+                    stripRows = this->getImageBlockSize(band);
+                }
+                else
+                {
+                    this->getOverviewSize(band, overview, &xSize, &ySize);
+                    stripRows = this->getOverviewBlockSize(band, overview);
+                }
+                if(stripRows == 0)
+                {
+                    stripRows = KEA_IMAGE_CHUNK_SIZE;
+                }
+                
+                auto remapStrip = [&, overview, xSize](RelabelStrip *strip)
+                {
+                    runOnThreads(strip->nRows, numThreads, [&](uint64_t start, uint64_t end, unsigned int)
+                    {
+                        std::unordered_map<uint64_t, int64_t> stripCounts;
+                        uint64_t lastLabel = 0;
+                        int64_t *count = nullptr;
+                        for(uint64_t i = start * xSize; i < end * xSize; ++i)
+                        {
+                            uint64_t label = strip->labels[i];
+                            if(noDataDefined && (label == noDataVal))
+                            {
+                                continue;
+                            }
+                            if(label < mapping.size())
+                            {
+                                label = (mapping[label] == KEA_RELABEL_DROP)?dropVal:mapping[label];
+                                strip->labels[i] = label;
+                                if(noDataDefined && (label == noDataVal))
+                                {
+                                    continue;
+                                }
+                            }
+                            if(overview == 0)
+                            {
+                                // segments are mostly runs of pixels along a row
+                                if((count == nullptr) || (label != lastLabel))
+                                {
+                                    count = &stripCounts[label];
+                                    lastLabel = label;
+                                }
+                                ++(*count);
+                            }
+                        }
+                        
+                        if(!stripCounts.empty())
+                        {
+                            std::lock_guard<std::mutex> lock(countsMutex);
+                            for(const std::pair<const uint64_t, int64_t> &item : stripCounts)
+                            {
+                                if(item.first >= counts.size())
+                                {
+                                    counts.resize(item.first + 1, 0);
+                                }
+                                counts[item.first] += item.second;
+                            }
+                        }
+                    });
+                };
+                
+                auto writeStrip = [&, overview, xSize](RelabelStrip &strip)
+                {
+                    if(overview == 0)
+                    {
+                        this->writeImageBlock2Band(band, strip.labels.data(), 0, strip.yOff, xSize, strip.nRows, xSize, strip.nRows, kea_64uint);
+                    }
+                    else
+                    {
+                        this->writeToOverview(band, overview, strip.labels.data(), 0, strip.yOff, xSize, strip.nRows, xSize, strip.nRows, kea_64uint);
+                    }
+                };
+                
+                // While one strip is remapped on the worker threads the
+                // previous strip is written and the next read.
+                RelabelStrip strips[2];
+                std::future<void> remapped;
+                uint64_t stripIdx = 0;
+                for(uint64_t yOff = 0; yOff < ySize; yOff += stripRows, ++stripIdx)
+                {
+                    RelabelStrip &strip = strips[stripIdx % 2];
+                    strip.yOff = yOff;
+                    strip.nRows = std::min(stripRows, ySize - yOff);
+                    strip.labels.resize(xSize * strip.nRows);
+                    if(overview == 0)
+                    {
+                        this->readImageBlock2Band(band, strip.labels.data(), 0, yOff, xSize, strip.nRows, xSize, strip.nRows, kea_64uint);
+                    }
+                    else
+                    {
+                        this->readFromOverview(band, overview, strip.labels.data(), 0, yOff, xSize, strip.nRows, xSize, strip.nRows, kea_64uint);
+                    }
+                    
+                    if(remapped.valid())
+                    {
+                        remapped.get();
+                        remapped = std::async(std::launch::async, remapStrip, &strip);
+                        writeStrip(strips[(stripIdx + 1) % 2]);
+                    }
+                    else
+                    {
+                        remapped = std::async(std::launch::async, remapStrip, &strip);
+                    }
+                }
+                if(remapped.valid())
+                {
+                    remapped.get();
+                    writeStrip(strips[(stripIdx + 1) % 2]);
+                }
+            }
+            
+            // the table only grows to the largest label in the image
+            while(!counts.empty() && (counts.back() == 0))
+            {
+                counts.pop_back();
+            }
+            
+            // srcRows gives the old row moved to each new row, being that
+            // with the most pixels (by the existing Histogram column) or
+            // otherwise the first.
+            att = this->getAttributeTable(kea_att_file, band);
+            size_t oldSize = att->getSize();
+            size_t blockRows = KEA_ATT_CHUNK_SIZE * KEA_ATT_PIPELINE_BLOCK_CHUNKS;
+            std::vector<double> oldCounts;
+            if(att->hasField(KEA_ATT_PIXELCOUNT_FIELD))
+            {
+                KEAATTField countField = att->getField(KEA_ATT_PIXELCOUNT_FIELD);
+                oldCounts.resize(oldSize);
+                std::vector<double> blockCounts;
+                for(size_t start = 0; start < oldSize; start += blockRows)
+                {
+                    size_t len = std::min(blockRows, oldSize - start);
+                    readATTColumn(att, countField, start, len, &blockCounts);
+                    std::copy(blockCounts.begin(), blockCounts.end(), oldCounts.begin() + start);
+                }
+            }
+            size_t newSize = counts.size();
+            for(size_t row = 0; row < oldSize; ++row)
+            {
+                uint64_t newRow = (row < mapping.size())?mapping[row]:row;
+                if(newRow != KEA_RELABEL_DROP)
+                {
+                    newSize = std::max<size_t>(newSize, newRow + 1);
+                }
+            }
+            std::vector<uint64_t> srcRows(newSize, KEA_RELABEL_DROP);
+            for(size_t row = 0; row < oldSize; ++row)
+            {
+                uint64_t newRow = (row < mapping.size())?mapping[row]:row;
+                if((newRow != KEA_RELABEL_DROP) && ((srcRows[newRow] == KEA_RELABEL_DROP) || (!oldCounts.empty() && (oldCounts[row] > oldCounts[srcRows[newRow]]))))
+                {
+                    srcRows[newRow] = row;
+                }
+            }
+            oldCounts.clear();
+            counts.resize(newSize, 0);
+            
+            std::string neighboursName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_ATT_NEIGHBOURS_DATA;
+            bool hasNeighbours = (oldSize > 0) && (H5Lexists(this->getH5File()->getId(), neighboursName.c_str(), H5P_DEFAULT) > 0);
+            
+            if(newSize > oldSize)
+            {
+                att->addRows(newSize - oldSize);
+            }
+            if(hasNeighbours && (newSize > oldSize))
+            {
+                // the neighbours are extended with the table so the old
+                // rows can still be read
+                std::vector<size_t> noNeighbours;
+                std::vector<std::vector<size_t>* > extendNeighbours(1, &noNeighbours);
+                att->setNeighbours(oldSize, 1, &extendNeighbours);
+            }
+            
+            std::vector<std::string> names = att->getFieldNames();
+            for(const std::string &name : names)
+            {
+                if(name == KEA_ATT_PIXELCOUNT_FIELD)
+                {
+                    continue;
+                }
+                KEAATTField field = att->getField(name);
+                if(field.dataType == kea_att_bool)
+                {
+                    std::unique_ptr<bool[]> boolVals(new bool[std::min(blockRows, std::max(oldSize, newSize))]);
+                    permuteATTColumn<uint8_t>(mapping, srcRows, oldSize, [&](size_t start, size_t len, uint8_t *vals)
+                    {
+                        att->getBoolFields(start, len, field.idx, boolVals.get());
+                        std::copy(boolVals.get(), boolVals.get() + len, vals);
+                    },
+                    [&](size_t start, size_t len, uint8_t *vals)
+                    {
+                        std::copy(vals, vals + len, boolVals.get());
+                        att->setBoolFields(start, len, field.idx, boolVals.get());
+                    });
+                }
+                else if(field.dataType == kea_att_int)
+                {
+                    permuteATTColumn<int64_t>(mapping, srcRows, oldSize, [&](size_t start, size_t len, int64_t *vals)
+                    {
+                        att->getIntFields(start, len, field.idx, vals);
+                    },
+                    [&](size_t start, size_t len, int64_t *vals)
+                    {
+                        att->setIntFields(start, len, field.idx, vals);
+                    });
+                }
+                else if(field.dataType == kea_att_float)
+                {
+                    permuteATTColumn<double>(mapping, srcRows, oldSize, [&](size_t start, size_t len, double *vals)
+                    {
+                        att->getFloatFields(start, len, field.idx, vals);
+                    },
+                    [&](size_t start, size_t len, double *vals)
+                    {
+                        att->setFloatFields(start, len, field.idx, vals);
+                    });
+                }
+                else if(field.dataType == kea_att_string)
+                {
+                    std::vector<std::string> strVals;
+                    permuteATTColumn<std::string>(mapping, srcRows, oldSize, [&](size_t start, size_t len, std::string *vals)
+                    {
+                        att->getStringFields(start, len, field.idx, &strVals);
+                        std::move(strVals.begin(), strVals.end(), vals);
+                    },
+                    [&](size_t start, size_t len, std::string *vals)
+                    {
+                        strVals.assign(vals, vals + len);
+                        att->setStringFields(start, len, field.idx, &strVals);
+                    });
+                }
             }
             
-            // GET NATIVE DATASET
-            H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
-
-            // OPEN BAND DATASET AND WRITE IMAGE DATA
-            try 
+            if(hasNeighbours)
             {
-                std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
-                H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( overviewName );
-                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();                
-                
-                hsize_t imgOffset[2];
-                imgOffset[0] = yPxlOff;
-                imgOffset[1] = xPxlOff;
-                hsize_t dataDims[2];
-                dataDims[0] = ySizeBuf;
-                dataDims[1] = xSizeBuf;
-                H5::DataSpace write2BandDataspace = H5::DataSpace(2, dataDims);
-                
-                if((ySizeOut != ySizeBuf) | (xSizeOut != xSizeBuf))
-                {                    
-                    hsize_t dataSelectMemDims[2];
-                    dataSelectMemDims[0] = ySizeOut;
-                    dataSelectMemDims[1] = 1;
-
-                    hsize_t dataOffDims[2];
-                    dataOffDims[0] = 0;
-                    dataOffDims[1] = 0;
-
-                    hsize_t dataSelectStrideDims[2];
-                    dataSelectStrideDims[0] = 1;
-                    if(xSizeBuf == xSizeOut)
+                // the neighbours of the old rows moved to each new row are
+                // combined a block of new rows at a time. Old rows are read
+                // before the block holding them is rewritten, so only those
+                // moving to a later block are held until it is reached.
+                std::vector<size_t> srcOffsets(newSize + 1, 0);
+                for(size_t row = 0; row < oldSize; ++row)
+                {
+                    uint64_t newRow = (row < mapping.size())?mapping[row]:row;
+                    if(newRow != KEA_RELABEL_DROP)
                     {
-                        dataSelectStrideDims[1] = 1;
+                        ++srcOffsets[newRow + 1];
                     }
-                    else
+                }
+                for(size_t i = 0; i < newSize; ++i)
+                {
+                    srcOffsets[i + 1] += srcOffsets[i];
+                }
+                std::vector<size_t> srcList(srcOffsets[newSize]);
+                {
+                    std::vector<size_t> fill(srcOffsets.begin(), srcOffsets.end() - 1);
+                    for(size_t row = 0; row < oldSize; ++row)
                     {
-                        dataSelectStrideDims[1] = xSizeBuf - xSizeOut;
+                        uint64_t newRow = (row < mapping.size())?mapping[row]:row;
+                        if(newRow != KEA_RELABEL_DROP)
+                        {
+                            srcList[fill[newRow]++] = row;
+                        }
                     }
-
-                    hsize_t dataSelectBlockSizeDims[2];
-                    dataSelectBlockSizeDims[0] = 1;
-                    dataSelectBlockSizeDims[1] = xSizeOut;
-                    write2BandDataspace.selectHyperslab(H5S_SELECT_SET, dataSelectMemDims, dataOffDims, dataSelectStrideDims, dataSelectBlockSizeDims);
-                    
-                    hsize_t dataOutDims[2];
-                    dataOutDims[0] = ySizeOut;
-                    dataOutDims[1] = xSizeOut;
-                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataOutDims, imgOffset);
                 }
-                else
+                
+                std::unordered_map<size_t, std::vector<size_t> > heldNeighbours;
+                std::vector< std::vector<size_t> > newNeighbours;
+                std::vector<std::vector<size_t>* > newNeighbourPtrs;
+                std::vector<size_t> readRows;
+                for(size_t start = 0; start < newSize; start += blockRows)
                 {
-                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataDims, imgOffset);
+                    size_t end = std::min(start + blockRows, newSize);
+                    newNeighbours.assign(end - start, std::vector<size_t>());
+                    
+                    // the old rows needed which are still in the table: the
+                    // sources of this block not yet overwritten and those
+                    // of this block moving to a later one.
+                    readRows.clear();
+                    for(size_t i = srcOffsets[start]; i < srcOffsets[end]; ++i)
+                    {
+                        if(srcList[i] >= start)
+                        {
+                            readRows.push_back(srcList[i]);
+                        }
+                    }
+                    for(size_t row = start; row < std::min(end, oldSize); ++row)
+                    {
+                        uint64_t newRow = (row < mapping.size())?mapping[row]:row;
+                        if((newRow != KEA_RELABEL_DROP) && (newRow >= end))
+                        {
+                            readRows.push_back(row);
+                        }
+                    }
+                    std::sort(readRows.begin(), readRows.end());
+                    
+                    for(size_t i = 0; i < readRows.size();)
+                    {
+                        size_t readStart = readRows[i];
+                        size_t j = i;
+                        while((j < readRows.size()) && ((readRows[j] - readStart) < blockRows))
+                        {
+                            ++j;
+                        }
+                        att->getNeighbours(readStart, (readRows[j - 1] - readStart) + 1, &blockNeighbours);
+                        for(; i < j; ++i)
+                        {
+                            size_t row = readRows[i];
+                            uint64_t newRow = (row < mapping.size())?mapping[row]:row;
+                            std::vector<size_t> &dest = (newRow < end) ? newNeighbours[newRow - start] : heldNeighbours[newRow];
+                            for(size_t neighbour : *blockNeighbours[row - readStart])
+                            {
+                                uint64_t newNeighbour = (neighbour < mapping.size())?mapping[neighbour]:neighbour;
+                                if((newNeighbour != KEA_RELABEL_DROP) && (newNeighbour != newRow))
+                                {
+                                    dest.push_back(newNeighbour);
+                                }
+                            }
+                        }
+                    }
+                    
+                    newNeighbourPtrs.resize(end - start);
+                    for(size_t newRow = start; newRow < end; ++newRow)
+                    {
+                        std::vector<size_t> &neighbours = newNeighbours[newRow - start];
+                        auto held = heldNeighbours.find(newRow);
+                        if(held != heldNeighbours.end())
+                        {
+                            neighbours.insert(neighbours.end(), held->second.begin(), held->second.end());
+                            heldNeighbours.erase(held);
+                        }
+                        std::sort(neighbours.begin(), neighbours.end());
+                        neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+                        newNeighbourPtrs[newRow - start] = &neighbours;
+                    }
+                    att->setNeighbours(start, end - start, &newNeighbourPtrs);
                 }
-                
-                imgBandDataset.write( data, imgBandDT, write2BandDataspace, imgBandDataspace);
-                
-                imgBandDataset.close();
-                imgBandDataspace.close();
-                write2BandDataspace.close();
-            } 
-            catch ( const H5::Exception &e) 
+            }
+            
+            if(newSize < oldSize)
             {
-                throw KEAIOException("Could not write image data.");
+                att->removeRows(oldSize - newSize);
             }
+            writeATTColumn(att, KEA_ATT_PIXELCOUNT_FIELD, KEA_ATT_PIXELCOUNT_USAGE, counts);
             
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
+            for(std::vector<size_t> *neighbours : blockNeighbours)
+            {
+                delete neighbours;
+            }
+            blockNeighbours.clear();
+            KEAAttributeTable::destroyAttributeTable(att);
+            att = nullptr;
+            this->getH5File()->flush(H5F_SCOPE_GLOBAL);
         }
         catch(const KEAIOException &e)
         {
+            for(std::vector<size_t> *neighbours : blockNeighbours)
+            {
+                delete neighbours;
+            }
+            KEAAttributeTable::destroyAttributeTable(att);
             throw e;
         }
-        catch( const H5::FileIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSetIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSpaceIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataTypeIException &e )
+        catch(const KEAException &e)
+        {
+            for(std::vector<size_t> *neighbours : blockNeighbours)
+            {
+                delete neighbours;
+            }
+            KEAAttributeTable::destroyAttributeTable(att);
+            throw KEAIOException(e.what());
+        }
+        catch( const H5::Exception &e )
 		{
+            for(std::vector<size_t> *neighbours : blockNeighbours)
+            {
+                delete neighbours;
+            }
+            KEAAttributeTable::destroyAttributeTable(att);
 			throw KEAIOException(e.getCDetailMsg());
 		}
         catch ( const std::exception &e)
         {
+            for(std::vector<size_t> *neighbours : blockNeighbours)
+            {
+                delete neighbours;
+            }
+            KEAAttributeTable::destroyAttributeTable(att);
             throw KEAIOException(e.what());
         }
     }
     
-    void KEAImageIO::readFromOverview(uint32_t band, uint32_t overview, void *data, uint64_t xPxlOff, uint64_t yPxlOff, uint64_t xSizeIn, uint64_t ySizeIn, uint64_t xSizeBuf, uint64_t ySizeBuf, KEADataType inDataType)
+    std::vector<uint64_t> KEAImageIO::compactLabels(uint32_t band, unsigned int numThreads)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
+        std::vector<uint64_t> mapping;
         try 
         {
-            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
-            if(band == 0)
+            bool noDataDefined = false;
+            uint64_t noDataVal = 0;
+            try
             {
-                throw KEAIOException("KEA Image Bands start at 1.");
+                this->getNoDataValue(band, &noDataVal, kea_64uint);
+                noDataDefined = true;
             }
-            else if(band > this->numImgBands)
+            catch(const KEAIOException &e)
             {
-                throw KEAIOException("Band is not present within image."); 
+                noDataDefined = false;
             }
             
-            // GET NATIVE DATASET
-            H5::DataType imgBandDT = convertDatatypeKeaToH5Native(inDataType);
-            
-            // OPEN BAND DATASET AND READ IMAGE DATA
-            try 
+            // each thread flags the values it finds, merged at the end.
+            numThreads = getNumThreads(numThreads);
+            std::vector< std::vector<bool> > threadUsed(numThreads);
+            uint64_t xSize = this->spatialInfoFile->xSize;
+            this->processBandStrips(band, kea_64uint, numThreads, [&](const void *data, uint64_t, uint64_t rowStart, uint64_t rowEnd, unsigned int thread)
             {
-                std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
-                H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( overviewName );
-                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();                
-                
-                hsize_t dataOffset[2];
-                dataOffset[0] = yPxlOff;
-                dataOffset[1] = xPxlOff;
-                hsize_t dataDims[2];
-                dataDims[0] = ySizeBuf;
-                dataDims[1] = xSizeBuf;
-                H5::DataSpace read2BandDataspace = H5::DataSpace(2, dataDims);
-                
-                if((ySizeBuf != ySizeIn) | (xSizeBuf != xSizeIn))
+                std::vector<bool> &used = threadUsed[thread];
+                const uint64_t *labels = (const uint64_t*)data;
+                for(uint64_t i = rowStart * xSize; i < rowEnd * xSize; ++i)
                 {
-                    hsize_t dataSelectMemDims[2];
-                    dataSelectMemDims[0] = ySizeIn;
-                    dataSelectMemDims[1] = 1;
-
-                    hsize_t dataOffDims[2];
-                    dataOffDims[0] = 0;
-                    dataOffDims[1] = 0;
-
-                    hsize_t dataSelectStrideDims[2];
-                    dataSelectStrideDims[0] = 1;
-                    if(xSizeBuf == xSizeIn)
+                    uint64_t label = labels[i];
+                    if(noDataDefined && (label == noDataVal))
                     {
-                        dataSelectStrideDims[1] = 1;
+                        continue;
                     }
-                    else
+                    if(label >= used.size())
                     {
-                        dataSelectStrideDims[1] = xSizeBuf - xSizeIn;
+                        used.resize(label + 1, false);
                     }
-
-                    hsize_t dataSelectBlockSizeDims[2];
-                    dataSelectBlockSizeDims[0] = 1;
-                    dataSelectBlockSizeDims[1] = xSizeIn;
-                    read2BandDataspace.selectHyperslab(H5S_SELECT_SET, dataSelectMemDims, dataOffDims, dataSelectStrideDims, dataSelectBlockSizeDims);
-                    
-                    hsize_t dataInDims[2];
-                    dataInDims[0] = ySizeIn;
-                    dataInDims[1] = xSizeIn;
-                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataInDims, dataOffset);
+                    used[label] = true;
                 }
-                else
+            });
+            
+            // the mapping also covers the rows without any pixels, which
+            // are dropped.
+            KEAAttributeTable *att = this->getAttributeTable(kea_att_file, band);
+            std::vector<bool> allUsed(att->getSize(), false);
+            KEAAttributeTable::destroyAttributeTable(att);
+            for(const std::vector<bool> &used : threadUsed)
+            {
+                if(used.size() > allUsed.size())
                 {
-                    imgBandDataspace.selectHyperslab( H5S_SELECT_SET, dataDims, dataOffset);
+                    allUsed.resize(used.size(), false);
                 }
-                imgBandDataset.read( data, imgBandDT, read2BandDataspace, imgBandDataspace);
-                
-                imgBandDataset.close();
-                imgBandDataspace.close();
-                read2BandDataspace.close();
-            } 
-            catch ( const H5::Exception &e) 
-            {
-                throw KEAIOException("Could not read from image overview.");
-            }            
+                for(size_t i = 0; i < used.size(); ++i)
+                {
+                    if(used[i])
+                    {
+                        allUsed[i] = true;
+                    }
+                }
+            }
+            threadUsed.clear();
+            buildCompactMapping(allUsed, noDataDefined, noDataVal, &mapping);
+            
+            this->relabel(band, mapping, numThreads);
         }
         catch(const KEAIOException &e)
         {
             throw e;
         }
-        catch( const H5::FileIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSetIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataSpaceIException &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-		catch( const H5::DataTypeIException &e )
+        catch(const KEAException &e)
+        {
+            throw KEAIOException(e.what());
+        }
+        catch( const H5::Exception &e )
 		{
 			throw KEAIOException(e.getCDetailMsg());
 		}
@@ -2644,236 +5973,503 @@ namespace kealib{
         {
             throw KEAIOException(e.what());
         }
+        return mapping;
     }
     
-    uint32_t KEAImageIO::getNumOfOverviews(uint32_t band)
+    std::vector<uint64_t> KEAImageIO::eliminateSmallSegments(uint32_t band, uint64_t minSize, const std::vector<size_t> &featureCols, unsigned int numThreads)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        std::string overviewGroupName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_OVERVIEWS;
-        uint32_t numOverviews = 0;
-        try 
-        {
-            // Try to open dataset with overviewName
-            H5::Group imgOverviewsGrp = this->keaImgFile->openGroup(overviewGroupName);
-            numOverviews = imgOverviewsGrp.getNumObjs();
-        }
-        catch (const H5::Exception &e)
-        {
-            throw KEAIOException("Could not retrieve the number of image band overviews.");
-        }
-        catch ( const KEAIOException &e)
-        {
-            throw e;
-        }
-        catch ( const std::exception &e)
-        {
-            throw KEAIOException(e.what());
-        }
-        
-        return numOverviews;
-    }
-    
-    void KEAImageIO::getOverviewSize(uint32_t band, uint32_t overview, uint64_t *xSize, uint64_t *ySize)
-    {
-        if(!this->fileOpen)
+        std::vector<uint64_t> mapping;
+        KEAAttributeTable *att = nullptr;
+        std::vector<std::vector<size_t>* > blockNeighbours;
+        auto releaseNeighbours = [&blockNeighbours]()
         {
-            throw KEAIOException("Image was not open.");
-        }
-        
+            for(std::vector<size_t> *neighbours : blockNeighbours)
+            {
+                delete neighbours;
+            }
+            blockNeighbours.clear();
+        };
         try 
         {
-            // CHECK PARAMETERS PROVIDED FIT WITHIN IMAGE
-            if(band == 0)
+            bool noDataDefined = false;
+            uint64_t noDataVal = 0;
+            try
+            {
+                this->getNoDataValue(band, &noDataVal, kea_64uint);
+                noDataDefined = true;
+            }
+            catch(const KEAIOException &e)
+            {
+                noDataDefined = false;
+            }
+            
+            att = this->getAttributeTable(kea_att_file, band);
+            size_t numRows = att->getSize();
+            if(!att->hasField(KEA_ATT_PIXELCOUNT_FIELD))
+            {
+                throw KEAIOException("The attribute table does not have a Histogram column (see calcSegmentExtents).");
+            }
+            std::string neighboursName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_ATT_NEIGHBOURS_DATA;
+            if((numRows > 0) && (H5Lexists(this->getH5File()->getId(), neighboursName.c_str(), H5P_DEFAULT) <= 0))
+            {
+                throw KEAIOException("The attribute table does not have the neighbours of the segments.");
+            }
+            KEAATTField countField = att->getField(KEA_ATT_PIXELCOUNT_FIELD);
+            size_t numFeatures = featureCols.size();
+            std::vector<KEAATTField> featureFields;
+            for(size_t colIdx : featureCols)
+            {
+                featureFields.push_back(att->getField(colIdx));
+            }
+            
+            // the features are held row-major so those of a segment are
+            // together.
+            std::vector<double> counts(numRows);
+            std::vector<double> features(numRows * numFeatures);
+            std::vector< std::vector<size_t> > neighbours(numRows);
+            std::vector<double> vals;
+            size_t blockRows = KEA_ATT_CHUNK_SIZE * KEA_ATT_PIPELINE_BLOCK_CHUNKS;
+            for(size_t start = 0; start < numRows; start += blockRows)
+            {
+                size_t len = std::min(blockRows, numRows - start);
+                readATTColumn(att, countField, start, len, &vals);
+                std::copy(vals.begin(), vals.end(), counts.begin() + start);
+                for(size_t f = 0; f < numFeatures; ++f)
+                {
+                    readATTColumn(att, featureFields[f], start, len, &vals);
+                    for(size_t i = 0; i < len; ++i)
+                    {
+                        features[((start + i) * numFeatures) + f] = vals[i];
+                    }
+                }
+                att->getNeighbours(start, len, &blockNeighbours);
+                for(size_t i = 0; i < len; ++i)
+                {
+                    neighbours[start + i].swap(*blockNeighbours[i]);
+                }
+            }
+            releaseNeighbours();
+            
+            // merged segments are tracked as sets, the root of each holding
+            // the values of the whole set.
+            std::vector<uint64_t> parent(numRows);
+            for(size_t fid = 0; fid < numRows; ++fid)
             {
-                throw KEAIOException("KEA Image Bands start at 1.");
+                parent[fid] = fid;
             }
-            else if(band > this->numImgBands)
+            auto findRoot = [&parent](uint64_t fid) -> uint64_t
             {
-                throw KEAIOException("Band is not present within image."); 
+                while(parent[fid] != fid)
+                {
+                    parent[fid] = parent[parent[fid]];
+                    fid = parent[fid];
+                }
+                return fid;
+            };
+            auto isSegment = [&](uint64_t fid) -> bool
+            {
+                return (counts[fid] > 0) && !(noDataDefined && (fid == noDataVal));
+            };
+            
+            typedef std::pair<double, uint64_t> QueueEntry;
+            std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry> > smallSegs;
+            for(size_t fid = 0; fid < numRows; ++fid)
+            {
+                if(isSegment(fid) && (counts[fid] < minSize))
+                {
+                    smallSegs.push(QueueEntry(counts[fid], fid));
+                }
             }
-                        
-            // OPEN BAND DATASET AND READ THE IMAGE DIMENSIONS
-            try 
+            
+            while(!smallSegs.empty())
             {
-                std::string overviewName = KEA_DATASETNAME_BAND + uint2Str(band) + KEA_OVERVIEWSNAME_OVERVIEW + uint2Str(overview);
-                H5::DataSet imgBandDataset = this->keaImgFile->openDataSet( overviewName );
-                H5::DataSpace imgBandDataspace = imgBandDataset.getSpace();                
+                QueueEntry entry = smallSegs.top();
+                smallSegs.pop();
+                uint64_t fid = entry.second;
+                // the entries of segments which have since grown or been
+                // merged are out of date.
+                if((parent[fid] != fid) || (counts[fid] != entry.first))
+                {
+                    continue;
+                }
                 
-                uint32_t nDims = imgBandDataspace.getSimpleExtentNdims();
-                if(nDims != 2)
+                std::vector<size_t> &fidNeighbours = neighbours[fid];
+                fidNeighbours.erase(std::remove_if(fidNeighbours.begin(), fidNeighbours.end(), [numRows](size_t n){ return n >= numRows; }), fidNeighbours.end());
+                for(size_t &n : fidNeighbours)
                 {
-                    throw KEAIOException("The number of dimensions for the overview must be 2.");
+                    n = findRoot(n);
                 }
-                hsize_t dims[2];
-                imgBandDataspace.getSimpleExtentDims(dims);
+                std::sort(fidNeighbours.begin(), fidNeighbours.end());
+                fidNeighbours.erase(std::unique(fidNeighbours.begin(), fidNeighbours.end()), fidNeighbours.end());
                 
-                *xSize = dims[1];
-                *ySize = dims[0];
-
-                imgBandDataset.close();
-            } 
-            catch(const KEAIOException &e)
+                // the closest neighbour, or the largest of those equally close.
+                uint64_t bestFid = KEA_RELABEL_DROP;
+                double bestDist = 0;
+                const double *fidFeatures = features.data() + (fid * numFeatures);
+                for(size_t n : fidNeighbours)
+                {
+                    if((n == fid) || !isSegment(n))
+                    {
+                        continue;
+                    }
+                    const double *nFeatures = features.data() + (n * numFeatures);
+                    double dist = 0;
+                    for(size_t f = 0; f < numFeatures; ++f)
+                    {
+                        dist += (fidFeatures[f] - nFeatures[f]) * (fidFeatures[f] - nFeatures[f]);
+                    }
+                    if((bestFid == KEA_RELABEL_DROP) || (dist < bestDist) || ((dist == bestDist) && (counts[n] > counts[bestFid])))
+                    {
+                        bestFid = n;
+                        bestDist = dist;
+                    }
+                }
+                if(bestFid == KEA_RELABEL_DROP)
+                {
+                    // isolated so cannot be merged.
+                    continue;
+                }
+                
+                double *bestFeatures = features.data() + (bestFid * numFeatures);
+                double total = counts[fid] + counts[bestFid];
+                for(size_t f = 0; f < numFeatures; ++f)
+                {
+                    bestFeatures[f] = ((bestFeatures[f] * counts[bestFid]) + (fidFeatures[f] * counts[fid])) / total;
+                }
+                counts[bestFid] = total;
+                counts[fid] = 0;
+                parent[fid] = bestFid;
+                neighbours[bestFid].insert(neighbours[bestFid].end(), fidNeighbours.begin(), fidNeighbours.end());
+                std::vector<size_t>().swap(fidNeighbours);
+                if(total < minSize)
+                {
+                    smallSegs.push(QueueEntry(total, bestFid));
+                }
+            }
+            neighbours.clear();
+            
+            // the merged statistics are written to the roots so relabel
+            // keeps their rows (having the most pixels).
+            std::vector<int64_t> intCounts(counts.begin(), counts.end());
+            writeATTColumn(att, KEA_ATT_PIXELCOUNT_FIELD, KEA_ATT_PIXELCOUNT_USAGE, intCounts);
+            intCounts.clear();
+            for(size_t f = 0; f < numFeatures; ++f)
             {
-                throw e;
+                const KEAATTField &field = featureFields[f];
+                for(size_t start = 0; start < numRows; start += blockRows)
+                {
+                    size_t len = std::min(blockRows, numRows - start);
+                    if(field.dataType == kea_att_float)
+                    {
+                        std::vector<double> floatVals(len);
+                        for(size_t i = 0; i < len; ++i)
+                        {
+                            floatVals[i] = features[((start + i) * numFeatures) + f];
+                        }
+                        att->setFloatFields(start, len, field.idx, floatVals.data());
+                    }
+                    else if(field.dataType == kea_att_int)
+                    {
+                        std::vector<int64_t> intVals(len);
+                        for(size_t i = 0; i < len; ++i)
+                        {
+                            intVals[i] = (int64_t)std::llround(features[((start + i) * numFeatures) + f]);
+                        }
+                        att->setIntFields(start, len, field.idx, intVals.data());
+                    }
+                    else
+                    {
+                        std::unique_ptr<bool[]> boolVals(new bool[len]);
+                        for(size_t i = 0; i < len; ++i)
+                        {
+                            boolVals[i] = features[((start + i) * numFeatures) + f] >= 0.5;
+                        }
+                        att->setBoolFields(start, len, field.idx, boolVals.get());
+                    }
+                }
             }
-            catch ( const H5::Exception &e) 
+            KEAAttributeTable::destroyAttributeTable(att);
+            att = nullptr;
+            
+            std::vector<bool> used(numRows, false);
+            for(size_t fid = 0; fid < numRows; ++fid)
             {
-                throw KEAIOException("Could not read from image overview.");
-            }            
+                used[fid] = (counts[fid] > 0);
+            }
+            std::vector<uint64_t> rootMapping;
+            buildCompactMapping(used, noDataDefined, noDataVal, &rootMapping);
+            mapping.resize(numRows);
+            for(size_t fid = 0; fid < numRows; ++fid)
+            {
+                mapping[fid] = rootMapping[findRoot(fid)];
+            }
+            
+            this->relabel(band, mapping, numThreads);
         }
-        catch( const H5::Exception &e )
-		{
-			throw KEAIOException("Could not get the overview size.");
-		}
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
+            releaseNeighbours();
+            KEAAttributeTable::destroyAttributeTable(att);
             throw e;
         }
+        catch(const KEAException &e)
+        {
+            releaseNeighbours();
+            KEAAttributeTable::destroyAttributeTable(att);
+            throw KEAIOException(e.what());
+        }
+        catch( const H5::Exception &e )
+		{
+            releaseNeighbours();
+            KEAAttributeTable::destroyAttributeTable(att);
+			throw KEAIOException(e.getCDetailMsg());
+		}
         catch ( const std::exception &e)
         {
+            releaseNeighbours();
+            KEAAttributeTable::destroyAttributeTable(att);
             throw KEAIOException(e.what());
         }
+        return mapping;
     }
     
-    KEAAttributeTable* KEAImageIO::getAttributeTable(KEAATTType type, uint32_t band)
+    void KEAImageIO::processBandStrips(uint32_t band, KEADataType dataType, unsigned int numThreads, const KEAStripFunc &func)
     {
-        KEAAttributeTable *att = nullptr;
-        try 
+        uint64_t xSize = this->spatialInfoFile->xSize;
+        uint64_t ySize = this->spatialInfoFile->ySize;
+        uint64_t stripRows = 0;
         {
-            if(type == kea_att_mem)
+            std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+            stripRows = this->getImageBlockSize(band);
+        }
+        if(stripRows == 0)
+        {
+            stripRows = KEA_IMAGE_CHUNK_SIZE;
+        }
+        size_t pxlSize = 0;
+        dispatchDataType(dataType, [&pxlSize](auto *type) { pxlSize = sizeof(*type); });
+        numThreads = getNumThreads(numThreads);
+        
+        // The future is declared after the strips so that it is always
+        // waited upon before the memory it is using is released.
+        std::vector<unsigned char> strips[2];
+        std::future<void> processed;
+        uint64_t stripIdx = 0;
+        for(uint64_t yOff = 0; yOff < ySize; yOff += stripRows, ++stripIdx)
+        {
+            uint64_t nRows = std::min(stripRows, ySize - yOff);
+            std::vector<unsigned char> &strip = strips[stripIdx % 2];
+            strip.resize(xSize * nRows * pxlSize);
             {
-                att = kealib::KEAAttributeTableInMem::createKeaAtt(this->keaImgFile, band);
+                // only held while reading, so other threads can use HDF5
+                // while the strip is processed
+                std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+                this->readImageBlock2Band(band, strip.data(), 0, yOff, xSize, nRows, xSize, nRows, dataType);
             }
-            else if(type == kea_att_file)
+            
+            if(processed.valid())
             {
-                att = kealib::KEAAttributeTableFile::createKeaAtt(this->keaImgFile, band);
+                processed.get();
             }
-            else
+            const void *data = strip.data();
+            processed = std::async(std::launch::async, [&func, data, yOff, nRows, numThreads]()
             {
-                throw KEAATTException("The attribute table type was not recognised.");
-            }
-        }
-        catch(const KEAATTException &e)
-        {
-            throw e;
-        }
-        catch ( const KEAIOException &e)
-        {
-            throw e;
+                runOnThreads(nRows, numThreads, [&func, data, yOff](uint64_t start, uint64_t end, unsigned int thread)
+                {
+                    func(data, yOff, start, end, thread);
+                });
+            });
         }
-        catch ( const std::exception &e)
+        if(processed.valid())
         {
-            throw KEAIOException(e.what());
+            processed.get();
         }
-        
-        return att;
     }
     
-    void KEAImageIO::setAttributeTable(KEAAttributeTable* att, uint32_t band, uint32_t chunkSize, uint32_t deflate)
+    unsigned int KEAImageIO::getNumThreads(unsigned int numThreads)
     {
-        if(!this->fileOpen)
+        if(numThreads == 0)
         {
-            throw KEAIOException("Image was not open.");
+            numThreads = std::max(std::thread::hardware_concurrency(), 1u);
         }
-        
+        return numThreads;
+    }
+    
+    void KEAImageIO::close()
+    {
         try 
         {
-            att->exportToKeaFile(this->keaImgFile, band, chunkSize, deflate);
-            this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
-        }
-        catch(const KEAATTException &e)
-        {
-            throw e;
+            // the prefetch thread uses the file
+            this->stopPrefetch();
+            delete this->spatialInfoFile;
+            this->bandExpressions.clear();
+            std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+            this->removeFromPool();
+            // it may have been closed by the file limits
+            if(this->keaImgFile != nullptr)
+            {
+                this->keaImgFile->close();
+                this->keaImgFile = nullptr;
+            }
+            this->fileOpen = false;
         }
-        catch ( const KEAIOException &e)
+        catch(const KEAIOException &e)
         {
             throw e;
         }
+        catch( const H5::Exception &e )
+		{
+			throw KEAIOException(e.getCDetailMsg());
+		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
     }
-    
-    bool KEAImageIO::attributeTablePresent(uint32_t band)
+        
+    void KEAImageIO::setReopenable(const std::function<H5::H5File*()> &reopenFile)
     {
         if(!this->fileOpen)
         {
             throw KEAIOException("Image was not open.");
         }
         
-        bool attPresent = false;
-        try 
+        try
         {
-            std::string bandPathBase = KEA_DATASETNAME_BAND + uint2Str(band);
-            hsize_t attSize[5];
-            try 
-            {   
-                hsize_t dimsValue[1];
-                dimsValue[0] = 5;
-                H5::DataSpace valueDataSpace(1, dimsValue);
-                H5::DataSet datasetAttSize = this->keaImgFile->openDataSet( bandPathBase + KEA_ATT_SIZE_HEADER );
-                datasetAttSize.read(attSize, H5::PredType::STD_U64LE, valueDataSpace);
-                datasetAttSize.close();
-                valueDataSpace.close();
-            } 
-            catch (const H5::Exception &e) 
+            std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+            unsigned int intent = 0;
+            if((H5Fget_intent(this->getH5File()->getId(), &intent) < 0) || (intent & H5F_ACC_RDWR))
             {
-                throw KEAIOException("The attribute table size field is not present.");
+                throw KEAIOException("Only images opened read-only can be reopened.");
             }
             
-            if(attSize[0] > 0)
+            int mdcElmts = 0;
+            size_t rdccNElmts = 0;
+            size_t rdccNBytes = 0;
+            double rdccW0 = 0;
+            this->getH5File()->getAccessPlist().getCache(mdcElmts, rdccNElmts, rdccNBytes, rdccW0);
+            
+            KEAFilePool &pool = getFilePool();
+            std::lock_guard<std::mutex> poolLock(pool.mutex);
+            this->reopenFile = reopenFile;
+            this->fileCacheBytes = rdccNBytes;
+            if(!this->filePooled)
             {
-                attPresent = true;
+                this->filePoolPos = pool.files.insert(pool.files.end(), this);
+                this->filePooled = true;
+                pool.cacheBytes += this->fileCacheBytes;
+            }
+            while(pool.overLimits() && (pool.files.front() != this))
+            {
+                pool.files.front()->releaseFile();
             }
         }
         catch(const KEAIOException &e)
         {
             throw e;
         }
-        catch(const KEAATTException &e)
+        catch( const H5::Exception &e )
         {
-            throw e;
+            throw KEAIOException(e.getCDetailMsg());
         }
-        catch( const H5::Exception &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
         catch ( const std::exception &e)
         {
             throw KEAIOException(e.what());
         }
-        return attPresent;
     }
     
-    void KEAImageIO::close()
+    void KEAImageIO::setFileLimits(size_t maxOpenFiles, size_t maxChunkCacheBytes)
     {
-        try 
+        std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+        KEAFilePool &pool = getFilePool();
+        std::lock_guard<std::mutex> poolLock(pool.mutex);
+        pool.maxOpenFiles = maxOpenFiles;
+        pool.maxCacheBytes = maxChunkCacheBytes;
+        while(pool.overLimits())
         {
-            delete this->spatialInfoFile;
-            this->keaImgFile->close();
-            delete this->keaImgFile;
-            this->keaImgFile = nullptr;
-            this->fileOpen = false;
+            pool.files.front()->releaseFile();
         }
-        catch(const KEAIOException &e)
+    }
+    
+    std::shared_ptr<H5::H5File> KEAImageIO::getH5File()
+    {
+        // once open, reopenFile and keaImgFile are only changed with the
+        // lock held
+        std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+        if(!this->reopenFile)
         {
-            throw e;
+            return this->keaImgFile;
         }
-        catch( const H5::Exception &e )
-		{
-			throw KEAIOException(e.getCDetailMsg());
-		}
-        catch ( const std::exception &e)
+        
+        if(this->keaImgFile == nullptr)
         {
-            throw KEAIOException(e.what());
+            H5::H5File *keaImgH5File = this->reopenFile();
+            if(keaImgH5File == nullptr)
+            {
+                throw KEAIOException("The file could not be reopened.");
+            }
+            this->keaImgFile = shareH5File(keaImgH5File);
+            this->getIOCounters(0).fileOpens++;
+        }
+        
+        KEAFilePool &pool = getFilePool();
+        std::lock_guard<std::mutex> poolLock(pool.mutex);
+        if(this->filePooled)
+        {
+            // now the most recently used
+            pool.files.splice(pool.files.end(), pool.files, this->filePoolPos);
+        }
+        else
+        {
+            this->filePoolPos = pool.files.insert(pool.files.end(), this);
+            this->filePooled = true;
+            pool.cacheBytes += this->fileCacheBytes;
+            while(pool.overLimits() && (pool.files.front() != this))
+            {
+                pool.files.front()->releaseFile();
+            }
         }
+        return this->keaImgFile;
     }
+    
+    void KEAImageIO::releaseFile()
+    {
+        // called with the pool's lock held too
+        KEAFilePool &pool = getFilePool();
+        pool.files.erase(this->filePoolPos);
+        this->filePooled = false;
+        pool.cacheBytes -= this->fileCacheBytes;
         
+        // closed now unless a call is still using it
+        this->keaImgFile = nullptr;
+        
+        // the prefetch thread stops at its next chunk row
+        KEAPrefetchCache &cache = *this->prefetchCache;
+        std::lock_guard<std::mutex> cacheLock(cache.mutex);
+        cache.pending.clear();
+        cache.chunks.clear();
+        cache.index.clear();
+        cache.bytes = 0;
+    }
+    
+    void KEAImageIO::removeFromPool()
+    {
+        KEAFilePool &pool = getFilePool();
+        std::lock_guard<std::mutex> poolLock(pool.mutex);
+        if(this->filePooled)
+        {
+            pool.files.erase(this->filePoolPos);
+            this->filePooled = false;
+            pool.cacheBytes -= this->fileCacheBytes;
+        }
+        this->reopenFile = nullptr;
+    }
+    
     H5::H5File* KEAImageIO::createKEAImage(const std::string &fileName, KEADataType dataType, uint32_t xSize, uint32_t ySize, uint32_t numImgBands, std::vector<std::string> *bandDescrips, KEAImageSpatialInfo * spatialInfo, uint32_t imageBlockSize, uint32_t attBlockSize, int mdcElmts, hsize_t rdccNElmts, hsize_t rdccNBytes, double rdccW0, hsize_t sieveBuf, hsize_t metaBlockSize, uint32_t deflate)
     {
         H5::Exception::dontPrint();
@@ -3212,7 +6808,9 @@ namespace kealib{
 
     KEAImageIO::~KEAImageIO()
     {
-        
+        this->stopPrefetch();
+        std::lock_guard<std::recursive_mutex> lock(getHDF5Mutex());
+        this->removeFromPool();
     }
 
     void KEAImageIO::addImageBand(const KEADataType dataType, const std::string &bandDescrip, const uint32_t imageBlockSize, const uint32_t attBlockSize, const uint32_t deflate)
@@ -3226,13 +6824,43 @@ namespace kealib{
         const uint32_t ySize = this->spatialInfoFile->ySize;
 
         // add a new image band to the file
-        KEAImageIO::addImageBandToFile(this->keaImgFile, dataType, xSize, ySize, this->numImgBands + 1, bandDescrip, imageBlockSize, attBlockSize, deflate);
+        KEAImageIO::addImageBandToFile(this->getH5File().get(), dataType, xSize, ySize, this->numImgBands + 1, bandDescrip, imageBlockSize, attBlockSize, deflate);
         ++this->numImgBands;
+        this->bandExpressions.resize(this->numImgBands);
 
         // update the band counter in the file metadata
-        KEAImageIO::setNumImgBandsInFileMetadata(this->keaImgFile, this->numImgBands);
+        KEAImageIO::setNumImgBandsInFileMetadata(this->getH5File().get(), this->numImgBands);
+
+        this->getH5File()->flush(H5F_SCOPE_GLOBAL);
+    }
+    
+    void KEAImageIO::addVirtualImageBand(const KEADataType dataType, const std::string &bandDescrip, const std::string &expression, const uint32_t imageBlockSize, const uint32_t attBlockSize)
+    {
+        if(!this->fileOpen)
+        {
+            throw KEAIOException("Image was not open.");
+        }
+        
+        // only the bands already there may be used, so they can't refer
+        // to each other in a loop
+        std::shared_ptr<KEABandExpression> bandExpression = std::make_shared<KEABandExpression>(expression);
+        if(!bandExpression->getBands().empty() && (bandExpression->getBands().back() > this->numImgBands))
+        {
+            throw KEAIOException("Band " + uint2Str(bandExpression->getBands().back()) + " used by the expression is not present within image.");
+        }
+        dispatchDataType(dataType, [](void*) {});
 
-        this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
+        const uint32_t xSize = this->spatialInfoFile->xSize;
+        const uint32_t ySize = this->spatialInfoFile->ySize;
+        
+        KEAImageIO::addImageBandToFile(this->getH5File().get(), dataType, xSize, ySize, this->numImgBands + 1, bandDescrip, imageBlockSize, attBlockSize, KEA_DEFLATE, expression);
+        ++this->numImgBands;
+        this->bandExpressions.resize(this->numImgBands);
+        this->bandExpressions[this->numImgBands - 1] = bandExpression;
+        
+        KEAImageIO::setNumImgBandsInFileMetadata(this->getH5File().get(), this->numImgBands);
+        
+        this->getH5File()->flush(H5F_SCOPE_GLOBAL);
     }
     
     void KEAImageIO::removeImageBand(const uint32_t bandIndex)
@@ -3243,14 +6871,54 @@ namespace kealib{
             throw KEAIOException("Image was not open.");
         }
         
-        KEAImageIO::removeImageBandFromFile(this->keaImgFile, bandIndex, this->numImgBands);
+        // virtual bands refer to the others by number
+        for(uint32_t band = 1; band <= this->bandExpressions.size(); ++band)
+        {
+            if((band != bandIndex) && this->bandExpressions[band - 1] && this->bandExpressions[band - 1]->usesBand(bandIndex))
+            {
+                throw KEAIOException("Band " + uint2Str(bandIndex) + " is used by virtual band " + uint2Str(band) + ".");
+            }
+        }
+        
+        KEAImageIO::removeImageBandFromFile(this->getH5File().get(), bandIndex, this->numImgBands);
     
         --this->numImgBands;
 
         // update the band counter in the file metadata
-        KEAImageIO::setNumImgBandsInFileMetadata(this->keaImgFile, this->numImgBands);
+        KEAImageIO::setNumImgBandsInFileMetadata(this->getH5File().get(), this->numImgBands);
+        
+        // and those after the band removed are now one less
+        if(bandIndex <= this->bandExpressions.size())
+        {
+            this->bandExpressions.erase(this->bandExpressions.begin() + (bandIndex - 1));
+        }
+        for(uint32_t band = 1; band <= this->bandExpressions.size(); ++band)
+        {
+            std::shared_ptr<KEABandExpression> &bandExpression = this->bandExpressions[band - 1];
+            if(!bandExpression || bandExpression->getBands().empty() || (bandExpression->getBands().back() < bandIndex))
+            {
+                continue;
+            }
+            std::shared_ptr<KEABandExpression> renumbered = std::make_shared<KEABandExpression>(bandExpression->toString());
+            renumbered->renumberBands([bandIndex](uint32_t inBand) { return (inBand > bandIndex) ? (inBand - 1) : inBand; });
+            try 
+            {
+                std::string expressionStr = renumbered->toString();
+                H5::StrType strTypeAll(0, H5T_VARIABLE);
+                H5::DataSet datasetExpression = this->getH5File()->openDataSet( KEA_DATASETNAME_BAND + uint2Str(band) + KEA_BANDNAME_EXPRESSION );
+                const char *wStrdata[1];
+                wStrdata[0] = expressionStr.c_str();
+                datasetExpression.write((void*)wStrdata, strTypeAll);
+                datasetExpression.close();
+            }
+            catch (const H5::Exception &e) 
+            {
+                throw KEAIOException("Could not update the expression of virtual band " + uint2Str(band) + ".");
+            }
+            bandExpression = renumbered;
+        }
 
-        this->keaImgFile->flush(H5F_SCOPE_GLOBAL);
+        this->getH5File()->flush(H5F_SCOPE_GLOBAL);
     }
 
     H5::DataType KEAImageIO::convertDatatypeKeaToH5STD(const KEADataType dataType)
@@ -3315,7 +6983,7 @@ namespace kealib{
         return h5Datatype;
     }
 
-    void KEAImageIO::addImageBandToFile(H5::H5File *keaImgH5File, const KEADataType dataType, const uint32_t xSize,   const uint32_t ySize, const uint32_t bandIndex, const std::string &bandDescripIn, const uint32_t imageBlockSize, const uint32_t attBlockSize,  const uint32_t deflate)
+    void KEAImageIO::addImageBandToFile(H5::H5File *keaImgH5File, const KEADataType dataType, const uint32_t xSize,   const uint32_t ySize, const uint32_t bandIndex, const std::string &bandDescripIn, const uint32_t imageBlockSize, const uint32_t attBlockSize,  const uint32_t deflate, const std::string &expression)
     {
         int initFillVal = 0;
         std::string bandDescrip = bandDescripIn; // may be updated below
@@ -3346,24 +7014,44 @@ namespace kealib{
             std::string bandName = KEA_DATASETNAME_BAND + uint2Str(bandIndex);
             keaImgH5File->createGroup( bandName );
 
-            // CREATE THE IMAGE DATA ARRAY
-            H5::DataType imgBandDT = convertDatatypeKeaToH5STD(dataType);
-            hsize_t imageBandDims[] = { ySize, xSize };
-            H5::DataSpace imgBandDataSpace(2, imageBandDims);
-            H5::DataSet imgBandDataSet = keaImgH5File->createDataSet((bandName+KEA_BANDNAME_DATA), imgBandDT, imgBandDataSpace, initParamsImgBand);
-            H5::Attribute classAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_CLASS, strdatatypeLen6, attr_dataspace);
-            classAttribute.write(strdatatypeLen6, strClassVal); 
-            classAttribute.close();
+            if(expression.empty())
+            {
+                // CREATE THE IMAGE DATA ARRAY
+                H5::DataType imgBandDT = convertDatatypeKeaToH5STD(dataType);
+                hsize_t imageBandDims[] = { ySize, xSize };
+                H5::DataSpace imgBandDataSpace(2, imageBandDims);
+                H5::DataSet imgBandDataSet = keaImgH5File->createDataSet((bandName+KEA_BANDNAME_DATA), imgBandDT, imgBandDataSpace, initParamsImgBand);
+                H5::Attribute classAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_CLASS, strdatatypeLen6, attr_dataspace);
+                classAttribute.write(strdatatypeLen6, strClassVal); 
+                classAttribute.close();
 
-            H5::Attribute imgVerAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_IMAGE_VERSION, strdatatypeLen4, attr_dataspace);
-            imgVerAttribute.write(strdatatypeLen4, strImgVerVal);
-            imgVerAttribute.close();
+                H5::Attribute imgVerAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_IMAGE_VERSION, strdatatypeLen4, attr_dataspace);
+                imgVerAttribute.write(strdatatypeLen4, strImgVerVal);
+                imgVerAttribute.close();
 
-            H5::Attribute blockSizeAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE, H5::PredType::STD_U16LE, attr_dataspace);
-            blockSizeAttribute.write(H5::PredType::NATIVE_UINT32, &blockSize2Use);
-            blockSizeAttribute.close();
-            imgBandDataSet.close();
-            imgBandDataSpace.close();
+                H5::Attribute blockSizeAttribute = imgBandDataSet.createAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE, H5::PredType::STD_U16LE, attr_dataspace);
+                blockSizeAttribute.write(H5::PredType::NATIVE_UINT32, &blockSize2Use);
+                blockSizeAttribute.close();
+                imgBandDataSet.close();
+                imgBandDataSpace.close();
+            }
+            else
+            {
+                // OR THE EXPRESSION OF A VIRTUAL BAND, WITH THE BLOCK SIZE IT IS EVALUATED IN
+                hsize_t dimsExpression[] = { 1 };
+                H5::DataSpace expressionDataSpace(1, dimsExpression);
+                H5::StrType strTypeExpression(0, H5T_VARIABLE);
+                H5::DataSet expressionDataSet = keaImgH5File->createDataSet((bandName+KEA_BANDNAME_EXPRESSION), strTypeExpression, expressionDataSpace);
+                const char *wExpression[1];
+                wExpression[0] = expression.c_str();
+                expressionDataSet.write((void*)wExpression, strTypeExpression);
+
+                H5::Attribute blockSizeAttribute = expressionDataSet.createAttribute(KEA_ATTRIBUTENAME_BLOCK_SIZE, H5::PredType::STD_U16LE, attr_dataspace);
+                blockSizeAttribute.write(H5::PredType::NATIVE_UINT32, &blockSize2Use);
+                blockSizeAttribute.close();
+                expressionDataSet.close();
+                expressionDataSpace.close();
+            }
 
             // SET BAND NAME / DESCRIPTION
             if (bandDescrip == "")
@@ -0,0 +1,378 @@
+/*
+ *  KEANeighbourGraph.cpp
+ *  LibKEA
+ *
+ *  Copyright 2012 LibKEA. All rights reserved.
+ *
+ *  This file is part of LibKEA.
+ *
+ *  Permission is hereby granted, free of charge, to any person 
+ *  obtaining a copy of this software and associated documentation 
+ *  files (the "Software"), to deal in the Software without restriction, 
+ *  including without limitation the rights to use, copy, modify, 
+ *  merge, publish, distribute, sublicense, and/or sell copies of the 
+ *  Software, and to permit persons to whom the Software is furnished 
+ *  to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice shall be 
+ *  included in all copies or substantial portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, 
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES 
+ *  OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. 
+ *  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR 
+ *  ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF 
+ *  CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION 
+ *  WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+
+#include "libkea/KEANeighbourGraph.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+
+namespace kealib{
+    
+    KEANeighbourGraph::KEANeighbourGraph()
+    {
+        this->offsets.assign(1, 0);
+    }
+    
+    void KEANeighbourGraph::load(const KEAAttributeTable *att, size_t blockRows)
+    {
+        size_t numRows = att->getSize();
+        blockRows = std::max<size_t>(blockRows, 1);
+        this->offsets.clear();
+        this->offsets.reserve(numRows + 1);
+        this->offsets.push_back(0);
+        this->neighbours.clear();
+        for(size_t start = 0; start < numRows; start += blockRows)
+        {
+            att->getNeighbourBlock(start, std::min(blockRows, numRows - start), &this->offsets, &this->neighbours);
+        }
+        
+        size_t numEdges = 0;
+        size_t rowStart = 0;
+        for(size_t fid = 0; fid < numRows; ++fid)
+        {
+            size_t rowEnd = this->offsets[fid + 1];
+            for(size_t i = rowStart; i < rowEnd; ++i)
+            {
+                if(this->neighbours[i] < numRows)
+                {
+                    this->neighbours[numEdges++] = this->neighbours[i];
+                }
+            }
+            rowStart = rowEnd;
+            this->offsets[fid + 1] = numEdges;
+        }
+        this->neighbours.resize(numEdges);
+        this->neighbours.shrink_to_fit();
+    }
+    
+    size_t KEANeighbourGraph::getNumNodes() const
+    {
+        return this->offsets.size() - 1;
+    }
+    
+    size_t KEANeighbourGraph::getNumEdges() const
+    {
+        return this->neighbours.size();
+    }
+    
+    size_t KEANeighbourGraph::getNumNeighbours(size_t fid) const
+    {
+        if(fid >= this->getNumNodes())
+        {
+            std::string message = std::string("Requested feature (") + sizet2Str(fid) + std::string(") is not within the graph.");
+            throw KEAATTException(message);
+        }
+        return this->offsets[fid + 1] - this->offsets[fid];
+    }
+    
+    const size_t* KEANeighbourGraph::getNeighbours(size_t fid) const
+    {
+        if(fid >= this->getNumNodes())
+        {
+            std::string message = std::string("Requested feature (") + sizet2Str(fid) + std::string(") is not within the graph.");
+            throw KEAATTException(message);
+        }
+        return this->neighbours.data() + this->offsets[fid];
+    }
+    
+    void KEANeighbourGraph::breadthFirst(size_t start, const std::function<bool(size_t fid, size_t depth)> &visit) const
+    {
+        if(start >= this->getNumNodes())
+        {
+            std::string message = std::string("Requested feature (") + sizet2Str(start) + std::string(") is not within the graph.");
+            throw KEAATTException(message);
+        }
+        
+        std::vector<bool> seen(this->getNumNodes(), false);
+        std::deque< std::pair<size_t, size_t> > toVisit;
+        toVisit.push_back(std::pair<size_t, size_t>(start, 0));
+        seen[start] = true;
+        while(!toVisit.empty())
+        {
+            std::pair<size_t, size_t> node = toVisit.front();
+            toVisit.pop_front();
+            if(!visit(node.first, node.second))
+            {
+                continue;
+            }
+            for(size_t i = this->offsets[node.first]; i < this->offsets[node.first + 1]; ++i)
+            {
+                size_t n = this->neighbours[i];
+                if(!seen[n])
+                {
+                    seen[n] = true;
+                    toVisit.push_back(std::pair<size_t, size_t>(n, node.second + 1));
+                }
+            }
+        }
+    }
+    
+    void KEANeighbourGraph::depthFirst(size_t start, const std::function<bool(size_t fid, size_t depth)> &visit) const
+    {
+        if(start >= this->getNumNodes())
+        {
+            std::string message = std::string("Requested feature (") + sizet2Str(start) + std::string(") is not within the graph.");
+            throw KEAATTException(message);
+        }
+        
+        std::vector<bool> seen(this->getNumNodes(), false);
+        std::vector< std::pair<size_t, size_t> > toVisit;
+        toVisit.push_back(std::pair<size_t, size_t>(start, 0));
+        while(!toVisit.empty())
+        {
+            std::pair<size_t, size_t> node = toVisit.back();
+            toVisit.pop_back();
+            if(seen[node.first])
+            {
+                continue;
+            }
+            seen[node.first] = true;
+            if(!visit(node.first, node.second))
+            {
+                continue;
+            }
+            // pushed in reverse so the neighbours are visited in order
+            for(size_t i = this->offsets[node.first + 1]; i > this->offsets[node.first]; --i)
+            {
+                size_t n = this->neighbours[i - 1];
+                if(!seen[n])
+                {
+                    toVisit.push_back(std::pair<size_t, size_t>(n, node.second + 1));
+                }
+            }
+        }
+    }
+    
+    size_t KEANeighbourGraph::connectedComponents(const std::vector<uint8_t> &include, std::vector<uint64_t> *components, unsigned int numThreads) const
+    {
+        size_t numNodes = this->getNumNodes();
+        if(include.size() != numNodes)
+        {
+            throw KEAATTException("The number of nodes to include does not match the graph.");
+        }
+        
+        // the edges are joined concurrently with a lock free union-find in
+        // which the larger root is always linked beneath the smaller, so the
+        // root of each set is its first node.
+        std::unique_ptr<std::atomic<uint64_t>[]> parents(new std::atomic<uint64_t>[numNodes]);
+        runOnThreads(numNodes, numThreads, [&](uint64_t start, uint64_t end, unsigned int)
+        {
+            for(size_t fid = start; fid < end; ++fid)
+            {
+                parents[fid].store(fid, std::memory_order_relaxed);
+            }
+        });
+        
+        auto findRoot = [&parents](uint64_t fid) -> uint64_t
+        {
+            while(true)
+            {
+                uint64_t parent = parents[fid].load();
+                if(parent == fid)
+                {
+                    return fid;
+                }
+                uint64_t grandParent = parents[parent].load();
+                if(grandParent != parent)
+                {
+                    parents[fid].compare_exchange_weak(parent, grandParent);
+                }
+                fid = grandParent;
+            }
+        };
+        
+        runOnThreads(numNodes, numThreads, [&](uint64_t start, uint64_t end, unsigned int)
+        {
+            for(size_t fid = start; fid < end; ++fid)
+            {
+                if(include[fid] == 0)
+                {
+                    continue;
+                }
+                for(size_t i = this->offsets[fid]; i < this->offsets[fid + 1]; ++i)
+                {
+                    size_t n = this->neighbours[i];
+                    if(include[n] == 0)
+                    {
+                        continue;
+                    }
+                    uint64_t rootA = fid;
+                    uint64_t rootB = n;
+                    while(true)
+                    {
+                        rootA = findRoot(rootA);
+                        rootB = findRoot(rootB);
+                        if(rootA == rootB)
+                        {
+                            break;
+                        }
+                        if(rootA < rootB)
+                        {
+                            std::swap(rootA, rootB);
+                        }
+                        uint64_t expected = rootA;
+                        if(parents[rootA].compare_exchange_strong(expected, rootB))
+                        {
+                            break;
+                        }
+                    }
+                }
+            }
+        });
+        
+        components->resize(numNodes);
+        size_t numComponents = 0;
+        for(size_t fid = 0; fid < numNodes; ++fid)
+        {
+            if((include[fid] != 0) && (parents[fid].load(std::memory_order_relaxed) == fid))
+            {
+                (*components)[fid] = numComponents++;
+            }
+        }
+        runOnThreads(numNodes, numThreads, [&](uint64_t start, uint64_t end, unsigned int)
+        {
+            for(size_t fid = start; fid < end; ++fid)
+            {
+                if(include[fid] == 0)
+                {
+                    (*components)[fid] = KEA_NO_COMPONENT;
+                }
+                else
+                {
+                    uint64_t root = findRoot(fid);
+                    if(root != fid)
+                    {
+                        (*components)[fid] = (*components)[root];
+                    }
+                }
+            }
+        });
+        return numComponents;
+    }
+    
+    size_t KEANeighbourGraph::connectedComponents(const KEAAttributeTable *att, size_t colIdx, const std::function<bool(double)> &predicate, std::vector<uint64_t> *components, unsigned int numThreads) const
+    {
+        size_t numNodes = this->getNumNodes();
+        if(att->getSize() != numNodes)
+        {
+            throw KEAATTException("The attribute table does not match the graph.");
+        }
+        
+        KEAATTField field = att->getField(colIdx);
+        std::vector<uint8_t> include(numNodes, 0);
+        size_t blockRows = KEA_ATT_CHUNK_SIZE * KEA_ATT_PIPELINE_BLOCK_CHUNKS;
+        std::vector<double> vals;
+        for(size_t start = 0; start < numNodes; start += blockRows)
+        {
+            size_t len = std::min(blockRows, numNodes - start);
+            vals.resize(len);
+            if(field.dataType == kea_att_float)
+            {
+                att->getFloatFields(start, len, field.idx, vals.data());
+            }
+            else if(field.dataType == kea_att_int)
+            {
+                std::vector<int64_t> intVals(len);
+                att->getIntFields(start, len, field.idx, intVals.data());
+                std::copy(intVals.begin(), intVals.end(), vals.begin());
+            }
+            else if(field.dataType == kea_att_bool)
+            {
+                std::unique_ptr<bool[]> boolVals(new bool[len]);
+                att->getBoolFields(start, len, field.idx, boolVals.get());
+                for(size_t i = 0; i < len; ++i)
+                {
+                    vals[i] = boolVals[i]?1:0;
+                }
+            }
+            else
+            {
+                throw KEAATTException("The column \'" + field.name + "\' is not numeric.");
+            }
+            for(size_t i = 0; i < len; ++i)
+            {
+                include[start + i] = predicate(vals[i])?1:0;
+            }
+        }
+        return this->connectedComponents(include, components, numThreads);
+    }
+    
+    void KEANeighbourGraph::aggregateNeighbours(const std::vector<double> &vals, KEANeighbourAggregate aggregate, std::vector<double> *out, unsigned int numThreads) const
+    {
+        size_t numNodes = this->getNumNodes();
+        if(vals.size() != numNodes)
+        {
+            throw KEAATTException("The number of values does not match the graph.");
+        }
+        
+        out->resize(numNodes);
+        runOnThreads(numNodes, numThreads, [&](uint64_t start, uint64_t end, unsigned int)
+        {
+            for(size_t fid = start; fid < end; ++fid)
+            {
+                size_t first = this->offsets[fid];
+                size_t last = this->offsets[fid + 1];
+                double result = 0;
+                if(last > first)
+                {
+                    result = vals[this->neighbours[first]];
+                    for(size_t i = first + 1; i < last; ++i)
+                    {
+                        double val = vals[this->neighbours[i]];
+                        if((aggregate == kea_nagg_sum) || (aggregate == kea_nagg_mean))
+                        {
+                            result += val;
+                        }
+                        else if(aggregate == kea_nagg_min)
+                        {
+                            result = std::min(result, val);
+                        }
+                        else
+                        {
+                            result = std::max(result, val);
+                        }
+                    }
+                    if(aggregate == kea_nagg_mean)
+                    {
+                        result /= (last - first);
+                    }
+                }
+                (*out)[fid] = result;
+            }
+        });
+    }
+    
+    KEANeighbourGraph::~KEANeighbourGraph()
+    {
+        
+    }
+    
+}
@@ -30,12 +30,36 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
 #include "libkea/KEAImageIO.h"
+#include "libkea/KEANeighbourGraph.h"
 
 #define IMG_XSIZE 20
 #define IMG_YSIZE 20
 #define TEST_FIELD "test"
 #define RAT_SIZE 256
+#define CONC_SIZE 100
+#define CONC_BLOCK 16
+#define CONC_WRITTEN 80
+#define CONC_THREADS 8
+#define CONC_READS 200
+#define PIPE_ROWS 40000
+#define POOL_FILES 5
+#define POOL_OPEN 2
+#define VIRT_EXPR "(b2 - b1) / (b2 + b1)"
+#define SEG_XSIZE 60
+#define SEG_YSIZE 50
+#define SEG_SPARSE 5000
+#define SEG_MOVED 20000
 
 int main()
 {
@@ -70,7 +94,852 @@ int main()
         pRat->addRows(RAT_SIZE);
         pRat->setIntFields(0, RAT_SIZE, colIdx, pRATData);
 
+        // cell level edits are buffered - check they are seen by reads
+        // both before and after being written back to the file
+        for( int i = 0; i < RAT_SIZE; i += 3 )
+        {
+            pRATData[i] = i;
+            pRat->setIntField(i, colIdx, i);
+        }
+        for( int i = 0; i < RAT_SIZE; i += 3 )
+        {
+            if( pRat->getIntField(i, colIdx) != i )
+            {
+                fprintf(stderr, "Buffered RAT value not returned for row %d\n", i);
+                return 1;
+            }
+        }
+        // and for the other column types, read a row and a block at a time
+        pRat->addAttBoolField("testBool", false);
+        pRat->addAttFloatField("testFloat", 0);
+        pRat->addAttStringField("testString", "");
+        size_t boolIdx = pRat->getFieldIndex("testBool");
+        size_t floatIdx = pRat->getFieldIndex("testFloat");
+        size_t stringIdx = pRat->getFieldIndex("testString");
+        for( int i = 0; i < RAT_SIZE; i += 3 )
+        {
+            pRat->setBoolField(i, boolIdx, true);
+            pRat->setFloatField(i, floatIdx, i * 0.5);
+            pRat->setStringField(i, stringIdx, "row " + std::to_string(i));
+        }
+        auto checkBuffered = [&](kealib::KEAAttributeTable *pTable, bool singles)
+        {
+            std::unique_ptr<bool[]> bools(new bool[RAT_SIZE]);
+            std::vector<double> floats(RAT_SIZE);
+            std::vector<std::string> strings;
+            pTable->getBoolFields(0, RAT_SIZE, boolIdx, bools.get());
+            pTable->getFloatFields(0, RAT_SIZE, floatIdx, floats.data());
+            pTable->getStringFields(0, RAT_SIZE, stringIdx, &strings);
+            bool ok = (strings.size() == RAT_SIZE);
+            for( int i = 0; ok && (i < RAT_SIZE); i++ )
+            {
+                bool edited = (i % 3) == 0;
+                std::string expectedString = edited ? ("row " + std::to_string(i)) : std::string();
+                ok = (bools[i] == edited) && (floats[i] == (edited ? (i * 0.5) : 0)) &&
+                     (strings[i] == expectedString);
+                if( ok && singles )
+                {
+                    ok = (pTable->getBoolField(i, boolIdx) == edited) &&
+                         (pTable->getFloatField(i, floatIdx) == floats[i]) &&
+                         (pTable->getStringField(i, stringIdx) == expectedString);
+                }
+            }
+            return ok;
+        };
+        if( !checkBuffered(pRat, true) )
+        {
+            fprintf(stderr, "Buffered RAT values not returned before being written\n");
+            return 1;
+        }
+        pRat->flush();
+        // a new table has nothing buffered so reads what is in the file
+        kealib::KEAAttributeTable *pWrittenRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        bool writtenOk = checkBuffered(pWrittenRat, false);
+        kealib::KEAAttributeTable::destroyAttributeTable(pWrittenRat);
+        if( !writtenOk )
+        {
+            fprintf(stderr, "Buffered RAT values not written\n");
+            return 1;
+        }
+
+        int64_t *pRATCheck = (int64_t*)calloc(RAT_SIZE, sizeof(int64_t));
+        pRat->getIntFields(0, RAT_SIZE, colIdx, pRATCheck);
+        for( int i = 0; i < RAT_SIZE; i++ )
+        {
+            if( pRATCheck[i] != pRATData[i] )
+            {
+                fprintf(stderr, "RAT value mismatch for row %d\n", i);
+                return 1;
+            }
+        }
+        free(pRATCheck);
+
+        // and that a whole block of rows comes back from a single read
+        pRat->setIntField(1, colIdx, 42);
+        pRATData[1] = 42;
+        kealib::KEAATTFeatureBlock features;
+        pRat->getFeatures(0, RAT_SIZE, &features);
+        for( int i = 0; i < RAT_SIZE; i++ )
+        {
+            if( features.getInt(i, colIdx) != pRATData[i] )
+            {
+                fprintf(stderr, "RAT feature block mismatch for row %d\n", i);
+                return 1;
+            }
+        }
+
         free(pRATData);
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        io.close();
+
+        // an in memory table is written and loaded a block of rows at a time
+        // (several blocks here), reporting the progress after each
+        h5file = kealib::KEAImageIO::createKEAImage("bob_pipe.kea", kealib::kea_8uint,
+                        IMG_XSIZE, IMG_YSIZE, 1);
+        io.openKEAImageHeader(h5file);
+        io.setImageBandLayerType(1, kealib::kea_thematic);
+        std::unique_ptr<bool[]> pipeBools(new bool[PIPE_ROWS]);
+        std::vector<int64_t> pipeInts(PIPE_ROWS);
+        std::vector<double> pipeFloats(PIPE_ROWS);
+        std::vector<std::string> pipeStrings(PIPE_ROWS);
+        std::vector< std::vector<size_t> > pipeNeighbours(PIPE_ROWS);
+        for( int i = 0; i < PIPE_ROWS; i++ )
+        {
+            pipeBools[i] = (i % 3) == 0;
+            pipeInts[i] = ((int64_t)i * 7) - 5;
+            pipeFloats[i] = i * 0.25;
+            pipeStrings[i] = ((i % 5) == 0) ? std::string() : ("row " + std::to_string(i));
+            if( (i % 4) != 0 )
+            {
+                if( i > 0 )
+                    pipeNeighbours[i].push_back(i - 1);
+                if( i < (PIPE_ROWS - 1) )
+                    pipeNeighbours[i].push_back(i + 1);
+            }
+        }
+        kealib::KEAAttributeTable *pMemRat = new kealib::KEAAttributeTableInMem();
+        pMemRat->addAttBoolField("Bool", false);
+        pMemRat->addAttIntField("Int", 0);
+        pMemRat->addAttFloatField("Float", 0);
+        pMemRat->addAttStringField("String", "");
+        pMemRat->addRows(PIPE_ROWS);
+        pMemRat->setBoolFields(0, PIPE_ROWS, pMemRat->getFieldIndex("Bool"), pipeBools.get());
+        pMemRat->setIntFields(0, PIPE_ROWS, pMemRat->getFieldIndex("Int"), pipeInts.data());
+        pMemRat->setFloatFields(0, PIPE_ROWS, pMemRat->getFieldIndex("Float"), pipeFloats.data());
+        pMemRat->setStringFields(0, PIPE_ROWS, pMemRat->getFieldIndex("String"), &pipeStrings);
+        for( int i = 0; i < PIPE_ROWS; i++ )
+        {
+            // setNeighbours is not implemented for in memory tables
+            *pMemRat->getFeature(i)->neighbours = pipeNeighbours[i];
+        }
+        
+        std::vector<double> progress;
+        auto recordProgress = [](double complete, void *pProgressData)
+        {
+            ((std::vector<double>*)pProgressData)->push_back(complete);
+        };
+        auto checkProgress = [&](const char *what)
+        {
+            bool ok = (progress.size() > 1) && (progress.back() == 1.0) &&
+                      std::is_sorted(progress.begin(), progress.end());
+            progress.clear();
+            if( !ok )
+                fprintf(stderr, "%s progress was not reported up to 100%%\n", what);
+            return ok;
+        };
+        auto checkPipeRat = [&](kealib::KEAAttributeTable *pTable, const char *what)
+        {
+            bool ok = (pTable->getSize() == PIPE_ROWS);
+            std::unique_ptr<bool[]> bools(new bool[PIPE_ROWS]);
+            std::vector<int64_t> ints(PIPE_ROWS);
+            std::vector<double> floats(PIPE_ROWS);
+            std::vector<std::string> strings;
+            std::vector<size_t> rowEnds;
+            std::vector<size_t> neighbours;
+            if( ok )
+            {
+                pTable->getBoolFields(0, PIPE_ROWS, pTable->getFieldIndex("Bool"), bools.get());
+                pTable->getIntFields(0, PIPE_ROWS, pTable->getFieldIndex("Int"), ints.data());
+                pTable->getFloatFields(0, PIPE_ROWS, pTable->getFieldIndex("Float"), floats.data());
+                pTable->getStringFields(0, PIPE_ROWS, pTable->getFieldIndex("String"), &strings);
+                pTable->getNeighbourBlock(0, PIPE_ROWS, &rowEnds, &neighbours);
+                ok = std::equal(bools.get(), bools.get() + PIPE_ROWS, pipeBools.get()) &&
+                     (ints == pipeInts) && (floats == pipeFloats) && (strings == pipeStrings) &&
+                     (rowEnds.size() == PIPE_ROWS);
+                for( int i = 0; ok && (i < PIPE_ROWS); i++ )
+                {
+                    size_t rowStart = (i > 0) ? rowEnds[i - 1] : 0;
+                    ok = std::equal(neighbours.begin() + rowStart, neighbours.begin() + rowEnds[i],
+                                    pipeNeighbours[i].begin(), pipeNeighbours[i].end());
+                }
+            }
+            if( !ok )
+                fprintf(stderr, "%s table did not match what was written\n", what);
+            return ok;
+        };
+        // whole rows read as blocks crossing a chunk boundary, the block
+        // being reused for the second
+        auto checkPipeFeatures = [&](kealib::KEAAttributeTable *pTable, const char *what)
+        {
+            size_t boolIdx = pTable->getFieldIndex("Bool");
+            size_t intIdx = pTable->getFieldIndex("Int");
+            size_t floatIdx = pTable->getFieldIndex("Float");
+            size_t stringIdx = pTable->getFieldIndex("String");
+            kealib::KEAATTFeatureBlock pipeFeatures;
+            bool ok = true;
+            for( size_t startfid : {kealib::KEA_ATT_CHUNK_SIZE - 50, (2 * kealib::KEA_ATT_CHUNK_SIZE) - 7} )
+            {
+                size_t len = 100;
+                pTable->getFeatures(startfid, len, &pipeFeatures);
+                ok = ok && (pipeFeatures.startfid == startfid) && (pipeFeatures.len == len);
+                for( size_t i = 0; ok && (i < len); i++ )
+                {
+                    size_t fid = startfid + i;
+                    ok = (pipeFeatures.getBool(i, boolIdx) == pipeBools[fid]) &&
+                         (pipeFeatures.getInt(i, intIdx) == pipeInts[fid]) &&
+                         (pipeFeatures.getFloat(i, floatIdx) == pipeFloats[fid]) &&
+                         (pipeStrings[fid] == pipeFeatures.getString(i, stringIdx)) &&
+                         std::equal(pipeFeatures.getNeighbours(i), pipeFeatures.getNeighbours(i) + pipeFeatures.getNumNeighbours(i),
+                                    pipeNeighbours[fid].begin(), pipeNeighbours[fid].end());
+                }
+            }
+            if( !ok )
+                fprintf(stderr, "%s table feature block did not match what was written\n", what);
+            return ok;
+        };
+        ((kealib::KEAAttributeTableInMem*)pMemRat)->exportToKeaFile(h5file, 1, kealib::KEA_ATT_CHUNK_SIZE, kealib::KEA_DEFLATE,
+                    recordProgress, &progress);
+        kealib::KEAAttributeTable::destroyAttributeTable(pMemRat);
+        if( !checkProgress("Export") )
+            return 1;
+        pRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        bool pipeOk = checkPipeRat(pRat, "Exported") && checkPipeFeatures(pRat, "Exported");
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        if( !pipeOk )
+            return 1;
+        pRat = kealib::KEAAttributeTableInMem::createKeaAtt(h5file, 1, recordProgress, &progress);
+        pipeOk = checkProgress("Load") && checkPipeRat(pRat, "Loaded") && checkPipeFeatures(pRat, "Loaded");
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        if( !pipeOk )
+            return 1;
+        io.close();
+
+        // copying a table over one already in a band should replace it
+        // entirely, leaving nothing of the old table or the copy beside it
+        h5file = kealib::KEAImageIO::createKEAImage("bob_copy.kea", kealib::kea_8uint,
+                        IMG_XSIZE, IMG_YSIZE, 1);
+        io.openKEAImageHeader(h5file);
+        io.setImageBandLayerType(1, kealib::kea_thematic);
+        pRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        pRat->addAttIntField("Old", 3);
+        pRat->addRows(10);
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        {
+            // the second copy fails if the first left its copy beside
+            kealib::KEAImageIO srcIO;
+            srcIO.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly("bob_pipe.kea"));
+            io.copyAttributeTable(&srcIO, 1, 1);
+            io.copyAttributeTable(&srcIO, 1, 1);
+            srcIO.close();
+        }
+        pRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        bool copyOk = checkPipeRat(pRat, "Copied") && !pRat->hasField("Old") &&
+                      (pRat->getTotalNumOfCols() == 4);
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        if( !copyOk )
+        {
+            fprintf(stderr, "Copied table did not replace the old one\n");
+            return 1;
+        }
+        io.close();
+
+        // many threads reading one read-only image at once should each see
+        // exactly what was written, and the fill value in unwritten chunks
+        h5file = kealib::KEAImageIO::createKEAImage("bob_conc.kea", kealib::kea_16uint,
+                        CONC_SIZE, CONC_SIZE, 1, NULL, NULL, CONC_BLOCK);
+        io.openKEAImageHeader(h5file);
+        std::vector<uint16_t> expected(CONC_SIZE * CONC_SIZE, 0);
+        for( int i = 0; i < (CONC_SIZE * CONC_WRITTEN); i++ )
+        {
+            expected[i] = (uint16_t)((i * 7919) % 65521);
+        }
+        io.writeImageBlock2Band(1, expected.data(), 0, 0, CONC_SIZE, CONC_WRITTEN,
+                    CONC_SIZE, CONC_WRITTEN, kealib::kea_16uint);
+        io.close();
+
+        io.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly("bob_conc.kea"));
+        std::atomic<int> nErrors(0);
+        std::vector<std::thread> threads;
+        for( int t = 0; t < CONC_THREADS; t++ )
+        {
+            threads.emplace_back([&, t]() {
+                srand(t);
+                std::vector<uint16_t> buf(CONC_SIZE * CONC_SIZE);
+                for( int n = 0; n < CONC_READS; n++ )
+                {
+                    int xOff = rand() % CONC_SIZE, yOff = rand() % CONC_SIZE;
+                    int xSize = 1 + rand() % (CONC_SIZE - xOff), ySize = 1 + rand() % (CONC_SIZE - yOff);
+                    try
+                    {
+                        io.readImageBlock2BandConcurrent(1, 0, buf.data(), xOff, yOff, xSize, ySize,
+                                    CONC_SIZE, kealib::kea_16uint);
+                    }
+                    catch(const kealib::KEAException &e)
+                    {
+                        nErrors++;
+                        return;
+                    }
+                    for( int y = 0; y < ySize; y++ )
+                    {
+                        for( int x = 0; x < xSize; x++ )
+                        {
+                            if( buf[(y * CONC_SIZE) + x] != expected[((yOff + y) * CONC_SIZE) + xOff + x] )
+                            {
+                                nErrors++;
+                                return;
+                            }
+                        }
+                    }
+                }
+            });
+        }
+        for( std::thread &thread : threads )
+        {
+            thread.join();
+        }
+        io.close();
+        if( nErrors > 0 )
+        {
+            fprintf(stderr, "Concurrent reads did not match what was written\n");
+            return 1;
+        }
+
+        // the I/O done should be counted for the band, and chunks which
+        // were prefetched should be used without being read again
+        io.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly("bob_conc.kea"));
+        const uint64_t writtenChunks = ((CONC_SIZE + CONC_BLOCK - 1) / CONC_BLOCK) * (CONC_WRITTEN / CONC_BLOCK);
+        std::vector<uint16_t> ioWindow(CONC_SIZE * CONC_WRITTEN);
+        io.resetIOStats();
+        io.readImageBlock2BandConcurrent(1, 0, ioWindow.data(), 0, 0, CONC_SIZE, CONC_WRITTEN,
+                    CONC_SIZE, kealib::kea_16uint);
+        kealib::KEAIOStats stats = io.getIOStats(1);
+        bool statsOk = (stats.bytesRead == (CONC_SIZE * CONC_WRITTEN * sizeof(uint16_t))) &&
+                       (stats.rawBytesRead > 0) && (stats.datasetOpens > 0) && (stats.cacheHits == 0) &&
+                       (io.getIOStats(0).bytesRead == stats.bytesRead) && (io.getIOStats(2).bytesRead == 0);
+        // chunks are only decoded here when built with zlib
+        bool decoded = (stats.chunksDecoded == writtenChunks);
+        statsOk = statsOk && (decoded ? (stats.cacheMisses == writtenChunks) : (stats.chunksDecoded == 0));
+        io.resetIOStats(1);
+        stats = io.getIOStats(1);
+        statsOk = statsOk && (stats.bytesRead == 0) && (stats.rawBytesRead == 0) && (stats.datasetOpens == 0);
+        if( !statsOk )
+        {
+            fprintf(stderr, "I/O not counted for the band read\n");
+            return 1;
+        }
+        if( decoded )
+        {
+            io.prefetchImageBlocks(1, 0, 0, 0, CONC_SIZE, CONC_WRITTEN);
+            for( int n = 0; (n < 1000) && (io.getIOStats(1).chunksDecoded < writtenChunks); n++ )
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+            kealib::KEAIOStats prefetched = io.getIOStats(1);
+            std::fill(ioWindow.begin(), ioWindow.end(), 0);
+            io.readImageBlock2BandConcurrent(1, 0, ioWindow.data(), 0, 0, CONC_SIZE, CONC_WRITTEN,
+                        CONC_SIZE, kealib::kea_16uint);
+            stats = io.getIOStats(1);
+            bool prefetchOk = (prefetched.chunksDecoded == writtenChunks) && (stats.cacheHits == writtenChunks) &&
+                              (stats.cacheMisses == 0) && (stats.rawBytesRead == prefetched.rawBytesRead) &&
+                              (stats.chunksDecoded == prefetched.chunksDecoded) &&
+                              std::equal(ioWindow.begin(), ioWindow.end(), expected.begin());
+            // each prefetched chunk is only used once
+            io.readImageBlock2BandConcurrent(1, 0, ioWindow.data(), 0, 0, CONC_SIZE, CONC_WRITTEN,
+                        CONC_SIZE, kealib::kea_16uint);
+            prefetchOk = prefetchOk && (io.getIOStats(1).cacheMisses == writtenChunks);
+            if( !prefetchOk )
+            {
+                fprintf(stderr, "Prefetched chunks were not used by the read\n");
+                return 1;
+            }
+        }
+        io.close();
+
+        // reopenable images should be closed and reopened to keep within the
+        // file limits, whether read from one thread or several at once
+        std::vector<std::unique_ptr<kealib::KEAImageIO> > pooled;
+        kealib::KEAImageIO::setFileLimits(POOL_OPEN, 0);
+        for( int i = 0; i < POOL_FILES; i++ )
+        {
+            std::string fileName = "bob_pool" + std::to_string(i) + ".kea";
+            h5file = kealib::KEAImageIO::createKEAImage(fileName, kealib::kea_16uint,
+                            CONC_SIZE, CONC_SIZE, 1, NULL, NULL, CONC_BLOCK);
+            io.openKEAImageHeader(h5file);
+            std::vector<uint16_t> poolVals(CONC_SIZE * CONC_SIZE, (uint16_t)(i + 1));
+            io.writeImageBlock2Band(1, poolVals.data(), 0, 0, CONC_SIZE, CONC_SIZE,
+                        CONC_SIZE, CONC_SIZE, kealib::kea_16uint);
+            io.close();
+            
+            pooled.emplace_back(new kealib::KEAImageIO());
+            pooled.back()->openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly(fileName));
+            pooled.back()->setReopenable([fileName]() { return kealib::KEAImageIO::openKeaH5RDOnly(fileName); });
+        }
+        auto checkPooled = [&](int i, bool concurrent)
+        {
+            std::vector<uint16_t> buf(CONC_SIZE * CONC_SIZE, 0);
+            if( concurrent )
+                pooled[i]->readImageBlock2BandConcurrent(1, 0, buf.data(), 0, 0, CONC_SIZE, CONC_SIZE,
+                            CONC_SIZE, kealib::kea_16uint);
+            else
+                pooled[i]->readImageBlock2Band(1, buf.data(), 0, 0, CONC_SIZE, CONC_SIZE,
+                            CONC_SIZE, CONC_SIZE, kealib::kea_16uint);
+            return std::count(buf.begin(), buf.end(), (uint16_t)(i + 1)) == (CONC_SIZE * CONC_SIZE);
+        };
+        bool poolOk = true;
+        for( int n = 0; n < (3 * POOL_FILES); n++ )
+        {
+            poolOk = poolOk && checkPooled(n % POOL_FILES, false);
+        }
+        for( int i = 0; i < POOL_FILES; i++ )
+        {
+            // opened once, then reopened for each round
+            poolOk = poolOk && (pooled[i]->getIOStats().fileOpens >= 3);
+        }
+        threads.clear();
+        for( int t = 0; t < CONC_THREADS; t++ )
+        {
+            threads.emplace_back([&, t]() {
+                for( int n = 0; n < (CONC_READS / 10); n++ )
+                {
+                    try
+                    {
+                        if( !checkPooled((n + t) % POOL_FILES, true) )
+                            nErrors++;
+                    }
+                    catch(const kealib::KEAException &e)
+                    {
+                        nErrors++;
+                    }
+                }
+            });
+        }
+        for( std::thread &thread : threads )
+        {
+            thread.join();
+        }
+        for( std::unique_ptr<kealib::KEAImageIO> &pPooled : pooled )
+        {
+            pPooled->close();
+        }
+        kealib::KEAImageIO::setFileLimits(0, 0);
+        if( !poolOk || (nErrors > 0) )
+        {
+            fprintf(stderr, "Images beyond the file limits were not read back\n");
+            return 1;
+        }
+
+        // a virtual band should be calculated from its bands on each read,
+        // whether the file is open for update or read-only
+        h5file = kealib::KEAImageIO::createKEAImage("bob_virt.kea", kealib::kea_16uint,
+                        CONC_SIZE, CONC_SIZE, 2, NULL, NULL, CONC_BLOCK);
+        io.openKEAImageHeader(h5file);
+        std::vector<uint16_t> band2(CONC_SIZE * CONC_SIZE);
+        for( int i = 0; i < (CONC_SIZE * CONC_SIZE); i++ )
+        {
+            band2[i] = (uint16_t)(1 + ((i * 104729) % 65000));
+        }
+        io.writeImageBlock2Band(1, expected.data(), 0, 0, CONC_SIZE, CONC_SIZE,
+                    CONC_SIZE, CONC_SIZE, kealib::kea_16uint);
+        io.writeImageBlock2Band(2, band2.data(), 0, 0, CONC_SIZE, CONC_SIZE,
+                    CONC_SIZE, CONC_SIZE, kealib::kea_16uint);
+        io.addVirtualImageBand(kealib::kea_32float, "ndvi", VIRT_EXPR, CONC_BLOCK);
+        std::vector<float> ndvi(CONC_SIZE * CONC_SIZE);
+        for( int i = 0; i < (CONC_SIZE * CONC_SIZE); i++ )
+        {
+            ndvi[i] = (float)(((double)band2[i] - expected[i]) / ((double)band2[i] + expected[i]));
+        }
+        for( int pass = 0; pass < 3; pass++ )
+        {
+            if( pass == 1 )
+            {
+                io.close();
+                io.openKEAImageHeader(kealib::KEAImageIO::openKeaH5RDOnly("bob_virt.kea"));
+            }
+            std::vector<float> buf(CONC_SIZE * CONC_SIZE, -1);
+            if( pass == 0 )
+            {
+                io.readImageBlock2Band(3, buf.data(), 0, 0, CONC_SIZE, CONC_SIZE,
+                            CONC_SIZE, CONC_SIZE, kealib::kea_32float);
+            }
+            else
+            {
+                // the second read is from the cached chunks
+                io.readImageBlock2BandConcurrent(3, 0, buf.data(), 0, 0, CONC_SIZE, CONC_SIZE,
+                            CONC_SIZE, kealib::kea_32float);
+            }
+            if( !io.isVirtualImageBand(3) || (buf != ndvi) )
+            {
+                fprintf(stderr, "Virtual band values did not match the expression\n");
+                return 1;
+            }
+        }
+        io.close();
+
+        // a segmentation of 10 x 10 squares, one with a sparse label, with
+        // a no data row along the top
+        h5file = kealib::KEAImageIO::createKEAImage("bob_segs.kea", kealib::kea_32uint,
+                        SEG_XSIZE, SEG_YSIZE, 1, NULL, NULL, CONC_BLOCK);
+        io.openKEAImageHeader(h5file);
+        io.setImageBandLayerType(1, kealib::kea_thematic);
+        uint32_t segNoData = 0;
+        io.setNoDataValue(1, &segNoData, kealib::kea_32uint);
+        std::vector<uint32_t> segs(SEG_XSIZE * SEG_YSIZE);
+        std::map<uint32_t, std::vector<int64_t> > segExtents; // minX, minY, maxX, maxY, count
+        for( int y = 0; y < SEG_YSIZE; y++ )
+        {
+            for( int x = 0; x < SEG_XSIZE; x++ )
+            {
+                uint32_t seg = 1 + (x / 10) + ((SEG_XSIZE / 10) * (y / 10));
+                if( y == 0 )
+                    seg = segNoData;
+                else if( (x >= 50) && (y >= 40) )
+                    seg = SEG_SPARSE;
+                segs[(y * SEG_XSIZE) + x] = seg;
+                if( seg == segNoData )
+                    continue;
+                auto found = segExtents.find(seg);
+                if( found == segExtents.end() )
+                {
+                    segExtents[seg] = {x, y, x, y, 1};
+                    continue;
+                }
+                std::vector<int64_t> &extent = found->second;
+                extent[0] = std::min<int64_t>(extent[0], x);
+                extent[1] = std::min<int64_t>(extent[1], y);
+                extent[2] = std::max<int64_t>(extent[2], x);
+                extent[3] = std::max<int64_t>(extent[3], y);
+                extent[4]++;
+            }
+        }
+        io.writeImageBlock2Band(1, segs.data(), 0, 0, SEG_XSIZE, SEG_YSIZE,
+                    SEG_XSIZE, SEG_YSIZE, kealib::kea_32uint);
+        
+        io.calcSegmentExtents(1, 4);
+        pRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        if( pRat->getSize() != (SEG_SPARSE + 1) )
+        {
+            fprintf(stderr, "Segment extents not calculated for every segment\n");
+            return 1;
+        }
+        const std::string extentFields[] = {kealib::KEA_ATT_SEG_MINX_FIELD, kealib::KEA_ATT_SEG_MINY_FIELD,
+                    kealib::KEA_ATT_SEG_MAXX_FIELD, kealib::KEA_ATT_SEG_MAXY_FIELD, kealib::KEA_ATT_PIXELCOUNT_FIELD};
+        std::vector<int64_t> column(SEG_SPARSE + 1);
+        for( int f = 0; f < 5; f++ )
+        {
+            pRat->getIntFields(0, SEG_SPARSE + 1, pRat->getFieldIndex(extentFields[f]), column.data());
+            for( int fid = 0; fid <= SEG_SPARSE; fid++ )
+            {
+                auto found = segExtents.find(fid);
+                int64_t expectedVal = (found != segExtents.end()) ? found->second[f] : ((f == 4) ? 0 : -1);
+                if( column[fid] != expectedVal )
+                {
+                    fprintf(stderr, "Segment %d has the wrong %s\n", fid, extentFields[f].c_str());
+                    return 1;
+                }
+            }
+        }
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        
+        kealib::KEASegmentWindow window;
+        io.readSegmentWindow(1, SEG_SPARSE, std::vector<uint32_t>(1, 1), &window);
+        if( (window.xOff != 50) || (window.yOff != 40) || (window.xSize != 10) || (window.ySize != 10) ||
+            (std::count(window.mask.begin(), window.mask.end(), 1) != 100) || (window.values[0][0] != SEG_SPARSE) )
+        {
+            fprintf(stderr, "Segment window does not cover the segment\n");
+            return 1;
+        }
+        
+        // a band made from an attribute table column
+        pRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        pRat->addAttFloatField("Half", 0);
+        std::vector<double> halves(SEG_SPARSE + 1);
+        for( int fid = 0; fid <= SEG_SPARSE; fid++ )
+        {
+            halves[fid] = fid * 0.5;
+        }
+        pRat->setFloatFields(0, SEG_SPARSE + 1, pRat->getFieldIndex("Half"), halves.data());
+        size_t halfCol = pRat->getField("Half").colNum;
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        io.addImageBand(kealib::kea_32float, "", CONC_BLOCK);
+        float halfNoData = -1;
+        io.setNoDataValue(2, &halfNoData, kealib::kea_32float);
+        io.applyRATColumn(1, halfCol, 2, 4);
+        std::vector<float> halfBand(SEG_XSIZE * SEG_YSIZE);
+        io.readImageBlock2Band(2, halfBand.data(), 0, 0, SEG_XSIZE, SEG_YSIZE,
+                    SEG_XSIZE, SEG_YSIZE, kealib::kea_32float);
+        for( int i = 0; i < (SEG_XSIZE * SEG_YSIZE); i++ )
+        {
+            float expectedHalf = (segs[i] == segNoData) ? halfNoData : (segs[i] * 0.5f);
+            if( halfBand[i] != expectedHalf )
+            {
+                fprintf(stderr, "Attribute table column not applied at pixel %d\n", i);
+                return 1;
+            }
+        }
+        
+        // rendering through the colour table, with values clamped to 0-255
+        pRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        const char *colourNames[] = {"Red", "Green", "Blue", "Alpha"};
+        std::vector<int64_t> colours[4];
+        for( int c = 0; c < 4; c++ )
+        {
+            pRat->addAttIntField(colourNames[c], 0, colourNames[c]);
+            colours[c].resize(SEG_SPARSE + 1);
+            for( int fid = 0; fid <= SEG_SPARSE; fid++ )
+            {
+                colours[c][fid] = (fid * (c + 1)) - 100;
+            }
+            pRat->setIntFields(0, SEG_SPARSE + 1, pRat->getFieldIndex(colourNames[c]), colours[c].data());
+        }
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        std::vector<uint8_t> lut;
+        if( !io.getRGBALookupTable(1, &lut) || (lut.size() != ((SEG_SPARSE + 1) * 4)) )
+        {
+            fprintf(stderr, "Colour table not loaded\n");
+            return 1;
+        }
+        std::vector<uint8_t> rgba(30 * 20 * 4);
+        io.renderRGBA(1, 0, lut, rgba.data(), 5, 0, 30, 20, 4);
+        for( int y = 0; y < 20; y++ )
+        {
+            for( int x = 0; x < 30; x++ )
+            {
+                uint32_t seg = segs[(y * SEG_XSIZE) + x + 5];
+                for( int c = 0; c < 4; c++ )
+                {
+                    int64_t expectedColour = (seg == segNoData) ? 0 : std::min<int64_t>(std::max<int64_t>(colours[c][seg], 0), 255);
+                    if( rgba[(((y * 30) + x) * 4) + c] != expectedColour )
+                    {
+                        fprintf(stderr, "Rendered colour wrong at %d, %d\n", x, y);
+                        return 1;
+                    }
+                }
+            }
+        }
+        
+        // relabelling moves the pixels, attribute table rows and neighbours
+        // (between blocks of rows as well) and compactLabels undoes the gaps
+        std::vector< std::set<size_t> > segNeighbours(SEG_SPARSE + 1);
+        for( int cy = 0; cy < (SEG_YSIZE / 10); cy++ )
+        {
+            for( int cx = 0; cx < (SEG_XSIZE / 10); cx++ )
+            {
+                uint32_t seg = segs[((cy * 10 + 5) * SEG_XSIZE) + (cx * 10)];
+                if( cx > 0 )
+                {
+                    uint32_t other = segs[((cy * 10 + 5) * SEG_XSIZE) + ((cx - 1) * 10)];
+                    segNeighbours[seg].insert(other);
+                    segNeighbours[other].insert(seg);
+                }
+                if( cy > 0 )
+                {
+                    uint32_t other = segs[(((cy - 1) * 10 + 5) * SEG_XSIZE) + (cx * 10)];
+                    segNeighbours[seg].insert(other);
+                    segNeighbours[other].insert(seg);
+                }
+            }
+        }
+        pRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        std::vector< std::vector<size_t> > neighbourLists(SEG_SPARSE + 1);
+        std::vector< std::vector<size_t>* > neighbourPtrs(SEG_SPARSE + 1);
+        for( int fid = 0; fid <= SEG_SPARSE; fid++ )
+        {
+            neighbourLists[fid].assign(segNeighbours[fid].begin(), segNeighbours[fid].end());
+            neighbourPtrs[fid] = &neighbourLists[fid];
+        }
+        pRat->setNeighbours(0, SEG_SPARSE + 1, &neighbourPtrs);
+        // each row records the segment it started as, to check the columns
+        // are moved with it
+        std::vector<int64_t> origFids(SEG_SPARSE + 1);
+        std::vector<uint64_t> origToCur(SEG_SPARSE + 1);
+        for( int fid = 0; fid <= SEG_SPARSE; fid++ )
+        {
+            origFids[fid] = fid;
+            origToCur[fid] = fid;
+        }
+        pRat->addAttIntField("Orig", -1);
+        pRat->setIntFields(0, SEG_SPARSE + 1, pRat->getFieldIndex("Orig"), origFids.data());
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        
+        auto checkRelabel = [&](const std::vector<uint64_t> &mapping, const char *what)
+        {
+            std::vector< std::set<size_t> > newNeighbours;
+            for( size_t fid = 0; fid < segNeighbours.size(); fid++ )
+            {
+                uint64_t newFid = (fid < mapping.size()) ? mapping[fid] : fid;
+                if( newFid == kealib::KEA_RELABEL_DROP )
+                    continue;
+                if( newFid >= newNeighbours.size() )
+                    newNeighbours.resize(newFid + 1);
+                for( size_t neighbour : segNeighbours[fid] )
+                {
+                    uint64_t newNeighbour = (neighbour < mapping.size()) ? mapping[neighbour] : neighbour;
+                    if( (newNeighbour != kealib::KEA_RELABEL_DROP) && (newNeighbour != newFid) )
+                        newNeighbours[newFid].insert(newNeighbour);
+                }
+            }
+            segNeighbours.swap(newNeighbours);
+            for( uint64_t &cur : origToCur )
+            {
+                if( cur != kealib::KEA_RELABEL_DROP )
+                    cur = (cur < mapping.size()) ? mapping[cur] : cur;
+            }
+            std::vector<int64_t> counts(segNeighbours.size(), 0);
+            for( uint32_t &seg : segs )
+            {
+                if( seg == segNoData )
+                    continue;
+                seg = (mapping[seg] == kealib::KEA_RELABEL_DROP) ? segNoData : mapping[seg];
+                if( seg != segNoData )
+                    counts[seg]++;
+            }
+            
+            std::vector<uint32_t> relabelled(SEG_XSIZE * SEG_YSIZE);
+            io.readImageBlock2Band(1, relabelled.data(), 0, 0, SEG_XSIZE, SEG_YSIZE,
+                        SEG_XSIZE, SEG_YSIZE, kealib::kea_32uint);
+            kealib::KEAAttributeTable *pRelabelledRat = io.getAttributeTable(kealib::kea_att_file, 1);
+            size_t numRows = pRelabelledRat->getSize();
+            std::vector<int64_t> histogram(numRows);
+            pRelabelledRat->getIntFields(0, numRows, pRelabelledRat->getFieldIndex(kealib::KEA_ATT_PIXELCOUNT_FIELD), histogram.data());
+            std::vector<int64_t> orig(numRows);
+            pRelabelledRat->getIntFields(0, numRows, pRelabelledRat->getFieldIndex("Orig"), orig.data());
+            std::vector<std::vector<size_t>* > neighbours;
+            pRelabelledRat->getNeighbours(0, numRows, &neighbours);
+            kealib::KEAAttributeTable::destroyAttributeTable(pRelabelledRat);
+            bool ok = (relabelled == segs) && (numRows == segNeighbours.size()) &&
+                      (histogram == counts);
+            for( size_t fid = 0; ok && (fid < numRows); fid++ )
+            {
+                ok = (*neighbours[fid] == std::vector<size_t>(segNeighbours[fid].begin(), segNeighbours[fid].end()));
+            }
+            for( size_t fid = 0; ok && (fid < numRows); fid++ )
+            {
+                if( counts[fid] > 0 )
+                    ok = (orig[fid] >= 0) && (origToCur[orig[fid]] == fid);
+            }
+            for( std::vector<size_t> *pNeighbours : neighbours )
+            {
+                delete pNeighbours;
+            }
+            if( !ok )
+                fprintf(stderr, "%s did not move the pixels, histogram, columns and neighbours\n", what);
+            return ok;
+        };
+        std::vector<uint64_t> mapping(SEG_SPARSE + 1, kealib::KEA_RELABEL_DROP);
+        mapping[0] = 0;
+        for( int fid = 1; fid <= 30; fid++ )
+        {
+            mapping[fid] = 31 - fid;
+        }
+        mapping[1] = 2; // merged with 29
+        mapping[SEG_SPARSE] = SEG_MOVED;
+        io.relabel(1, mapping, 4);
+        if( !checkRelabel(mapping, "relabel") )
+            return 1;
+        mapping = io.compactLabels(1, 4);
+        if( !checkRelabel(mapping, "compactLabels") )
+            return 1;
+        io.close();
+
+        // a small segment should be merged into its most similar neighbour
+        // and the features updated as pixel weighted means
+        h5file = kealib::KEAImageIO::createKEAImage("bob_elim.kea", kealib::kea_32uint,
+                        30, 10, 1, NULL, NULL, CONC_BLOCK);
+        io.openKEAImageHeader(h5file);
+        io.setImageBandLayerType(1, kealib::kea_thematic);
+        std::vector<uint32_t> elimSegs(30 * 10);
+        for( int i = 0; i < (30 * 10); i++ )
+        {
+            int x = i % 30;
+            elimSegs[i] = (x < 10) ? 1 : ((x < 12) ? 2 : 3);
+        }
+        io.writeImageBlock2Band(1, elimSegs.data(), 0, 0, 30, 10, 30, 10, kealib::kea_32uint);
+        io.calcSegmentExtents(1, 4);
+        pRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        pRat->addAttFloatField("Mean", 0);
+        double means[] = {0.0, 1.0, 9.0, 10.0};
+        pRat->setFloatFields(0, 4, pRat->getFieldIndex("Mean"), means);
+        std::vector<size_t> elimNeighbours[] = {{}, {2}, {1, 3}, {2}};
+        std::vector<std::vector<size_t>* > elimNeighbourPtrs = {&elimNeighbours[0], &elimNeighbours[1],
+                    &elimNeighbours[2], &elimNeighbours[3]};
+        pRat->setNeighbours(0, 4, &elimNeighbourPtrs);
+        size_t meanCol = pRat->getField("Mean").colNum;
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        
+        mapping = io.eliminateSmallSegments(1, 50, std::vector<size_t>(1, meanCol), 4);
+        io.readImageBlock2Band(1, elimSegs.data(), 0, 0, 30, 10, 30, 10, kealib::kea_32uint);
+        pRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        pRat->getFloatFields(0, 2, pRat->getFieldIndex("Mean"), means);
+        int64_t elimCounts[2];
+        pRat->getIntFields(0, 2, pRat->getFieldIndex(kealib::KEA_ATT_PIXELCOUNT_FIELD), elimCounts);
+        bool elimOk = (pRat->getSize() == 2) && (mapping.size() >= 4) && (mapping[1] == 0) &&
+                      (mapping[2] == 1) && (mapping[3] == 1) && (elimCounts[0] == 100) &&
+                      (elimCounts[1] == 200) && (means[0] == 1.0) && (std::abs(means[1] - 9.9) < 1e-9);
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        for( int i = 0; elimOk && (i < (30 * 10)); i++ )
+        {
+            elimOk = (elimSegs[i] == (((i % 30) < 10) ? 0u : 1u));
+        }
+        if( !elimOk )
+        {
+            fprintf(stderr, "Small segment not merged into its most similar neighbour\n");
+            return 1;
+        }
+        io.close();
+
+        // the neighbour graph should be the same whether loaded from the
+        // file or an in memory table, and across several blocks of rows
+        h5file = kealib::KEAImageIO::createKEAImage("bob_graph.kea", kealib::kea_32uint, 8, 1, 1);
+        io.openKEAImageHeader(h5file);
+        io.setImageBandLayerType(1, kealib::kea_thematic);
+        pRat = io.getAttributeTable(kealib::kea_att_file, 1);
+        pRat->addRows(8);
+        pRat->addAttFloatField("Val", 0);
+        double graphVals[] = {1, 2, 3, 4, 5, 6, 0, 8};
+        pRat->setFloatFields(0, 8, pRat->getFieldIndex("Val"), graphVals);
+        size_t valCol = pRat->getField("Val").colNum;
+        // 9 is not a row of the table so should be ignored
+        std::vector<size_t> graphNeighbours[] = {{1}, {0, 2}, {1, 9}, {4}, {3}, {}, {7}, {6}};
+        std::vector<std::vector<size_t>* > graphNeighbourPtrs;
+        for( std::vector<size_t> &rowNeighbours : graphNeighbours )
+        {
+            graphNeighbourPtrs.push_back(&rowNeighbours);
+        }
+        pRat->setNeighbours(0, 8, &graphNeighbourPtrs);
+        kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+        for( kealib::KEAATTType attType : {kealib::kea_att_file, kealib::kea_att_mem} )
+        {
+            pRat = io.getAttributeTable(attType, 1);
+            kealib::KEANeighbourGraph graph;
+            graph.load(pRat, 3);
+            std::vector<uint64_t> components;
+            size_t numComponents = graph.connectedComponents(pRat, valCol, [](double val){ return val > 0; }, &components, 4);
+            kealib::KEAAttributeTable::destroyAttributeTable(pRat);
+            std::vector<double> neighbourMeans;
+            graph.aggregateNeighbours(std::vector<double>(graphVals, graphVals + 8), kealib::kea_nagg_mean, &neighbourMeans, 4);
+            
+            bool graphOk = (graph.getNumNodes() == 8) && (graph.getNumEdges() == 8) &&
+                           (graph.getNumNeighbours(2) == 1) && (graph.getNeighbours(2)[0] == 1) &&
+                           (numComponents == 4) &&
+                           (components == std::vector<uint64_t>{0, 0, 0, 1, 1, 2, kealib::KEA_NO_COMPONENT, 3}) &&
+                           (neighbourMeans == std::vector<double>{2, 2, 2, 5, 4, 0, 8, 0});
+            if( !graphOk )
+            {
+                fprintf(stderr, "Neighbour graph not loaded, labelled or aggregated from the %s table\n",
+                        (attType == kealib::kea_att_file) ? "file" : "in memory");
+                return 1;
+            }
+        }
         io.close();
     }
     catch(const kealib::KEAException &e)